@@ -0,0 +1,61 @@
+# Writes data/assets.manifest right before littlefs.bin is built.
+#
+# Loaded as a post: script because the platform defines ESP32_FS_IMAGE_NAME
+# only after pre: scripts have run, and the target below is substituted when
+# AddPreAction is called.
+#
+# One line per asset the web server serves: request path, size, 1 if the
+# content is gzipped (stored as path + ".gz" unless the path already ends in
+# .gz), the first 16 hex digits of its SHA-1 (the ETag) and the MIME type. See lib/SS2K/include/AssetManifest.h.
+import hashlib
+import mimetypes
+import os
+
+Import("env")
+
+MANIFEST = "assets.manifest"
+TYPES = {
+    ".html": "text/html",
+    ".htm": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".ico": "image/x-icon",
+    ".png": "image/png",
+    ".svg": "image/svg+xml",
+}
+
+
+def mime_type(path):
+    ext = os.path.splitext(path)[1].lower()
+    return TYPES.get(ext) or mimetypes.guess_type(path)[0] or "application/octet-stream"
+
+
+def build_manifest(source, target, env):
+    data_dir = env.subst("$PROJECT_DATA_DIR")
+    if not os.path.isdir(data_dir):
+        return
+    lines = ["# path\tsize\tgzip\thash\tmime"]
+    for root, _, files in os.walk(data_dir):
+        for name in sorted(files):
+            if name == MANIFEST:
+                continue
+            full = os.path.join(root, name)
+            path = "/" + os.path.relpath(full, data_dir).replace(os.sep, "/")
+            with open(full, "rb") as f:
+                content = f.read()
+            digest = hashlib.sha1(content).hexdigest()[:16]
+            if path.endswith(".gz"):
+                # Requested as is (e.g. jquery.js.gz), typed by the file inside.
+                lines.append("%s\t%d\t1\t%s\t%s" % (path, len(content), digest, mime_type(path[:-3])))
+                # and preferred over an uncompressed copy for the plain name.
+                plain = path[:-3]
+                lines.append("%s\t%d\t1\t%s\t%s" % (plain, len(content), digest, mime_type(plain)))
+            elif not os.path.exists(full + ".gz"):
+                lines.append("%s\t%d\t0\t%s\t%s" % (path, len(content), digest, mime_type(path)))
+    with open(os.path.join(data_dir, MANIFEST), "w", newline="\n") as f:
+        f.write("\n".join(lines) + "\n")
+    print("Wrote %s with %d assets" % (MANIFEST, len(lines) - 1))
+
+
+env.AddPreAction("$BUILD_DIR/${ESP32_FS_IMAGE_NAME}.bin", build_manifest)
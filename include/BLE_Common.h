@@ -13,6 +13,11 @@
 #include <NimBLEDevice.h>
 #include <Arduino.h>
 #include <Main.h>
+#include <AdvertisementFilter.h>
+#include <ScanResultCache.h>
+#include <HIDReportMap.h>
+#include <HIDKeyMapper.h>
+#include <transport/Transport.h>
 
 #define BLE_CLIENT_LOG_TAG  "BLE_Client"
 #define BLE_COMMON_LOG_TAG  "BLE_Common"
@@ -85,7 +90,8 @@ class ss2kCustomCharacteristicCallbacks : public BLECharacteristicCallbacks {
 extern std::string FTMSWrite;
 
 // TODO add the rest of the server to this class
-class SpinBLEServer {
+// Also the ServerTransport the sensor pipeline notifies connected apps through.
+class SpinBLEServer : public ServerTransport {
  public:
   struct {
     bool Heartrate : 1;
@@ -95,6 +101,8 @@ class SpinBLEServer {
 
   void setClientSubscribed(NimBLEUUID pUUID, bool subscribe);
   void notifyShift();
+  bool isSubscribed(const NimBLEUUID &charUUID) const override;
+  void notify(const NimBLEUUID &charUUID, const uint8_t *data, size_t length) override;
 
   SpinBLEServer() { memset(&clientSubscribed, 0, sizeof(clientSubscribed)); }
 };
@@ -105,10 +113,8 @@ void startBLEServer();
 bool spinDown();
 void logCharacteristic(char *buffer, const size_t bufferCapacity, const byte *data, const size_t dataLength, const NimBLEUUID serviceUUID, const NimBLEUUID charUUID,
                        const char *format, ...);
-void updateIndoorBikeDataChar();
-void updateCyclingPowerMeasurementChar();
 void calculateInstPwrFromHR();
-void updateHeartRateMeasurementChar();
+void calibrateHRToPower();
 int connectedClientCount();
 void controlPointIndicate();
 void processFTMSWrite();
@@ -159,11 +165,46 @@ class SpinBLEAdvertisedDevice {
   bool isRemote         = false;
   bool doConnect        = false;
   bool postConnected    = false;
+  // Resolved once the subscription succeeds so the communications loop doesn't walk the GATT table.
+  NimBLEClient *pClient                             = nullptr;
+  NimBLERemoteCharacteristic *pRemoteCharacteristic = nullptr;
+  // Battery level characteristic, cached at connect. Only set when it has to be polled.
+  NimBLERemoteCharacteristic *battCharacteristic    = nullptr;
+  unsigned long lastBatteryUpdate                   = 0;
   void set(BLEAdvertisedDevice *device, int id = BLE_HS_CONN_HANDLE_NONE, BLEUUID inServiceUUID = (uint16_t)0x0000, BLEUUID inCharUUID = (uint16_t)0x0000);
   void reset();
   void print();
   bool enqueueData(uint8_t data[25], size_t length);
   NotifyData dequeueData();
+  void setBatteryLevel(uint8_t level);
+};
+
+// Device records for every connection the BLE stack can hold. Sensors are looked up
+// by connection handle from the notify callbacks, so the table is indexed by handle.
+// The index is rebuilt from the client task, the comms loop and the NimBLE host
+// callbacks while notifications read it, so both hold handleLock.
+class SpinBLEDevicePool {
+ public:
+  SpinBLEDevicePool() { rebuildHandleIndex(); }
+
+  size_t size() const { return BLE_DEVICE_POOL_SIZE; }
+  SpinBLEAdvertisedDevice &operator[](size_t i) { return devices[i]; }
+
+  // Record for a newly discovered device: the slot already holding this address, else the first free one.
+  SpinBLEAdvertisedDevice *acquire(const NimBLEAddress &address);
+  SpinBLEAdvertisedDevice *findByAddress(const NimBLEAddress &address);
+  SpinBLEAdvertisedDevice *findByConnHandle(uint16_t connHandle);
+  int indexOf(const SpinBLEAdvertisedDevice *device) const;
+  // Number of records bound to a live connection.
+  size_t connectedCount() const;
+  // Keep the handle index in sync after connectedClientID changes.
+  void rebuildHandleIndex();
+
+ private:
+  SpinBLEAdvertisedDevice devices[BLE_DEVICE_POOL_SIZE];
+  // Open addressed on connHandle % size; holds the slot number or -1.
+  int8_t handleIndex[BLE_DEVICE_POOL_SIZE];
+  portMUX_TYPE handleLock = portMUX_INITIALIZER_UNLOCKED;
 };
 
 class SpinBLEClient {
@@ -178,19 +219,33 @@ class SpinBLEClient {
   bool dontBlockScan         = true;
   bool intentionalDisconnect = false;
   int noReadingIn            = 0;
-  int cscCumulativeCrankRev  = 0;
-  int cscLastCrankEvtTime    = 0;
   int reconnectTries         = MAX_RECONNECT_TRIES;
+  int lastScanDuration       = 0;
 
   BLERemoteCharacteristic *pRemoteCharacteristic = nullptr;
 
-  // BLEDevices myBLEDevices;
-  SpinBLEAdvertisedDevice myBLEDevices[NUM_BLE_DEVICES];
+  SpinBLEDevicePool myBLEDevices;
+
+  // Compiled form of the configured device selections used by the scan callback.
+  AdvertisementFilter advertisementFilter;
+  // Supported devices seen while scanning, updated from the scan callback.
+  ScanResultCache scanResults;
+  // Report map of the connected remote and the configured key bindings.
+  HIDReportMap remoteReportMap;
+  HIDKeyMapper remoteKeys;
+  // Report ID of each subscribed remote input report characteristic.
+  uint16_t remoteReportHandles[HID_REPORT_MAP_MAX_REPORTS];
+  uint8_t remoteReportIds[HID_REPORT_MAP_MAX_REPORTS];
+  size_t remoteReportCount = 0;
 
   void start();
+  // Recompile the advertisement filter after the device selections change.
+  void updateAdvertisementFilter();
   // void serverScan(bool connectRequest);
   bool connectToServer();
   void scanProcess(int duration = DEFAULT_SCAN_DURATION);
+  // Serialize the recently seen devices in the foundDevices JSON format.
+  String getFoundDevicesJSON();
   // Check for duplicate services of BLEClient and remove the previously
   // connected one.
   void removeDuplicates(NimBLEClient *pClient);
@@ -199,8 +254,24 @@ class SpinBLEClient {
   void FTMSControlPointWrite(const uint8_t *pData, int length);
   void connectBLE_HID(NimBLEClient *pClient);
   void keepAliveBLE_HID(NimBLEClient *pClient);
+  // Reload the remote key bindings from userConfig.
+  void updateRemoteKeyMap();
+  // Decode a remote input report and apply the bound action.
+  void handleRemoteReport(uint16_t handle, const uint8_t *pData, size_t length);
+  void handleRemoteAction(HIDKeyMapper::Action action);
+  // Resolve long / double presses and keep the remote connection alive. Runs in the client task.
+  void pollRemote();
   void checkBLEReconnect();
-  void handleBattInfo(NimBLEClient *pClient, bool updateNow);
+  // Queue a connection to a selected device of the category from the last scan's results.
+  bool reconnectFromScanResults(AdvertisementFilter::Category category, const DeviceSelection &selection);
+  // Rebuild the connection handle index and the connectedXX flags from myBLEDevices.
+  void connectionsChanged();
+  // Connections to keep free for the configured sensors.
+  int reservedConnections();
+  // Subscribe to battery level notifications, or cache the characteristic for polling.
+  void setupBattery(NimBLEClient *pClient, SpinBLEAdvertisedDevice *device);
+  // Poll the battery levels that can't be notified. Runs in the client task.
+  void updateBatteries();
 };
 
 class MyAdvertisedDeviceCallback : public NimBLEAdvertisedDeviceCallbacks {
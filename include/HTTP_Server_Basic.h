@@ -9,6 +9,8 @@
 
 #include <Arduino.h>
 
+class AsyncWebServerRequest;
+
 #define HTTP_SERVER_LOG_TAG "HTTP_Server"
 
 class HTTP_Server {
@@ -18,13 +20,18 @@ class HTTP_Server {
 
   void start();
   void stop();
-  static void handleLittleFSFile();
-  static void handleIndexFile();
-  static void settingsProcessor();
-  static void handleHrSlider();
+  static void handleLittleFSFile(AsyncWebServerRequest *request);
+  static void handleIndexFile(AsyncWebServerRequest *request);
+  static bool serveAsset(AsyncWebServerRequest *request, const String &path);
+  static void loadAssetManifest();
+  static void settingsProcessor(AsyncWebServerRequest *request);
+  static void handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final);
+  static void handleUploadComplete(AsyncWebServerRequest *request);
+  static void restartAfterResponse();
   static void FirmwareUpdate();
-  
-  static void webClientUpdate(void *pvParameters);
+
+  static void webServerMaintenance(void *pvParameters);
+  static void telemetryUpdate(void *pvParameters);
 
   HTTP_Server() { internetConnection = false; }
 };
@@ -14,6 +14,11 @@
 #include "LittleFS_Upgrade.h"
 #include "boards.h"
 #include "SensorCollector.h"
+#include "BootTimeline.h"
+#include "PWCCollector.h"
+#include "PelotonLink.h"
+#include "DriverTelemetry.h"
+#include "ThermalController.h"
 
 #define MAIN_LOG_TAG "Main"
 
@@ -34,11 +39,14 @@ class SS2K {
   bool stepperIsRunning;
   bool externalControl;
   bool syncMode;
-  int txCheck;
+  bool pelotonIsConnected;
 
   bool IRAM_ATTR deBounce();
   static void IRAM_ATTR moveStepper(void* pvParameters);
   static void IRAM_ATTR maintenanceLoop(void* pvParameters);
+  static void startNetwork(void* pvParameters);
+  // Mark a boot phase as done in bootTimeline and log it.
+  static void bootPhase(const char* phase);
   static void IRAM_ATTR shiftUp();
   static void IRAM_ATTR shiftDown();
   void resetIfShiftersHeld();
@@ -48,12 +56,14 @@ class SS2K {
   void setupTMCStepperDriver();
   void updateStepperPower();
   void updateStealthChop();
+  void pollDriverTelemetry();
   void checkDriverTemperature();
   void motorStop(bool releaseTension = false);
   void FTMSModeShiftModifier();
   static void rxSerial(void);
   void txSerial();
   void pelotonConnected();
+  void pelotonDisconnected();
 
   SS2K() {
     targetPosition      = 0;
@@ -67,27 +77,26 @@ class SS2K {
     shiftersHoldForScan = SHIFTERS_HOLD_FOR_SCAN;
     scanDelayTime       = 10000;
     scanDelayStart      = 0;
-    txCheck             = TX_CHECK_INTERVAL;
-  }
-};
-
-class AuxSerialBuffer {
- public:
-  uint8_t data[AUX_BUF_SIZE];
-  size_t len;
-
-  AuxSerialBuffer() {
-    for (int i = 0; i < AUX_BUF_SIZE; i++) {
-      this->data[i] = 0;
-    }
-    this->len = 0;
+    pelotonIsConnected  = false;
   }
 };
 
 // Users Physical Working Capacity Calculation Parameters (heart rate to Power
 // calculation)
 extern physicalWorkingCapacity userPWC;
+// Learns userPWC from rides with both a heart rate monitor and a power meter, served at /pwcCalibration.json
+extern PWCCollector pwcCollector;
 extern SS2K ss2k;
+// Woken early when a shift needs to be applied.
+extern TaskHandle_t maintenanceLoopTask;
+// Peloton frames (PelotonFramer::Frame) split out by SS2K::rxSerial, decoded in BLECommunications
+extern QueueHandle_t pelotonFrameQueue;
+// Frames and paces the Peloton serial traffic, its stats are served at /peloton.json
+extern PelotonLink pelotonLink;
+// Stepper driver status read over its UART, served at /driver.json
+extern DriverTelemetry driverTelemetry;
+// When each boot phase finished, served at /boot.json
+extern BootTimeline bootTimeline;
 
 // Main program variable that stores most everything
 extern userParameters userConfig;
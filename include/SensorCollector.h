@@ -7,8 +7,25 @@
 #include <NimBLEDevice.h>
 #include <Arduino.h>
 #include <Main.h>
+#include <PacketCapture.h>
+#include <SensorPipeline.h>
 
 #pragma once
 
+// Decodes sensor data into rtConfig and notifies the apps connected to our server
+extern SensorPipeline sensorPipeline;
+// Raw sensor traffic passed to collectAndSet(), paused while replaying.
+extern PacketCapture packetCapture;
+// Replayed packets (SensorNotification) waiting for BLECommunications, created by the first replay
+extern QueueHandle_t packetReplayQueue;
 
-void collectAndSet(NimBLEUUID charUUID, NimBLEUUID serviceUUID, NimBLEAddress address, uint8_t *pData, size_t length);
\ No newline at end of file
+void collectAndSet(NimBLEUUID charUUID, NimBLEUUID serviceUUID, NimBLEAddress address, uint8_t *pData, size_t length);
+
+/**
+ * @brief Feed the current capture back through collectAndSet(). A background task paces the packets
+ *        onto packetReplayQueue and BLECommunications decodes them with the live traffic.
+ * @param [in] speed Playback speed, 1 is as recorded.
+ * @return False if a replay is running or there is nothing to replay.
+ */
+bool startPacketReplay(float speed);
+bool packetReplayRunning();
@@ -13,8 +13,31 @@
 #include <ArduinoFake.h>
 #endif
 
+#include <JsonWriter.h>
+#include <ConfigFile.h>
+#include <ConfigRecord.h>
+#include <DeviceSelection.h>
+#include <HRPowerEstimator.h>
+
 #define CONFIG_LOG_TAG "Config"
 
+// Streams JSON into anything Arduino can print to, e.g. a LittleFS File, and keeps its CRC.
+class PrintJsonOutput : public JsonOutput {
+ public:
+  explicit PrintJsonOutput(Print &print) : print(print) {}
+  void write(const char *data, size_t length) override {
+    written += print.write(reinterpret_cast<const uint8_t *>(data), length);
+    checksum = ConfigFile::crc32(reinterpret_cast<const uint8_t *>(data), length, checksum);
+  }
+  size_t size() const { return written; }
+  uint32_t crc() const { return checksum; }
+
+ private:
+  Print &print;
+  size_t written    = 0;
+  uint32_t checksum = 0;
+};
+
 class Measurement {
  private:
   bool simulate;
@@ -102,7 +125,7 @@ class RuntimeParameters {
   void setMaxResistance(int max) { maxResistance = max; }
   int getMaxResistance() { return maxResistance; }
 
-  String returnJSON();
+  void writeJSON(JsonWriter &json);
 };
 
 class userParameters {
@@ -122,18 +145,21 @@ class userParameters {
   bool shifterDir;
   bool udpLogEnabled = false;
   bool logComm       = false;
-  String ssid;
-  String password;
-  String connectedPowerMeter   = CONNECTED_POWER_METER;
-  String connectedHeartMonitor = CONNECTED_HEART_MONITOR;
-  String connectedRemote    = CONNECTED_REMOTE;
-  String foundDevices          = " ";
+  int telemetryInterval;
+  int updateCheckInterval;
+  char ssid[WIFI_SSID_MAX_LENGTH + 1]         = DEVICE_NAME;
+  char password[WIFI_PASSWORD_MAX_LENGTH + 1] = DEFAULT_PASSWORD;
+  DeviceSelection connectedPowerMeter   = CONNECTED_POWER_METER;
+  DeviceSelection connectedHeartMonitor = CONNECTED_HEART_MONITOR;
+  DeviceSelection connectedRemote       = CONNECTED_REMOTE;
+  String remoteKeyMap       = REMOTE_KEY_MAP;
 
  public:
-  void setFirmwareUpdateURL(String fURL) { firmwareUpdateURL = fURL; }
+  // The string settings are set under a lock so snapshot() never copies one while it is replaced.
+  void setFirmwareUpdateURL(String fURL);
   const char* getFirmwareUpdateURL() { return firmwareUpdateURL.c_str(); }
 
-  void setDeviceName(String dvn) { deviceName = dvn; }
+  void setDeviceName(String dvn);
   const char* getDeviceName() { return deviceName.c_str(); }
 
   void setShiftStep(int ss) { shiftStep = ss; }
@@ -154,20 +180,27 @@ class userParameters {
   void setAutoUpdate(bool atd) { autoUpdate = atd; }
   bool getAutoUpdate() { return autoUpdate; }
 
-  void setSsid(String sid) { ssid = sid; }
-  const char* getSsid() { return ssid.c_str(); }
+  void setSsid(const char* sid);
+  const char* getSsid() { return ssid; }
 
-  void setPassword(String pwd) { password = pwd; }
-  const char* getPassword() { return password.c_str(); }
+  void setPassword(const char* pwd);
+  const char* getPassword() { return password; }
 
-  void setConnectedPowerMeter(String cpm) { connectedPowerMeter = cpm; }
+  // The sensor selections are classified when set, see DeviceSelection.
+  void setConnectedPowerMeter(const char* cpm);
   const char* getConnectedPowerMeter() { return connectedPowerMeter.c_str(); }
+  const DeviceSelection& getPowerMeterSelection() { return connectedPowerMeter; }
 
-  void setConnectedHeartMonitor(String cHr) { connectedHeartMonitor = cHr; }
+  void setConnectedHeartMonitor(const char* cHr);
   const char* getConnectedHeartMonitor() { return connectedHeartMonitor.c_str(); }
+  const DeviceSelection& getHeartMonitorSelection() { return connectedHeartMonitor; }
 
-  void setConnectedRemote(String cRemote) { connectedRemote = cRemote; }
-  const char* getConnectedRemote() { return connectedRemote.c_str();}
+  void setConnectedRemote(const char* cRemote);
+  const char* getConnectedRemote() { return connectedRemote.c_str(); }
+  const DeviceSelection& getRemoteSelection() { return connectedRemote; }
+
+  void setRemoteKeyMap(String map);
+  const char* getRemoteKeyMap() { return remoteKeyMap.c_str(); }
 
   void setStepperPower(int sp) { stepperPower = sp; }
   int getStepperPower() { return stepperPower; }
@@ -190,14 +223,30 @@ class userParameters {
   void setLogComm(bool lgcm) { logComm = lgcm; }
   bool getLogComm() { return logComm; }
 
-  void setFoundDevices(String fdv) { foundDevices = fdv; }
-  const char* getFoundDevices() { return foundDevices.c_str(); }
+  void setTelemetryInterval(int ti) { telemetryInterval = ti; }
+  int getTelemetryInterval() { return telemetryInterval; }
+
+  void setUpdateCheckInterval(int uci) { updateCheckInterval = uci; }
+  int getUpdateCheckInterval() { return updateCheckInterval; }
 
   void setDefaults();
-  String returnJSON();
+  // A copy that is safe to serialize while other tasks change the settings.
+  userParameters snapshot();
+  void writeJSON(JsonWriter &json, const String &foundDevices);
   void saveToLittleFS();
   void loadFromLittleFS();
-  void printFile();
+  // Apply the JSON backup (e.g. after it was uploaded) and save it as the binary record.
+  bool importFromLittleFS();
+  // Save after a burst of changes settles, see SaveDebouncer.
+  void requestSave();
+  // Write a requested save if it is due, or right away if forced (e.g. before a reboot).
+  void savePending(bool force = false);
+
+ private:
+  void writeSettings(JsonWriter &json);
+  bool importJSON(const String &content);
+  void writeRecord(ConfigRecordWriter &record);
+  void readRecord(ConfigRecordReader &record);
 };
 
 class physicalWorkingCapacity {
@@ -206,11 +255,29 @@ class physicalWorkingCapacity {
   int session1Pwr;
   int session2HR;
   int session2Pwr;
+  // Sessions after the first two (session3HR, session3Pwr, ...), unused ones are 0.
+  HRPowerPoint extraSessions[HR_POWER_MAX_POINTS - 2];
   bool hr2Pwr;
+  // The sessions were entered by the rider or saved by a calibration, not the setDefaults() examples.
+  bool sessionsMeasured;
+
+  // Copies every session, the first two included, for HRPowerEstimator::setCalibration().
+  size_t getSessions(HRPowerPoint *out, size_t capacity) const;
+  // Replaces every session, the ones past count are cleared.
+  void setSessions(const HRPowerPoint *sessions, size_t count);
+  // Whether the sessions are still the setDefaults() examples, for files saved before sessionsMeasured.
+  bool hasDefaultSessions() const;
 
   void setDefaults();
-  String returnJSON();
+  void writeJSON(JsonWriter &json);
   void saveToLittleFS();
   void loadFromLittleFS();
-  void printFile();
+  bool importFromLittleFS();
+  void requestSave();
+  void savePending(bool force = false);
+
+ private:
+  bool importJSON(const String &content);
+  void writeRecord(ConfigRecordWriter &record);
+  void readRecord(ConfigRecordReader &record);
 };
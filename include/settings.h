@@ -34,12 +34,30 @@
 
 #define DATA_FILELIST "/list.json"
 
+// Longest WiFi SSID and WPA passphrase
+#define WIFI_SSID_MAX_LENGTH     32
+#define WIFI_PASSWORD_MAX_LENGTH 64
+
 // name of local file to save configuration in LittleFS
 #define configFILENAME "/config.txt"
 
 // name of local file to save Physical Working Capacity in LittleFS
 #define userPWCFILENAME "/userPWC.txt"
 
+// Binary records the settings are loaded from, the JSON files above are backups for import and export
+#define configRecordFILENAME  "/config.bin"
+#define userPWCRecordFILENAME "/userPWC.bin"
+
+// Layout versions of the binary records, bump when a field is appended or changes meaning
+#define USERCONFIG_RECORD_VERSION 2
+#define USERPWC_RECORD_VERSION    2
+
+// Max size of a binary config record
+#define CONFIG_RECORD_MAX_SIZE 1024
+
+// Longest remote key map kept, longer maps are cut after the last whole binding that fits
+#define REMOTE_KEY_MAP_MAX_LENGTH 512
+
 // Default Incline Multiplier.
 // Incline multiplier is the multiple required to convert incline received from the remote client (percent grade*100)
 // into actual stepper steps that move the stepper motor. It takes 2,181.76 steps to rotate the knob 1 full revolution. with hardware version 1.
@@ -209,11 +227,43 @@
 // loop speed for the SmartSpin2k BLE Client reconnect
 #define BLE_CLIENT_DELAY 101
 
-// Number of devices that can be connected to the Client (myBLEDevices size)
-#define NUM_BLE_DEVICES 4
+// Number of device records the Client can track (myBLEDevices size). One per possible connection.
+#define BLE_DEVICE_POOL_SIZE CONFIG_BT_NIMBLE_MAX_CONNECTIONS
+
+// loop speed for the captive portal DNS server (AP mode only, HTTP requests are event driven)
+#define DNS_SERVER_DELAY 7
+
+// How often the MDNS service record is refreshed
+#define MDNS_REFRESH_DELAY 30000
+
+// Default interval between live telemetry frames pushed to /events, in ms.
+#define TELEMETRY_INTERVAL 100
+
+// Allowed range of the telemetry interval setting, in ms.
+#define MIN_TELEMETRY_INTERVAL 50
+#define MAX_TELEMETRY_INTERVAL 5000
+
+// Default hours between firmware version checks. Boots in between don't touch the network for it.
+#define UPDATE_CHECK_INTERVAL 24
+
+// Allowed range of the update check interval setting, in hours. 0 checks at every boot.
+#define MIN_UPDATE_CHECK_INTERVAL 0
+#define MAX_UPDATE_CHECK_INTERVAL 720
+
+// Result of the last firmware version check (see UpdateCheck)
+#define UPDATE_CHECK_FILENAME "/updateCheck.bin"
 
-// loop speed for the Webserver
-#define WEBSERVER_DELAY 7
+// Static asset index written by build_asset_manifest.py into the filesystem image
+#define ASSET_MANIFEST_FILENAME "/assets.manifest"
+
+// A download that stalls this long is dropped, in ms. The next attempt resumes it.
+#define ASSET_UPDATE_READ_TIMEOUT 5000
+
+// Cache-Control for static assets other than HTML, which is always revalidated
+#define ASSET_CACHE_CONTROL "public, max-age=86400"
+
+// Buffer for one telemetry frame. A keyframe of every runtime value is about 400 bytes.
+#define TELEMETRY_FRAME_SIZE 512
 
 // Name of default Power Meter. any connects to anything, none connects to
 // nothing.
@@ -227,6 +277,10 @@
 // nothing.
 #define CONNECTED_REMOTE "none"
 
+// Default BLE remote key bindings, KEY[.long|.double]=up|down|ergUp|ergDown|mode.
+// Raw 04/08 reports, mouse buttons 3/4 and consumer volume up/down shift.
+#define REMOTE_KEY_MAP "0004=up,0008=down,9003=up,9004=down,c0e9=up,c0ea=down"
+
 // number of main loops the shifters need to be held before a BLE scan is
 // initiated.
 #define SHIFTERS_HOLD_FOR_SCAN 2
@@ -240,7 +294,8 @@
 // Max size of userconfig
 #define USERCONFIG_JSON_SIZE 1524 + DEBUG_LOG_BUFFER_SIZE
 
-#define RUNTIMECONFIG_JSON_SIZE 512 + DEBUG_LOG_BUFFER_SIZE
+// Largest buffer a chunked JSON response is serialized into. Bigger documents are serialized once per buffer full.
+#define JSON_RESPONSE_BUFFER_SIZE 4096
 
 /* Number of entries in the ERG Power Lookup Table
  This is currently maintained as to keep memory usage lower and reduce the print output of the table.
@@ -257,18 +312,18 @@
 // Normal cadence value (used in power table and other areas)
 #define NORMAL_CAD 90
 
-// Temperature of the ESP32 at which to start reducing the power output of the stepper motor driver.
+// Temperature of the ESP32 at which to start reducing the power output of the stepper motor driver (see ThermalController.h).
 #define THROTTLE_TEMP 85
 
-// Size of the Aux Serial Buffer for Peloton
-#define AUX_BUF_SIZE 10
+// Receive ring of the Peloton aux serial port (UART driver buffer), in bytes
+#define PELOTON_RX_BUFFER_SIZE 256
+
+// Peloton frames waiting for the BLE communications task
+#define PELOTON_FRAME_QUEUE_SIZE 16
 
 // Interrogate Peloton bike for data?
 #define PELOTON_TX true
 
-// If not receiving Peloton Messages, how long to wait before next TX attempt is
-#define TX_CHECK_INTERVAL 20
-
 // If ble devices are both setup, how often to attempt a reconnect.
 #define BLE_RECONNECT_INTERVAL 1
 
@@ -281,6 +336,21 @@
 // BLE automatic reconnect duration. Set this low to avoid interruption.
 #define BLE_RECONNECT_SCAN_DURATION 1
 
+// Scan results not seen for this long are left out of foundDevices.
+#define BLE_SCAN_RESULT_MAX_AGE_MILLIS 300000
+
+// A selected device seen by a scan this recently is reconnected to without scanning again.
+#define BLE_RECONNECT_RESULT_MAX_AGE_MILLIS 10000
+
+// Bytes of raw sensor traffic kept for /capture.bin. Roughly 400 power meter notifications.
+#define PACKET_CAPTURE_SIZE 8192
+
+// Replayed packets waiting for the BLE communications task
+#define PACKET_REPLAY_QUEUE_SIZE 16
+
+// Milliseconds the replay task waits for room in the queue before dropping a packet
+#define PACKET_REPLAY_QUEUE_WAIT 100
+
 // Uncomment to enable sending Telegram debug messages back to the chat
 // specified in telegram_token.h
 // #define USE_TELEGRAM
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <NimBLEUUID.h>
+#include "DeviceSelection.h"
+
+// Longest name that fits in a legacy advertisement or scan response.
+#define ADVERTISEMENT_FILTER_MAX_NAME 31
+
+/**
+ * Classifies raw advertisement payloads without touching the heap.
+ *
+ * The supported services are compiled into a table once and the configured
+ * device selections are copied by configure(), so the scan callback only walks the
+ * AD structures of each report and compares integers / hashes.
+ */
+class AdvertisementFilter {
+ public:
+  enum Category : uint8_t { NONE = 0, POWER_METER, HEART_MONITOR, REMOTE };
+
+  struct Result {
+    // Sensor role implied by the highest priority supported service.
+    Category category;
+    // True if the configuration wants a device of this category with this name or address.
+    bool selected;
+    // The supported service that matched, nullptr if none did.
+    const NimBLEUUID *service;
+    // Advertised name. Points into the payload and is not NUL terminated.
+    const char *name;
+    uint8_t nameLength;
+  };
+
+  AdvertisementFilter();
+
+  /**
+   * @brief Cache the configured device selections. Call whenever they change.
+   * @param [in] powerMeter "any", "none", the name or the address of the power meter.
+   * @param [in] heartMonitor "any", "none", the name or the address of the heart monitor.
+   * @param [in] remote "any", "none", the name or the address of the remote.
+   */
+  void configure(const DeviceSelection &powerMeter, const DeviceSelection &heartMonitor, const DeviceSelection &remote);
+
+  /**
+   * @brief Classify an advertisement.
+   * @param [in] payload The raw advertisement (and scan response) data.
+   * @param [in] length The length of the payload in bytes.
+   * @param [in] address The advertiser's address, for selections by address.
+   */
+  Result evaluate(const uint8_t *payload, size_t length, uint64_t address = 0) const;
+
+  /**
+   * @brief Is a device of this category wanted at all ("none" not configured)?
+   */
+  bool isEnabled(Category category) const;
+
+  /**
+   * @brief 32 bit FNV-1a hash used for the precomputed UUID and name keys.
+   */
+  static uint32_t hash(const uint8_t *data, size_t length);
+
+ private:
+  struct ServiceEntry {
+    NimBLEUUID uuid;
+    uint16_t uuid16;  // 0 for 128 bit UUIDs
+    uint32_t hash;    // FNV-1a of the little endian 128 bit value
+    Category category;
+    bool requiresFlywheelName;
+  };
+
+  static const size_t SERVICE_COUNT = 6;
+
+  ServiceEntry services[SERVICE_COUNT];
+  DeviceSelection selections[4];  // indexed by Category
+  uint32_t flywheelNameHash;
+  uint8_t flywheelNameLength;
+
+  void addService(size_t index, const NimBLEUUID &uuid, Category category, bool requiresFlywheelName);
+  uint8_t matchUUID16(uint16_t uuid) const;
+  uint8_t matchUUID128(const uint8_t *uuid) const;
+  bool isFlywheelName(const char *name, uint8_t length) const;
+};
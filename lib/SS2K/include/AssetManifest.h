@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Static assets the manifest can describe.
+#define ASSET_MANIFEST_MAX_ENTRIES 32
+// Longest request path, including the leading slash.
+#define ASSET_MANIFEST_MAX_PATH 48
+// Longest MIME type.
+#define ASSET_MANIFEST_MAX_MIME 32
+// Quoted ETag, 16 hex digits of the content hash plus quotes.
+#define ASSET_MANIFEST_ETAG_LENGTH 18
+
+/**
+ * Index of the static web assets in the filesystem image.
+ *
+ * Built by build_asset_manifest.py when littlefs.bin is created and loaded once at
+ * boot, so requests for known assets don't need LittleFS.exists() or a content type
+ * guess. One asset per line, tab separated:
+ *
+ *   /style.css<TAB>4711<TAB>1<TAB>0123456789abcdef<TAB>text/css
+ *
+ * i.e. request path, size served, 1 if the content is gzipped (stored as path + ".gz"
+ * unless the path already ends in .gz), content hash and MIME type. Lines starting
+ * with '#' are ignored.
+ */
+class AssetManifest {
+ public:
+  struct Entry {
+    char path[ASSET_MANIFEST_MAX_PATH + 1];
+    char mime[ASSET_MANIFEST_MAX_MIME + 1];
+    char etag[ASSET_MANIFEST_ETAG_LENGTH + 1];
+    uint32_t size;
+    bool gzip;
+  };
+
+  /**
+   * @brief Replace the entries with the ones in a manifest.
+   * @return The number of entries loaded. Malformed lines are skipped.
+   */
+  size_t load(const char *text, size_t length);
+  void clear();
+  size_t size() const;
+
+  /**
+   * @brief Copy the entry for a request path.
+   * @return False if the path isn't in the manifest.
+   */
+  bool find(const char *path, Entry *entry) const;
+  // Copy the entry at index, for walking the whole manifest.
+  bool at(size_t index, Entry *entry) const;
+
+  // Forget an asset whose file was replaced, it's then served without caching headers.
+  void remove(const char *path);
+
+  /**
+   * @brief Does an If-None-Match header match the ETag?
+   * @details Handles lists, weak validators (W/"...") and "*".
+   */
+  static bool etagMatches(const char *ifNoneMatch, const char *etag);
+
+  // The file an entry is stored in, path + ".gz" for gzipped content. At least ASSET_MANIFEST_MAX_PATH + 4 bytes.
+  static void storedPath(const Entry &entry, char *out, size_t capacity);
+
+ private:
+  mutable std::mutex mutex;
+  Entry entries[ASSET_MANIFEST_MAX_ENTRIES];
+  size_t count = 0;
+};
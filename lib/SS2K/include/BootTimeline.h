@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "JsonWriter.h"
+
+// Boot phases the timeline can hold, later marks are dropped.
+#define BOOT_TIMELINE_MAX_PHASES 16
+
+/**
+ * When each boot phase finished, in milliseconds since reset.
+ *
+ * setup() marks the phases that make the trainer usable and the network task marks
+ * the ones it defers, so marks can come from several tasks. Phase names must be
+ * string literals, they are stored as pointers.
+ */
+class BootTimeline {
+ public:
+  BootTimeline() {}
+  // Copies the marks under the other timeline's lock, a snapshot for serializing.
+  BootTimeline(const BootTimeline &other);
+  BootTimeline &operator=(const BootTimeline &) = delete;
+
+  /**
+   * @brief Record that a phase finished.
+   * @return Milliseconds since the previous mark (since reset for the first one).
+   */
+  uint32_t mark(const char *phase, uint32_t now);
+  size_t size() const;
+
+  // {"phase":millis,...} in the order the phases finished.
+  void writeJSON(JsonWriter &json) const;
+
+ private:
+  struct Phase {
+    const char *name;
+    uint32_t at;
+  };
+
+  mutable std::mutex mutex;
+  Phase phases[BOOT_TIMELINE_MAX_PHASES];
+  size_t count      = 0;
+  uint32_t lastMark = 0;
+};
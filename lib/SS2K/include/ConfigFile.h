@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// A change is saved once the settings have been quiet this long.
+#define CONFIG_SAVE_DEBOUNCE_MILLIS 2000
+// Keeps changing settings from postponing the save forever.
+#define CONFIG_SAVE_MAX_DELAY_MILLIS 10000
+// Longest trailer written after the content, see ConfigFile::trailer().
+#define CONFIG_FILE_TRAILER_LENGTH 17
+
+/**
+ * Integrity check for config files that are written to a temporary file and renamed.
+ *
+ * The content is followed by "\n#crc32=xxxxxxxx\n", the CRC-32 of everything before
+ * it. Readers that stop at the end of the JSON value never see it, and files written
+ * before the check existed (or uploaded by hand) load as UNCHECKED.
+ */
+class ConfigFile {
+ public:
+  enum Check : uint8_t { VALID = 0, UNCHECKED, CORRUPT };
+
+  // CRC-32 (IEEE 802.3), pass the previous result to continue over several buffers.
+  static uint32_t crc32(const uint8_t *data, size_t length, uint32_t crc = 0);
+
+  /**
+   * @brief Format the trailer for content with this CRC.
+   * @param [out] out At least CONFIG_FILE_TRAILER_LENGTH + 1 bytes.
+   * @return The trailer length.
+   */
+  static size_t trailer(uint32_t crc, char *out);
+
+  /**
+   * @brief Check a file read back in full.
+   * @param [out] contentLength Length of the content without the trailer.
+   */
+  static Check verify(const char *data, size_t length, size_t *contentLength);
+};
+
+/**
+ * Coalesces bursts of settings changes into one flash write.
+ *
+ * Call markDirty() on every change and claimSave() periodically. A save is due once
+ * no change happened for CONFIG_SAVE_DEBOUNCE_MILLIS, or CONFIG_SAVE_MAX_DELAY_MILLIS
+ * after the first unsaved change. Changes made while the claimed save is being
+ * written mark it dirty again, so they aren't lost.
+ */
+class SaveDebouncer {
+ public:
+  void markDirty(uint32_t now);
+  bool isDirty() const;
+
+  /**
+   * @brief Clear the dirty flag if a save is due.
+   * @param [in] force Claim any pending change now, e.g. before a reboot.
+   * @return True if the caller should write now. Call markDirty() if the write fails.
+   */
+  bool claimSave(uint32_t now, bool force = false);
+
+ private:
+  mutable std::mutex mutex;
+  bool dirty          = false;
+  uint32_t firstDirty = 0;
+  uint32_t lastDirty  = 0;
+};
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// "SS2K" little endian, first bytes of every config record.
+#define CONFIG_RECORD_MAGIC 0x4b325353
+// Magic, version, payload length and CRC.
+#define CONFIG_RECORD_HEADER_SIZE 12
+
+/**
+ * Binary config record, the primary store for the settings.
+ *
+ * Header: magic (uint32), version (uint16), payload length (uint16), CRC-32 of the
+ * payload (uint32), all little endian. The payload is the fields in a fixed order:
+ * bool as 1 byte, int as int32, float as IEEE 754, strings as a length byte and the
+ * characters, long strings as a uint16 length and the characters. Fields are only ever appended, so a record written by an older version
+ * just ends early and the reader keeps the defaults for the newer fields. Anything
+ * else a new version changes is migrated by the caller based on version().
+ */
+class ConfigRecordWriter {
+ public:
+  ConfigRecordWriter(uint8_t *buffer, size_t capacity, uint16_t version);
+
+  void putBool(bool value);
+  void putInt(int32_t value);
+  void putFloat(float value);
+  // Strings longer than 255 characters are truncated.
+  void putString(const char *value);
+  // For strings that can outgrow putString(), up to 65535 characters.
+  void putLongString(const char *value);
+
+  /**
+   * @brief Fill in the header.
+   * @return The record length, 0 if it didn't fit the buffer.
+   */
+  size_t finish();
+
+ private:
+  uint8_t *buffer;
+  size_t capacity;
+  size_t length;
+  uint16_t version;
+  bool overflow = false;
+
+  void put(const void *data, size_t size);
+  void putString(const char *value, size_t lengthSize);
+};
+
+class ConfigRecordReader {
+ public:
+  /**
+   * @brief Validate a record.
+   * @return False if the magic, length or CRC don't match.
+   */
+  bool open(const uint8_t *data, size_t length);
+  uint16_t version() const { return recordVersion; }
+
+  // Each getter returns the fallback once the record has no more fields.
+  bool getBool(bool fallback);
+  int32_t getInt(int32_t fallback);
+  float getFloat(float fallback);
+  /**
+   * @brief Copy the next string, truncated to the capacity and terminated.
+   * @return False (and out untouched) if the record has no more fields.
+   */
+  bool getString(char *out, size_t capacity);
+  // Reads a field written by putLongString().
+  bool getLongString(char *out, size_t capacity);
+
+ private:
+  const uint8_t *payload = nullptr;
+  size_t payloadLength   = 0;
+  size_t position        = 0;
+  uint16_t recordVersion = 0;
+
+  bool get(void *data, size_t size);
+  bool getString(char *out, size_t capacity, size_t lengthSize);
+};
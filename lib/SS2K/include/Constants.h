@@ -84,3 +84,4 @@
 #define HID_REPORT_MAP_UUID NimBLEUUID((uint16_t)0x2A4B)
 #define HID_CONTROL_POINT_UUID NimBLEUUID((uint16_t)0x2A4C)
 #define HID_REPORT_DATA_UUID NimBLEUUID((uint16_t)0x2A4D)
+#define HID_REPORT_REFERENCE_UUID NimBLEUUID((uint16_t)0x2908)
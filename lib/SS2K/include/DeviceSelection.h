@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Longest configured device name, the longest name a legacy advertisement can carry.
+#define DEVICE_SELECTION_MAX_LENGTH 31
+
+/**
+ * A configured sensor selection ("any", "none", a device name or a device address).
+ *
+ * The value lives in a fixed buffer and is classified once when it is set, so the
+ * scan callback and the notify path compare a mode and a hash instead of strings.
+ * Addresses are written like NimBLEAddress::toString(), e.g. "e8:fe:6e:91:9f:16".
+ */
+class DeviceSelection {
+ public:
+  enum Mode : uint8_t { ANY = 0, NONE, NAME, ADDRESS };
+
+  DeviceSelection(const char *value = "any") { set(value); }
+
+  // nullptr or "" select any device. Names longer than DEVICE_SELECTION_MAX_LENGTH are truncated.
+  void set(const char *value);
+  const char *c_str() const { return value; }
+  Mode getMode() const { return mode; }
+  // Is one particular device configured (not "any" or "none")?
+  bool isSpecific() const { return mode == NAME || mode == ADDRESS; }
+
+  /**
+   * @brief Does an advertised device satisfy the selection?
+   * @param [in] name The advertised name, not NUL terminated. May be nullptr.
+   * @param [in] length The length of the name.
+   * @param [in] address The device address as a 48 bit integer.
+   */
+  bool matches(const char *name, size_t length, uint64_t address) const;
+
+  // 32 bit FNV-1a
+  static uint32_t hash(const uint8_t *data, size_t length);
+  // Parse "xx:xx:xx:xx:xx:xx", returns false if it isn't an address.
+  static bool parseAddress(const char *text, uint64_t *address);
+
+ private:
+  char value[DEVICE_SELECTION_MAX_LENGTH + 1];
+  uint8_t length   = 0;
+  Mode mode        = ANY;
+  uint32_t hashKey = 0;
+  uint64_t address = 0;
+};
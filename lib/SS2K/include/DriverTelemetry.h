@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "JsonWriter.h"
+
+// Reads in a row a fault has to show up in before it's reported. Open load flickers at standstill and at speed.
+#define DRIVER_FAULT_READS 3
+// pwm_scale_sum at or above this while moving means StealthChop ran out of headroom: stalled motor or a hard stop.
+#define DRIVER_STALL_SCALE 248
+// Moving load below this share of its average means the knob is slipping.
+#define DRIVER_SLIP_RATIO 0.5f
+// Moving reads averaged before slipping is looked for.
+#define DRIVER_LOAD_SETTLE_READS 10
+
+/**
+ * Decodes the TMC2208's DRV_STATUS and PWM_SCALE registers.
+ *
+ * The TMC2208 has no StallGuard, so the StealthChop amplitude (pwm_scale_sum) is
+ * used as the load: it rises with the torque the motor needs. While moving, a
+ * saturated amplitude is a stall and one far below its running average is a
+ * slipping knob. Faults are only reported once they've been seen in
+ * DRIVER_FAULT_READS reads in a row.
+ *
+ * update() is called from the maintenance loop; getStatus() returns a copy so
+ * other tasks can read it.
+ */
+class DriverTelemetry {
+ public:
+  struct Status {
+    bool responding;        // the last DRIVER_FAULT_READS reads didn't all fail
+    bool overTempWarning;   // otpw, 120C on the driver
+    bool overTemp;          // ot, the driver has shut down
+    bool shortCircuit;      // s2ga, s2gb, s2vsa or s2vsb
+    bool openLoad;          // ola or olb while moving
+    uint8_t temperature;    // highest threshold flag set (120, 143, 150, 157), 0 below
+    uint8_t current;        // cs_actual, 0-31
+    bool stealthChop;
+    bool standstill;
+    uint8_t load;           // pwm_scale_sum
+    float loadAverage;      // while moving
+    bool stalled;
+    bool slipping;
+    uint32_t reads;
+    uint32_t failures;
+
+    // {"responding":true,"overTempWarning":false,...,"load":92,"loadAverage":88.5,"stalled":false,...}
+    void writeJSON(JsonWriter &json) const;
+  };
+
+  /**
+   * @brief Decode a read of both registers.
+   * @param [in] drvStatus DRV_STATUS.
+   * @param [in] pwmScale PWM_SCALE.
+   * @param [in] moving Whether the stepper was running, load and open load mean nothing at rest.
+   */
+  void update(uint32_t drvStatus, uint32_t pwmScale, bool moving);
+  // A read that didn't come back or failed its CRC.
+  void readFailed();
+
+  Status getStatus() const;
+
+ private:
+  mutable std::mutex mutex;
+  Status status        = {};
+  int failedReads      = 0;
+  int openLoadReads    = 0;
+  int stallReads       = 0;
+  int slipReads        = 0;
+  uint32_t movingReads = 0;
+};
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Bindings a remote key map can hold.
+#define HID_KEY_MAP_SIZE 16
+// A key held at least this long is a long press.
+#define HID_LONG_PRESS_MILLIS 600
+// Second press within this time of the first release is a double press.
+#define HID_MULTI_PRESS_MILLIS 350
+// Actions resolved by one report that haven't been returned yet.
+#define HID_ACTION_QUEUE_SIZE 4
+
+/**
+ * Turns key presses of a BLE remote into actions.
+ *
+ * Bindings are configured as a comma separated list of KEY[.GESTURE]=ACTION, where KEY
+ * is the hex key code from HIDReportMap, GESTURE is "long" or "double" and ACTION is
+ * one of up, down, ergUp, ergDown or mode. For example "c0e9=up,c0e9.long=ergUp".
+ *
+ * A key with only a plain press binding fires on key down. Keys that also have long or
+ * double press bindings fire once the gesture is known, so only those pay the latency.
+ * A press still waiting for its gesture when another key goes down is resolved as a
+ * short press first. update() and poll() return one action at a time, so when a report
+ * resolves more than one, call poll() until it returns NO_ACTION.
+ * Safe to call from the BLE host task and the client task at the same time.
+ */
+class HIDKeyMapper {
+ public:
+  enum Action : uint8_t { NO_ACTION = 0, SHIFT_UP, SHIFT_DOWN, ERG_UP, ERG_DOWN, TOGGLE_MODE };
+  enum Gesture : uint8_t { PRESS = 0, LONG_PRESS, DOUBLE_PRESS };
+
+  /**
+   * @brief Replace the bindings.
+   * @return False if any entry couldn't be parsed. Valid entries are still applied.
+   */
+  bool configure(const char *map);
+  size_t size() const;
+
+  // Report a key going down (key != 0) or all keys being released (key == 0).
+  Action update(uint16_t key, uint32_t now);
+  // Resolve gestures that complete by time passing (long press held, double press window over)
+  // and return actions queued by update().
+  Action poll(uint32_t now);
+
+  static const char *actionName(Action action);
+
+  /**
+   * @brief Length of the longest start of map that fits maxLength and ends on a whole binding.
+   */
+  static size_t fitBindings(const char *map, size_t maxLength);
+
+ private:
+  struct Binding {
+    uint16_t key;
+    Gesture gesture;
+    Action action;
+  };
+
+  mutable std::mutex mutex;
+  Binding bindings[HID_KEY_MAP_SIZE];
+  size_t count = 0;
+
+  // Key currently held
+  bool held          = false;
+  bool consumed      = false;  // its action already fired
+  uint16_t heldKey   = 0;
+  uint32_t pressedAt = 0;
+  // Key released and waiting for a possible second press
+  bool pending        = false;
+  uint16_t pendingKey = 0;
+  uint32_t releasedAt = 0;
+  // Resolved actions, oldest first
+  Action queue[HID_ACTION_QUEUE_SIZE];
+  size_t queued = 0;
+
+  Action lookup(uint16_t key, Gesture gesture) const;
+  void keyDown(uint16_t key, uint32_t now);
+  void keyUp(uint32_t now);
+  void push(Action action);
+  Action pop();
+};
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Input fields remembered from a remote's report map.
+#define HID_REPORT_MAP_MAX_FIELDS 16
+// Report IDs tracked while laying out the report map.
+#define HID_REPORT_MAP_MAX_REPORTS 8
+
+/**
+ * Decodes input reports of a BLE HID remote using its report map.
+ *
+ * The report map (HID report descriptor) is parsed once at connect. Each input
+ * report is then reduced to a key code: the usage page in the top nibble and the
+ * usage in the lower 12 bits (e.g. 0xC0E9 = Consumer Volume Up, 0x9003 = Button 3).
+ * Without a parsed map the first non-zero byte of the report is the key code, which
+ * is what remotes were matched on before report maps were read.
+ */
+class HIDReportMap {
+ public:
+  /**
+   * @brief Parse a report map, replacing any previous one.
+   * @return True if at least one button or array input field was found.
+   */
+  bool parse(const uint8_t *map, size_t length);
+  void clear();
+  size_t fieldCount() const { return count; }
+
+  /**
+   * @brief Decode an input report to the key code of the first pressed key.
+   * @param [in] reportId Report ID from the characteristic's Report Reference descriptor, 0 if none.
+   * @param [in] report The report as notified, without the report ID byte.
+   * @param [in] length The length of the report in bytes.
+   * @return The key code or 0 if no key is pressed.
+   */
+  uint16_t decode(uint8_t reportId, const uint8_t *report, size_t length) const;
+
+  static uint16_t keyCode(uint16_t usagePage, uint16_t usage) { return (uint16_t)(((usagePage & 0x0f) << 12) | (usage & 0x0fff)); }
+
+ private:
+  struct Field {
+    uint8_t reportId;
+    uint16_t bitOffset;
+    uint8_t size;
+    uint8_t count;
+    bool array;
+    uint16_t usagePage;
+    uint16_t usageMin;
+    int32_t logicalMin;
+  };
+
+  Field fields[HID_REPORT_MAP_MAX_FIELDS];
+  size_t count = 0;
+
+  static uint32_t readBits(const uint8_t *report, size_t length, size_t bitOffset, uint8_t size, bool *inRange);
+};
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Calibration points (PWC sessions) used for the fit.
+#define HR_POWER_MAX_POINTS 8
+// Time constant of heart rate following a change in power, in seconds.
+#define HR_POWER_TIME_CONSTANT 30.0f
+// Time constant of the heart rate and heart rate slope filters, in seconds.
+#define HR_POWER_SMOOTHING 4.0f
+// Largest lag correction applied to the heart rate, in bpm.
+#define HR_POWER_MAX_CORRECTION 30.0f
+// Heart rates this far (bpm) outside the calibrated range halve the confidence.
+#define HR_POWER_EXTRAPOLATION_RANGE 10.0f
+
+// A heart rate held at a steady power, e.g. a PWC session.
+struct HRPowerPoint {
+  int hr;
+  int watts;
+};
+
+/**
+ * Estimates power from heart rate for riders without a power meter.
+ *
+ * Steady state heart rate is a straight line of power, fitted by least squares
+ * through the calibration points. Heart rate follows a change in power like a
+ * first order lag, HR' = (HRss - HR) / tau, so the steady state heart rate the
+ * current effort leads to is HR + tau * HR'. The heart rate and its slope are
+ * low pass filtered since the sensors report whole bpm about once a second.
+ *
+ * The confidence (0 to 1) combines how well the points fit a line and how many
+ * there are, and drops while extrapolating outside the calibrated heart rates
+ * or while a large lag correction is applied.
+ */
+class HRPowerEstimator {
+ public:
+  /**
+   * @brief Use new calibration points. Points with no heart rate or power are ignored.
+   * @return False if the points didn't change, the fit is kept.
+   */
+  bool setCalibration(const HRPowerPoint *points, size_t count);
+  // Whether the points give a usable fit (two heart rates, power rising with heart rate).
+  bool isCalibrated() const { return calibrated; }
+  float getGradient() const { return gradient; }
+  float getIntercept() const { return intercept; }
+  // Coefficient of determination of the fit.
+  float getR2() const { return r2; }
+
+  /**
+   * @brief Feed a heart rate reading.
+   * @param [in] hr Beats per minute.
+   * @param [in] now Milliseconds, from any monotonic clock.
+   * @return The estimated power in watts, 0 if not calibrated.
+   */
+  float update(float hr, uint32_t now);
+  // Forget the heart rate history, e.g. after the heart rate monitor dropped out.
+  void reset() { started = false; }
+
+  float getWatts() const { return watts; }
+  float getSteadyStateHR() const { return steadyHR; }
+  float getConfidence() const { return confidence; }
+
+ private:
+  HRPowerPoint points[HR_POWER_MAX_POINTS];
+  size_t pointCount = 0;
+  bool calibrated   = false;
+  float gradient    = 0;
+  float intercept   = 0;
+  float r2          = 0;
+  float minHR       = 0;
+  float maxHR       = 0;
+
+  bool started        = false;
+  uint32_t lastUpdate = 0;
+  float hrFiltered    = 0;
+  float hrSlope       = 0;
+  float steadyHR      = 0;
+  float watts         = 0;
+  float confidence    = 0;
+
+  void fit();
+};
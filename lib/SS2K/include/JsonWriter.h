@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Destination of streamed JSON, e.g. a file, a String or a response chunk.
+class JsonOutput {
+ public:
+  virtual ~JsonOutput() {}
+  virtual void write(const char *data, size_t length) = 0;
+};
+
+/**
+ * Keeps bytes [offset, offset + capacity) of everything written to it.
+ *
+ * Lets a chunked HTTP response serialize the document again for every chunk and
+ * keep only that chunk, so the whole document is never held in memory. The values
+ * must not change between chunks, serialize from a snapshot.
+ */
+class JsonWindow : public JsonOutput {
+ public:
+  JsonWindow(char *buffer, size_t capacity, size_t offset) : buffer(buffer), capacity(capacity), offset(offset) {}
+  void write(const char *data, size_t length) override;
+
+  // Bytes stored in the buffer
+  size_t size() const { return stored; }
+  // Bytes written in total
+  size_t total() const { return position; }
+
+ private:
+  char *buffer;
+  size_t capacity;
+  size_t offset;
+  size_t position = 0;
+  size_t stored   = 0;
+};
+
+/**
+ * Writes a flat JSON object straight to a JsonOutput, without building a document.
+ *
+ *   JsonWriter json(out);
+ *   json.beginObject();
+ *   json.add("watts", 212).add("simHr", false);
+ *   json.endObject();
+ */
+class JsonWriter {
+ public:
+  explicit JsonWriter(JsonOutput &out) : out(out) {}
+
+  void beginObject();
+  void endObject();
+
+  JsonWriter &add(const char *key, int value);
+  JsonWriter &add(const char *key, long value);
+  JsonWriter &add(const char *key, bool value);
+  JsonWriter &add(const char *key, double value);
+  JsonWriter &add(const char *key, const char *value);
+
+ private:
+  JsonOutput &out;
+  bool first = true;
+
+  void write(const char *str);
+  void writeKey(const char *key);
+  void writeString(const char *str);
+};
+
+/**
+ * Hands out a JSON document in chunks, e.g. for a chunked HTTP response.
+ *
+ * The first read sizes the document, then it's serialized once into a buffer of up
+ * to maxBuffer bytes that the chunks are copied from. Only a document bigger than
+ * that is serialized again, once per buffer full, so the cost stays linear in its
+ * size however small the chunks are. write() must serialize a snapshot.
+ */
+class JsonChunker {
+ public:
+  typedef std::function<void(JsonWriter &json)> Writer;
+
+  JsonChunker(const Writer &write, size_t maxBuffer) : writeDocument(write), maxBuffer(maxBuffer) {}
+
+  /**
+   * @brief Copy bytes [index, index + length) of the document, or as many as are left.
+   * @return The bytes copied, 0 at the end.
+   */
+  size_t read(char *out, size_t length, size_t index);
+  // Times the document was serialized, sizing included.
+  size_t serializations() const { return passes; }
+
+ private:
+  Writer writeDocument;
+  size_t maxBuffer;
+  std::vector<char> buffer;
+  bool sized    = false;
+  size_t total  = 0;
+  size_t start  = 0;  // document offset of buffer[0]
+  size_t filled = 0;
+  size_t passes = 0;
+
+  void fill(size_t offset);
+};
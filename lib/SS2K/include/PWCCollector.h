@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "HRPowerEstimator.h"
+#include "JsonWriter.h"
+
+// Width of a power bucket and the number of buckets, 0 to 500 W.
+#define PWC_BUCKET_WIDTH 25
+#define PWC_BUCKETS      20
+// Power has to stay this close (watts or percent of the effort, whichever is larger) to count as steady.
+#define PWC_STEADY_WATTS   15
+#define PWC_STEADY_PERCENT 10
+// Time constant of the power filter used for the steadiness test, in seconds.
+#define PWC_POWER_SMOOTHING 3.0f
+// Seconds of steady power before heart rate is taken as settled, about three heart rate time constants.
+#define PWC_SETTLE_TIME 90
+// Seconds of settled data a bucket needs before it is used for the fit.
+#define PWC_MIN_BUCKET_TIME 60
+// Older data in a bucket fades out once it holds this many seconds, so the fit follows fitness changes.
+#define PWC_MAX_BUCKET_TIME 600
+// Seconds of settled riding over which a saved session fades out of its bucket, so rides replace it.
+#define PWC_SEED_FADE_TIME 1800
+// Seconds of new settled data between refits.
+#define PWC_REFIT_TIME 300
+// A gap between readings this long (seconds) ends the steady effort, e.g. a sensor dropped out.
+#define PWC_MAX_GAP 5
+// Buckets and fit quality needed before the fit replaces the saved sessions.
+#define PWC_MIN_POINTS 3
+#define PWC_MIN_R2     0.8f
+
+/**
+ * Calibrates heart rate to power from rides with both a heart rate monitor and a power meter.
+ *
+ * Once power has been steady for PWC_SETTLE_TIME, the (heart rate, power) readings are
+ * averaged into buckets by power, weighted by time. Buckets with enough data become the
+ * points of a least squares fit (HRPowerEstimator). update() says when a fit good enough
+ * to replace the saved PWC sessions is ready; seed() starts from the saved sessions so
+ * every ride refines the previous calibration. Saved sessions count as points until
+ * PWC_SEED_FADE_TIME of settled riding has faded them out, so one that the rider's
+ * efforts never reach doesn't stay in every fit.
+ *
+ * update() is called from the BLE task and writeJSON() from the web server.
+ */
+class PWCCollector {
+ public:
+  // How the calibration is going, a copy so it can be served while riding.
+  struct Summary {
+    int points;
+    float r2;
+    float gradient;
+    float intercept;
+    bool settled;
+    long steadySeconds;
+    long fits;
+
+    // {"points":3,"r2":0.97,"gradient":2.1,"intercept":-160,"settled":true,"steadySeconds":120,"fits":2}
+    void writeJSON(JsonWriter &json) const;
+  };
+
+  // Start from saved sessions (measured ones, not placeholders), each counts as PWC_MIN_BUCKET_TIME of data.
+  void seed(const HRPowerPoint *points, size_t count);
+
+  /**
+   * @brief Add a heart rate and power reading.
+   * @param [in] now Milliseconds, from any monotonic clock.
+   * @return True when a new fit is ready to be saved, see getPoints().
+   */
+  bool update(int hr, int watts, uint32_t now);
+
+  // The fitted points (bucket averages) ordered by power, at most HR_POWER_MAX_POINTS.
+  size_t getPoints(HRPowerPoint *out, size_t capacity) const;
+  float getR2() const;
+  // Whether power is steady and heart rate has settled right now.
+  bool isSettled() const;
+
+  Summary getSummary() const;
+
+ private:
+  struct Bucket {
+    float seconds;
+    float hrSum;
+    float wattsSum;
+    // The part of the above that came from seed(), and its averages
+    float seedSeconds;
+    float seedHr;
+    float seedWatts;
+  };
+
+  mutable std::mutex mutex;
+  Bucket buckets[PWC_BUCKETS] = {};
+  HRPowerEstimator fit;
+  size_t fitCount = 0;
+
+  bool started        = false;
+  uint32_t lastUpdate = 0;
+  uint32_t steadyFrom = 0;
+  float effortSeconds = 0;
+  float effortWatts   = 0;  // mean power since the effort started
+  float wattsFiltered = 0;
+  float sinceRefit    = 0;
+
+  void startEffort(uint32_t now);
+  bool settled() const;
+  bool refit();
+  void fadeSeeds(float dt);
+  static bool usable(const Bucket &bucket);
+  size_t collectPoints(HRPowerPoint *out, size_t capacity) const;
+};
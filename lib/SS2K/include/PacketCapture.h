@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "transport/Transport.h"
+
+// Capture file version written after the "SCAP" magic.
+#define PACKET_CAPTURE_VERSION 1
+
+/**
+ * Ring of raw sensor notifications for diagnosing decoding and timing issues.
+ *
+ * Records are packed as: record length, timestamp (uint32 LE, ms), address (6 bytes LE),
+ * UUID length (2 or 16), UUID (LE), data length, data. When the ring is full the oldest
+ * records are dropped. Safe to record from one task while another takes a snapshot.
+ */
+class PacketCapture {
+ public:
+  explicit PacketCapture(size_t capacity) : ring(capacity) {}
+
+  void setEnabled(bool enable) { enabled = enable; }
+  bool isEnabled() const { return enabled; }
+
+  void record(uint32_t timestamp, uint64_t address, const NimBLEUUID &charUUID, const uint8_t *data, size_t length);
+  void clear();
+  size_t size() const;
+
+  /**
+   * @brief Copy the ring, oldest record first, behind a "SCAP" header.
+   * @details Header: "SCAP", version, reserved byte, record count (uint16 LE).
+   */
+  std::vector<uint8_t> snapshot() const;
+
+ private:
+  mutable std::mutex mutex;
+  std::vector<uint8_t> ring;
+  size_t head  = 0;  // oldest record
+  size_t used  = 0;
+  size_t count = 0;
+  bool enabled = true;
+
+  void dropOldest();
+  uint8_t at(size_t offset) const { return ring[(head + offset) % ring.size()]; }
+};
+
+/**
+ * Feeds a capture back to a SensorSink, at recorded speed or faster.
+ */
+class PacketReplay {
+ public:
+  /**
+   * @brief Load a capture produced by PacketCapture::snapshot().
+   * @return False if the header or a record is malformed.
+   */
+  bool load(const uint8_t *capture, size_t length);
+  size_t size() const { return records; }
+
+  /**
+   * @brief Start replaying.
+   * @param [in] now The current time in milliseconds.
+   * @param [in] speed Playback speed, 1 is as recorded.
+   */
+  void start(uint32_t now, float speed = 1.0);
+
+  /**
+   * @brief Deliver every record due by now.
+   * @return The number of records delivered.
+   */
+  size_t pump(uint32_t now, SensorSink &sink);
+
+  bool finished() const { return offset >= data.size(); }
+  // When the next record is due, only meaningful while not finished.
+  uint32_t nextDue() const;
+
+ private:
+  std::vector<uint8_t> data;
+  size_t records     = 0;
+  size_t offset      = 0;
+  uint32_t firstTime = 0;
+  uint32_t startTime = 0;
+  float speed        = 1.0;
+
+  bool parse(size_t at, SensorNotification *notification, size_t *next) const;
+};
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Longest payload (ASCII digits) in a Peloton response.
+#define PELOTON_MAX_PAYLOAD 8
+// Header, id, payload length, payload, checksum and footer.
+#define PELOTON_MAX_FRAME (PELOTON_MAX_PAYLOAD + 5)
+
+/**
+ * Splits the Peloton aux serial stream into response frames, one byte at a time.
+ *
+ * A response is PELOTON_HEADER, the field id, the payload length, the payload, a
+ * checksum (the sum of all the bytes before it, mod 256) and PELOTON_FOOTER. Frames
+ * may arrive split over any number of reads. Bytes outside a frame (e.g. our own
+ * requests echoed back) are skipped. A bad id, length, payload digit, checksum or
+ * footer drops the frame and looks for the next header, including one inside the
+ * dropped bytes. Since the header can't be an id, a length or a digit, a valid
+ * frame never hides inside a dropped one.
+ */
+class PelotonFramer {
+ public:
+  struct Frame {
+    uint8_t data[PELOTON_MAX_FRAME];
+    uint8_t length;
+  };
+
+  /**
+   * @brief Add the next byte from the serial port.
+   * @return True if it completed a valid frame, see getFrame().
+   */
+  bool push(uint8_t byte);
+  // The last complete frame, valid until the next push().
+  const Frame &getFrame() const { return frame; }
+  void reset() {
+    frame.length = 0;
+    complete     = false;
+  }
+
+  uint32_t getFrames() const { return frames; }
+  uint32_t getErrors() const { return errors; }
+  // Bytes that weren't part of a valid frame.
+  uint32_t getSkippedBytes() const { return skipped; }
+
+ private:
+  Frame frame      = {{0}, 0};
+  bool complete    = false;
+  uint32_t frames  = 0;
+  uint32_t errors  = 0;
+  uint32_t skipped = 0;
+
+  bool append(uint8_t byte);
+  bool accept(uint8_t byte) const;
+  void resync();
+};
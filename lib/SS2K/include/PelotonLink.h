@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <functional>
+#include "PelotonFramer.h"
+#include "PelotonScheduler.h"
+#include "transport/Transport.h"
+
+/**
+ * The Peloton aux serial protocol over a SerialPort: frames what the bike sends and
+ * asks for the next field as each reply arrives (see PelotonScheduler).
+ *
+ * receive() runs where the bytes arrive (the UART callback on the device) and only
+ * hands complete frames on; tick() runs on the maintenance loop.
+ */
+class PelotonLink {
+ public:
+  typedef std::function<void(const PelotonFramer::Frame &frame)> FrameHandler;
+
+  explicit PelotonLink(SerialPort &port) : port(port) {}
+
+  // Whether to send requests at all (PELOTON_TX), the bike may be polled by something else.
+  void setRequesting(bool requesting) { this->requesting = requesting; }
+  void setErgMode(bool erg) { scheduler.setErgMode(erg); }
+
+  /**
+   * @brief Read everything the port has and pass each complete frame to handler.
+   * @return The number of frames.
+   */
+  size_t receive(uint32_t now, const FrameHandler &handler);
+  // Start the request cycle or give up on a reply that didn't come.
+  void tick(uint32_t now);
+
+  bool isConnected() const { return scheduler.isConnected(); }
+  PelotonScheduler::Stats getStats() const { return scheduler.getStats(); }
+  const PelotonFramer &getFramer() const { return framer; }
+
+ private:
+  SerialPort &port;
+  PelotonFramer framer;
+  PelotonScheduler scheduler;
+  bool requesting = true;
+
+  void send(uint8_t id);
+};
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "JsonWriter.h"
+
+// A request without a reply after this many ms is given up and the next field is asked for.
+#define PELOTON_RESPONSE_TIMEOUT 150
+// Missed replies in a row after which the bike counts as disconnected.
+#define PELOTON_MAX_MISSES 10
+// While disconnected, how often the bike is probed, in ms.
+#define PELOTON_PROBE_INTERVAL 1000
+
+/**
+ * Decides which Peloton field to request next.
+ *
+ * The bike answers one request at a time, so a request goes out as soon as the
+ * reply to the previous one arrives (onResponse()) instead of on a fixed tick;
+ * poll() only starts the cycle and gives up on replies that don't come. Power is
+ * asked for every other request in ERG mode and every third one otherwise. Each
+ * field's reply latency is averaged, and PELOTON_MAX_MISSES timeouts in a row mark
+ * the bike as disconnected, after which it is only probed every PELOTON_PROBE_INTERVAL.
+ *
+ * onResponse() is called from the UART callback and poll() from the maintenance loop.
+ */
+class PelotonScheduler {
+ public:
+  enum Field : uint8_t { POWER = 0, CADENCE, RESISTANCE, FIELD_COUNT };
+
+  // Reply counts and latency, a copy so it can be served while riding.
+  struct Stats {
+    bool connected;
+    uint32_t requests;
+    uint32_t responses;
+    uint32_t timeouts;
+    float latency[FIELD_COUNT];  // ms, averaged
+
+    // {"connected":true,"requests":120,"responses":118,"timeouts":2,"powerLatency":21.5,...}
+    void writeJSON(JsonWriter &json) const;
+  };
+
+  void setErgMode(bool erg);
+
+  /**
+   * @brief Start a request if none is waiting for its reply, or give up on one that timed out.
+   * @param [in] now Milliseconds, from any monotonic clock.
+   * @return The field id to request (PELOTON_POW_ID...), 0 for none.
+   */
+  uint8_t poll(uint32_t now);
+
+  /**
+   * @brief A reply for the field id arrived.
+   * @return The next field id to request right away, 0 for none.
+   */
+  uint8_t onResponse(uint8_t id, uint32_t now);
+
+  bool isConnected() const;
+  Stats getStats() const;
+
+  // {PELOTON_REQUEST, id, checksum, PELOTON_FOOTER}
+  static void buildRequest(uint8_t id, uint8_t *out);
+  static uint8_t fieldId(Field field);
+
+ private:
+  mutable std::mutex mutex;
+  bool erg           = false;
+  size_t slot        = 0;
+  uint8_t pending    = 0;  // id waiting for its reply, 0 for none
+  uint32_t sentAt    = 0;
+  uint32_t lastProbe = 0;
+  int misses         = 0;
+  bool connected     = false;
+  Stats stats        = {};
+
+  uint8_t next(uint32_t now);
+};
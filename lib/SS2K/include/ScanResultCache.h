@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <NimBLEUUID.h>
+#include "AdvertisementFilter.h"
+
+// Number of supported devices remembered between scans.
+#define SCAN_RESULT_CACHE_SIZE 16
+
+/**
+ * Bounded cache of supported devices seen while scanning.
+ *
+ * Entries are updated incrementally from the scan callback and serialized on
+ * demand, so scans no longer rebuild a JSON document or touch the configuration.
+ * All methods are safe to call from the BLE host task and the web server task.
+ */
+class ScanResultCache {
+ public:
+  struct Entry {
+    uint64_t address;
+    uint8_t addressType;
+    AdvertisementFilter::Category category;
+    bool selected;  // matched the device selection when last seen
+    NimBLEUUID service;
+    char name[ADVERTISEMENT_FILTER_MAX_NAME + 1];
+    float rssi;  // exponential moving average
+    uint32_t lastSeen;
+    uint16_t timesSeen;
+  };
+
+  /**
+   * @brief Record an advertisement that passed the filter classification.
+   * @param [in] address The 48 bit peer address.
+   * @param [in] addressType The NimBLE address type.
+   * @param [in] result The filter result for the advertisement.
+   * @param [in] rssi The received signal strength of this report.
+   * @param [in] now The current time in milliseconds.
+   */
+  void update(uint64_t address, uint8_t addressType, const AdvertisementFilter::Result &result, int rssi, uint32_t now);
+
+  /**
+   * @brief Copy the entry for an address.
+   * @return False if the address isn't cached.
+   */
+  bool find(uint64_t address, Entry *entry) const;
+
+  /**
+   * @brief Copy the most recently seen device of a category that matched the selection.
+   * @return False if none was seen within maxAge.
+   */
+  bool findSelected(AdvertisementFilter::Category category, uint32_t now, uint32_t maxAge, Entry *entry) const;
+
+  size_t size() const;
+  void clear();
+
+  /**
+   * @brief Serialize the devices seen within maxAge as the foundDevices JSON object.
+   * @details Behaves like snprintf: the output is truncated to the capacity and
+   *          the return value is the length the complete output needs.
+   */
+  size_t toJSON(char *buffer, size_t capacity, uint32_t now, uint32_t maxAge) const;
+
+  /**
+   * @brief Serialize the devices seen within maxAge as packed binary records.
+   * @details Layout: count, then per device 6 address bytes (LSB first), address type,
+   *          category, rssi (int8), age in seconds (uint16 LE), name length and name.
+   * @return The number of bytes written, records that don't fit are dropped.
+   */
+  size_t toBinary(uint8_t *buffer, size_t capacity, uint32_t now, uint32_t maxAge) const;
+
+ private:
+  // Weight of a new RSSI sample in the moving average.
+  static constexpr float RSSI_ALPHA = 0.25f;
+
+  mutable std::mutex mutex;
+  Entry entries[SCAN_RESULT_CACHE_SIZE];
+  size_t count = 0;
+
+  static void formatAddress(uint64_t address, char *out);
+};
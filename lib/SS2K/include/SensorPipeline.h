@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <functional>
+#include "ServerData.h"
+#include "sensors/SensorDataFactory.h"
+#include "transport/Transport.h"
+
+/**
+ * Values the pipeline reads and writes. rtConfig on the device, HostRideMetrics in [env:native].
+ */
+class RideMetrics {
+ public:
+  enum Metric : uint8_t { HEART_RATE = 0, CADENCE, POWER, SPEED, RESISTANCE, METRIC_COUNT };
+
+  virtual ~RideMetrics() {}
+  virtual float get(Metric metric) const = 0;
+  virtual void set(Metric metric, float value) = 0;
+  // Simulated values are set by the user or an app and are not overwritten by sensors.
+  virtual bool isSimulated(Metric metric) const = 0;
+};
+
+/**
+ * Sensor notifications -> metrics -> control step -> server notifications.
+ *
+ * This is collectAndSet() and the server update of BLECommunications(). The firmware runs
+ * it on rtConfig and NimBLE, [env:native] runs it against fakes with virtual time.
+ * The control step stands in for ERG mode, which needs the stepper.
+ */
+class SensorPipeline : public SensorSink {
+ public:
+  typedef std::function<void(RideMetrics &metrics, uint32_t now)> ControlStep;
+
+  // Settings that pick which sensor a value is taken from.
+  struct Sources {
+    float powerCorrectionFactor = 1.0;
+    // A specific power meter is selected, so cadence and power from the Peloton are ignored.
+    bool powerMeterSelected = false;
+    // The Peloton resistance range is in use, so only the Peloton sets resistance.
+    bool pelotonResistance = false;
+  };
+
+  // Bits returned by apply() for the values a notification set.
+  enum Applied : uint8_t {
+    APPLIED_HEART_RATE = 1 << 0,
+    APPLIED_CADENCE    = 1 << 1,
+    APPLIED_POWER      = 1 << 2,
+    APPLIED_SPEED      = 1 << 3,
+    APPLIED_RESISTANCE = 1 << 4,
+  };
+
+  struct Stats {
+    uint32_t sensorNotifications = 0;
+    uint32_t serverNotifications = 0;
+    // Time from a sensor notification to the server notification carrying it.
+    uint32_t maxLatency     = 0;
+    uint64_t totalLatency   = 0;
+    uint32_t latencySamples = 0;
+  };
+
+  explicit SensorPipeline(RideMetrics &metrics) : metrics(metrics) {}
+
+  void setSources(const Sources &sources) { this->sources = sources; }
+  void setControlStep(ControlStep step) { controlStep = step; }
+
+  /**
+   * @brief Decode a sensor notification and set the values it carries, skipping simulated
+   *        values and values the Sources say come from another sensor.
+   * @param [in] now Milliseconds, used for the latency stats.
+   * @param [out] log If not null, the decoded values for the log, e.g. "CPS[ CD(90.00) PW(212) ]".
+   * @return Applied bits for the values that were set.
+   */
+  uint8_t apply(const NimBLEUUID &charUUID, uint64_t address, uint8_t *data, size_t length, uint32_t now, char *log = nullptr, size_t logCapacity = 0);
+
+  void onSensorNotification(const SensorNotification &notification) override;
+
+  /**
+   * @brief One pass of the communications loop: run the control step and notify subscribed characteristics.
+   */
+  void update(uint32_t now, ServerTransport &server);
+
+  RideMetrics &getMetrics() { return metrics; }
+  const Stats &getStats() const { return stats; }
+
+ private:
+  RideMetrics &metrics;
+  SensorDataFactory sensorDataFactory;
+  // Crank revolutions synthesized for the Cycling Power Measurement we serve.
+  ServerData::CrankRevolutions crank;
+  ControlStep controlStep;
+  Sources sources;
+  Stats stats;
+  // Oldest sensor notification not yet sent on
+  bool pending          = false;
+  uint32_t pendingSince = 0;
+};
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Largest payload produced by ServerData.
+#define SERVER_DATA_MAX_LENGTH 11
+
+/**
+ * Encodes the characteristic values SmartSpin2k notifies to connected apps.
+ *
+ * Shared by the BLE server and the host pipeline so both send the same bytes.
+ * Each function writes into out (at least SERVER_DATA_MAX_LENGTH bytes) and
+ * returns the payload length.
+ */
+class ServerData {
+ public:
+  // Crank revolution data the Cycling Power Measurement synthesizes from cadence.
+  struct CrankRevolutions {
+    int cumulative    = 0;
+    int lastEventTime = 0;  // 1/1024 s
+  };
+
+  /**
+   * @brief FTMS Indoor Bike Data: speed, cadence, resistance, power and heart rate.
+   * @param [in] speed Simulated speed, if <= 0 it is derived from cadence and power.
+   */
+  static size_t indoorBikeData(float cadence, int watts, int hr, int resistance, float speed, uint8_t *out);
+
+  /**
+   * @brief CPS Cycling Power Measurement with crank revolution data.
+   * @details Every call with a cadence advances the crank revolutions by one.
+   */
+  static size_t cyclingPowerMeasurement(int watts, float cadence, CrankRevolutions &crank, uint8_t *out);
+
+  // HRS Heart Rate Measurement, 8 bit format.
+  static size_t heartRateMeasurement(int hr, uint8_t *out);
+};
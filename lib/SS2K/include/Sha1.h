@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Streaming SHA-1, the content hash build_asset_manifest.py puts in the manifest.
+ *
+ * Only used to verify downloads against the manifest, not for anything that needs a
+ * secure hash.
+ */
+class Sha1 {
+ public:
+  Sha1() { reset(); }
+
+  void reset();
+  void update(const uint8_t *data, size_t length);
+  // Finish and write the 20 byte digest. Call reset() before hashing again.
+  void finish(uint8_t digest[20]);
+  // Finish and write the first digits of the hex digest, terminated. At most 40 digits.
+  void finishHex(char *out, size_t digits);
+
+ private:
+  uint32_t state[5];
+  uint8_t block[64];
+  size_t blockLength;
+  uint64_t totalLength;
+
+  void transform(const uint8_t *data);
+};
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Values a telemetry frame can carry.
+#define TELEMETRY_MAX_FIELDS 24
+// Every value is resent at least this often so clients that missed a frame catch up.
+#define TELEMETRY_KEYFRAME_MILLIS 5000
+
+/**
+ * Serializes live values as compact JSON deltas for push clients.
+ *
+ * Fields are registered once, then set every tick. serialize() writes only the
+ * fields that changed since the previous frame, e.g. {"watts":212,"cad":91}, or
+ * all of them when a keyframe is due. The frame is built once and sent to every
+ * client. Keys and types match /runtimeConfigJSON. Not thread safe: set and
+ * serialize from the same task.
+ */
+class TelemetryDelta {
+ public:
+  enum Type : uint8_t { INT = 0, FLOAT, BOOL };
+
+  /**
+   * @brief Register a field.
+   * @param [in] name JSON key, must outlive this object.
+   * @param [in] type How the value is written.
+   * @return The field index for set(), -1 if full.
+   */
+  int addField(const char *name, Type type = INT);
+  size_t fieldCount() const { return count; }
+
+  void set(int field, float value);
+
+  // Send every field in the next frame, e.g. when a client connects.
+  void requestKeyframe() { keyframe = true; }
+
+  /**
+   * @brief Write the next frame and mark its values as sent.
+   * @return The frame length, 0 if nothing changed or it didn't fit the buffer.
+   */
+  size_t serialize(char *buffer, size_t capacity, uint32_t now);
+
+ private:
+  struct Field {
+    const char *name;
+    Type type;
+    float value;
+    float sent;
+  };
+
+  Field fields[TELEMETRY_MAX_FIELDS];
+  size_t count          = 0;
+  bool keyframe         = true;
+  uint32_t lastKeyframe = 0;
+};
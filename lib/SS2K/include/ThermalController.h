@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Weight of a new temperature reading in the filtered temperature.
+#define THERMAL_FILTER_WEIGHT 0.2f
+// Run current steps (of 31) taken off per degree over the throttle temperature.
+#define THERMAL_DERATE_GAIN 1.0f
+// Degrees under the throttle temperature the filtered temperature has to fall before derating ends.
+#define THERMAL_HYSTERESIS 5
+// Degrees over the throttle temperature assumed while the driver reports its over temperature pre-warning (120C).
+#define THERMAL_WARNING_EXCESS 4
+// Lowest run current derating goes to, percent of full.
+#define THERMAL_MIN_RUN_PERCENT 50
+// Hold current while riding, percent of the run current.
+#define THERMAL_HOLD_PERCENT 50
+// Hold current once the knob hasn't moved for THERMAL_IDLE_DELAY, percent of the run current.
+#define THERMAL_IDLE_HOLD_PERCENT 25
+// Milliseconds without a move before the hold current is lowered.
+#define THERMAL_IDLE_DELAY 10000
+
+/**
+ * Sets the stepper driver's run and hold current (irun, ihold) from temperature.
+ *
+ * Temperature readings are low pass filtered. Above the throttle temperature the
+ * run current is lowered in proportion to how far over it is; once derating has
+ * started, the current is held until the temperature falls THERMAL_HYSTERESIS
+ * under the throttle temperature and then stepped back up one step per update,
+ * so it doesn't switch between full and throttled power every check. The hold
+ * current drops further when the knob hasn't moved for a while, since that's
+ * where the driver spends most of a steady ERG session.
+ *
+ * Call update() from one task; setFullCurrent() only stores the new current.
+ */
+class ThermalController {
+ public:
+  explicit ThermalController(float throttleTemp) : throttleTemp(throttleTemp) {}
+
+  // The run current without derating, 0-31.
+  void setFullCurrent(uint8_t current);
+
+  /**
+   * @brief Take a reading and work out the currents.
+   * @param [in] temperature In C.
+   * @param [in] driverWarning The driver's over temperature pre-warning (otpw).
+   * @param [in] moving Whether the stepper moved since the last update.
+   * @param [in] now Milliseconds, from any monotonic clock.
+   */
+  void update(float temperature, bool driverWarning, bool moving, uint32_t now);
+
+  uint8_t getRunCurrent() const { return runCurrent; }
+  uint8_t getHoldCurrent() const;
+  float getTemperature() const { return temperature; }
+  bool isDerating() const { return derating; }
+  bool isIdle() const { return idle; }
+
+ private:
+  float throttleTemp;
+  uint8_t fullCurrent = 0;
+  uint8_t runCurrent  = 0;
+  float temperature   = 0;
+  bool filtered       = false;  // temperature holds a reading
+  bool derating       = false;
+  bool idle           = false;
+  uint32_t lastMove   = 0;
+};
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+
+// Longest branch name and commit id kept from a version string.
+#define VERSION_MAX_BRANCH_LENGTH 31
+#define VERSION_MAX_COMMIT_LENGTH 15
+
+/**
+ * A firmware version as printed by git_tag_macro.py, parsed once.
+ *
+ * Accepts "1.2.3.4", "v1.2.3.4", "v1.2.3.4-5-gabc1234" and
+ * "v1.2.3.4-branch-5-gabc1234". A version without a branch is on master.
+ * Versions on different branches are never newer than each other.
+ */
+struct Version {
+ public:
+  Version() { parse(""); }
+  explicit Version(const char *version) { parse(version); }
+
+  void parse(const char *version);
+
+  // Overload greater than(>) operator to compare two version objects
+  bool operator>(const Version &other) const;
+
+  // Overload equal to(==) operator to compare two version
+  bool operator==(const Version &other) const;
+  bool operator!=(const Version &other) const { return !(*this == other); }
+
+  const char *getBranch() const { return branch; }
+  const char *getCommit() const { return commit; }
+
+ private:
+  // Here, we are saying it as version-tag
+  int major, minor, revision, build, commitCount;
+  char branch[VERSION_MAX_BRANCH_LENGTH + 1];
+  char commit[VERSION_MAX_COMMIT_LENGTH + 1];
+};
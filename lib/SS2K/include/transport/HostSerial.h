@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include "transport/Transport.h"
+
+/**
+ * Host stand-in for a Peloton bike on the aux serial port.
+ *
+ * Requests written to the port are parsed the way the bike does, and each valid one
+ * is answered after the configured latency with the current value of the field plus
+ * noise. Replies can be corrupted (one byte changed) or dropped, and read() hands
+ * them out a few bytes at a time like the UART does. The noise and faults come from
+ * a seeded generator, so a run repeats exactly.
+ */
+class PelotonEmulator : public SerialPort {
+ public:
+  explicit PelotonEmulator(const Clock &clock, uint32_t seed = 1) : clock(clock), seed(seed) {}
+
+  void setPower(float watts) { power = watts; }
+  void setCadence(float rpm) { cadence = rpm; }
+  void setResistance(float percent) { resistance = percent; }
+  // Milliseconds from a request to its reply.
+  void setLatency(uint32_t millis) { latency = millis; }
+  // Each reply is off by up to this much, in the field's unit.
+  void setNoise(float amplitude) { noise = amplitude; }
+  void setCorruption(int percent) { corruptPercent = percent; }
+  void setDropRate(int percent) { dropPercent = percent; }
+  // Most bytes returned by one read().
+  void setChunkSize(size_t bytes) { chunkSize = bytes; }
+  // An unplugged bike ignores every request.
+  void setConnected(bool connected) { this->connected = connected; }
+
+  size_t read(uint8_t *buffer, size_t length) override;
+  size_t availableForWrite() override { return 128; }
+  size_t write(const uint8_t *data, size_t length) override;
+
+  uint32_t getRequests() const { return requests; }
+  uint32_t getBadRequests() const { return badRequests; }
+  uint32_t getReplies() const { return replies; }
+  uint32_t getCorrupted() const { return corrupted; }
+  uint32_t getDropped() const { return dropped; }
+
+ private:
+  struct Reply {
+    uint32_t due;
+    std::vector<uint8_t> bytes;
+  };
+
+  const Clock &clock;
+  uint32_t seed;
+  float power          = 0;
+  float cadence        = 0;
+  float resistance     = 0;
+  uint32_t latency     = 10;
+  float noise          = 0;
+  int corruptPercent   = 0;
+  int dropPercent      = 0;
+  size_t chunkSize     = 8;
+  bool connected       = true;
+  uint32_t requests    = 0;
+  uint32_t badRequests = 0;
+  uint32_t replies     = 0;
+  uint32_t corrupted   = 0;
+  uint32_t dropped     = 0;
+
+  std::vector<uint8_t> inbox;  // request bytes not parsed yet
+  std::deque<Reply> pending;   // replies waiting for their latency
+  std::deque<uint8_t> outbox;  // reply bytes ready to read
+
+  uint32_t random();
+  void answer(uint8_t id);
+};
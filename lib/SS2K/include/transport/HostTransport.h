@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <vector>
+#include "SensorPipeline.h"
+#include "transport/Transport.h"
+
+// Deterministic clock that only moves when told to.
+class VirtualClock : public Clock {
+ public:
+  uint32_t now() const override { return time; }
+  void advance(uint32_t millis) { time += millis; }
+  void set(uint32_t millis) { time = millis; }
+
+ private:
+  uint32_t time = 0;
+};
+
+/**
+ * In-process sensor that plays back a recorded notification stream.
+ */
+class FakePeripheral {
+ public:
+  FakePeripheral(uint64_t address, const NimBLEUUID &serviceUUID, const NimBLEUUID &charUUID) : address(address), serviceUUID(serviceUUID), charUUID(charUUID) {}
+
+  /**
+   * @brief Add a notification to the stream.
+   * @param [in] offset Milliseconds after the start of the stream.
+   */
+  void record(uint32_t offset, const uint8_t *data, size_t length);
+
+  /**
+   * @brief Replay the stream every period milliseconds once it ends. 0 plays it once.
+   */
+  void setRepeat(uint32_t period) { repeatPeriod = period; }
+
+  // Start (or restart) the stream at the given time.
+  void start(uint32_t now);
+
+  /**
+   * @brief Deliver every notification due by now.
+   * @return The number of notifications delivered.
+   */
+  size_t pump(uint32_t now, SensorSink &sink);
+
+  bool finished() const { return repeatPeriod == 0 && next >= stream.size(); }
+
+ private:
+  struct Recorded {
+    uint32_t offset;
+    std::vector<uint8_t> data;
+  };
+
+  uint64_t address;
+  NimBLEUUID serviceUUID;
+  NimBLEUUID charUUID;
+  std::vector<Recorded> stream;
+  uint32_t repeatPeriod = 0;
+  uint32_t startTime    = 0;
+  size_t next           = 0;
+};
+
+/**
+ * In-process app that subscribes to the server and records what it is sent.
+ */
+class FakeCentral : public ServerTransport {
+ public:
+  struct Received {
+    uint32_t timestamp;
+    NimBLEUUID charUUID;
+    std::vector<uint8_t> data;
+  };
+
+  explicit FakeCentral(const Clock &clock) : clock(clock) {}
+
+  void subscribe(const NimBLEUUID &charUUID);
+  bool isSubscribed(const NimBLEUUID &charUUID) const override;
+  void notify(const NimBLEUUID &charUUID, const uint8_t *data, size_t length) override;
+
+  const std::vector<Received> &received() const { return log; }
+  // Most recent notification of a characteristic, nullptr if none arrived.
+  const Received *last(const NimBLEUUID &charUUID) const;
+  size_t count(const NimBLEUUID &charUUID) const;
+  void clear() { log.clear(); }
+
+ private:
+  const Clock &clock;
+  std::vector<NimBLEUUID> subscriptions;
+  std::vector<Received> log;
+};
+
+// Plain values standing in for rtConfig.
+class HostRideMetrics : public RideMetrics {
+ public:
+  float get(Metric metric) const override { return values[metric]; }
+  void set(Metric metric, float value) override { values[metric] = value; }
+  bool isSimulated(Metric metric) const override { return simulated[metric]; }
+  void setSimulated(Metric metric, bool simulate) { simulated[metric] = simulate; }
+
+ private:
+  float values[METRIC_COUNT]   = {};
+  bool simulated[METRIC_COUNT] = {};
+};
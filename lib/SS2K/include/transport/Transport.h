@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <NimBLEUUID.h>
+
+// Largest sensor notification carried, same as the client notify queue.
+#define SENSOR_NOTIFICATION_MAX_LENGTH 25
+
+/**
+ * Seams between the sensor pipeline and the BLE stack or the aux serial port.
+ *
+ * The firmware implements these on top of NimBLE and HardwareSerial; the host
+ * implementations in HostTransport.h and HostSerial.h let the pipeline run in
+ * [env:native] with virtual time.
+ */
+
+// A notification received from a sensor the client is subscribed to.
+struct SensorNotification {
+  uint32_t timestamp;  // milliseconds
+  uint64_t address;
+  NimBLEUUID serviceUUID;
+  NimBLEUUID charUUID;
+  uint8_t data[SENSOR_NOTIFICATION_MAX_LENGTH];
+  uint8_t length;
+};
+
+// Receives sensor notifications (the client side of the pipeline).
+class SensorSink {
+ public:
+  virtual ~SensorSink() {}
+  virtual void onSensorNotification(const SensorNotification &notification) = 0;
+};
+
+// Sends notifications to the apps connected to our server.
+class ServerTransport {
+ public:
+  virtual ~ServerTransport() {}
+  virtual bool isSubscribed(const NimBLEUUID &charUUID) const = 0;
+  virtual void notify(const NimBLEUUID &charUUID, const uint8_t *data, size_t length) = 0;
+};
+
+// Time source in milliseconds.
+class Clock {
+ public:
+  virtual ~Clock() {}
+  virtual uint32_t now() const = 0;
+};
+
+// A byte stream such as the aux serial port. None of the calls block.
+class SerialPort {
+ public:
+  virtual ~SerialPort() {}
+  // Up to length received bytes, 0 if there are none.
+  virtual size_t read(uint8_t *buffer, size_t length) = 0;
+  virtual size_t availableForWrite() = 0;
+  virtual size_t write(const uint8_t *data, size_t length) = 0;
+};
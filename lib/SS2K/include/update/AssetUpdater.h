@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "AssetManifest.h"
+#include "Sha1.h"
+#include "update/UpdateTransport.h"
+
+// Bytes downloaded per step().
+#define ASSET_UPDATE_CHUNK_SIZE 1024
+// Largest asset manifest, local or remote.
+#define ASSET_UPDATE_MANIFEST_SIZE 4096
+// Attempts per file before a run gives up. The partial file is kept for the next run.
+#define ASSET_UPDATE_MAX_ATTEMPTS 3
+// Suffix of a file while it is downloaded.
+#define ASSET_UPDATE_PART_SUFFIX ".part"
+
+/**
+ * Brings the web assets in the filesystem up to date with a remote asset manifest.
+ *
+ * Files whose content hash didn't change are skipped. The others are streamed in
+ * chunks to path + ".part", checked against the manifest hash and renamed over the
+ * old file, so a page is never served half written. A run that is interrupted (lost
+ * connection, reboot) leaves the .part file behind and the next attempt continues
+ * from its size with a range request. The manifest is replaced last.
+ *
+ * step() does one chunk of work, so the caller decides how much time the update
+ * gets, e.g. a low priority task that yields between steps.
+ */
+class AssetUpdater {
+ public:
+  enum State : uint8_t { IDLE = 0, MANIFEST, FILES, DONE, FAILED };
+
+  AssetUpdater(UpdateSource &source, UpdateStore &store) : source(source), store(store) {}
+
+  /**
+   * @brief Start a run.
+   * @param [in] manifestPath Path of the manifest, the same locally and on the server.
+   */
+  void begin(const char *manifestPath);
+
+  /**
+   * @brief Do one chunk of work.
+   * @return True while the run isn't finished.
+   */
+  bool step();
+
+  State getState() const { return state; }
+  // Step a FAILED run stopped in: MANIFEST if the remote manifest couldn't be fetched, FILES otherwise.
+  State getFailedStep() const { return failedStep; }
+  // Files that differed from the local copy, updated so far, and bytes downloaded in this run
+  size_t getFilesChanged() const { return filesChanged; }
+  size_t getFilesUpdated() const { return filesUpdated; }
+  size_t getBytesDownloaded() const { return bytesDownloaded; }
+
+ private:
+  UpdateSource &source;
+  UpdateStore &store;
+  State state      = IDLE;
+  State failedStep = IDLE;
+  char manifestPath[ASSET_MANIFEST_MAX_PATH + 1];
+  char manifestText[ASSET_UPDATE_MANIFEST_SIZE];
+  size_t manifestLength = 0;
+  AssetManifest local;
+  AssetManifest remote;
+
+  // The file being downloaded
+  size_t entryIndex = 0;
+  bool downloading  = false;
+  AssetManifest::Entry entry;
+  char storedPath[ASSET_MANIFEST_MAX_PATH + 4];
+  char partPath[ASSET_MANIFEST_MAX_PATH + 4 + sizeof(ASSET_UPDATE_PART_SUFFIX)];
+  Sha1 sha;
+  size_t received  = 0;
+  uint8_t attempts = 0;
+
+  size_t filesChanged    = 0;
+  size_t filesUpdated    = 0;
+  size_t bytesDownloaded = 0;
+  uint8_t chunk[ASSET_UPDATE_CHUNK_SIZE];
+
+  bool loadManifests();
+  bool nextFile();
+  void startFile();
+  void readChunk();
+  void finishFile();
+  void retry();
+  bool installManifest();
+  bool hashFile(const char *path, size_t length);
+  bool hashMatches();
+};
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include "update/UpdateTransport.h"
+
+/**
+ * In-process stand-in for the update server.
+ *
+ * Serves files from memory with range support (like GitHub raw), counts what it
+ * sends and can drop the connection part way through a transfer.
+ */
+class LocalHttpServer : public UpdateSource {
+ public:
+  void put(const std::string &path, const std::string &content) { files[path] = content; }
+  void setRangeSupport(bool supported) { rangeSupport = supported; }
+  // The connection drops after this many more bytes are served, once.
+  void dropAfter(size_t bytes) { dropIn = bytes; }
+
+  long open(const char *path, size_t offset) override;
+  int read(uint8_t *buffer, size_t length) override;
+  void close() override { current = nullptr; }
+
+  size_t getRequests() const { return requests; }
+  size_t getBytesServed() const { return bytesServed; }
+  // Offset of the last request, 0 if it wasn't a range request.
+  size_t getLastOffset() const { return lastOffset; }
+
+ private:
+  std::map<std::string, std::string> files;
+  const std::string *current = nullptr;
+  size_t position            = 0;
+  bool rangeSupport          = true;
+  size_t dropIn              = 0;
+  size_t requests            = 0;
+  size_t bytesServed         = 0;
+  size_t lastOffset          = 0;
+};
+
+// Filesystem in memory.
+class MemoryStore : public UpdateStore {
+ public:
+  std::map<std::string, std::string> files;
+
+  bool exists(const std::string &path) const { return files.count(path) > 0; }
+
+  long size(const char *path) override;
+  int read(const char *path, size_t offset, uint8_t *buffer, size_t length) override;
+  bool append(const char *path, const uint8_t *data, size_t length) override;
+  bool rename(const char *from, const char *to) override;
+  void remove(const char *path) override { files.erase(path); }
+};
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "Version_Converter.h"
+
+// Longest update URL, version text and ETag / Last-Modified kept in the cache.
+#define UPDATE_CHECK_MAX_URL_LENGTH       127
+#define UPDATE_CHECK_MAX_VERSION_LENGTH   63
+#define UPDATE_CHECK_MAX_VALIDATOR_LENGTH 63
+// Clock readings before 2020-01-01 mean the clock hasn't been synced.
+#define UPDATE_CHECK_MIN_CLOCK 1577836800UL
+// Record version of the saved cache.
+#define UPDATE_CHECK_RECORD_VERSION 1
+// Largest saved cache, with every field at its longest.
+#define UPDATE_CHECK_RECORD_SIZE 384
+
+/**
+ * The result of the last firmware version check, kept between boots.
+ *
+ * A check is due once the interval has passed since the last one, when the
+ * update URL changed, or when the clock can't tell (not synced or gone back).
+ * The version file's ETag and Last-Modified are kept for a conditional request,
+ * so a check that finds nothing new costs a 304 instead of the file.
+ * The available version is parsed once, when it arrives or is loaded.
+ */
+class UpdateCheck {
+ public:
+  /**
+   * @brief Whether the version file should be fetched again.
+   * @param [in] now UTC seconds.
+   * @param [in] interval Seconds between checks, 0 to check every time.
+   * @param [in] url Where the version file comes from.
+   */
+  bool isDue(uint32_t now, uint32_t interval, const char *url) const;
+
+  // The server sent the version file.
+  void checked(uint32_t now, const char *url, const char *version, const char *etag, const char *lastModified);
+  // The server answered 304, the cached version is still current.
+  void notModified(uint32_t now);
+  void clear();
+
+  // Whether the cached version came from url.
+  bool isFrom(const char *url) const;
+  bool hasVersion() const { return versionText[0] != '\0'; }
+  const Version &getAvailable() const { return available; }
+  const char *getVersionText() const { return versionText; }
+  const char *getETag() const { return etag; }
+  const char *getLastModified() const { return lastModified; }
+  uint32_t getLastCheck() const { return lastCheck; }
+
+  /**
+   * @brief Serialize as a config record.
+   * @return The record length, 0 if it didn't fit.
+   */
+  size_t write(uint8_t *buffer, size_t capacity) const;
+  // False (and the cache cleared) if the record isn't valid.
+  bool read(const uint8_t *data, size_t length);
+
+ private:
+  uint32_t lastCheck                                       = 0;
+  char url[UPDATE_CHECK_MAX_URL_LENGTH + 1]                = "";
+  char versionText[UPDATE_CHECK_MAX_VERSION_LENGTH + 1]    = "";
+  char etag[UPDATE_CHECK_MAX_VALIDATOR_LENGTH + 1]         = "";
+  char lastModified[UPDATE_CHECK_MAX_VALIDATOR_LENGTH + 1] = "";
+  Version available;
+};
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Seams between the asset updater and the network / filesystem.
+ *
+ * The firmware implements these with HTTPClient and LittleFS; the host
+ * implementations in HostUpdate.h let the updater run in [env:native] offline.
+ */
+
+// Where updates are downloaded from, e.g. the data directory on GitHub.
+class UpdateSource {
+ public:
+  virtual ~UpdateSource() {}
+
+  /**
+   * @brief Start downloading a file.
+   * @param [in] path Path below the update URL, with the leading slash.
+   * @param [in] offset Bytes already downloaded, requested as a range.
+   * @return The offset the content starts at (0 if the range was ignored), -1 if the file can't be fetched.
+   */
+  virtual long open(const char *path, size_t offset) = 0;
+
+  // Read the next bytes of the open file. 0 at the end of the file, -1 on errors.
+  virtual int read(uint8_t *buffer, size_t length) = 0;
+  virtual void close() = 0;
+};
+
+// The filesystem the assets are stored in.
+class UpdateStore {
+ public:
+  virtual ~UpdateStore() {}
+
+  // Size of a file, -1 if it doesn't exist.
+  virtual long size(const char *path) = 0;
+  // Read from offset, returns the bytes read or -1 on errors.
+  virtual int read(const char *path, size_t offset, uint8_t *buffer, size_t length) = 0;
+  // Append to a file, creating it if needed.
+  virtual bool append(const char *path, const uint8_t *data, size_t length) = 0;
+  // Replace `to` with `from`.
+  virtual bool rename(const char *from, const char *to) = 0;
+  virtual void remove(const char *path) = 0;
+};
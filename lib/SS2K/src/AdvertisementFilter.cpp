@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstring>
+#include "Constants.h"
+#include "AdvertisementFilter.h"
+
+// AD structure types from the Bluetooth Core Specification Supplement.
+#define AD_TYPE_INCOMPLETE_16BIT_UUIDS  0x02
+#define AD_TYPE_COMPLETE_16BIT_UUIDS    0x03
+#define AD_TYPE_INCOMPLETE_128BIT_UUIDS 0x06
+#define AD_TYPE_COMPLETE_128BIT_UUIDS   0x07
+#define AD_TYPE_SHORTENED_NAME          0x08
+#define AD_TYPE_COMPLETE_NAME           0x09
+
+// Bluetooth base UUID (00000000-0000-1000-8000-00805F9B34FB), little endian, minus the 32 bit alias.
+static const uint8_t BLUETOOTH_BASE_UUID[12] = {0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00};
+
+AdvertisementFilter::AdvertisementFilter() {
+  // Same priority order connectToServer() uses to pick the service of a device.
+  addService(0, FLYWHEEL_UART_SERVICE_UUID, POWER_METER, true);
+  addService(1, FITNESSMACHINESERVICE_UUID, POWER_METER, false);
+  addService(2, CYCLINGPOWERSERVICE_UUID, POWER_METER, false);
+  addService(3, ECHELON_DEVICE_UUID, POWER_METER, false);
+  addService(4, HEARTSERVICE_UUID, HEART_MONITOR, false);
+  addService(5, HID_SERVICE_UUID, REMOTE, false);
+
+  flywheelNameLength = strlen(FLYWHEEL_BLE_NAME);
+  flywheelNameHash   = hash(reinterpret_cast<const uint8_t *>(FLYWHEEL_BLE_NAME), flywheelNameLength);
+
+  configure("any", "any", "any");
+}
+
+void AdvertisementFilter::addService(size_t index, const NimBLEUUID &uuid, Category category, bool requiresFlywheelName) {
+  ServiceEntry &entry        = services[index];
+  entry.uuid                 = uuid;
+  entry.category             = category;
+  entry.requiresFlywheelName = requiresFlywheelName;
+  if (uuid.bitSize() == 16) {
+    entry.uuid16 = uuid.getNative()->u16.value;
+    entry.hash   = 0;
+  } else {
+    entry.uuid16 = 0;
+    entry.hash   = hash(uuid.getNative()->u128.value, 16);
+  }
+}
+
+void AdvertisementFilter::configure(const DeviceSelection &powerMeter, const DeviceSelection &heartMonitor, const DeviceSelection &remote) {
+  selections[NONE].set("none");
+  selections[POWER_METER]   = powerMeter;
+  selections[HEART_MONITOR] = heartMonitor;
+  selections[REMOTE]        = remote;
+}
+
+bool AdvertisementFilter::isEnabled(Category category) const { return selections[category].getMode() != DeviceSelection::NONE; }
+
+AdvertisementFilter::Result AdvertisementFilter::evaluate(const uint8_t *payload, size_t length, uint64_t address) const {
+  Result result     = {NONE, false, nullptr, nullptr, 0};
+  uint8_t matched   = 0;  // bit per services[] entry
+  bool completeName = false;
+
+  size_t pos = 0;
+  while (pos + 1 < length) {
+    uint8_t fieldLength = payload[pos];
+    if (fieldLength == 0 || pos + 1 + fieldLength > length) {
+      break;
+    }
+    uint8_t type        = payload[pos + 1];
+    const uint8_t *data = &payload[pos + 2];
+    uint8_t dataLength  = fieldLength - 1;
+
+    switch (type) {
+      case AD_TYPE_INCOMPLETE_16BIT_UUIDS:
+      case AD_TYPE_COMPLETE_16BIT_UUIDS:
+        for (uint8_t i = 0; i + 2 <= dataLength; i += 2) {
+          matched |= matchUUID16(data[i] | (data[i + 1] << 8));
+        }
+        break;
+      case AD_TYPE_INCOMPLETE_128BIT_UUIDS:
+      case AD_TYPE_COMPLETE_128BIT_UUIDS:
+        for (uint8_t i = 0; i + 16 <= dataLength; i += 16) {
+          matched |= matchUUID128(&data[i]);
+        }
+        break;
+      case AD_TYPE_SHORTENED_NAME:
+      case AD_TYPE_COMPLETE_NAME:
+        // Prefer the complete name if both are present.
+        if (!completeName) {
+          result.name       = reinterpret_cast<const char *>(data);
+          result.nameLength = dataLength;
+          completeName      = (type == AD_TYPE_COMPLETE_NAME);
+        }
+        break;
+      default:
+        break;
+    }
+    pos += fieldLength + 1;
+  }
+
+  for (size_t i = 0; i < SERVICE_COUNT; i++) {
+    if (!(matched & (1 << i))) {
+      continue;
+    }
+    if (services[i].requiresFlywheelName && !isFlywheelName(result.name, result.nameLength)) {
+      continue;
+    }
+    result.category = services[i].category;
+    result.service  = &services[i].uuid;
+    result.selected = selections[result.category].matches(result.name, result.nameLength, address);
+    break;
+  }
+  return result;
+}
+
+uint8_t AdvertisementFilter::matchUUID16(uint16_t uuid) const {
+  uint8_t matched = 0;
+  for (size_t i = 0; i < SERVICE_COUNT; i++) {
+    if (services[i].uuid16 != 0 && services[i].uuid16 == uuid) {
+      matched |= (1 << i);
+    }
+  }
+  return matched;
+}
+
+uint8_t AdvertisementFilter::matchUUID128(const uint8_t *uuid) const {
+  // 16 bit UUIDs are sometimes advertised in their expanded form.
+  if (memcmp(uuid, BLUETOOTH_BASE_UUID, sizeof(BLUETOOTH_BASE_UUID)) == 0 && uuid[14] == 0 && uuid[15] == 0) {
+    return matchUUID16(uuid[12] | (uuid[13] << 8));
+  }
+  uint32_t uuidHash = hash(uuid, 16);
+  uint8_t matched   = 0;
+  for (size_t i = 0; i < SERVICE_COUNT; i++) {
+    if (services[i].uuid16 == 0 && services[i].hash == uuidHash && memcmp(services[i].uuid.getNative()->u128.value, uuid, 16) == 0) {
+      matched |= (1 << i);
+    }
+  }
+  return matched;
+}
+
+bool AdvertisementFilter::isFlywheelName(const char *name, uint8_t length) const {
+  return name != nullptr && length == flywheelNameLength && hash(reinterpret_cast<const uint8_t *>(name), length) == flywheelNameHash &&
+         memcmp(name, FLYWHEEL_BLE_NAME, length) == 0;
+}
+
+uint32_t AdvertisementFilter::hash(const uint8_t *data, size_t length) { return DeviceSelection::hash(data, length); }
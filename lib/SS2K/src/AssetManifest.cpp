@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "AssetManifest.h"
+
+// Copy [start, end) to a terminated buffer of capacity + 1 bytes.
+static bool copyField(const char *start, const char *end, char *out, size_t capacity) {
+  size_t length = end - start;
+  if (length == 0 || length > capacity) {
+    return false;
+  }
+  memcpy(out, start, length);
+  out[length] = '\0';
+  return true;
+}
+
+size_t AssetManifest::load(const char *text, size_t length) {
+  std::lock_guard<std::mutex> lock(mutex);
+  count = 0;
+
+  const char *p   = text;
+  const char *eof = text + length;
+  while (p < eof) {
+    const char *eol = static_cast<const char *>(memchr(p, '\n', eof - p));
+    eol             = eol ? eol : eof;
+    const char *end = eol > p && eol[-1] == '\r' ? eol - 1 : eol;
+
+    // path, size, gzip, hash, mime
+    const char *fields[5];
+    const char *fieldEnds[5];
+    size_t found    = 0;
+    const char *pos = p;
+    while (found < 5 && pos <= end) {
+      const char *tab   = static_cast<const char *>(memchr(pos, '\t', end - pos));
+      fields[found]    = pos;
+      fieldEnds[found] = tab ? tab : end;
+      pos              = fieldEnds[found] + 1;
+      found++;
+      if (!tab) {
+        break;
+      }
+    }
+
+    Entry entry;
+    char number[12];
+    char hash[ASSET_MANIFEST_ETAG_LENGTH - 2 + 1];
+    bool valid = *p != '#' && found == 5 && fields[0][0] == '/' && copyField(fields[0], fieldEnds[0], entry.path, ASSET_MANIFEST_MAX_PATH) &&
+                 copyField(fields[1], fieldEnds[1], number, sizeof(number) - 1) && fieldEnds[2] - fields[2] == 1 &&
+                 copyField(fields[3], fieldEnds[3], hash, sizeof(hash) - 1) && copyField(fields[4], fieldEnds[4], entry.mime, ASSET_MANIFEST_MAX_MIME);
+    if (valid && count < ASSET_MANIFEST_MAX_ENTRIES) {
+      entry.size = strtoul(number, nullptr, 10);
+      entry.gzip = fields[2][0] == '1';
+      snprintf(entry.etag, sizeof(entry.etag), "\"%s\"", hash);
+      entries[count++] = entry;
+    }
+    p = eol + 1;
+  }
+  return count;
+}
+
+void AssetManifest::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  count = 0;
+}
+
+size_t AssetManifest::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return count;
+}
+
+bool AssetManifest::find(const char *path, Entry *entry) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (size_t i = 0; i < count; i++) {
+    if (strcmp(entries[i].path, path) == 0) {
+      *entry = entries[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool AssetManifest::at(size_t index, Entry *entry) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (index >= count) {
+    return false;
+  }
+  *entry = entries[index];
+  return true;
+}
+
+void AssetManifest::remove(const char *path) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (size_t i = 0; i < count; i++) {
+    if (strcmp(entries[i].path, path) == 0) {
+      entries[i] = entries[--count];
+      return;
+    }
+  }
+}
+
+bool AssetManifest::etagMatches(const char *ifNoneMatch, const char *etag) {
+  if (ifNoneMatch == nullptr || etag == nullptr) {
+    return false;
+  }
+  size_t etagLength = strlen(etag);
+  const char *p     = ifNoneMatch;
+  while (*p) {
+    while (*p == ' ' || *p == ',') {
+      p++;
+    }
+    if (*p == '*') {
+      return true;
+    }
+    if (p[0] == 'W' && p[1] == '/') {
+      p += 2;
+    }
+    const char *end = strchr(p, ',');
+    end             = end ? end : p + strlen(p);
+    const char *e   = end;
+    while (e > p && e[-1] == ' ') {
+      e--;
+    }
+    if ((size_t)(e - p) == etagLength && strncmp(p, etag, etagLength) == 0) {
+      return true;
+    }
+    p = end;
+  }
+  return false;
+}
+
+void AssetManifest::storedPath(const Entry &entry, char *out, size_t capacity) {
+  size_t length = strlen(entry.path);
+  bool gzipped  = entry.gzip && !(length >= 3 && strcmp(&entry.path[length - 3], ".gz") == 0);
+  snprintf(out, capacity, "%s%s", entry.path, gzipped ? ".gz" : "");
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "BootTimeline.h"
+
+BootTimeline::BootTimeline(const BootTimeline &other) {
+  std::lock_guard<std::mutex> lock(other.mutex);
+  for (size_t i = 0; i < other.count; i++) {
+    phases[i] = other.phases[i];
+  }
+  count    = other.count;
+  lastMark = other.lastMark;
+}
+
+uint32_t BootTimeline::mark(const char *phase, uint32_t now) {
+  std::lock_guard<std::mutex> lock(mutex);
+  uint32_t elapsed = now - lastMark;
+  lastMark         = now;
+  if (count < BOOT_TIMELINE_MAX_PHASES) {
+    phases[count++] = {phase, now};
+  }
+  return elapsed;
+}
+
+size_t BootTimeline::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return count;
+}
+
+void BootTimeline::writeJSON(JsonWriter &json) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  json.beginObject();
+  for (size_t i = 0; i < count; i++) {
+    json.add(phases[i].name, (long)phases[i].at);
+  }
+  json.endObject();
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "ConfigFile.h"
+
+static const char TRAILER_PREFIX[] = "\n#crc32=";
+
+uint32_t ConfigFile::crc32(const uint8_t *data, size_t length, uint32_t crc) {
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+size_t ConfigFile::trailer(uint32_t crc, char *out) { return snprintf(out, CONFIG_FILE_TRAILER_LENGTH + 1, "%s%08x\n", TRAILER_PREFIX, (unsigned)crc); }
+
+ConfigFile::Check ConfigFile::verify(const char *data, size_t length, size_t *contentLength) {
+  *contentLength          = length;
+  const size_t prefixSize = sizeof(TRAILER_PREFIX) - 1;
+  // Find the last trailer prefix, it may be followed by a newline or not.
+  for (size_t start = length >= CONFIG_FILE_TRAILER_LENGTH ? length - CONFIG_FILE_TRAILER_LENGTH : 0; start + prefixSize + 8 <= length; start++) {
+    if (memcmp(&data[start], TRAILER_PREFIX, prefixSize) != 0) {
+      continue;
+    }
+    char hex[9];
+    memcpy(hex, &data[start + prefixSize], 8);
+    hex[8] = '\0';
+    char *end;
+    uint32_t expected = strtoul(hex, &end, 16);
+    if (end != hex + 8) {
+      return CORRUPT;
+    }
+    *contentLength = start;
+    return crc32(reinterpret_cast<const uint8_t *>(data), start) == expected ? VALID : CORRUPT;
+  }
+  return UNCHECKED;
+}
+
+void SaveDebouncer::markDirty(uint32_t now) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!dirty) {
+    firstDirty = now;
+  }
+  dirty     = true;
+  lastDirty = now;
+}
+
+bool SaveDebouncer::isDirty() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return dirty;
+}
+
+bool SaveDebouncer::claimSave(uint32_t now, bool force) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!dirty) {
+    return false;
+  }
+  if (force || (uint32_t)(now - lastDirty) >= CONFIG_SAVE_DEBOUNCE_MILLIS || (uint32_t)(now - firstDirty) >= CONFIG_SAVE_MAX_DELAY_MILLIS) {
+    dirty = false;
+    return true;
+  }
+  return false;
+}
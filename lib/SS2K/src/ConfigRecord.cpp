@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstring>
+#include "ConfigFile.h"
+#include "ConfigRecord.h"
+
+static void writeLE(uint8_t *out, uint32_t value, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    out[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static uint32_t readLE(const uint8_t *in, size_t size) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < size; i++) {
+    value |= (uint32_t)in[i] << (8 * i);
+  }
+  return value;
+}
+
+ConfigRecordWriter::ConfigRecordWriter(uint8_t *buffer, size_t capacity, uint16_t version)
+    : buffer(buffer), capacity(capacity), length(CONFIG_RECORD_HEADER_SIZE), version(version) {
+  overflow = capacity < CONFIG_RECORD_HEADER_SIZE;
+}
+
+void ConfigRecordWriter::put(const void *data, size_t size) {
+  if (overflow || length + size > capacity) {
+    overflow = true;
+    return;
+  }
+  memcpy(&buffer[length], data, size);
+  length += size;
+}
+
+void ConfigRecordWriter::putBool(bool value) {
+  uint8_t byte = value ? 1 : 0;
+  put(&byte, 1);
+}
+
+void ConfigRecordWriter::putInt(int32_t value) {
+  uint8_t bytes[4];
+  writeLE(bytes, (uint32_t)value, 4);
+  put(bytes, 4);
+}
+
+void ConfigRecordWriter::putFloat(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, 4);
+  putInt((int32_t)bits);
+}
+
+void ConfigRecordWriter::putString(const char *value) { putString(value, 1); }
+
+void ConfigRecordWriter::putLongString(const char *value) { putString(value, 2); }
+
+void ConfigRecordWriter::putString(const char *value, size_t lengthSize) {
+  size_t maxSize = lengthSize == 1 ? UINT8_MAX : UINT16_MAX;
+  size_t size    = value ? strlen(value) : 0;
+  size           = size > maxSize ? maxSize : size;
+  uint8_t bytes[2];
+  writeLE(bytes, size, lengthSize);
+  put(bytes, lengthSize);
+  put(value, size);
+}
+
+size_t ConfigRecordWriter::finish() {
+  if (overflow || length - CONFIG_RECORD_HEADER_SIZE > UINT16_MAX) {
+    return 0;
+  }
+  size_t payloadLength = length - CONFIG_RECORD_HEADER_SIZE;
+  writeLE(&buffer[0], CONFIG_RECORD_MAGIC, 4);
+  writeLE(&buffer[4], version, 2);
+  writeLE(&buffer[6], payloadLength, 2);
+  writeLE(&buffer[8], ConfigFile::crc32(&buffer[CONFIG_RECORD_HEADER_SIZE], payloadLength), 4);
+  return length;
+}
+
+bool ConfigRecordReader::open(const uint8_t *data, size_t length) {
+  payload = nullptr;
+  if (length < CONFIG_RECORD_HEADER_SIZE || readLE(&data[0], 4) != CONFIG_RECORD_MAGIC) {
+    return false;
+  }
+  size_t recordLength = readLE(&data[6], 2);
+  if (CONFIG_RECORD_HEADER_SIZE + recordLength > length || ConfigFile::crc32(&data[CONFIG_RECORD_HEADER_SIZE], recordLength) != readLE(&data[8], 4)) {
+    return false;
+  }
+  recordVersion = readLE(&data[4], 2);
+  payload       = &data[CONFIG_RECORD_HEADER_SIZE];
+  payloadLength = recordLength;
+  position      = 0;
+  return true;
+}
+
+bool ConfigRecordReader::get(void *data, size_t size) {
+  if (payload == nullptr || position + size > payloadLength) {
+    position = payloadLength;  // don't read the fields after a short one
+    return false;
+  }
+  memcpy(data, &payload[position], size);
+  position += size;
+  return true;
+}
+
+bool ConfigRecordReader::getBool(bool fallback) {
+  uint8_t byte;
+  return get(&byte, 1) ? byte != 0 : fallback;
+}
+
+int32_t ConfigRecordReader::getInt(int32_t fallback) {
+  uint8_t bytes[4];
+  return get(bytes, 4) ? (int32_t)readLE(bytes, 4) : fallback;
+}
+
+float ConfigRecordReader::getFloat(float fallback) {
+  uint8_t bytes[4];
+  if (!get(bytes, 4)) {
+    return fallback;
+  }
+  uint32_t bits = readLE(bytes, 4);
+  float value;
+  memcpy(&value, &bits, 4);
+  return value;
+}
+
+bool ConfigRecordReader::getString(char *out, size_t capacity) { return getString(out, capacity, 1); }
+
+bool ConfigRecordReader::getLongString(char *out, size_t capacity) { return getString(out, capacity, 2); }
+
+bool ConfigRecordReader::getString(char *out, size_t capacity, size_t lengthSize) {
+  uint8_t bytes[2];
+  if (!get(bytes, lengthSize)) {
+    return false;
+  }
+  size_t size = readLE(bytes, lengthSize);
+  if (position + size > payloadLength) {
+    position = payloadLength;
+    return false;
+  }
+  if (capacity > 0) {
+    size_t copied = size < capacity - 1 ? size : capacity - 1;
+    memcpy(out, &payload[position], copied);
+    out[copied] = '\0';
+  }
+  position += size;
+  return true;
+}
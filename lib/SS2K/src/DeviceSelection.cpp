@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstring>
+#include "DeviceSelection.h"
+
+void DeviceSelection::set(const char *configured) {
+  if (configured == nullptr || configured[0] == '\0') {
+    configured = "any";
+  }
+  length = strnlen(configured, DEVICE_SELECTION_MAX_LENGTH);
+  memcpy(value, configured, length);
+  value[length] = '\0';
+  hashKey       = hash(reinterpret_cast<const uint8_t *>(value), length);
+  address       = 0;
+
+  if (strcmp(value, "any") == 0) {
+    mode = ANY;
+  } else if (strcmp(value, "none") == 0) {
+    mode = NONE;
+  } else if (parseAddress(value, &address)) {
+    mode = ADDRESS;
+  } else {
+    mode = NAME;
+  }
+}
+
+bool DeviceSelection::matches(const char *name, size_t nameLength, uint64_t deviceAddress) const {
+  switch (mode) {
+    case ANY:
+      return true;
+    case NONE:
+      return false;
+    case ADDRESS:
+      return deviceAddress == address;
+    default:
+      break;
+  }
+  if (nameLength != length || name == nullptr) {
+    return false;
+  }
+  return hash(reinterpret_cast<const uint8_t *>(name), nameLength) == hashKey && memcmp(name, value, length) == 0;
+}
+
+uint32_t DeviceSelection::hash(const uint8_t *data, size_t length) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    h ^= data[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+bool DeviceSelection::parseAddress(const char *text, uint64_t *address) {
+  uint64_t parsed = 0;
+  for (int i = 0; i < 17; i++) {
+    char c = text[i];
+    if (i % 3 == 2) {
+      if (c != ':') {
+        return false;
+      }
+      continue;
+    }
+    int digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      return false;
+    }
+    parsed = (parsed << 4) | digit;
+  }
+  if (text[17] != '\0') {
+    return false;
+  }
+  *address = parsed;
+  return true;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "DriverTelemetry.h"
+
+// DRV_STATUS bits, TMC2208 datasheet 5.5.
+#define DRV_OTPW         (1UL << 0)
+#define DRV_OT           (1UL << 1)
+#define DRV_SHORT        (0xFUL << 2)  // s2ga, s2gb, s2vsa, s2vsb
+#define DRV_OPEN_LOAD    (3UL << 6)    // ola, olb
+#define DRV_T120         (1UL << 8)
+#define DRV_T143         (1UL << 9)
+#define DRV_T150         (1UL << 10)
+#define DRV_T157         (1UL << 11)
+#define DRV_CS_SHIFT     16
+#define DRV_CS_MASK      0x1F
+#define DRV_STEALTH      (1UL << 30)
+#define DRV_STANDSTILL   (1UL << 31)
+// PWM_SCALE bits.
+#define PWM_SCALE_SUM_MASK 0xFF
+// Weight of a new moving read in the load average.
+#define LOAD_WEIGHT 0.1f
+
+// Counts reads in a row the condition held for, returns whether it held for enough of them.
+static bool debounce(int &reads, bool condition) {
+  reads = condition ? reads + 1 : 0;
+  return reads >= DRIVER_FAULT_READS;
+}
+
+void DriverTelemetry::update(uint32_t drvStatus, uint32_t pwmScale, bool moving) {
+  std::lock_guard<std::mutex> lock(mutex);
+  failedReads            = 0;
+  status.responding      = true;
+  status.reads++;
+  status.overTempWarning = drvStatus & DRV_OTPW;
+  status.overTemp        = drvStatus & DRV_OT;
+  status.shortCircuit    = drvStatus & DRV_SHORT;
+  status.current         = (drvStatus >> DRV_CS_SHIFT) & DRV_CS_MASK;
+  status.stealthChop     = drvStatus & DRV_STEALTH;
+  status.standstill      = drvStatus & DRV_STANDSTILL;
+  status.load            = pwmScale & PWM_SCALE_SUM_MASK;
+
+  status.temperature = 0;
+  if (drvStatus & DRV_T157) {
+    status.temperature = 157;
+  } else if (drvStatus & DRV_T150) {
+    status.temperature = 150;
+  } else if (drvStatus & DRV_T143) {
+    status.temperature = 143;
+  } else if (drvStatus & DRV_T120) {
+    status.temperature = 120;
+  }
+
+  // The open load flags are only meaningful while current is switching.
+  moving          = moving && !status.standstill;
+  status.openLoad = debounce(openLoadReads, moving && (drvStatus & DRV_OPEN_LOAD));
+
+  // pwm_scale_sum is only regulated to the load in StealthChop.
+  if (!moving || !status.stealthChop) {
+    stallReads = slipReads = 0;
+    status.stalled = status.slipping = false;
+    return;
+  }
+  bool settled    = movingReads >= DRIVER_LOAD_SETTLE_READS;
+  bool saturated  = status.load >= DRIVER_STALL_SCALE;
+  bool light      = settled && status.load < status.loadAverage * DRIVER_SLIP_RATIO;
+  status.stalled  = debounce(stallReads, saturated);
+  status.slipping = debounce(slipReads, light);
+  if (saturated || light) {
+    return;  // keep the average to what normal riding looks like
+  }
+  status.loadAverage = movingReads == 0 ? status.load : status.loadAverage + (status.load - status.loadAverage) * LOAD_WEIGHT;
+  movingReads++;
+}
+
+void DriverTelemetry::readFailed() {
+  std::lock_guard<std::mutex> lock(mutex);
+  status.failures++;
+  failedReads++;
+  if (failedReads >= DRIVER_FAULT_READS) {
+    status.responding = false;
+  }
+}
+
+DriverTelemetry::Status DriverTelemetry::getStatus() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return status;
+}
+
+void DriverTelemetry::Status::writeJSON(JsonWriter &json) const {
+  json.beginObject();
+  json.add("responding", responding);
+  json.add("overTempWarning", overTempWarning);
+  json.add("overTemp", overTemp);
+  json.add("shortCircuit", shortCircuit);
+  json.add("openLoad", openLoad);
+  json.add("temperature", (int)temperature);
+  json.add("current", (int)current);
+  json.add("stealthChop", stealthChop);
+  json.add("standstill", standstill);
+  json.add("load", (int)load);
+  json.add("loadAverage", (double)loadAverage);
+  json.add("stalled", stalled);
+  json.add("slipping", slipping);
+  json.add("reads", (long)reads);
+  json.add("failures", (long)failures);
+  json.endObject();
+}
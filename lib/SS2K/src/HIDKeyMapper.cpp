@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstring>
+#include "HIDKeyMapper.h"
+
+static const char *const ACTION_NAMES[] = {"none", "up", "down", "ergUp", "ergDown", "mode"};
+static const char *const GESTURE_NAMES[] = {"", "long", "double"};
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Does [start, end) equal str?
+static bool tokenEquals(const char *start, const char *end, const char *str) { return (size_t)(end - start) == strlen(str) && strncmp(start, str, end - start) == 0; }
+
+bool HIDKeyMapper::configure(const char *map) {
+  std::lock_guard<std::mutex> lock(mutex);
+  count   = 0;
+  held    = false;
+  pending = false;
+  queued  = 0;
+  if (map == nullptr) {
+    return true;
+  }
+
+  bool valid    = true;
+  const char *p = map;
+  while (*p) {
+    const char *end = strchr(p, ',');
+    end             = end ? end : p + strlen(p);
+    while (p < end && *p == ' ') {
+      p++;
+    }
+
+    // KEY
+    uint32_t key = 0;
+    int digits   = 0;
+    while (p < end && hexValue(*p) >= 0 && digits < 4) {
+      key = (key << 4) | hexValue(*p++);
+      digits++;
+    }
+    // [.GESTURE]
+    Gesture gesture = PRESS;
+    if (p < end && *p == '.') {
+      const char *g = ++p;
+      while (p < end && *p != '=') {
+        p++;
+      }
+      gesture = tokenEquals(g, p, GESTURE_NAMES[LONG_PRESS]) ? LONG_PRESS : tokenEquals(g, p, GESTURE_NAMES[DOUBLE_PRESS]) ? DOUBLE_PRESS : PRESS;
+      if (gesture == PRESS) {
+        digits = 0;  // unknown gesture, reject the entry
+      }
+    }
+    // =ACTION
+    Action action = NO_ACTION;
+    if (p < end && *p == '=') {
+      const char *a = ++p;
+      const char *e = end;
+      while (e > a && e[-1] == ' ') {
+        e--;
+      }
+      for (uint8_t i = SHIFT_UP; i <= TOGGLE_MODE; i++) {
+        if (tokenEquals(a, e, ACTION_NAMES[i])) {
+          action = (Action)i;
+        }
+      }
+    }
+
+    if (digits > 0 && key != 0 && action != NO_ACTION && count < HID_KEY_MAP_SIZE) {
+      bindings[count++] = {(uint16_t)key, gesture, action};
+    } else {
+      valid = false;
+    }
+    p = *end ? end + 1 : end;
+  }
+  return valid;
+}
+
+size_t HIDKeyMapper::fitBindings(const char *map, size_t maxLength) {
+  size_t length = map ? strlen(map) : 0;
+  if (length <= maxLength) {
+    return length;
+  }
+  // Cut before the separator of the last binding that still fits.
+  for (size_t i = maxLength + 1; i > 0; i--) {
+    if (map[i - 1] == ',') {
+      return i - 1;
+    }
+  }
+  return 0;
+}
+
+size_t HIDKeyMapper::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return count;
+}
+
+HIDKeyMapper::Action HIDKeyMapper::update(uint16_t key, uint32_t now) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (key == 0) {
+    keyUp(now);
+  } else {
+    keyDown(key, now);
+  }
+  return pop();
+}
+
+void HIDKeyMapper::keyDown(uint16_t key, uint32_t now) {
+  if (held && heldKey == key) {
+    return;  // repeated report
+  }
+  if (held && heldKey != key) {
+    // Rolled onto another key without a release report.
+    keyUp(now);
+  }
+  if (pending) {
+    pending = false;
+    if (pendingKey == key && (uint32_t)(now - releasedAt) <= HID_MULTI_PRESS_MILLIS) {
+      held      = true;
+      consumed  = true;
+      heldKey   = key;
+      pressedAt = now;
+      push(lookup(key, DOUBLE_PRESS));
+      return;
+    }
+    // Another key ended the double press window, so it was a single press.
+    push(lookup(pendingKey, PRESS));
+  }
+
+  held      = true;
+  consumed  = false;
+  heldKey   = key;
+  pressedAt = now;
+  if (lookup(key, LONG_PRESS) == NO_ACTION && lookup(key, DOUBLE_PRESS) == NO_ACTION) {
+    // Nothing to wait for.
+    consumed = true;
+    push(lookup(key, PRESS));
+  }
+}
+
+void HIDKeyMapper::keyUp(uint32_t now) {
+  if (!held) {
+    return;
+  }
+  held = false;
+  if (consumed) {
+    return;
+  }
+  if ((uint32_t)(now - pressedAt) >= HID_LONG_PRESS_MILLIS && lookup(heldKey, LONG_PRESS) != NO_ACTION) {
+    push(lookup(heldKey, LONG_PRESS));
+    return;
+  }
+  if (lookup(heldKey, DOUBLE_PRESS) != NO_ACTION) {
+    pending    = true;
+    pendingKey = heldKey;
+    releasedAt = now;
+    return;
+  }
+  push(lookup(heldKey, PRESS));
+}
+
+HIDKeyMapper::Action HIDKeyMapper::poll(uint32_t now) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (held && !consumed && (uint32_t)(now - pressedAt) >= HID_LONG_PRESS_MILLIS && lookup(heldKey, LONG_PRESS) != NO_ACTION) {
+    consumed = true;
+    push(lookup(heldKey, LONG_PRESS));
+  }
+  if (pending && (uint32_t)(now - releasedAt) > HID_MULTI_PRESS_MILLIS) {
+    pending = false;
+    push(lookup(pendingKey, PRESS));
+  }
+  return pop();
+}
+
+void HIDKeyMapper::push(Action action) {
+  if (action != NO_ACTION && queued < HID_ACTION_QUEUE_SIZE) {
+    queue[queued++] = action;
+  }
+}
+
+HIDKeyMapper::Action HIDKeyMapper::pop() {
+  if (queued == 0) {
+    return NO_ACTION;
+  }
+  Action action = queue[0];
+  memmove(queue, queue + 1, (--queued) * sizeof(queue[0]));
+  return action;
+}
+
+const char *HIDKeyMapper::actionName(Action action) { return action <= TOGGLE_MODE ? ACTION_NAMES[action] : ACTION_NAMES[NO_ACTION]; }
+
+HIDKeyMapper::Action HIDKeyMapper::lookup(uint16_t key, Gesture gesture) const {
+  for (size_t i = 0; i < count; i++) {
+    if (bindings[i].key == key && bindings[i].gesture == gesture) {
+      return bindings[i].action;
+    }
+  }
+  return NO_ACTION;
+}
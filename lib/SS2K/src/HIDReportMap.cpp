@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "HIDReportMap.h"
+
+// Short item types and tags from the Device Class Definition for HID 1.11, section 6.2.2.
+#define HID_ITEM_TYPE_MAIN   0
+#define HID_ITEM_TYPE_GLOBAL 1
+#define HID_ITEM_TYPE_LOCAL  2
+
+#define HID_MAIN_INPUT          0x8
+#define HID_GLOBAL_USAGE_PAGE   0x0
+#define HID_GLOBAL_LOGICAL_MIN  0x1
+#define HID_GLOBAL_REPORT_SIZE  0x7
+#define HID_GLOBAL_REPORT_ID    0x8
+#define HID_GLOBAL_REPORT_COUNT 0x9
+#define HID_LOCAL_USAGE         0x0
+#define HID_LOCAL_USAGE_MIN     0x1
+
+#define HID_INPUT_CONSTANT 0x01
+#define HID_INPUT_VARIABLE 0x02
+
+#define HID_LONG_ITEM_PREFIX 0xfe
+
+bool HIDReportMap::parse(const uint8_t *map, size_t length) {
+  clear();
+
+  // Global state
+  uint16_t usagePage  = 0;
+  int32_t logicalMin  = 0;
+  uint8_t reportSize  = 0;
+  uint8_t reportCount = 0;
+  uint8_t reportId    = 0;
+  // Local state, reset after every main item
+  uint16_t usageMin = 0;
+  bool haveUsage    = false;
+
+  // Input bit offset per report ID
+  uint8_t reportIds[HID_REPORT_MAP_MAX_REPORTS];
+  uint16_t reportBits[HID_REPORT_MAP_MAX_REPORTS];
+  size_t reports = 0;
+
+  size_t pos = 0;
+  while (pos < length) {
+    uint8_t prefix = map[pos];
+    if (prefix == HID_LONG_ITEM_PREFIX) {  // not used by any defined usage, skip
+      if (pos + 1 >= length) {
+        break;
+      }
+      pos += 3 + map[pos + 1];
+      continue;
+    }
+    uint8_t size = prefix & 0x03;
+    size         = size == 3 ? 4 : size;
+    uint8_t type = (prefix >> 2) & 0x03;
+    uint8_t tag  = prefix >> 4;
+    if (pos + 1 + size > length) {
+      break;
+    }
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < size; i++) {
+      value |= (uint32_t)map[pos + 1 + i] << (8 * i);
+    }
+    int32_t signedValue = (int32_t)value;
+    if (size == 1) {
+      signedValue = (int8_t)value;
+    } else if (size == 2) {
+      signedValue = (int16_t)value;
+    }
+    pos += 1 + size;
+
+    if (type == HID_ITEM_TYPE_MAIN) {
+      if (tag == HID_MAIN_INPUT) {
+        size_t r = 0;
+        while (r < reports && reportIds[r] != reportId) {
+          r++;
+        }
+        if (r == reports) {
+          if (reports == HID_REPORT_MAP_MAX_REPORTS) {
+            break;
+          }
+          reportIds[reports]  = reportId;
+          reportBits[reports] = 0;
+          reports++;
+        }
+        bool buttons = !(value & HID_INPUT_VARIABLE) || reportSize == 1;
+        if (!(value & HID_INPUT_CONSTANT) && buttons && reportSize > 0 && reportSize <= 16 && count < HID_REPORT_MAP_MAX_FIELDS) {
+          Field &field     = fields[count++];
+          field.reportId   = reportId;
+          field.bitOffset  = reportBits[r];
+          field.size       = reportSize;
+          field.count      = reportCount;
+          field.array      = !(value & HID_INPUT_VARIABLE);
+          field.usagePage  = usagePage;
+          field.usageMin   = haveUsage ? usageMin : 0;
+          field.logicalMin = logicalMin;
+        }
+        reportBits[r] += reportSize * reportCount;
+      }
+      haveUsage = false;
+    } else if (type == HID_ITEM_TYPE_GLOBAL) {
+      switch (tag) {
+        case HID_GLOBAL_USAGE_PAGE:
+          usagePage = value;
+          break;
+        case HID_GLOBAL_LOGICAL_MIN:
+          logicalMin = signedValue;
+          break;
+        case HID_GLOBAL_REPORT_SIZE:
+          reportSize = value;
+          break;
+        case HID_GLOBAL_REPORT_ID:
+          reportId = value;
+          break;
+        case HID_GLOBAL_REPORT_COUNT:
+          reportCount = value;
+          break;
+        default:
+          break;
+      }
+    } else if (type == HID_ITEM_TYPE_LOCAL) {
+      // The first usage (or usage minimum) of the field is enough to number its keys.
+      if ((tag == HID_LOCAL_USAGE || tag == HID_LOCAL_USAGE_MIN) && !haveUsage) {
+        usageMin  = value & 0xffff;
+        haveUsage = true;
+      }
+    }
+  }
+  return count > 0;
+}
+
+void HIDReportMap::clear() { count = 0; }
+
+uint16_t HIDReportMap::decode(uint8_t reportId, const uint8_t *report, size_t length) const {
+  bool known = false;
+  for (size_t f = 0; f < count; f++) {
+    const Field &field = fields[f];
+    if (field.reportId != reportId) {
+      continue;
+    }
+    known = true;
+    for (uint8_t i = 0; i < field.count; i++) {
+      bool inRange   = false;
+      uint32_t value = readBits(report, length, field.bitOffset + i * field.size, field.size, &inRange);
+      if (!inRange) {
+        break;
+      }
+      if (value == 0) {
+        continue;
+      }
+      if (field.array) {
+        return keyCode(field.usagePage, field.usageMin + (int32_t)value - field.logicalMin);
+      }
+      return keyCode(field.usagePage, field.usageMin + i);
+    }
+  }
+  if (known) {
+    return 0;
+  }
+  // No map (or an unknown report), fall back to the raw report.
+  for (size_t i = 0; i < length; i++) {
+    if (report[i] != 0) {
+      return report[i];
+    }
+  }
+  return 0;
+}
+
+uint32_t HIDReportMap::readBits(const uint8_t *report, size_t length, size_t bitOffset, uint8_t size, bool *inRange) {
+  *inRange = (bitOffset + size) <= length * 8;
+  if (!*inRange) {
+    return 0;
+  }
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < size; i++) {
+    size_t bit = bitOffset + i;
+    if (report[bit / 8] & (1 << (bit % 8))) {
+      value |= (1u << i);
+    }
+  }
+  return value;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "HRPowerEstimator.h"
+
+#include <cmath>
+
+bool HRPowerEstimator::setCalibration(const HRPowerPoint *points, size_t count) {
+  HRPowerPoint usable[HR_POWER_MAX_POINTS];
+  size_t usableCount = 0;
+  for (size_t i = 0; i < count && usableCount < HR_POWER_MAX_POINTS; i++) {
+    if (points[i].hr > 0 && points[i].watts > 0) {
+      usable[usableCount++] = points[i];
+    }
+  }
+
+  bool changed = usableCount != pointCount;
+  for (size_t i = 0; i < usableCount && !changed; i++) {
+    changed = usable[i].hr != this->points[i].hr || usable[i].watts != this->points[i].watts;
+  }
+  if (!changed) {
+    return false;
+  }
+  for (size_t i = 0; i < usableCount; i++) {
+    this->points[i] = usable[i];
+  }
+  pointCount = usableCount;
+  fit();
+  return true;
+}
+
+void HRPowerEstimator::fit() {
+  calibrated = false;
+  gradient = intercept = r2 = 0;
+  if (pointCount < 2) {
+    return;
+  }
+
+  float meanHR = 0, meanWatts = 0;
+  minHR = maxHR = points[0].hr;
+  for (size_t i = 0; i < pointCount; i++) {
+    meanHR += points[i].hr;
+    meanWatts += points[i].watts;
+    minHR = fminf(minHR, points[i].hr);
+    maxHR = fmaxf(maxHR, points[i].hr);
+  }
+  meanHR /= pointCount;
+  meanWatts /= pointCount;
+
+  float sxx = 0, sxy = 0, syy = 0;
+  for (size_t i = 0; i < pointCount; i++) {
+    float dx = points[i].hr - meanHR;
+    float dy = points[i].watts - meanWatts;
+    sxx += dx * dx;
+    sxy += dx * dy;
+    syy += dy * dy;
+  }
+  // Power has to rise with heart rate for the line to mean anything.
+  if (sxx <= 0 || sxy <= 0) {
+    return;
+  }
+  gradient   = sxy / sxx;
+  intercept  = meanWatts - gradient * meanHR;
+  r2         = (sxy * sxy) / (sxx * syy);
+  calibrated = true;
+}
+
+float HRPowerEstimator::update(float hr, uint32_t now) {
+  if (!started) {
+    started    = true;
+    lastUpdate = now;
+    hrFiltered = hr;
+    hrSlope    = 0;
+  } else {
+    float dt = (now - lastUpdate) / 1000.0f;
+    if (dt <= 0) {
+      return watts;
+    }
+    lastUpdate     = now;
+    float alpha    = dt / (HR_POWER_SMOOTHING + dt);
+    float previous = hrFiltered;
+    hrFiltered += alpha * (hr - hrFiltered);
+    hrSlope += alpha * ((hrFiltered - previous) / dt - hrSlope);
+  }
+
+  float correction = fmaxf(-HR_POWER_MAX_CORRECTION, fminf(HR_POWER_MAX_CORRECTION, HR_POWER_TIME_CONSTANT * hrSlope));
+  steadyHR         = hrFiltered + correction;
+  if (!calibrated) {
+    watts = confidence = 0;
+    return watts;
+  }
+  watts = fmaxf(0, intercept + gradient * steadyHR);
+
+  float outside = fmaxf(0, fmaxf(minHR - steadyHR, steadyHR - maxHR));
+  confidence    = r2 * (1.0f - 1.0f / pointCount);
+  confidence /= 1.0f + outside / HR_POWER_EXTRAPOLATION_RANGE;
+  confidence /= 1.0f + fabsf(correction) / HR_POWER_MAX_CORRECTION;
+  return watts;
+}
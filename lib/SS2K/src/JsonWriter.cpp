@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "JsonWriter.h"
+
+void JsonWindow::write(const char *data, size_t length) {
+  size_t end = position + length;
+  if (end > offset && position < offset + capacity) {
+    size_t from = position < offset ? offset - position : 0;
+    size_t to   = end > offset + capacity ? offset + capacity - position : length;
+    memcpy(&buffer[stored], &data[from], to - from);
+    stored += to - from;
+  }
+  position = end;
+}
+
+void JsonWriter::beginObject() {
+  write("{");
+  first = true;
+}
+
+void JsonWriter::endObject() { write("}"); }
+
+JsonWriter &JsonWriter::add(const char *key, int value) { return add(key, (long)value); }
+
+JsonWriter &JsonWriter::add(const char *key, long value) {
+  char number[24];
+  snprintf(number, sizeof(number), "%ld", value);
+  writeKey(key);
+  write(number);
+  return *this;
+}
+
+JsonWriter &JsonWriter::add(const char *key, bool value) {
+  writeKey(key);
+  write(value ? "true" : "false");
+  return *this;
+}
+
+JsonWriter &JsonWriter::add(const char *key, double value) {
+  char number[24];
+  writeKey(key);
+  if (std::isnan(value) || std::isinf(value)) {
+    write("null");  // what ArduinoJson writes as well
+    return *this;
+  }
+  // Settings are floats, 7 significant digits give back the value that was stored.
+  snprintf(number, sizeof(number), "%.7g", value);
+  write(number);
+  return *this;
+}
+
+JsonWriter &JsonWriter::add(const char *key, const char *value) {
+  writeKey(key);
+  if (value == nullptr) {
+    write("null");
+  } else {
+    writeString(value);
+  }
+  return *this;
+}
+
+void JsonWriter::write(const char *str) { out.write(str, strlen(str)); }
+
+void JsonWriter::writeKey(const char *key) {
+  if (!first) {
+    write(",");
+  }
+  first = false;
+  writeString(key);
+  write(":");
+}
+
+void JsonWriter::writeString(const char *str) {
+  write("\"");
+  const char *run = str;
+  for (; *str; str++) {
+    unsigned char c = *str;
+    if (c != '"' && c != '\\' && c >= 0x20) {
+      continue;
+    }
+    out.write(run, str - run);
+    char escaped[8];
+    if (c == '"' || c == '\\') {
+      snprintf(escaped, sizeof(escaped), "\\%c", c);
+    } else {
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+    }
+    write(escaped);
+    run = str + 1;
+  }
+  out.write(run, str - run);
+  write("\"");
+}
+
+size_t JsonChunker::read(char *out, size_t length, size_t index) {
+  if (!sized) {
+    JsonWindow counter(nullptr, 0, 0);
+    JsonWriter json(counter);
+    writeDocument(json);
+    passes++;
+    total = counter.total();
+    buffer.resize(total < maxBuffer ? total : maxBuffer);
+    sized = true;
+  }
+  if (index >= total || buffer.empty()) {
+    return 0;
+  }
+  if (index < start || index >= start + filled) {
+    fill(index);
+  }
+  size_t count = start + filled - index;
+  count        = count < length ? count : length;
+  memcpy(out, &buffer[index - start], count);
+  return count;
+}
+
+void JsonChunker::fill(size_t offset) {
+  JsonWindow window(buffer.data(), buffer.size(), offset);
+  JsonWriter json(window);
+  writeDocument(json);
+  passes++;
+  start  = offset;
+  filled = window.size();
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "PWCCollector.h"
+
+#include <algorithm>
+#include <cmath>
+
+void PWCCollector::seed(const HRPowerPoint *points, size_t count) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (Bucket &bucket : buckets) {
+    bucket = {0, 0, 0, 0, 0, 0};
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (points[i].hr <= 0 || points[i].watts <= 0) {
+      continue;
+    }
+    Bucket &bucket = buckets[std::min(points[i].watts / PWC_BUCKET_WIDTH, PWC_BUCKETS - 1)];
+    bucket.seconds += PWC_MIN_BUCKET_TIME;
+    bucket.hrSum += PWC_MIN_BUCKET_TIME * (float)points[i].hr;
+    bucket.wattsSum += PWC_MIN_BUCKET_TIME * (float)points[i].watts;
+    bucket.seedSeconds += PWC_MIN_BUCKET_TIME;
+    bucket.seedHr    = bucket.hrSum / bucket.seconds;  // the bucket only holds seeds so far
+    bucket.seedWatts = bucket.wattsSum / bucket.seconds;
+  }
+  HRPowerPoint fitted[HR_POWER_MAX_POINTS];
+  fit.setCalibration(fitted, collectPoints(fitted, HR_POWER_MAX_POINTS));
+}
+
+void PWCCollector::startEffort(uint32_t now) {
+  steadyFrom    = now;
+  effortSeconds = 0;
+  effortWatts   = 0;
+}
+
+bool PWCCollector::update(int hr, int watts, uint32_t now) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!started) {
+    started       = true;
+    lastUpdate    = now;
+    wattsFiltered = watts;
+    startEffort(now);
+    return false;
+  }
+  float dt   = (now - lastUpdate) / 1000.0f;
+  lastUpdate = now;
+  if (dt <= 0) {
+    return false;
+  }
+  if (hr <= 0 || watts <= 0 || dt > PWC_MAX_GAP) {
+    wattsFiltered = watts;
+    startEffort(now);
+    return false;
+  }
+
+  wattsFiltered += (watts - wattsFiltered) * dt / (PWC_POWER_SMOOTHING + dt);
+  float tolerance = std::max((float)PWC_STEADY_WATTS, effortWatts * PWC_STEADY_PERCENT / 100.0f);
+  if (effortSeconds > 0 && fabsf(wattsFiltered - effortWatts) > tolerance) {
+    startEffort(now);
+  }
+  effortWatts += (watts - effortWatts) * dt / (effortSeconds + dt);
+  effortSeconds += dt;
+  if ((now - steadyFrom) / 1000 < PWC_SETTLE_TIME) {
+    return false;
+  }
+
+  fadeSeeds(dt);
+  Bucket &bucket   = buckets[std::min((int)effortWatts / PWC_BUCKET_WIDTH, PWC_BUCKETS - 1)];
+  bool wasUsable   = usable(bucket);
+  bucket.seconds  += dt;
+  bucket.hrSum    += dt * hr;
+  bucket.wattsSum += dt * watts;
+  if (bucket.seconds > PWC_MAX_BUCKET_TIME) {
+    float scale = PWC_MAX_BUCKET_TIME / bucket.seconds;
+    bucket.seconds *= scale;
+    bucket.hrSum *= scale;
+    bucket.wattsSum *= scale;
+    bucket.seedSeconds *= scale;
+  }
+  sinceRefit += dt;
+
+  bool nowUsable = usable(bucket);
+  if ((nowUsable && !wasUsable) || sinceRefit >= PWC_REFIT_TIME) {
+    sinceRefit = 0;
+    return refit();
+  }
+  return false;
+}
+
+bool PWCCollector::refit() {
+  HRPowerPoint points[HR_POWER_MAX_POINTS];
+  size_t count = collectPoints(points, HR_POWER_MAX_POINTS);
+  fit.setCalibration(points, count);
+  if (count < PWC_MIN_POINTS || !fit.isCalibrated() || fit.getR2() < PWC_MIN_R2) {
+    return false;
+  }
+  fitCount++;
+  return true;
+}
+
+// Takes dt's share of PWC_SEED_FADE_TIME off every seeded bucket.
+void PWCCollector::fadeSeeds(float dt) {
+  for (Bucket &bucket : buckets) {
+    if (bucket.seedSeconds <= 0) {
+      continue;
+    }
+    float fade = std::min(bucket.seedSeconds, PWC_MIN_BUCKET_TIME * dt / PWC_SEED_FADE_TIME);
+    bucket.seedSeconds -= fade;
+    bucket.seconds -= fade;
+    bucket.hrSum -= fade * bucket.seedHr;
+    bucket.wattsSum -= fade * bucket.seedWatts;
+    if (bucket.seconds <= 0) {
+      bucket = {0, 0, 0, 0, 0, 0};  // nothing but rounding left
+    }
+  }
+}
+
+// A bucket is a point once it has enough riding in it, or while it still holds a saved session.
+bool PWCCollector::usable(const Bucket &bucket) { return bucket.seconds >= PWC_MIN_BUCKET_TIME || bucket.seedSeconds > 0; }
+
+size_t PWCCollector::collectPoints(HRPowerPoint *out, size_t capacity) const {
+  // The usable buckets with the most data, kept in order of power.
+  bool chosen[PWC_BUCKETS] = {};
+  size_t count             = 0;
+  while (count < capacity) {
+    int best = -1;
+    for (int i = 0; i < PWC_BUCKETS; i++) {
+      if (!chosen[i] && usable(buckets[i]) && (best < 0 || buckets[i].seconds > buckets[best].seconds)) {
+        best = i;
+      }
+    }
+    if (best < 0) {
+      break;
+    }
+    chosen[best] = true;
+    count++;
+  }
+  size_t written = 0;
+  for (int i = 0; i < PWC_BUCKETS && written < count; i++) {
+    if (chosen[i]) {
+      out[written++] = {(int)lroundf(buckets[i].hrSum / buckets[i].seconds), (int)lroundf(buckets[i].wattsSum / buckets[i].seconds)};
+    }
+  }
+  return written;
+}
+
+size_t PWCCollector::getPoints(HRPowerPoint *out, size_t capacity) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return collectPoints(out, capacity);
+}
+
+float PWCCollector::getR2() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return fit.getR2();
+}
+
+bool PWCCollector::settled() const { return started && effortSeconds > 0 && (lastUpdate - steadyFrom) / 1000 >= PWC_SETTLE_TIME; }
+
+bool PWCCollector::isSettled() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return settled();
+}
+
+PWCCollector::Summary PWCCollector::getSummary() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  HRPowerPoint points[HR_POWER_MAX_POINTS];
+  Summary summary;
+  summary.points        = (int)collectPoints(points, HR_POWER_MAX_POINTS);
+  summary.r2            = fit.getR2();
+  summary.gradient      = fit.getGradient();
+  summary.intercept     = fit.getIntercept();
+  summary.settled       = settled();
+  summary.steadySeconds = started ? (lastUpdate - steadyFrom) / 1000 : 0;
+  summary.fits          = fitCount;
+  return summary;
+}
+
+void PWCCollector::Summary::writeJSON(JsonWriter &json) const {
+  json.beginObject();
+  json.add("points", points);
+  json.add("r2", (double)r2);
+  json.add("gradient", (double)gradient);
+  json.add("intercept", (double)intercept);
+  json.add("settled", settled);
+  json.add("steadySeconds", steadySeconds);
+  json.add("fits", fits);
+  json.endObject();
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstring>
+#include "PacketCapture.h"
+
+static const uint8_t CAPTURE_MAGIC[4] = {'S', 'C', 'A', 'P'};
+static const size_t HEADER_LENGTH     = 8;
+// Length byte, timestamp, address, UUID length, data length
+static const size_t RECORD_OVERHEAD = 1 + 4 + 6 + 1 + 1;
+
+void PacketCapture::record(uint32_t timestamp, uint64_t address, const NimBLEUUID &charUUID, const uint8_t *data, size_t length) {
+  if (!enabled || ring.empty()) {
+    return;
+  }
+  uint8_t uuid[16];
+  uint8_t uuidLength;
+  if (charUUID.bitSize() == 16) {
+    uint16_t value = charUUID.getNative()->u16.value;
+    uuid[0]        = value & 0xff;
+    uuid[1]        = value >> 8;
+    uuidLength     = 2;
+  } else {
+    NimBLEUUID full = charUUID;
+    memcpy(uuid, full.to128().getNative()->u128.value, 16);
+    uuidLength = 16;
+  }
+  length              = length < SENSOR_NOTIFICATION_MAX_LENGTH ? length : SENSOR_NOTIFICATION_MAX_LENGTH;
+  size_t recordLength = RECORD_OVERHEAD + uuidLength + length;
+
+  uint8_t packed[RECORD_OVERHEAD + 16 + SENSOR_NOTIFICATION_MAX_LENGTH];
+  size_t n    = 0;
+  packed[n++] = recordLength;
+  for (int i = 0; i < 4; i++) {
+    packed[n++] = timestamp >> (8 * i);
+  }
+  for (int i = 0; i < 6; i++) {
+    packed[n++] = address >> (8 * i);
+  }
+  packed[n++] = uuidLength;
+  memcpy(&packed[n], uuid, uuidLength);
+  n += uuidLength;
+  packed[n++] = length;
+  memcpy(&packed[n], data, length);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (recordLength > ring.size()) {
+    return;
+  }
+  while (ring.size() - used < recordLength) {
+    dropOldest();
+  }
+  size_t tail = (head + used) % ring.size();
+  for (size_t i = 0; i < recordLength; i++) {
+    ring[(tail + i) % ring.size()] = packed[i];
+  }
+  used += recordLength;
+  count++;
+}
+
+void PacketCapture::dropOldest() {
+  size_t recordLength = at(0);
+  head                = (head + recordLength) % ring.size();
+  used -= recordLength;
+  count--;
+}
+
+void PacketCapture::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  head  = 0;
+  used  = 0;
+  count = 0;
+}
+
+size_t PacketCapture::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return count;
+}
+
+std::vector<uint8_t> PacketCapture::snapshot() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<uint8_t> out;
+  out.reserve(HEADER_LENGTH + used);
+  out.insert(out.end(), CAPTURE_MAGIC, CAPTURE_MAGIC + sizeof(CAPTURE_MAGIC));
+  out.push_back(PACKET_CAPTURE_VERSION);
+  out.push_back(0);
+  out.push_back(count & 0xff);
+  out.push_back(count >> 8);
+  for (size_t i = 0; i < used; i++) {
+    out.push_back(at(i));
+  }
+  return out;
+}
+
+bool PacketReplay::load(const uint8_t *capture, size_t length) {
+  data.clear();
+  records = 0;
+  offset  = 0;
+  if (length < HEADER_LENGTH || memcmp(capture, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 || capture[4] != PACKET_CAPTURE_VERSION) {
+    return false;
+  }
+  data.assign(capture + HEADER_LENGTH, capture + length);
+
+  // Validate every record up front so pump() can't run off the end.
+  SensorNotification notification;
+  size_t at = 0;
+  while (at < data.size()) {
+    if (!parse(at, &notification, &at)) {
+      data.clear();
+      records = 0;
+      return false;
+    }
+    if (records == 0) {
+      firstTime = notification.timestamp;
+    }
+    records++;
+  }
+  return true;
+}
+
+void PacketReplay::start(uint32_t now, float speed) {
+  startTime   = now;
+  this->speed = speed > 0 ? speed : 1.0;
+  offset      = 0;
+}
+
+uint32_t PacketReplay::nextDue() const {
+  SensorNotification notification;
+  size_t next;
+  if (!parse(offset, &notification, &next)) {
+    return startTime;
+  }
+  return startTime + (uint32_t)((notification.timestamp - firstTime) / speed);
+}
+
+size_t PacketReplay::pump(uint32_t now, SensorSink &sink) {
+  size_t delivered = 0;
+  SensorNotification notification;
+  size_t next;
+  while (offset < data.size() && parse(offset, &notification, &next)) {
+    if ((int32_t)(now - (startTime + (uint32_t)((notification.timestamp - firstTime) / speed))) < 0) {
+      break;
+    }
+    sink.onSensorNotification(notification);
+    offset = next;
+    delivered++;
+  }
+  return delivered;
+}
+
+bool PacketReplay::parse(size_t at, SensorNotification *notification, size_t *next) const {
+  if (at + RECORD_OVERHEAD > data.size()) {
+    return false;
+  }
+  const uint8_t *p    = &data[at];
+  size_t recordLength = p[0];
+  uint8_t uuidLength  = p[11];
+  if (recordLength < RECORD_OVERHEAD + uuidLength || at + recordLength > data.size() || (uuidLength != 2 && uuidLength != 16)) {
+    return false;
+  }
+  uint8_t length = p[12 + uuidLength];
+  if (recordLength != RECORD_OVERHEAD + uuidLength + length || length > SENSOR_NOTIFICATION_MAX_LENGTH) {
+    return false;
+  }
+
+  notification->timestamp = p[1] | (p[2] << 8) | (p[3] << 16) | ((uint32_t)p[4] << 24);
+  notification->address   = 0;
+  for (int i = 0; i < 6; i++) {
+    notification->address |= (uint64_t)p[5 + i] << (8 * i);
+  }
+  if (uuidLength == 2) {
+    notification->charUUID = NimBLEUUID((uint16_t)(p[12] | (p[13] << 8)));
+  } else {
+    notification->charUUID = NimBLEUUID(&p[12], 16, false);
+  }
+  notification->serviceUUID = NimBLEUUID((uint16_t)0x0000);  // not captured
+  notification->length      = length;
+  memcpy(notification->data, &p[13 + uuidLength], length);
+  *next = at + recordLength;
+  return true;
+}
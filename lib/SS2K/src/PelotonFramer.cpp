@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "PelotonFramer.h"
+#include "Constants.h"
+
+#include <cstring>
+
+// Positions in a response frame.
+#define FRAME_ID_POS     1
+#define FRAME_LENGTH_POS 2
+// Header, id, length, checksum and footer.
+#define FRAME_OVERHEAD 5
+
+bool PelotonFramer::push(uint8_t byte) {
+  if (complete) {
+    frame.length = 0;  // the frame returned last time
+  }
+  complete = append(byte);
+  if (complete) {
+    frames++;
+  }
+  return complete;
+}
+
+// Adds a byte to the frame, returns true if it completed the frame.
+bool PelotonFramer::append(uint8_t byte) {
+  if (frame.length == 0 && byte != PELOTON_HEADER) {
+    skipped++;
+    return false;
+  }
+  frame.data[frame.length++] = byte;
+  if (!accept(byte)) {
+    errors++;
+    resync();
+    return false;
+  }
+  return frame.length > FRAME_LENGTH_POS && frame.length == frame.data[FRAME_LENGTH_POS] + FRAME_OVERHEAD;
+}
+
+// Whether the byte just added can be part of a frame.
+bool PelotonFramer::accept(uint8_t byte) const {
+  size_t position = frame.length - 1;
+  if (position == FRAME_ID_POS) {
+    return byte != PELOTON_HEADER;
+  }
+  if (position == FRAME_LENGTH_POS) {
+    return byte > 0 && byte <= PELOTON_MAX_PAYLOAD;
+  }
+  size_t checksumPos = frame.data[FRAME_LENGTH_POS] + FRAME_LENGTH_POS + 1;
+  if (position > FRAME_LENGTH_POS && position < checksumPos) {
+    return byte >= '0' && byte <= '9';
+  }
+  if (position == checksumPos) {
+    uint8_t sum = 0;
+    for (size_t i = 0; i < checksumPos; i++) {
+      sum += frame.data[i];
+    }
+    return byte == sum;
+  }
+  if (position == checksumPos + 1) {
+    return byte == PELOTON_FOOTER;
+  }
+  return true;  // the header
+}
+
+// Drops the first byte of a bad frame and starts over with the bytes after it.
+void PelotonFramer::resync() {
+  uint8_t pending[PELOTON_MAX_FRAME];
+  size_t count = frame.length - 1;
+  memcpy(pending, frame.data + 1, count);
+  frame.length = 0;
+  skipped++;
+  for (size_t i = 0; i < count; i++) {
+    append(pending[i]);  // can't complete a frame, see the class comment
+  }
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "PelotonLink.h"
+#include "Constants.h"
+
+size_t PelotonLink::receive(uint32_t now, const FrameHandler &handler) {
+  uint8_t chunk[32];
+  size_t length;
+  size_t frames = 0;
+  while ((length = port.read(chunk, sizeof(chunk))) > 0) {
+    for (size_t i = 0; i < length; i++) {
+      if (!framer.push(chunk[i])) {
+        continue;
+      }
+      handler(framer.getFrame());
+      frames++;
+      uint8_t next = scheduler.onResponse(framer.getFrame().data[PELOTON_REQ_POS], now);
+      if (next != 0) {
+        send(next);
+      }
+    }
+  }
+  return frames;
+}
+
+void PelotonLink::tick(uint32_t now) {
+  if (!requesting) {
+    return;
+  }
+  uint8_t id = scheduler.poll(now);
+  if (id != 0) {
+    send(id);
+  }
+}
+
+void PelotonLink::send(uint8_t id) {
+  if (!requesting) {
+    return;
+  }
+  uint8_t request[PELOTON_RQ_SIZE];
+  PelotonScheduler::buildRequest(id, request);
+  if (port.availableForWrite() >= PELOTON_RQ_SIZE) {
+    port.write(request, PELOTON_RQ_SIZE);
+  }
+}
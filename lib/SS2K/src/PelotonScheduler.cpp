@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "PelotonScheduler.h"
+#include "Constants.h"
+
+// Request order, power gets twice the share in ERG mode.
+static const PelotonScheduler::Field kSimOrder[] = {PelotonScheduler::POWER, PelotonScheduler::CADENCE, PelotonScheduler::RESISTANCE};
+static const PelotonScheduler::Field kErgOrder[] = {PelotonScheduler::POWER, PelotonScheduler::CADENCE, PelotonScheduler::POWER, PelotonScheduler::RESISTANCE};
+// Weight of a new latency sample in the average.
+#define LATENCY_WEIGHT 0.1f
+
+uint8_t PelotonScheduler::fieldId(Field field) {
+  switch (field) {
+    case POWER:
+      return PELOTON_POW_ID;
+    case CADENCE:
+      return PELOTON_CAD_ID;
+    case RESISTANCE:
+      return PELOTON_RES_ID;
+    default:
+      return 0;
+  }
+}
+
+void PelotonScheduler::buildRequest(uint8_t id, uint8_t *out) {
+  out[0]                    = PELOTON_REQUEST;
+  out[PELOTON_REQ_POS]      = id;
+  out[PELOTON_CHECKSUM_POS] = (PELOTON_REQUEST + id) % 256;
+  out[3]                    = PELOTON_FOOTER;
+}
+
+void PelotonScheduler::setErgMode(bool erg) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (this->erg != erg) {
+    this->erg = erg;
+    slot      = 0;
+  }
+}
+
+// Picks the next field and marks it as waiting for its reply.
+uint8_t PelotonScheduler::next(uint32_t now) {
+  const Field *order = erg ? kErgOrder : kSimOrder;
+  size_t length      = erg ? sizeof(kErgOrder) / sizeof(kErgOrder[0]) : sizeof(kSimOrder) / sizeof(kSimOrder[0]);
+  pending            = fieldId(order[slot % length]);
+  slot               = (slot + 1) % length;
+  sentAt             = now;
+  stats.requests++;
+  return pending;
+}
+
+uint8_t PelotonScheduler::poll(uint32_t now) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (pending != 0) {
+    if (now - sentAt < PELOTON_RESPONSE_TIMEOUT) {
+      return 0;
+    }
+    pending = 0;
+    stats.timeouts++;
+    if (++misses >= PELOTON_MAX_MISSES) {
+      connected = false;
+    }
+  }
+  if (!connected && misses >= PELOTON_MAX_MISSES) {
+    if (now - lastProbe < PELOTON_PROBE_INTERVAL) {
+      return 0;
+    }
+    lastProbe = now;
+  }
+  return next(now);
+}
+
+uint8_t PelotonScheduler::onResponse(uint8_t id, uint32_t now) {
+  std::lock_guard<std::mutex> lock(mutex);
+  stats.responses++;
+  misses    = 0;
+  connected = true;
+  if (pending == 0 || id != pending) {
+    return 0;  // a late reply, the request after it is still waiting
+  }
+  for (int field = 0; field < FIELD_COUNT; field++) {
+    if (fieldId((Field)field) == id) {
+      float latency  = now - sentAt;
+      float &average = stats.latency[field];
+      average        = average == 0 ? latency : average + LATENCY_WEIGHT * (latency - average);
+    }
+  }
+  return next(now);
+}
+
+bool PelotonScheduler::isConnected() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return connected;
+}
+
+PelotonScheduler::Stats PelotonScheduler::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  Stats copy     = stats;
+  copy.connected = connected;
+  return copy;
+}
+
+void PelotonScheduler::Stats::writeJSON(JsonWriter &json) const {
+  json.beginObject();
+  json.add("connected", connected);
+  json.add("requests", (long)requests);
+  json.add("responses", (long)responses);
+  json.add("timeouts", (long)timeouts);
+  json.add("powerLatency", (double)latency[POWER]);
+  json.add("cadenceLatency", (double)latency[CADENCE]);
+  json.add("resistanceLatency", (double)latency[RESISTANCE]);
+  json.endObject();
+}
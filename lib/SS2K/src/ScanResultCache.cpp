@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include "ScanResultCache.h"
+
+namespace {
+// Bounded writer with snprintf semantics: keeps counting once the buffer is full.
+class BoundedWriter {
+ public:
+  BoundedWriter(char *buffer, size_t capacity) : buffer(buffer), capacity(capacity), length(0) {
+    if (capacity > 0) {
+      buffer[0] = '\0';
+    }
+  }
+
+  void append(char c) {
+    if (length + 1 < capacity) {
+      buffer[length]     = c;
+      buffer[length + 1] = '\0';
+    }
+    length++;
+  }
+
+  void append(const char *format, ...) {
+    char scratch[64];
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(scratch, sizeof(scratch), format, args);
+    va_end(args);
+    for (int i = 0; i < written && i < (int)sizeof(scratch) - 1; i++) {
+      append(scratch[i]);
+    }
+  }
+
+  void appendEscaped(const char *str) {
+    for (; *str; str++) {
+      unsigned char c = *str;
+      if (c == '"' || c == '\\') {
+        append('\\');
+        append((char)c);
+      } else if (c < 0x20) {
+        append("\\u%04x", c);
+      } else {
+        append((char)c);
+      }
+    }
+  }
+
+  size_t size() const { return length; }
+
+ private:
+  char *buffer;
+  size_t capacity;
+  size_t length;
+};
+}  // namespace
+
+void ScanResultCache::update(uint64_t address, uint8_t addressType, const AdvertisementFilter::Result &result, int rssi, uint32_t now) {
+  if (result.category == AdvertisementFilter::NONE) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+
+  Entry *entry = nullptr;
+  for (size_t i = 0; i < count; i++) {
+    if (entries[i].address == address) {
+      entry = &entries[i];
+      break;
+    }
+  }
+
+  if (entry == nullptr) {
+    if (count < SCAN_RESULT_CACHE_SIZE) {
+      entry = &entries[count++];
+    } else {
+      // Full, reuse the slot of the device we haven't heard from the longest.
+      entry = &entries[0];
+      for (size_t i = 1; i < count; i++) {
+        if ((uint32_t)(now - entries[i].lastSeen) > (uint32_t)(now - entry->lastSeen)) {
+          entry = &entries[i];
+        }
+      }
+    }
+    entry->address   = address;
+    entry->rssi      = rssi;
+    entry->timesSeen = 0;
+    entry->name[0]   = '\0';
+  } else {
+    entry->rssi += RSSI_ALPHA * (rssi - entry->rssi);
+  }
+
+  entry->addressType = addressType;
+  entry->category    = result.category;
+  entry->selected    = result.selected;
+  entry->service     = *result.service;
+  entry->lastSeen    = now;
+  if (entry->timesSeen < UINT16_MAX) {
+    entry->timesSeen++;
+  }
+  // Scan responses without a name shouldn't erase the one we already know.
+  if (result.name != nullptr && result.nameLength > 0) {
+    size_t length = result.nameLength < ADVERTISEMENT_FILTER_MAX_NAME ? result.nameLength : ADVERTISEMENT_FILTER_MAX_NAME;
+    memcpy(entry->name, result.name, length);
+    entry->name[length] = '\0';
+  }
+}
+
+bool ScanResultCache::find(uint64_t address, Entry *entry) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (size_t i = 0; i < count; i++) {
+    if (entries[i].address == address) {
+      *entry = entries[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ScanResultCache::findSelected(AdvertisementFilter::Category category, uint32_t now, uint32_t maxAge, Entry *entry) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  const Entry *newest = nullptr;
+  for (size_t i = 0; i < count; i++) {
+    const Entry &candidate = entries[i];
+    if (candidate.category != category || !candidate.selected || (uint32_t)(now - candidate.lastSeen) > maxAge) {
+      continue;
+    }
+    if (newest == nullptr || (uint32_t)(now - candidate.lastSeen) < (uint32_t)(now - newest->lastSeen)) {
+      newest = &candidate;
+    }
+  }
+  if (newest == nullptr) {
+    return false;
+  }
+  *entry = *newest;
+  return true;
+}
+
+size_t ScanResultCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return count;
+}
+
+void ScanResultCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  count = 0;
+}
+
+size_t ScanResultCache::toJSON(char *buffer, size_t capacity, uint32_t now, uint32_t maxAge) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  BoundedWriter out(buffer, capacity);
+  char address[18];
+  size_t index = 0;
+
+  out.append('{');
+  for (size_t i = 0; i < count; i++) {
+    const Entry &entry = entries[i];
+    if ((uint32_t)(now - entry.lastSeen) > maxAge) {
+      continue;
+    }
+    formatAddress(entry.address, address);
+    out.append("%s\"device %u\":{\"address\":\"%s\"", index > 0 ? "," : "", (unsigned)index, address);
+    if (entry.name[0] != '\0') {
+      out.append(",\"name\":\"");
+      out.appendEscaped(entry.name);
+      out.append('"');
+    }
+    out.append(",\"UUID\":\"%s\"", entry.service.toString().c_str());
+    out.append(",\"rssi\":%d,\"age\":%u}", (int)lroundf(entry.rssi), (unsigned)((now - entry.lastSeen) / 1000));
+    index++;
+  }
+  out.append('}');
+  return out.size();
+}
+
+size_t ScanResultCache::toBinary(uint8_t *buffer, size_t capacity, uint32_t now, uint32_t maxAge) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (capacity == 0) {
+    return 0;
+  }
+  size_t length = 1;
+  uint8_t index = 0;
+  for (size_t i = 0; i < count; i++) {
+    const Entry &entry = entries[i];
+    if ((uint32_t)(now - entry.lastSeen) > maxAge) {
+      continue;
+    }
+    size_t nameLength = strlen(entry.name);
+    if (length + 12 + nameLength > capacity) {
+      break;
+    }
+    for (int b = 0; b < 6; b++) {
+      buffer[length++] = (uint8_t)(entry.address >> (8 * b));
+    }
+    uint32_t age     = (now - entry.lastSeen) / 1000;
+    age              = age > UINT16_MAX ? UINT16_MAX : age;
+    buffer[length++] = entry.addressType;
+    buffer[length++] = entry.category;
+    buffer[length++] = (uint8_t)(int8_t)lroundf(entry.rssi);
+    buffer[length++] = (uint8_t)(age & 0xff);
+    buffer[length++] = (uint8_t)(age >> 8);
+    buffer[length++] = (uint8_t)nameLength;
+    memcpy(&buffer[length], entry.name, nameLength);
+    length += nameLength;
+    index++;
+  }
+  buffer[0] = index;
+  return length;
+}
+
+// Same format as NimBLEAddress::toString()
+void ScanResultCache::formatAddress(uint64_t address, char *out) {
+  snprintf(out, 18, "%02x:%02x:%02x:%02x:%02x:%02x", (unsigned)((address >> 40) & 0xff), (unsigned)((address >> 32) & 0xff), (unsigned)((address >> 24) & 0xff),
+           (unsigned)((address >> 16) & 0xff), (unsigned)((address >> 8) & 0xff), (unsigned)(address & 0xff));
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include "Constants.h"
+#include "SensorPipeline.h"
+
+// snprintf that stops at the end of the buffer instead of running past it.
+static void appendLog(char *log, size_t capacity, size_t &length, const char *format, ...) {
+  if (log == nullptr || length + 1 >= capacity) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(log + length, capacity - length, format, args);
+  va_end(args);
+  if (written > 0) {
+    length += (size_t)written < capacity - length ? written : capacity - length - 1;
+  }
+}
+
+uint8_t SensorPipeline::apply(const NimBLEUUID &charUUID, uint64_t address, uint8_t *data, size_t length, uint32_t now, char *log, size_t logCapacity) {
+  std::shared_ptr<SensorData> sensorData = sensorDataFactory.getSensorData(charUUID, address, data, length);
+  // Peloton connected but using a BLE power meter, so its cadence and power are skipped.
+  bool skipPeloton = (charUUID == PELOTON_DATA_UUID) && sources.powerMeterSelected;
+  uint8_t applied  = 0;
+  size_t logLength = 0;
+  if (log != nullptr && logCapacity > 0) {
+    log[0] = '\0';
+  }
+
+  appendLog(log, logCapacity, logLength, "%s[", sensorData->getId().c_str());
+  if (sensorData->hasHeartRate() && !metrics.isSimulated(RideMetrics::HEART_RATE)) {
+    int heartRate = sensorData->getHeartRate();
+    metrics.set(RideMetrics::HEART_RATE, heartRate);
+    applied |= APPLIED_HEART_RATE;
+    appendLog(log, logCapacity, logLength, " HR(%d)", heartRate % 1000);
+  }
+  if (sensorData->hasCadence() && !metrics.isSimulated(RideMetrics::CADENCE) && !skipPeloton) {
+    float cadence = sensorData->getCadence();
+    metrics.set(RideMetrics::CADENCE, cadence);
+    applied |= APPLIED_CADENCE;
+    appendLog(log, logCapacity, logLength, " CD(%.2f)", fmodf(cadence, 1000.0));
+  }
+  if (sensorData->hasPower() && !metrics.isSimulated(RideMetrics::POWER) && !skipPeloton) {
+    int power = sensorData->getPower() * sources.powerCorrectionFactor;
+    metrics.set(RideMetrics::POWER, power);
+    applied |= APPLIED_POWER;
+    appendLog(log, logCapacity, logLength, " PW(%d)", power % 10000);
+  }
+  if (sensorData->hasSpeed()) {
+    float speed = sensorData->getSpeed();
+    metrics.set(RideMetrics::SPEED, speed);
+    applied |= APPLIED_SPEED;
+    appendLog(log, logCapacity, logLength, " SD(%.2f)", fmodf(speed, 1000.0));
+  }
+  // With the Peloton resistance range only the Peloton reports resistance.
+  if (sensorData->hasResistance() && !(sources.pelotonResistance && charUUID != PELOTON_DATA_UUID)) {
+    int resistance = sensorData->getResistance();
+    metrics.set(RideMetrics::RESISTANCE, resistance);
+    applied |= APPLIED_RESISTANCE;
+    appendLog(log, logCapacity, logLength, " RS(%d)", resistance % 1000);
+  }
+  appendLog(log, logCapacity, logLength, " ]");
+
+  stats.sensorNotifications++;
+  if (!pending) {
+    pending      = true;
+    pendingSince = now;
+  }
+  return applied;
+}
+
+void SensorPipeline::onSensorNotification(const SensorNotification &notification) {
+  uint8_t data[SENSOR_NOTIFICATION_MAX_LENGTH];
+  memcpy(data, notification.data, notification.length);
+  apply(notification.charUUID, notification.address, data, notification.length, notification.timestamp);
+}
+
+void SensorPipeline::update(uint32_t now, ServerTransport &server) {
+  if (controlStep) {
+    controlStep(metrics, now);
+  }
+
+  float cadence  = metrics.get(RideMetrics::CADENCE);
+  int watts      = metrics.get(RideMetrics::POWER);
+  int hr         = metrics.get(RideMetrics::HEART_RATE);
+  int resistance = metrics.get(RideMetrics::RESISTANCE);
+  float speed    = metrics.get(RideMetrics::SPEED);
+
+  uint8_t buffer[SERVER_DATA_MAX_LENGTH];
+  size_t sent = 0;
+  if (server.isSubscribed(FITNESSMACHINEINDOORBIKEDATA_UUID)) {
+    server.notify(FITNESSMACHINEINDOORBIKEDATA_UUID, buffer, ServerData::indoorBikeData(cadence, watts, hr, resistance, speed, buffer));
+    sent++;
+  }
+  if (server.isSubscribed(CYCLINGPOWERMEASUREMENT_UUID)) {
+    server.notify(CYCLINGPOWERMEASUREMENT_UUID, buffer, ServerData::cyclingPowerMeasurement(watts, cadence, crank, buffer));
+    sent++;
+  }
+  if (server.isSubscribed(HEARTCHARACTERISTIC_UUID)) {
+    server.notify(HEARTCHARACTERISTIC_UUID, buffer, ServerData::heartRateMeasurement(hr, buffer));
+    sent++;
+  }
+  stats.serverNotifications += sent;
+
+  if (pending && sent > 0) {
+    uint32_t latency = now - pendingSince;
+    stats.maxLatency = latency > stats.maxLatency ? latency : stats.maxLatency;
+    stats.totalLatency += latency;
+    stats.latencySamples++;
+    pending = false;
+  }
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "ServerData.h"
+
+size_t ServerData::indoorBikeData(float cadence, int watts, int hr, int resistance, float speed, uint8_t *out) {
+  int cad = static_cast<int>(cadence * 2);  // 0.5 rpm resolution
+  int spd = speed <= 0 ? (((cad * watts) / 100) * 1.5) : static_cast<int>(speed);
+
+  out[0]  = 0x64;  // 1001100100 ISpeed, ICAD, Resistance, IPower, HeartRate
+  out[1]  = 0x02;
+  out[2]  = (uint8_t)(spd & 0xff);
+  out[3]  = (uint8_t)(spd >> 8);
+  out[4]  = (uint8_t)(cad & 0xff);
+  out[5]  = (uint8_t)(cad >> 8);
+  out[6]  = (uint8_t)(resistance & 0xff);
+  out[7]  = (uint8_t)(resistance >> 8);
+  out[8]  = (uint8_t)(watts & 0xff);
+  out[9]  = (uint8_t)(watts >> 8);
+  out[10] = (uint8_t)hr;
+  return 11;
+}
+
+size_t ServerData::cyclingPowerMeasurement(int watts, float cadence, CrankRevolutions &crank, uint8_t *out) {
+  if (cadence > 0) {
+    float crankRevPeriod = (60 * 1024) / cadence;
+    crank.cumulative++;
+    crank.lastEventTime += crankRevPeriod;
+  }
+  out[0] = 0x23;  // Pedal Power Balance, Pedal Power Balance Reference, Crank Revolution Data
+  out[1] = 0x00;
+  out[2] = (uint8_t)(watts & 0xff);
+  out[3] = (uint8_t)((watts >> 8) & 0xff);
+  out[4] = 0x00;
+  out[5] = (uint8_t)(crank.cumulative & 0xff);
+  out[6] = (uint8_t)((crank.cumulative >> 8) & 0xff);
+  out[7] = (uint8_t)(crank.lastEventTime & 0xff);
+  out[8] = (uint8_t)((crank.lastEventTime >> 8) & 0xff);
+  return 9;
+}
+
+size_t ServerData::heartRateMeasurement(int hr, uint8_t *out) {
+  out[0] = 0x00;
+  out[1] = (uint8_t)hr;
+  return 2;
+}
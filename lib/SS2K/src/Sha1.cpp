@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstring>
+#include "Sha1.h"
+
+static uint32_t rotl(uint32_t value, int bits) { return (value << bits) | (value >> (32 - bits)); }
+
+void Sha1::reset() {
+  state[0]    = 0x67452301;
+  state[1]    = 0xefcdab89;
+  state[2]    = 0x98badcfe;
+  state[3]    = 0x10325476;
+  state[4]    = 0xc3d2e1f0;
+  blockLength = 0;
+  totalLength = 0;
+}
+
+void Sha1::update(const uint8_t *data, size_t length) {
+  totalLength += length;
+  while (length > 0) {
+    size_t take = 64 - blockLength < length ? 64 - blockLength : length;
+    memcpy(&block[blockLength], data, take);
+    blockLength += take;
+    data += take;
+    length -= take;
+    if (blockLength == 64) {
+      transform(block);
+      blockLength = 0;
+    }
+  }
+}
+
+void Sha1::finish(uint8_t digest[20]) {
+  uint64_t bits = totalLength * 8;
+  uint8_t pad   = 0x80;
+  update(&pad, 1);
+  pad = 0;
+  while (blockLength != 56) {
+    update(&pad, 1);
+  }
+  uint8_t length[8];
+  for (int i = 0; i < 8; i++) {
+    length[i] = (uint8_t)(bits >> (56 - 8 * i));
+  }
+  update(length, 8);
+  for (int i = 0; i < 20; i++) {
+    digest[i] = (uint8_t)(state[i / 4] >> (24 - 8 * (i % 4)));
+  }
+}
+
+void Sha1::finishHex(char *out, size_t digits) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  uint8_t digest[20];
+  finish(digest);
+  digits = digits > 40 ? 40 : digits;
+  for (size_t i = 0; i < digits; i++) {
+    out[i] = HEX_DIGITS[(digest[i / 2] >> (i % 2 ? 0 : 4)) & 0x0f];
+  }
+  out[digits] = '\0';
+}
+
+void Sha1::transform(const uint8_t *data) {
+  uint32_t w[80];
+  for (int i = 0; i < 16; i++) {
+    w[i] = ((uint32_t)data[4 * i] << 24) | ((uint32_t)data[4 * i + 1] << 16) | ((uint32_t)data[4 * i + 2] << 8) | data[4 * i + 3];
+  }
+  for (int i = 16; i < 80; i++) {
+    w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  }
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+  for (int i = 0; i < 80; i++) {
+    uint32_t f, k;
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5a827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ed9eba1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8f1bbcdc;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xca62c1d6;
+    }
+    uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+    e             = d;
+    d             = c;
+    c             = rotl(b, 30);
+    b             = a;
+    a             = temp;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstdio>
+#include "TelemetryDelta.h"
+
+int TelemetryDelta::addField(const char *name, Type type) {
+  if (count == TELEMETRY_MAX_FIELDS) {
+    return -1;
+  }
+  fields[count] = {name, type, 0, 0};
+  keyframe      = true;
+  return count++;
+}
+
+void TelemetryDelta::set(int field, float value) {
+  if (field >= 0 && (size_t)field < count) {
+    fields[field].value = value;
+  }
+}
+
+size_t TelemetryDelta::serialize(char *buffer, size_t capacity, uint32_t now) {
+  bool full = keyframe || (uint32_t)(now - lastKeyframe) >= TELEMETRY_KEYFRAME_MILLIS;
+  if (capacity < 3) {
+    return 0;
+  }
+
+  size_t length    = 0;
+  buffer[length++] = '{';
+  for (size_t i = 0; i < count; i++) {
+    Field &field = fields[i];
+    if (!full && field.value == field.sent) {
+      continue;
+    }
+    int written;
+    const char *separator = length > 1 ? "," : "";
+    switch (field.type) {
+      case FLOAT:
+        written = snprintf(&buffer[length], capacity - length, "%s\"%s\":%.2f", separator, field.name, field.value);
+        break;
+      case BOOL:
+        written = snprintf(&buffer[length], capacity - length, "%s\"%s\":%s", separator, field.name, field.value != 0 ? "true" : "false");
+        break;
+      default:
+        written = snprintf(&buffer[length], capacity - length, "%s\"%s\":%ld", separator, field.name, (long)field.value);
+        break;
+    }
+    if (written < 0 || length + written + 2 > capacity) {
+      return 0;  // nothing is marked sent, the next frame retries
+    }
+    length += written;
+  }
+  if (length == 1) {
+    return 0;
+  }
+  buffer[length++] = '}';
+  buffer[length]   = '\0';
+
+  for (size_t i = 0; i < count; i++) {
+    fields[i].sent = fields[i].value;
+  }
+  if (full) {
+    keyframe     = false;
+    lastKeyframe = now;
+  }
+  return length;
+}
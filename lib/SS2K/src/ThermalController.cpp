@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "ThermalController.h"
+
+void ThermalController::setFullCurrent(uint8_t current) {
+  fullCurrent = current;
+  if (!derating || runCurrent > current) {
+    runCurrent = current;
+  }
+}
+
+void ThermalController::update(float reading, bool driverWarning, bool moving, uint32_t now) {
+  temperature = filtered ? temperature + (reading - temperature) * THERMAL_FILTER_WEIGHT : reading;
+  filtered    = true;
+
+  float excess = temperature - throttleTemp;
+  if (driverWarning && excess < THERMAL_WARNING_EXCESS) {
+    excess = THERMAL_WARNING_EXCESS;
+  }
+  if (excess > 0) {
+    derating = true;
+  } else if (excess <= -THERMAL_HYSTERESIS) {
+    derating = false;
+  }
+
+  if (derating && excess > 0) {
+    int floor  = std::max(1, fullCurrent * THERMAL_MIN_RUN_PERCENT / 100);
+    int target = std::max(floor, fullCurrent - (int)lroundf(excess * THERMAL_DERATE_GAIN));
+    // Down right away, back up a step at a time and only once it's a step clear, so a
+    // reading on the edge of a step doesn't switch between the two.
+    if (target < runCurrent) {
+      runCurrent = target;
+    } else if (target > runCurrent + 1) {
+      runCurrent++;
+    }
+  } else if (!derating && runCurrent < fullCurrent) {
+    runCurrent++;
+  }  // else between the thresholds: keep the current
+
+  if (moving) {
+    lastMove = now;
+  }
+  idle = now - lastMove >= THERMAL_IDLE_DELAY;
+}
+
+uint8_t ThermalController::getHoldCurrent() const {
+  int hold = runCurrent * (idle ? THERMAL_IDLE_HOLD_PERCENT : THERMAL_HOLD_PERCENT) / 100;
+  return std::max(1, hold);
+}
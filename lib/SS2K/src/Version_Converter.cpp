@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "Version_Converter.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Copies length characters of text into out, cutting them to fit.
+static void copyPart(const char *text, size_t length, char *out, size_t capacity) {
+  if (length >= capacity) {
+    length = capacity - 1;
+  }
+  memcpy(out, text, length);
+  out[length] = '\0';
+}
+
+void Version::parse(const char *version) {
+  // Assign it by zero, otherwise std::sscanf() will leave garbage in the
+  // version-tag if there are less than four numbers.
+  major = minor = revision = build = commitCount = 0;
+  strcpy(branch, "master");
+  commit[0] = '\0';
+  if (version == nullptr) {
+    return;
+  }
+
+  if (*version == 'v') {
+    version++;
+  }
+  int consumed = 0;
+  sscanf(version, "%d%n.%d%n.%d%n.%d%n", &major, &consumed, &minor, &consumed, &revision, &consumed, &build, &consumed);
+  const char *suffix = version + consumed;
+
+  // "-<count>-g<commit>" that git describe appends after the tag.
+  const char *end      = suffix + strlen(suffix);
+  const char *commitAt = strrchr(suffix, '-');
+  if (commitAt != nullptr && commitAt > suffix && commitAt[1] == 'g') {
+    const char *countAt = commitAt - 1;
+    while (countAt > suffix && isdigit(static_cast<unsigned char>(*countAt))) {
+      countAt--;
+    }
+    if (*countAt == '-' && countAt < commitAt - 1) {
+      commitCount = atoi(countAt + 1);
+      copyPart(commitAt + 2, end - commitAt - 2, commit, sizeof(commit));
+      end = countAt;
+    }
+  }
+  // Anything left is "-<branch>", inserted by git_tag_macro.py off master.
+  if (*suffix == '-' && end > suffix + 1) {
+    copyPart(suffix + 1, end - suffix - 1, branch, sizeof(branch));
+  }
+
+  // version-tag must be >=0, if it is less than zero, then make it zero.
+  if (major < 0) major = 0;
+  if (minor < 0) minor = 0;
+  if (revision < 0) revision = 0;
+  if (build < 0) build = 0;
+  if (commitCount < 0) commitCount = 0;
+}
+
+bool Version::operator>(const Version &other) const {
+  // Start comparing version tag from left most. While the version tags are
+  // equal, move to the next one.
+  if (strcmp(branch, other.branch) != 0) return false;
+
+  if (major != other.major) return major > other.major;
+  if (minor != other.minor) return minor > other.minor;
+  if (revision != other.revision) return revision > other.revision;
+  if (build != other.build) return build > other.build;
+  return commitCount > other.commitCount;
+}
+
+bool Version::operator==(const Version &other) const {
+  return major == other.major && minor == other.minor && revision == other.revision && build == other.build && commitCount == other.commitCount &&
+         strcmp(branch, other.branch) == 0 && strcmp(commit, other.commit) == 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cmath>
+#include "transport/HostSerial.h"
+#include "Constants.h"
+
+// Reply digits per field, least significant first like the bike sends them.
+#define POWER_DIGITS      4
+#define CADENCE_DIGITS    3
+#define RESISTANCE_DIGITS 3
+
+size_t PelotonEmulator::read(uint8_t *buffer, size_t length) {
+  uint32_t now = clock.now();
+  while (!pending.empty() && (int32_t)(now - pending.front().due) >= 0) {
+    outbox.insert(outbox.end(), pending.front().bytes.begin(), pending.front().bytes.end());
+    pending.pop_front();
+  }
+  size_t count = 0;
+  while (count < length && count < chunkSize && !outbox.empty()) {
+    buffer[count++] = outbox.front();
+    outbox.pop_front();
+  }
+  return count;
+}
+
+size_t PelotonEmulator::write(const uint8_t *data, size_t length) {
+  inbox.insert(inbox.end(), data, data + length);
+  while (!inbox.empty()) {
+    if (inbox[0] != PELOTON_REQUEST) {
+      inbox.erase(inbox.begin());
+      continue;
+    }
+    if (inbox.size() < PELOTON_RQ_SIZE) {
+      break;
+    }
+    bool valid = inbox[PELOTON_CHECKSUM_POS] == (uint8_t)(inbox[0] + inbox[PELOTON_REQ_POS]) && inbox[3] == PELOTON_FOOTER;
+    if (!valid) {
+      badRequests++;
+      inbox.erase(inbox.begin());
+      continue;
+    }
+    requests++;
+    if (connected) {
+      answer(inbox[PELOTON_REQ_POS]);
+    }
+    inbox.erase(inbox.begin(), inbox.begin() + PELOTON_RQ_SIZE);
+  }
+  return length;
+}
+
+// Park-Miller, good enough for noise and faults.
+uint32_t PelotonEmulator::random() {
+  seed = (uint32_t)(((uint64_t)seed * 48271) % 2147483647);
+  return seed;
+}
+
+void PelotonEmulator::answer(uint8_t id) {
+  float value;
+  size_t digits;
+  switch (id) {
+    case PELOTON_POW_ID:
+      value  = power * 10;  // tenths of a watt
+      digits = POWER_DIGITS;
+      break;
+    case PELOTON_CAD_ID:
+      value  = cadence;
+      digits = CADENCE_DIGITS;
+      break;
+    case PELOTON_RES_ID:
+      value  = resistance;
+      digits = RESISTANCE_DIGITS;
+      break;
+    default:
+      return;  // the bike doesn't answer fields it doesn't know
+  }
+  if (random() % 100 < (uint32_t)dropPercent) {
+    dropped++;
+    return;
+  }
+  if (noise > 0) {
+    float offset = ((random() % 2001) / 1000.0f - 1) * noise;
+    value += id == PELOTON_POW_ID ? offset * 10 : offset;
+  }
+  uint32_t number = value > 0 ? (uint32_t)lroundf(value) : 0;
+
+  Reply reply;
+  reply.due = clock.now() + latency;
+  reply.bytes.push_back(PELOTON_HEADER);
+  reply.bytes.push_back(id);
+  reply.bytes.push_back(digits);
+  for (size_t i = 0; i < digits; i++) {
+    reply.bytes.push_back('0' + number % 10);
+    number /= 10;
+  }
+  uint8_t sum = 0;
+  for (uint8_t byte : reply.bytes) {
+    sum += byte;
+  }
+  reply.bytes.push_back(sum);
+  reply.bytes.push_back(PELOTON_FOOTER);
+  if (random() % 100 < (uint32_t)corruptPercent) {
+    size_t position = 1 + random() % (reply.bytes.size() - 1);
+    reply.bytes[position] ^= 1 + random() % 255;
+    corrupted++;
+  }
+  pending.push_back(reply);
+  replies++;
+}
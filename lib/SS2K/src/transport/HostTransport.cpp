@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstring>
+#include "transport/HostTransport.h"
+
+void FakePeripheral::record(uint32_t offset, const uint8_t *data, size_t length) {
+  Recorded entry;
+  entry.offset = offset;
+  entry.data.assign(data, data + length);
+  stream.push_back(entry);
+}
+
+void FakePeripheral::start(uint32_t now) {
+  startTime = now;
+  next      = 0;
+}
+
+size_t FakePeripheral::pump(uint32_t now, SensorSink &sink) {
+  size_t delivered = 0;
+  while (!stream.empty()) {
+    if (next >= stream.size()) {
+      if (repeatPeriod == 0) {
+        break;
+      }
+      startTime += repeatPeriod;
+      next = 0;
+    }
+    const Recorded &entry = stream[next];
+    if ((int32_t)(now - (startTime + entry.offset)) < 0) {
+      break;
+    }
+    SensorNotification notification;
+    notification.timestamp   = startTime + entry.offset;
+    notification.address     = address;
+    notification.serviceUUID = serviceUUID;
+    notification.charUUID    = charUUID;
+    notification.length      = entry.data.size() < SENSOR_NOTIFICATION_MAX_LENGTH ? entry.data.size() : SENSOR_NOTIFICATION_MAX_LENGTH;
+    memcpy(notification.data, entry.data.data(), notification.length);
+    sink.onSensorNotification(notification);
+    delivered++;
+    next++;
+  }
+  return delivered;
+}
+
+void FakeCentral::subscribe(const NimBLEUUID &charUUID) {
+  if (!isSubscribed(charUUID)) {
+    subscriptions.push_back(charUUID);
+  }
+}
+
+bool FakeCentral::isSubscribed(const NimBLEUUID &charUUID) const {
+  for (const NimBLEUUID &uuid : subscriptions) {
+    if (uuid == charUUID) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void FakeCentral::notify(const NimBLEUUID &charUUID, const uint8_t *data, size_t length) {
+  if (!isSubscribed(charUUID)) {
+    return;
+  }
+  Received entry;
+  entry.timestamp = clock.now();
+  entry.charUUID  = charUUID;
+  entry.data.assign(data, data + length);
+  log.push_back(entry);
+}
+
+const FakeCentral::Received *FakeCentral::last(const NimBLEUUID &charUUID) const {
+  for (auto it = log.rbegin(); it != log.rend(); ++it) {
+    if (it->charUUID == charUUID) {
+      return &*it;
+    }
+  }
+  return nullptr;
+}
+
+size_t FakeCentral::count(const NimBLEUUID &charUUID) const {
+  size_t n = 0;
+  for (const Received &entry : log) {
+    if (entry.charUUID == charUUID) {
+      n++;
+    }
+  }
+  return n;
+}
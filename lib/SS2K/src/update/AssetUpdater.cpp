@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstdio>
+#include <cstring>
+#include "update/AssetUpdater.h"
+
+void AssetUpdater::begin(const char *path) {
+  snprintf(manifestPath, sizeof(manifestPath), "%s", path);
+  state           = MANIFEST;
+  failedStep      = IDLE;
+  entryIndex      = 0;
+  downloading     = false;
+  attempts        = 0;
+  filesChanged    = 0;
+  filesUpdated    = 0;
+  bytesDownloaded = 0;
+}
+
+bool AssetUpdater::step() {
+  State current = state;
+  switch (state) {
+    case MANIFEST:
+      state = loadManifests() ? FILES : FAILED;
+      break;
+    case FILES:
+      if (downloading) {
+        readChunk();
+      } else if (nextFile()) {
+        startFile();
+      } else {
+        state = installManifest() ? DONE : FAILED;
+      }
+      break;
+    default:
+      break;
+  }
+  if (state == FAILED && current != FAILED) {
+    failedStep = current;
+  }
+  return state == MANIFEST || state == FILES;
+}
+
+bool AssetUpdater::loadManifests() {
+  // Local first, the buffer then holds the remote manifest until it is installed.
+  local.clear();
+  long localLength = store.size(manifestPath);
+  if (localLength > 0 && (size_t)localLength <= sizeof(manifestText)) {
+    int length = store.read(manifestPath, 0, reinterpret_cast<uint8_t *>(manifestText), localLength);
+    if (length > 0) {
+      local.load(manifestText, length);
+    }
+  }
+
+  manifestLength = 0;
+  if (source.open(manifestPath, 0) != 0) {
+    source.close();
+    return false;
+  }
+  for (;;) {
+    int length = source.read(reinterpret_cast<uint8_t *>(&manifestText[manifestLength]), sizeof(manifestText) - manifestLength);
+    if (length < 0) {
+      source.close();
+      return false;
+    }
+    if (length == 0) {
+      break;
+    }
+    manifestLength += length;
+    if (manifestLength == sizeof(manifestText)) {
+      uint8_t extra;
+      if (source.read(&extra, 1) != 0) {  // doesn't fit
+        source.close();
+        return false;
+      }
+      break;
+    }
+  }
+  source.close();
+  return remote.load(manifestText, manifestLength) > 0;
+}
+
+// Move entryIndex to the next file that has to be downloaded, false once there are none left.
+bool AssetUpdater::nextFile() {
+  for (; remote.at(entryIndex, &entry); entryIndex++) {
+    AssetManifest::storedPath(entry, storedPath, sizeof(storedPath));
+
+    // Gzipped assets are listed under both names but stored once.
+    bool duplicate = false;
+    AssetManifest::Entry other;
+    char otherPath[sizeof(storedPath)];
+    for (size_t i = 0; i < entryIndex && !duplicate && remote.at(i, &other); i++) {
+      AssetManifest::storedPath(other, otherPath, sizeof(otherPath));
+      duplicate = strcmp(otherPath, storedPath) == 0;
+    }
+    if (duplicate) {
+      continue;
+    }
+
+    if (store.size(storedPath) == (long)entry.size) {
+      AssetManifest::Entry installed;
+      if (local.find(entry.path, &installed) && strcmp(installed.etag, entry.etag) == 0) {
+        continue;
+      }
+      // Not in the local manifest (e.g. it was removed after an upload), but the content may still match.
+      if (hashFile(storedPath, entry.size) && hashMatches()) {
+        continue;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+void AssetUpdater::startFile() {
+  if (attempts == 0) {
+    filesChanged++;
+  }
+  snprintf(partPath, sizeof(partPath), "%s%s", storedPath, ASSET_UPDATE_PART_SUFFIX);
+
+  // Continue what an earlier attempt or run left behind.
+  long have = store.size(partPath);
+  if (have > 0 && (have > (long)entry.size || !hashFile(partPath, have))) {
+    store.remove(partPath);
+    have = 0;
+  }
+  if (have <= 0) {
+    sha.reset();  // otherwise hashFile() already hashed what we have
+  }
+  received = have > 0 ? have : 0;
+  if (received == entry.size) {
+    finishFile();
+    return;
+  }
+
+  long start = source.open(storedPath, received);
+  if (start != (long)received) {
+    if (start != 0) {
+      source.close();
+      retry();
+      return;
+    }
+    // The server ignored the range, start over.
+    store.remove(partPath);
+    sha.reset();
+    received = 0;
+  }
+  downloading = true;
+}
+
+void AssetUpdater::readChunk() {
+  size_t want = entry.size - received < sizeof(chunk) ? entry.size - received : sizeof(chunk);
+  int length  = source.read(chunk, want);
+  if (length <= 0) {
+    // Connection lost (or the file is shorter than the manifest says). Keep what we have.
+    source.close();
+    downloading = false;
+    retry();
+    return;
+  }
+  if (!store.append(partPath, chunk, length)) {
+    source.close();
+    downloading = false;
+    state       = FAILED;
+    return;
+  }
+  sha.update(chunk, length);
+  received += length;
+  bytesDownloaded += length;
+  if (received == entry.size) {
+    source.close();
+    downloading = false;
+    finishFile();
+  }
+}
+
+void AssetUpdater::finishFile() {
+  if (!hashMatches()) {
+    store.remove(partPath);
+    retry();
+    return;
+  }
+  if (!store.rename(partPath, storedPath)) {
+    state = FAILED;
+    return;
+  }
+  filesUpdated++;
+  entryIndex++;
+  attempts = 0;
+}
+
+void AssetUpdater::retry() {
+  if (++attempts >= ASSET_UPDATE_MAX_ATTEMPTS) {
+    state = FAILED;
+  }
+}
+
+bool AssetUpdater::installManifest() {
+  if (filesChanged == 0 && local.size() == remote.size()) {
+    return true;  // nothing to do
+  }
+  char tmpPath[sizeof(manifestPath) + sizeof(ASSET_UPDATE_PART_SUFFIX)];
+  snprintf(tmpPath, sizeof(tmpPath), "%s%s", manifestPath, ASSET_UPDATE_PART_SUFFIX);
+  store.remove(tmpPath);
+  return store.append(tmpPath, reinterpret_cast<const uint8_t *>(manifestText), manifestLength) && store.rename(tmpPath, manifestPath);
+}
+
+// Hash the first length bytes of a file into sha.
+bool AssetUpdater::hashFile(const char *path, size_t length) {
+  sha.reset();
+  size_t offset = 0;
+  while (offset < length) {
+    size_t want = length - offset < sizeof(chunk) ? length - offset : sizeof(chunk);
+    int read    = store.read(path, offset, chunk, want);
+    if (read <= 0) {
+      return false;
+    }
+    sha.update(chunk, read);
+    offset += read;
+  }
+  return true;
+}
+
+// Does the hash so far match the entry? Finishes sha.
+bool AssetUpdater::hashMatches() {
+  size_t digits = strlen(entry.etag) - 2;  // without the quotes
+  char hex[ASSET_MANIFEST_ETAG_LENGTH];
+  sha.finishHex(hex, digits);
+  return digits > 0 && strncmp(hex, entry.etag + 1, digits) == 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstring>
+#include "update/HostUpdate.h"
+
+long LocalHttpServer::open(const char *path, size_t offset) {
+  requests++;
+  auto file = files.find(path);
+  if (file == files.end() || offset > file->second.size()) {
+    current = nullptr;
+    return -1;
+  }
+  current    = &file->second;
+  position   = rangeSupport ? offset : 0;
+  lastOffset = position;
+  return position;
+}
+
+int LocalHttpServer::read(uint8_t *buffer, size_t length) {
+  if (current == nullptr) {
+    return -1;
+  }
+  size_t available = current->size() - position;
+  length           = length < available ? length : available;
+  if (dropIn > 0) {
+    length = length < dropIn ? length : dropIn;
+  }
+  memcpy(buffer, current->data() + position, length);
+  position += length;
+  bytesServed += length;
+  if (dropIn > 0 && (dropIn -= length) == 0) {
+    current = nullptr;  // the connection drops after these bytes
+  }
+  return length;
+}
+
+long MemoryStore::size(const char *path) {
+  auto file = files.find(path);
+  return file == files.end() ? -1 : (long)file->second.size();
+}
+
+int MemoryStore::read(const char *path, size_t offset, uint8_t *buffer, size_t length) {
+  auto file = files.find(path);
+  if (file == files.end() || offset > file->second.size()) {
+    return -1;
+  }
+  length = length < file->second.size() - offset ? length : file->second.size() - offset;
+  memcpy(buffer, file->second.data() + offset, length);
+  return length;
+}
+
+bool MemoryStore::append(const char *path, const uint8_t *data, size_t length) {
+  files[path].append(reinterpret_cast<const char *>(data), length);
+  return true;
+}
+
+bool MemoryStore::rename(const char *from, const char *to) {
+  auto file = files.find(from);
+  if (file == files.end()) {
+    return false;
+  }
+  files[to] = file->second;
+  files.erase(from);
+  return true;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "update/UpdateCheck.h"
+#include "ConfigRecord.h"
+
+#include <cstring>
+
+// Copies text into out, cutting it to fit. nullptr is copied as "".
+static void copyText(const char *text, char *out, size_t capacity) {
+  if (text == nullptr) {
+    text = "";
+  }
+  strncpy(out, text, capacity - 1);
+  out[capacity - 1] = '\0';
+}
+
+bool UpdateCheck::isDue(uint32_t now, uint32_t interval, const char *url) const {
+  if (lastCheck == 0 || !hasVersion() || now < UPDATE_CHECK_MIN_CLOCK || now < lastCheck) {
+    return true;
+  }
+  return !isFrom(url) || now - lastCheck >= interval;
+}
+
+bool UpdateCheck::isFrom(const char *url) const { return url != nullptr && strncmp(this->url, url, sizeof(this->url) - 1) == 0; }
+
+void UpdateCheck::checked(uint32_t now, const char *url, const char *version, const char *etag, const char *lastModified) {
+  lastCheck = now;
+  copyText(url, this->url, sizeof(this->url));
+  copyText(version, versionText, sizeof(versionText));
+  copyText(etag, this->etag, sizeof(this->etag));
+  copyText(lastModified, this->lastModified, sizeof(this->lastModified));
+  available.parse(versionText);
+}
+
+void UpdateCheck::notModified(uint32_t now) { lastCheck = now; }
+
+void UpdateCheck::clear() {
+  lastCheck       = 0;
+  url[0]          = '\0';
+  versionText[0]  = '\0';
+  etag[0]         = '\0';
+  lastModified[0] = '\0';
+  available.parse("");
+}
+
+size_t UpdateCheck::write(uint8_t *buffer, size_t capacity) const {
+  ConfigRecordWriter record(buffer, capacity, UPDATE_CHECK_RECORD_VERSION);
+  record.putInt(static_cast<int32_t>(lastCheck));
+  record.putString(url);
+  record.putString(versionText);
+  record.putString(etag);
+  record.putString(lastModified);
+  return record.finish();
+}
+
+bool UpdateCheck::read(const uint8_t *data, size_t length) {
+  clear();
+  ConfigRecordReader record;
+  if (!record.open(data, length) || record.version() != UPDATE_CHECK_RECORD_VERSION) {
+    return false;
+  }
+  lastCheck = static_cast<uint32_t>(record.getInt(0));
+  record.getString(url, sizeof(url));
+  record.getString(versionText, sizeof(versionText));
+  record.getString(etag, sizeof(etag));
+  record.getString(lastModified, sizeof(lastModified));
+  available.parse(versionText);
+  return true;
+}
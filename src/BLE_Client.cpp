@@ -15,7 +15,6 @@ appearance: 1156, manufacturer data: 640302018743, serviceUUID:
 #include "BLE_Common.h"
 #include "SS2KLog.h"
 
-#include <ArduinoJson.h>
 #include <Constants.h>
 #include <memory>
 #include <NimBLEDevice.h>
@@ -28,6 +27,8 @@ static MyClientCallback myClientCallback;
 static MyAdvertisedDeviceCallback myAdvertisedDeviceCallbacks;
 
 void SpinBLEClient::start() {
+  this->updateAdvertisementFilter();
+  this->updateRemoteKeyMap();
   // Create the task for the BLE Client loop
   xTaskCreatePinnedToCore(bleClientTask,   /* Task function. */
                           "BLEClientTask", /* name of task. */
@@ -38,23 +39,31 @@ void SpinBLEClient::start() {
                           1);              /* pin task to core */
 }
 
+void SpinBLEClient::updateAdvertisementFilter() {
+  advertisementFilter.configure(userConfig.getPowerMeterSelection(), userConfig.getHeartMonitorSelection(), userConfig.getRemoteSelection());
+}
+
 static void onNotify(BLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length, bool isNotify) {
-  // Parse BLE shifter info.
-  if (pBLERemoteCharacteristic->getRemoteService()->getUUID() == HID_SERVICE_UUID) {
-    Serial.print(pData[0], HEX);
-    if (pData[0] == 0x04) {
-      rtConfig.setShifterPosition(rtConfig.getShifterPosition() + 1);
-    }
-    if (pData[0] == 0x08) {
-      rtConfig.setShifterPosition(rtConfig.getShifterPosition() - 1);
-    }
+  SpinBLEAdvertisedDevice *device = spinBLEClient.myBLEDevices.findByConnHandle(pBLERemoteCharacteristic->getRemoteService()->getClient()->getConnId());
+  if (device == nullptr) {
+    return;
   }
 
   // enqueue sensor data
-  for (size_t i = 0; i < NUM_BLE_DEVICES; i++) {
-    if (pBLERemoteCharacteristic->getUUID() == spinBLEClient.myBLEDevices[i].charUUID) {
-      spinBLEClient.myBLEDevices[i].enqueueData(pData, length);
-    }
+  if (pBLERemoteCharacteristic->getUUID() == device->charUUID) {
+    device->enqueueData(pData, length);
+  }
+}
+
+// Remote input reports are handled right here so shifts don't wait for the communications loop.
+static void onRemoteNotify(BLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length, bool isNotify) {
+  spinBLEClient.handleRemoteReport(pBLERemoteCharacteristic->getHandle(), pData, length);
+}
+
+static void onBatteryNotify(BLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length, bool isNotify) {
+  SpinBLEAdvertisedDevice *device = spinBLEClient.myBLEDevices.findByConnHandle(pBLERemoteCharacteristic->getRemoteService()->getClient()->getConnId());
+  if (device != nullptr && length > 0) {
+    device->setBatteryLevel(pData[0]);
   }
 }
 
@@ -63,6 +72,8 @@ void bleClientTask(void *pvParameters) {
   for (;;) {
     vTaskDelay(BLE_CLIENT_DELAY / portTICK_PERIOD_MS);  // Delay a second between loops.
     spinBLEClient.checkBLEReconnect();
+    spinBLEClient.updateBatteries();
+    spinBLEClient.pollRemote();
     // if (spinBLEClient.doScan && (spinBLEClient.scanRetries > 0) && !NimBLEDevice::getScan()->isScanning()) {
     //   spinBLEClient.scanRetries--;
     //   SS2K_LOG(BLE_CLIENT_LOG_TAG, "Initiating Scan from Client Task:");
@@ -71,7 +82,7 @@ void bleClientTask(void *pvParameters) {
 #ifdef DEBUG_STACK
     Serial.printf("BLEClient: %d \n", uxTaskGetStackHighWaterMark(BLEClientTask));
 #endif  // DEBUG_STACK
-    for (int x = 0; x < NUM_BLE_DEVICES; x++) {
+    for (size_t x = 0; x < spinBLEClient.myBLEDevices.size(); x++) {
       if (spinBLEClient.myBLEDevices[x].doConnect == true) {
         if (spinBLEClient.connectToServer()) {
           SS2K_LOG(BLE_CLIENT_LOG_TAG, "We are now connected to the BLE Server.");
@@ -88,32 +99,34 @@ bool SpinBLEClient::connectToServer() {
   NimBLEUUID serviceUUID;
   NimBLEUUID charUUID;
 
-  int successful                = 0;
-  BLEAdvertisedDevice *myDevice = nullptr;
-  int device_number             = -1;
-
-  for (int i = 0; i < NUM_BLE_DEVICES; i++) {
-    if (spinBLEClient.myBLEDevices[i].doConnect == true) {   // Client wants to be connected
-      if (spinBLEClient.myBLEDevices[i].advertisedDevice) {  // Client is assigned
-        if (spinBLEClient.myBLEDevices[i].advertisedDevice->isAdvertisingService(HEARTSERVICE_UUID) &&
-            (!spinBLEClient.myBLEDevices[i].advertisedDevice->isAdvertisingService(FITNESSMACHINESERVICE_UUID)) && (!connectedPM) &&
-            (spinBLEClient.myBLEDevices[i + 1].doConnect == true)) {  // Connect HRM last because it causes problems when connecting PM if it connects first.
-          myDevice      = spinBLEClient.myBLEDevices[i + 1].advertisedDevice;
-          device_number = i + 1;
-          SS2K_LOG(BLE_CLIENT_LOG_TAG, "Connecting HRM last.");
-        } else {
-          myDevice      = spinBLEClient.myBLEDevices[i].advertisedDevice;
-          device_number = i;
+  SpinBLEAdvertisedDevice *device = nullptr;
+  bool deferredHRM                = false;
+
+  for (size_t i = 0; i < myBLEDevices.size(); i++) {
+    SpinBLEAdvertisedDevice &candidate = myBLEDevices[i];
+    if (candidate.doConnect == true) {  // Client wants to be connected
+      if (candidate.advertisedDevice) {  // Client is assigned
+        // Connect HRM last because it causes problems when connecting PM if it connects first.
+        bool isHRM = candidate.advertisedDevice->isAdvertisingService(HEARTSERVICE_UUID) && !candidate.advertisedDevice->isAdvertisingService(FITNESSMACHINESERVICE_UUID) &&
+                     !connectedPM;
+        if (device == nullptr || (deferredHRM && !isHRM)) {
+          device      = &candidate;
+          deferredHRM = isHRM;
+        }
+        if (!deferredHRM) {
+          break;
         }
-        break;
       } else {
         SS2K_LOG(BLE_CLIENT_LOG_TAG, "doConnect and client out of alignment. Resetting device slot");
-        spinBLEClient.myBLEDevices[i].reset();
-        // spinBLEClient.serverScan(true);
+        candidate.reset();
         return false;
       }
     }
   }
+  if (deferredHRM) {
+    SS2K_LOG(BLE_CLIENT_LOG_TAG, "Connecting HRM last.");
+  }
+  BLEAdvertisedDevice *myDevice = device ? device->advertisedDevice : nullptr;
   if (myDevice == nullptr) {
     SS2K_LOG(BLE_CLIENT_LOG_TAG, "No Device Found to Connect");
     return false;
@@ -146,12 +159,12 @@ bool SpinBLEClient::connectToServer() {
       SS2K_LOG(BLE_CLIENT_LOG_TAG, "Trying to connect to BLE HID remote");
     } else {
       SS2K_LOG(BLE_CLIENT_LOG_TAG, "No advertised UUID found");
-      spinBLEClient.myBLEDevices[device_number].reset();
+      device->reset();
       return false;
     }
   } else {
     SS2K_LOG(BLE_CLIENT_LOG_TAG, "Device has no Service UUID");
-    spinBLEClient.myBLEDevices[device_number].reset();
+    device->reset();
     // spinBLEClient.serverScan(true);
     return false;
   }
@@ -178,7 +191,7 @@ bool SpinBLEClient::connectToServer() {
         this->reconnectTries--;
         SS2K_LOG(BLE_CLIENT_LOG_TAG, "%d left.", reconnectTries);
         if (reconnectTries < 1) {
-          spinBLEClient.myBLEDevices[device_number].reset();
+          device->reset();
           spinBLEClient.resetDevices(pClient);
           pClient->deleteServices();
           pClient->disconnect();
@@ -221,7 +234,7 @@ bool SpinBLEClient::connectToServer() {
     if (!pClient->connect(myDevice->getAddress())) {
       SS2K_LOG(BLE_CLIENT_LOG_TAG, " - Failed to connect client");
       /** Created a client but failed to connect, don't need to keep it as it has no data */
-      spinBLEClient.myBLEDevices[device_number].reset();
+      device->reset();
       pClient->deleteServices();
       pClient->disconnect();
       NimBLEDevice::getScan()->erase(pClient->getPeerAddress());
@@ -240,12 +253,13 @@ bool SpinBLEClient::connectToServer() {
   SS2K_LOG(BLE_CLIENT_LOG_TAG, "Connected to: %s RSSI %d", pClient->getPeerAddress().toString().c_str(), pClient->getRssi());
 
   if (serviceUUID == HID_SERVICE_UUID) {
+    // Register the connection handle first so the first reports aren't dropped.
+    device->set(myDevice, pClient->getConnId(), serviceUUID, charUUID);
     connectBLE_HID(pClient);
-    this->reconnectTries = MAX_RECONNECT_TRIES;
     SS2K_LOG(BLE_CLIENT_LOG_TAG, "Successful remote subscription.");
-    spinBLEClient.myBLEDevices[device_number].doConnect = false;
-    this->reconnectTries                                = MAX_RECONNECT_TRIES;
-    spinBLEClient.myBLEDevices[device_number].set(myDevice, pClient->getConnId(), serviceUUID, charUUID);
+    device->pClient      = pClient;
+    device->doConnect    = false;
+    this->reconnectTries = MAX_RECONNECT_TRIES;
     removeDuplicates(pClient);
     return true;
   }
@@ -265,11 +279,13 @@ bool SpinBLEClient::connectToServer() {
         SS2K_LOG(BLE_CLIENT_LOG_TAG, "The characteristic value was: %s", value.c_str());
       }
 
+      // Register the connection handle first so the first notifications aren't dropped.
+      device->set(myDevice, pClient->getConnId(), serviceUUID, charUUID);
       if (pChr->canNotify()) {
         // if(!pChr->registerForNotify(notifyCB)) {
         if (!pChr->subscribe(true, onNotify)) {
           /** Disconnect if subscribe failed */
-          spinBLEClient.myBLEDevices[device_number].reset();
+          device->reset();
           pClient->deleteServices();
           pClient->disconnect();
           NimBLEDevice::getScan()->erase(pClient->getPeerAddress());
@@ -281,7 +297,7 @@ bool SpinBLEClient::connectToServer() {
         // if(!pChr->registerForNotify(notifyCB, false)) {
         if (!pChr->subscribe(false, onNotify)) {
           /** Disconnect if subscribe failed */
-          spinBLEClient.myBLEDevices[device_number].reset();
+          device->reset();
           pClient->deleteServices();
           pClient->disconnect();
           NimBLEDevice::getScan()->erase(pClient->getPeerAddress());
@@ -289,11 +305,12 @@ bool SpinBLEClient::connectToServer() {
           return false;
         }
       }
-      this->reconnectTries = MAX_RECONNECT_TRIES;
       SS2K_LOG(BLE_CLIENT_LOG_TAG, "Successful %s subscription.", pChr->getUUID().toString().c_str());
-      spinBLEClient.myBLEDevices[device_number].doConnect = false;
-      this->reconnectTries                                = MAX_RECONNECT_TRIES;
-      spinBLEClient.myBLEDevices[device_number].set(myDevice, pClient->getConnId(), serviceUUID, charUUID);
+      device->pClient               = pClient;
+      device->pRemoteCharacteristic = pChr;
+      device->doConnect             = false;
+      this->reconnectTries          = MAX_RECONNECT_TRIES;
+      setupBattery(pClient, device);
 
       removeDuplicates(pClient);
     }
@@ -310,8 +327,7 @@ bool SpinBLEClient::connectToServer() {
  **                       Remove as you see fit for your needs                        */
 
 void MyClientCallback::onConnect(NimBLEClient *pClient) {
-  // additional characteristic subscriptions.
-  spinBLEClient.handleBattInfo(pClient, true);
+  // Services aren't discovered yet. Additional subscriptions happen in connectToServer().
 }
 
 void MyClientCallback::onDisconnect(NimBLEClient *pClient) {
@@ -328,30 +344,23 @@ void MyClientCallback::onDisconnect(NimBLEClient *pClient) {
     NimBLEAddress addr = pClient->getPeerAddress();
     // auto addr = BLEDevice::getDisconnectedClient()->getPeerAddress();
     SS2K_LOG(BLE_CLIENT_LOG_TAG, "This disconnected client Address %s", addr.toString().c_str());
-    for (size_t i = 0; i < NUM_BLE_DEVICES; i++) {
-      if (addr == spinBLEClient.myBLEDevices[i].peerAddress) {
-        // spinBLEClient.myBLEDevices[i].connectedClientID = BLE_HS_CONN_HANDLE_NONE;
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Detected %s Disconnect", spinBLEClient.myBLEDevices[i].serviceUUID.toString().c_str());
-        spinBLEClient.myBLEDevices[i].doConnect = true;
-        if ((spinBLEClient.myBLEDevices[i].charUUID == CYCLINGPOWERMEASUREMENT_UUID) || (spinBLEClient.myBLEDevices[i].charUUID == FITNESSMACHINEINDOORBIKEDATA_UUID) ||
-            (spinBLEClient.myBLEDevices[i].charUUID == FLYWHEEL_UART_RX_UUID) || (spinBLEClient.myBLEDevices[i].charUUID == ECHELON_SERVICE_UUID) ||
-            (spinBLEClient.myBLEDevices[i].charUUID == CYCLINGPOWERSERVICE_UUID)) {
-          SS2K_LOG(BLE_CLIENT_LOG_TAG, "Deregistered PM on Disconnect");
-          rtConfig.pm_batt.setValue(0);
-          spinBLEClient.connectedPM = false;
-          break;
-        }
-        if ((spinBLEClient.myBLEDevices[i].charUUID == HEARTCHARACTERISTIC_UUID)) {
-          SS2K_LOG(BLE_CLIENT_LOG_TAG, "Deregistered HR on Disconnect");
-          rtConfig.hr_batt.setValue(0);
-          spinBLEClient.connectedHRM = false;
-          break;
-        }
-        if ((spinBLEClient.myBLEDevices[i].charUUID == HID_REPORT_DATA_UUID)) {
-          SS2K_LOG(BLE_CLIENT_LOG_TAG, "Deregistered Remote on Disconnect");
-          spinBLEClient.connectedRemote = false;
-          break;
-        }
+    SpinBLEAdvertisedDevice *device = spinBLEClient.myBLEDevices.findByAddress(addr);
+    if (device != nullptr) {
+      SS2K_LOG(BLE_CLIENT_LOG_TAG, "Detected %s Disconnect", device->serviceUUID.toString().c_str());
+      device->doConnect             = true;
+      device->connectedClientID     = BLE_HS_CONN_HANDLE_NONE;
+      device->pClient               = nullptr;
+      device->pRemoteCharacteristic = nullptr;
+      device->battCharacteristic    = nullptr;
+      spinBLEClient.connectionsChanged();
+      if (device->isPM) {
+        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Deregistered PM on Disconnect");
+        rtConfig.pm_batt.setValue(0);
+      } else if (device->isHRM) {
+        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Deregistered HR on Disconnect");
+        rtConfig.hr_batt.setValue(0);
+      } else if (device->isRemote) {
+        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Deregistered Remote on Disconnect");
       }
     }
     return;
@@ -377,111 +386,77 @@ void MyClientCallback::onAuthenticationComplete(ble_gap_conn_desc desc) { SS2K_L
  */
 
 void MyAdvertisedDeviceCallback::onResult(BLEAdvertisedDevice *advertisedDevice) {
-  auto advertisedDeviceInfo = advertisedDevice->toString();
-  ss2k_remove_newlines(&advertisedDeviceInfo);
-  String aDevName;
-  if (advertisedDevice->haveName()) {
-    aDevName = String(advertisedDevice->getName().c_str());
-  } else {
-    aDevName = "";
-  }
-  if ((advertisedDevice->haveServiceUUID()) &&
-      (advertisedDevice->isAdvertisingService(CYCLINGPOWERSERVICE_UUID) || (advertisedDevice->isAdvertisingService(FLYWHEEL_UART_SERVICE_UUID) && aDevName == FLYWHEEL_BLE_NAME) ||
-       advertisedDevice->isAdvertisingService(FITNESSMACHINESERVICE_UUID) || advertisedDevice->isAdvertisingService(HEARTSERVICE_UUID) ||
-       advertisedDevice->isAdvertisingService(ECHELON_DEVICE_UUID) || advertisedDevice->isAdvertisingService(HID_SERVICE_UUID))) {
-    SS2K_LOG(BLE_CLIENT_LOG_TAG, "Matching Device Name: %s", aDevName.c_str());
-    if (advertisedDevice->getServiceUUID() == HID_SERVICE_UUID) {
-      if (String(userConfig.getConnectedRemote()) == "any") {
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Remote String Matched Any");
-        // continue
-      } else if (aDevName != String(userConfig.getConnectedRemote()) || (String(userConfig.getConnectedRemote()) == "none")) {
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Skipping non-selected Remote |%s|%s", aDevName.c_str(), userConfig.getConnectedRemote());
-        return;
-      } else if (aDevName == String(userConfig.getConnectedRemote())) {
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Remote String Matched %s", aDevName.c_str());
-      }
-    } else if (advertisedDevice->getServiceUUID() == HEARTSERVICE_UUID) {
-      if (String(userConfig.getConnectedHeartMonitor()) == "any") {
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "HR String Matched Any");
-        // continue
-      } else if (aDevName != String(userConfig.getConnectedHeartMonitor()) || (String(userConfig.getConnectedHeartMonitor()) == "none")) {
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Skipping non-selected HRM |%s|%s", aDevName.c_str(), userConfig.getConnectedHeartMonitor());
-        return;
-      } else if (aDevName == String(userConfig.getConnectedHeartMonitor())) {
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "HR String Matched %s", aDevName.c_str());
-      }
-    } else {
-      if (String(userConfig.getConnectedPowerMeter()) == "any") {
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "PM String Matched Any");
-        // continue
-      } else if (aDevName != String(userConfig.getConnectedPowerMeter()) || (String(userConfig.getConnectedPowerMeter()) == "none")) {
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Skipping non-selected PM |%s|%s", aDevName.c_str(), userConfig.getConnectedPowerMeter());
-        return;
-      } else if (aDevName == String(userConfig.getConnectedPowerMeter())) {
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "PM String Matched %s", aDevName.c_str());
-      }
-    }
-    for (size_t i = 0; i < NUM_BLE_DEVICES; i++) {
-      if ((spinBLEClient.myBLEDevices[i].advertisedDevice == nullptr) ||
-          (advertisedDevice->getAddress() == spinBLEClient.myBLEDevices[i].peerAddress)) {  // found empty device slot
-        spinBLEClient.myBLEDevices[i].set(advertisedDevice);
-        spinBLEClient.myBLEDevices[i].doConnect = true;
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "doConnect set on device: %d", i);
-
-        return;
-      }
-      SS2K_LOG(BLE_CLIENT_LOG_TAG, "Checking Slot %d", i);
-    }
+  // Runs for every advertisement report, so reject early and don't allocate.
+  uint64_t address                   = (uint64_t)advertisedDevice->getAddress();
+  AdvertisementFilter::Result result = spinBLEClient.advertisementFilter.evaluate(advertisedDevice->getPayload(), advertisedDevice->getPayloadLength(), address);
+  if (result.category == AdvertisementFilter::NONE) {
+    return;
+  }
+  spinBLEClient.scanResults.update(address, advertisedDevice->getAddress().getType(), result, advertisedDevice->getRSSI(), millis());
+  if (!result.selected) {
+    SS2K_LOGD(BLE_CLIENT_LOG_TAG, "Skipping non-selected device |%.*s|", result.nameLength, result.name ? result.name : "");
+    return;
+  }
+  SS2K_LOG(BLE_CLIENT_LOG_TAG, "Matching Device Name: %.*s", result.nameLength, result.name ? result.name : "");
+  SpinBLEAdvertisedDevice *device = spinBLEClient.myBLEDevices.acquire(advertisedDevice->getAddress());
+  if (device == nullptr) {
+    SS2K_LOG(BLE_CLIENT_LOG_TAG, "No free device slot");
     return;
-    //}
+  }
+  if (device->connectedClientID != BLE_HS_CONN_HANDLE_NONE) {
+    return;  // already connected
+  }
+  device->set(advertisedDevice);
+  device->doConnect = true;
+  SS2K_LOG(BLE_CLIENT_LOG_TAG, "doConnect set on device: %d", spinBLEClient.myBLEDevices.indexOf(device));
+}
+
+static void scanCompleteCB(NimBLEScanResults results) {
+  spinBLEClient.dontBlockScan = false;
+  if (spinBLEClient.lastScanDuration > BLE_RECONNECT_SCAN_DURATION) {
+    String output = spinBLEClient.getFoundDevicesJSON();
+    SS2K_LOG(BLE_CLIENT_LOG_TAG, "Bluetooth Client Found Devices: %s", output.c_str());
+#ifdef USE_TELEGRAM
+    SEND_TO_TELEGRAM("Bluetooth Client Found Devices: " + output);
+#endif
   }
 }
+
 void SpinBLEClient::scanProcess(int duration) {
   this->doScan = false;  // Confirming we did the scan
   SS2K_LOGW(BLE_CLIENT_LOG_TAG, "Scanning for BLE servers and putting them into a list...");
 
   BLEScan *pBLEScan = BLEDevice::getScan();
+  if (pBLEScan->isScanning()) {
+    pBLEScan->stop();  // restart with the requested duration
+  }
   pBLEScan->setAdvertisedDeviceCallbacks(&myAdvertisedDeviceCallbacks);
   pBLEScan->setInterval(49);  // 97
   pBLEScan->setWindow(33);    // 67
   pBLEScan->setDuplicateFilter(true);
   pBLEScan->setActiveScan(true);
-  BLEScanResults foundDevices = pBLEScan->start(duration, true);
-  this->dontBlockScan         = false;
-  // Load the scan into a Json String
-  int count = foundDevices.getCount();
-
-  StaticJsonDocument<1000> devices;
-
-  String device = "";
-
-  for (int i = 0; i < count; i++) {
-    BLEAdvertisedDevice d = foundDevices.getDevice(i);
-    if (d.isAdvertisingService(CYCLINGPOWERSERVICE_UUID) || d.isAdvertisingService(HEARTSERVICE_UUID) || d.isAdvertisingService(FLYWHEEL_UART_SERVICE_UUID) ||
-        d.isAdvertisingService(FITNESSMACHINESERVICE_UUID) || d.isAdvertisingService(ECHELON_DEVICE_UUID) || d.isAdvertisingService(HID_SERVICE_UUID)) {
-      device                     = "device " + String(i);
-      devices[device]["address"] = d.getAddress().toString();
-
-      if (d.haveName()) {
-        devices[device]["name"] = d.getName();
-      }
-
-      if (d.haveServiceUUID()) {
-        devices[device]["UUID"] = d.getServiceUUID().toString();
-      }
-    }
+  this->lastScanDuration = duration;
+  if (duration > BLE_RECONNECT_SCAN_DURATION) {
+    this->dontBlockScan = true;
   }
+  // Don't block: results are added to scanResults as they arrive.
+  if (!pBLEScan->start(duration, scanCompleteCB, false)) {
+    SS2K_LOG(BLE_CLIENT_LOG_TAG, "Failed to start scan");
+    this->dontBlockScan = false;
+  }
+}
 
-  String output;
-  serializeJson(devices, output);
-  if (duration > BLE_RECONNECT_SCAN_DURATION) {
-    SS2K_LOG(BLE_CLIENT_LOG_TAG, "Bluetooth Client Found Devices: %s", output.c_str());
+String SpinBLEClient::getFoundDevicesJSON() {
+  uint32_t now    = millis();
+  size_t capacity = scanResults.toJSON(nullptr, 0, now, BLE_SCAN_RESULT_MAX_AGE_MILLIS) + 1;
+  for (;;) {
+    std::unique_ptr<char[]> buffer(new char[capacity]);
+    size_t length = scanResults.toJSON(buffer.get(), capacity, now, BLE_SCAN_RESULT_MAX_AGE_MILLIS);
+    if (length < capacity) {
+      return String(buffer.get());
+    }
+    capacity = length + 1;  // a device was added in between, try again
   }
-#ifdef USE_TELEGRAM
-  SEND_TO_TELEGRAM("Bluetooth Client Found Devices: " + output);
-#endif
-  userConfig.setFoundDevices(output);
-  pBLEScan = nullptr;  // free up memory
 }
 
 /*// This is the main server scan request process to use.
@@ -495,28 +470,22 @@ void SpinBLEClient::serverScan(bool connectRequest) {
 
 // remove the last connected BLE Power Meter
 void SpinBLEClient::removeDuplicates(NimBLEClient *pClient) {
-  // BLEAddress thisAddress = pClient->getPeerAddress();
-  SpinBLEAdvertisedDevice tBLEd;
-  SpinBLEAdvertisedDevice oldBLEd;
-  for (size_t i = 0; i < NUM_BLE_DEVICES; i++) {  // Disconnect oldest PM to avoid two connected.
-    tBLEd = this->myBLEDevices[i];
-    if (tBLEd.peerAddress == pClient->getPeerAddress()) {
-      break;
-    }
+  SpinBLEAdvertisedDevice *tBLEd = myBLEDevices.findByAddress(pClient->getPeerAddress());
+  if (tBLEd == nullptr) {
+    return;
   }
 
-  for (size_t i = 0; i < NUM_BLE_DEVICES; i++) {  // Disconnect oldest PM to avoid two connected.
-    oldBLEd = this->myBLEDevices[i];
+  for (size_t i = 0; i < myBLEDevices.size(); i++) {  // Disconnect oldest PM to avoid two connected.
+    SpinBLEAdvertisedDevice &oldBLEd = myBLEDevices[i];
     if (oldBLEd.advertisedDevice) {
-      if ((tBLEd.serviceUUID == oldBLEd.serviceUUID) && (tBLEd.peerAddress != oldBLEd.peerAddress)) {
-        if (BLEDevice::getClientByPeerAddress(oldBLEd.peerAddress)) {
-          if (BLEDevice::getClientByPeerAddress(oldBLEd.peerAddress)->isConnected()) {
-            SS2K_LOG(BLE_CLIENT_LOG_TAG, "%s Matched another service.  Disconnecting: %s", tBLEd.peerAddress.toString().c_str(), oldBLEd.peerAddress.toString().c_str());
-            BLEDevice::getClientByPeerAddress(oldBLEd.peerAddress)->disconnect();
-            oldBLEd.reset();
-            spinBLEClient.intentionalDisconnect = true;
-            return;
-          }
+      if ((tBLEd->serviceUUID == oldBLEd.serviceUUID) && (tBLEd->peerAddress != oldBLEd.peerAddress)) {
+        NimBLEClient *oldClient = BLEDevice::getClientByPeerAddress(oldBLEd.peerAddress);
+        if (oldClient && oldClient->isConnected()) {
+          SS2K_LOG(BLE_CLIENT_LOG_TAG, "%s Matched another service.  Disconnecting: %s", tBLEd->peerAddress.toString().c_str(), oldBLEd.peerAddress.toString().c_str());
+          spinBLEClient.intentionalDisconnect = true;
+          oldClient->disconnect();
+          oldBLEd.reset();
+          return;
         }
       }
     }
@@ -524,7 +493,7 @@ void SpinBLEClient::removeDuplicates(NimBLEClient *pClient) {
 }
 
 void SpinBLEClient::resetDevices(NimBLEClient *pClient) {
-  for (size_t i = 0; i < NUM_BLE_DEVICES; i++) {
+  for (size_t i = 0; i < myBLEDevices.size(); i++) {
     if (pClient->getPeerAddress() == myBLEDevices[i].peerAddress) {
       SS2K_LOGW(BLE_CLIENT_LOG_TAG, "Reset Client Slot: %d", i);
       myBLEDevices[i].reset();
@@ -534,7 +503,7 @@ void SpinBLEClient::resetDevices(NimBLEClient *pClient) {
 
 void SpinBLEClient::FTMSControlPointWrite(const uint8_t *pData, int length) {
   NimBLEClient *pClient = nullptr;
-  for (int i = 0; i < NUM_BLE_DEVICES; i++) {
+  for (size_t i = 0; i < myBLEDevices.size(); i++) {
     if (myBLEDevices[i].postConnected && (myBLEDevices[i].serviceUUID == FITNESSMACHINESERVICE_UUID)) {
       if (NimBLEDevice::getClientByPeerAddress(myBLEDevices[i].peerAddress)->getService(FITNESSMACHINESERVICE_UUID)) {
         pClient = NimBLEDevice::getClientByPeerAddress(myBLEDevices[i].peerAddress);
@@ -552,8 +521,8 @@ void SpinBLEClient::FTMSControlPointWrite(const uint8_t *pData, int length) {
 }
 
 void SpinBLEClient::postConnect() {
-  for (int i = 0; i < NUM_BLE_DEVICES; i++) {
-    if (!myBLEDevices[i].postConnected) {
+  for (size_t i = 0; i < myBLEDevices.size(); i++) {
+    if (!myBLEDevices[i].postConnected && (myBLEDevices[i].connectedClientID != BLE_HS_CONN_HANDLE_NONE)) {
       if (NimBLEDevice::getClientByPeerAddress(myBLEDevices[i].peerAddress)) {
         myBLEDevices[i].postConnected = true;
         NimBLEClient *pClient         = NimBLEDevice::getClientByPeerAddress(myBLEDevices[i].peerAddress);
@@ -650,29 +619,23 @@ void SpinBLEClient::connectBLE_HID(NimBLEClient *pClient) {
   NimBLERemoteService *pSvc        = nullptr;
   NimBLERemoteCharacteristic *pChr = nullptr;
   pSvc                             = pClient->getService(HID_SERVICE_UUID);
+  remoteReportCount                = 0;
+  remoteReportMap.clear();
   if (pSvc) { /** make sure it's not null */
-    // This returns the HID report descriptor like this
-    // HID_REPORT_MAP 0x2a4b Value: 5,1,9,2,A1,1,9,1,A1,0,5,9,19,1,29,5,15,0,25,1,75,1,
-    // Copy and paste the value digits to http://eleccelerator.com/usbdescreqparser/
-    // to see the decoded report descriptor.
-    /*pChr = pSvc->getCharacteristic(HID_REPORT_MAP_UUID);
-    if (pChr) { /** make sure it's not null */
-    /*  Serial.print("HID_REPORT_MAP ");
-      if (pChr->canRead()) {
-        std::string value = pChr->readValue();
-        Serial.print(pChr->getUUID().toString().c_str());
-        Serial.print(" Value: ");
-        uint8_t *p = (uint8_t *)value.data();
-        for (size_t i = 0; i < value.length(); i++) {
-          Serial.print(p[i], HEX);
-          Serial.print(',');
-        }
-        Serial.println();
+    // The report map (HID report descriptor) tells us where the keys are in each report.
+    // Copy a logged map to http://eleccelerator.com/usbdescreqparser/ to decode it by hand.
+    pChr = pSvc->getCharacteristic(HID_REPORT_MAP_UUID);
+    if (pChr && pChr->canRead()) {
+      std::string value = pChr->readValue();
+      if (remoteReportMap.parse((const uint8_t *)value.data(), value.length())) {
+        SS2K_LOG(BLE_CLIENT_LOG_TAG, "HID report map: %d input fields", remoteReportMap.fieldCount());
+      } else {
+        SS2K_LOG(BLE_CLIENT_LOG_TAG, "HID report map has no keys, using raw reports");
       }
     } else {
-      Serial.println("HID REPORT MAP char not found.");
+      SS2K_LOG(BLE_CLIENT_LOG_TAG, "HID report map not found, using raw reports");
     }
-*/
+
     // Subscribe to characteristics HID_REPORT_DATA.
     // One real device reports 2 with the same UUID but
     // different handles. Using getCharacteristic() results
@@ -680,55 +643,161 @@ void SpinBLEClient::connectBLE_HID(NimBLEClient *pClient) {
     std::vector<NimBLERemoteCharacteristic *> *charVector;
     charVector = pSvc->getCharacteristics(true);
     for (auto &it : *charVector) {
-      if (it->getUUID() == NimBLEUUID(HID_REPORT_DATA_UUID)) {
-        Serial.println(it->toString().c_str());
-        if (it->canNotify()) {
-          if (!it->subscribe(true, onNotify)) {
-            /** Disconnect if subscribe failed */
-            Serial.println("subscribe notification failed");
-            pClient->disconnect();
-            return;  // false;
-          } else {
-            Serial.println("subscribed");
+      if (it->getUUID() == HID_REPORT_DATA_UUID && it->canNotify()) {
+        // Report Reference: report ID, report type (1 = input)
+        uint8_t reportId                   = 0;
+        NimBLERemoteDescriptor *pReportRef = it->getDescriptor(HID_REPORT_REFERENCE_UUID);
+        if (pReportRef) {
+          std::string ref = pReportRef->readValue();
+          if (ref.length() >= 2) {
+            if (ref[1] != 1) {
+              continue;
+            }
+            reportId = ref[0];
           }
         }
+        if (!it->subscribe(true, onRemoteNotify)) {
+          /** Disconnect if subscribe failed */
+          SS2K_LOG(BLE_CLIENT_LOG_TAG, "HID report subscription failed");
+          pClient->disconnect();
+          return;
+        }
+        if (remoteReportCount < HID_REPORT_MAP_MAX_REPORTS) {
+          remoteReportHandles[remoteReportCount] = it->getHandle();
+          remoteReportIds[remoteReportCount]     = reportId;
+          remoteReportCount++;
+        }
+        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Subscribed to HID report %d (handle %d)", reportId, it->getHandle());
       }
     }
   }
-  Serial.println("Done with this device!");
-  return;  // true;
+  return;
 }
 
+// Only sets connection parameters, so it's cheap enough for the client task.
 void SpinBLEClient::keepAliveBLE_HID(NimBLEClient *pClient) {
-  static int intervalTimer = millis();
+  static unsigned long intervalTimer = millis();
   if ((millis() - intervalTimer) < 6000) {
     return;
   }
-  NimBLERemoteService *pSvc        = nullptr;
-  NimBLERemoteCharacteristic *pChr = nullptr;
-  pSvc                             = pClient->getService(HID_SERVICE_UUID);
-  if (pSvc) { /** make sure it's not null */
-    pChr = pSvc->getCharacteristic(HID_REPORT_MAP_UUID);
-    if (pChr) {
-      SS2K_LOG(BLE_CLIENT_LOG_TAG, "BLE HID Keep Alive");
-      pClient->setConnectionParams(12, 12, 0, 3200);
-      intervalTimer = millis();
-    } else {
-      SS2K_LOG(BLE_CLIENT_LOG_TAG, "Keep Alive failed");
+  SS2K_LOGD(BLE_CLIENT_LOG_TAG, "BLE HID Keep Alive");
+  pClient->setConnectionParams(12, 12, 0, 3200);
+  intervalTimer = millis();
+}
+
+void SpinBLEClient::updateRemoteKeyMap() {
+  if (!remoteKeys.configure(userConfig.getRemoteKeyMap())) {
+    SS2K_LOGW(BLE_CLIENT_LOG_TAG, "Ignored invalid entries in remote key map: %s", userConfig.getRemoteKeyMap());
+  }
+}
+
+void SpinBLEClient::handleRemoteReport(uint16_t handle, const uint8_t *pData, size_t length) {
+  uint8_t reportId = 0;
+  for (size_t i = 0; i < remoteReportCount; i++) {
+    if (remoteReportHandles[i] == handle) {
+      reportId = remoteReportIds[i];
+      break;
     }
   }
+  uint16_t key = remoteReportMap.decode(reportId, pData, length);
+  SS2K_LOGD(BLE_CLIENT_LOG_TAG, "Remote report %d key %04x", reportId, key);
+  // A key can also resolve the press that was waiting before it.
+  for (HIDKeyMapper::Action action = remoteKeys.update(key, millis()); action != HIDKeyMapper::NO_ACTION; action = remoteKeys.poll(millis())) {
+    handleRemoteAction(action);
+  }
+}
+
+void SpinBLEClient::handleRemoteAction(HIDKeyMapper::Action action) {
+  switch (action) {
+    case HIDKeyMapper::SHIFT_UP:
+      rtConfig.setShifterPosition(rtConfig.getShifterPosition() + 1);
+      break;
+    case HIDKeyMapper::SHIFT_DOWN:
+      rtConfig.setShifterPosition(rtConfig.getShifterPosition() - 1);
+      break;
+    case HIDKeyMapper::ERG_UP:
+    case HIDKeyMapper::ERG_DOWN: {
+      if (rtConfig.getFTMSMode() != FitnessMachineControlPointProcedure::SetTargetPower) {
+        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Remote ERG change ignored, not in ERG mode");
+        return;
+      }
+      int target = rtConfig.watts.getTarget() + (action == HIDKeyMapper::ERG_UP ? ERG_PER_SHIFT : -ERG_PER_SHIFT);
+      target     = constrain(target, userConfig.getMinWatts(), userConfig.getMaxWatts());
+      rtConfig.watts.setTarget(target);
+      SS2K_LOG(BLE_CLIENT_LOG_TAG, "Remote ERG target %dw", target);
+      break;
+    }
+    case HIDKeyMapper::TOGGLE_MODE:
+      if (rtConfig.getFTMSMode() == FitnessMachineControlPointProcedure::SetTargetPower) {
+        rtConfig.setFTMSMode(FitnessMachineControlPointProcedure::SetIndoorBikeSimulationParameters);
+        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Remote switched to SIM mode");
+      } else {
+        // Start ERG at what the rider is doing now rather than a stale target.
+        int target = rtConfig.watts.getValue() > 0 ? rtConfig.watts.getValue() : rtConfig.watts.getTarget();
+        rtConfig.watts.setTarget(constrain(target, userConfig.getMinWatts(), userConfig.getMaxWatts()));
+        rtConfig.setFTMSMode(FitnessMachineControlPointProcedure::SetTargetPower);
+        SS2K_LOG(BLE_CLIENT_LOG_TAG, "Remote switched to ERG mode at %dw", rtConfig.watts.getTarget());
+      }
+      break;
+    default:
+      return;
+  }
+  // Apply shifts now instead of on the next maintenance pass.
+  if (maintenanceLoopTask != NULL) {
+    xTaskNotifyGive(maintenanceLoopTask);
+  }
+}
+
+void SpinBLEClient::pollRemote() {
+  if (!connectedRemote) {
+    return;
+  }
+  handleRemoteAction(remoteKeys.poll(millis()));
+  for (size_t i = 0; i < myBLEDevices.size(); i++) {
+    SpinBLEAdvertisedDevice &device = myBLEDevices[i];
+    if (device.isRemote && device.pClient != nullptr && device.pClient->isConnected()) {
+      keepAliveBLE_HID(device.pClient);  // keep alive doesn't seem to help :(
+    }
+  }
+}
+
+bool SpinBLEClient::reconnectFromScanResults(AdvertisementFilter::Category category, const DeviceSelection &selection) {
+  ScanResultCache::Entry entry;
+  if (!scanResults.findSelected(category, millis(), BLE_RECONNECT_RESULT_MAX_AGE_MILLIS, &entry) || !selection.matches(entry.name, strlen(entry.name), entry.address)) {
+    return false;
+  }
+  // The advertised device is owned by the scan results, which the next scan replaces.
+  NimBLEScan *pBLEScan = NimBLEDevice::getScan();
+  if (pBLEScan->isScanning()) {
+    return false;
+  }
+  NimBLEAdvertisedDevice *advertisedDevice = pBLEScan->getResults().getDevice(NimBLEAddress(entry.address, entry.addressType));
+  if (advertisedDevice == nullptr) {
+    return false;
+  }
+  SpinBLEAdvertisedDevice *device = myBLEDevices.acquire(advertisedDevice->getAddress());
+  if (device == nullptr || device->connectedClientID != BLE_HS_CONN_HANDLE_NONE) {
+    return false;
+  }
+  if (!device->doConnect) {
+    SS2K_LOG(BLE_CLIENT_LOG_TAG, "Reconnecting to %s from the scan results", advertisedDevice->getAddress().toString().c_str());
+    device->set(advertisedDevice);
+    device->doConnect = true;
+  }
+  return true;
 }
 
 void SpinBLEClient::checkBLEReconnect() {
+  // Devices the last scan saw recently are connected to directly, the rest need a scan.
   bool scan = false;
-  if ((String(userConfig.getConnectedHeartMonitor()) != "none") && !(spinBLEClient.connectedHRM)) {
-    scan = true;
+  if (advertisementFilter.isEnabled(AdvertisementFilter::HEART_MONITOR) && !(spinBLEClient.connectedHRM)) {
+    scan |= !reconnectFromScanResults(AdvertisementFilter::HEART_MONITOR, userConfig.getHeartMonitorSelection());
   }
-  if ((String(userConfig.getConnectedPowerMeter()) != "none") && !(spinBLEClient.connectedPM)) {
-    scan = true;
+  if (advertisementFilter.isEnabled(AdvertisementFilter::POWER_METER) && !(spinBLEClient.connectedPM)) {
+    scan |= !reconnectFromScanResults(AdvertisementFilter::POWER_METER, userConfig.getPowerMeterSelection());
   }
-  if ((String(userConfig.getConnectedRemote()) != "none") && !(spinBLEClient.connectedRemote)) {
-    scan = true;
+  if (advertisementFilter.isEnabled(AdvertisementFilter::REMOTE) && !(spinBLEClient.connectedRemote)) {
+    scan |= !reconnectFromScanResults(AdvertisementFilter::REMOTE, userConfig.getRemoteSelection());
   }
   if (scan) {
     if (!NimBLEDevice::getScan()->isScanning()) {
@@ -738,77 +807,226 @@ void SpinBLEClient::checkBLEReconnect() {
   }
 }
 
+void SpinBLEClient::connectionsChanged() {
+  myBLEDevices.rebuildHandleIndex();
+  bool pm = false, hrm = false, cd = false, remote = false;
+  for (size_t i = 0; i < myBLEDevices.size(); i++) {
+    SpinBLEAdvertisedDevice &device = myBLEDevices[i];
+    if (device.connectedClientID == BLE_HS_CONN_HANDLE_NONE) {
+      continue;
+    }
+    pm |= device.isPM;
+    hrm |= device.isHRM;
+    cd |= device.isCSC;
+    remote |= device.isRemote;
+  }
+  connectedPM     = pm;
+  connectedHRM    = hrm;
+  connectedCD     = cd;
+  connectedRemote = remote;
+}
+
+int SpinBLEClient::reservedConnections() {
+  int reserved = 0;
+  if (advertisementFilter.isEnabled(AdvertisementFilter::POWER_METER)) {
+    reserved++;
+  }
+  if (advertisementFilter.isEnabled(AdvertisementFilter::HEART_MONITOR)) {
+    reserved++;
+  }
+  if (advertisementFilter.isEnabled(AdvertisementFilter::REMOTE)) {
+    reserved++;
+  }
+  int connected = myBLEDevices.connectedCount();
+  return connected > reserved ? connected : reserved;
+}
+
 void SpinBLEAdvertisedDevice::set(BLEAdvertisedDevice *device, int id, BLEUUID inServiceUUID, BLEUUID inCharUUID) {
   advertisedDevice  = device;
   peerAddress       = device->getAddress();
   connectedClientID = id;
   serviceUUID       = BLEUUID(inServiceUUID);
   charUUID          = BLEUUID(inCharUUID);
-  dataBufferQueue   = xQueueCreate(4, sizeof(NotifyData));
+  // The queue lives as long as the slot; only its contents belong to a connection.
+  if (dataBufferQueue == nullptr) {
+    dataBufferQueue = xQueueCreate(4, sizeof(NotifyData));
+  } else {
+    xQueueReset(dataBufferQueue);
+  }
   if (inServiceUUID == HEARTSERVICE_UUID) {
-    isHRM                      = true;
-    spinBLEClient.connectedHRM = true;
+    isHRM = true;
     SS2K_LOG(BLE_CLIENT_LOG_TAG, "Registered HRM on Connect");
   } else if (inServiceUUID == CSCSERVICE_UUID) {
-    isCSC                     = true;
-    spinBLEClient.connectedCD = true;
+    isCSC = true;
     SS2K_LOG(BLE_CLIENT_LOG_TAG, "Registered CSC on Connect");
   } else if (inServiceUUID == CYCLINGPOWERSERVICE_UUID || inServiceUUID == FITNESSMACHINESERVICE_UUID || inServiceUUID == FLYWHEEL_UART_SERVICE_UUID ||
              inServiceUUID == ECHELON_SERVICE_UUID || inServiceUUID == PELOTON_DATA_UUID) {
-    isPM                      = true;
-    spinBLEClient.connectedPM = true;
+    isPM = true;
     SS2K_LOG(BLE_CLIENT_LOG_TAG, "Registered PM on Connect");
   } else if (inServiceUUID == HID_SERVICE_UUID) {
-    isRemote                      = true;
-    spinBLEClient.connectedRemote = true;
+    isRemote = true;
     SS2K_LOG(BLE_CLIENT_LOG_TAG, "Registered Remote on Connect");
-  } else {
+  } else if (id != BLE_HS_CONN_HANDLE_NONE) {
     SS2K_LOG(BLE_CLIENT_LOG_TAG, "Failed to set service!");
   }
+  if (id != BLE_HS_CONN_HANDLE_NONE) {
+    postConnected = false;  // new connection, run postConnect() again
+  }
+  spinBLEClient.connectionsChanged();
 }
 
 void SpinBLEAdvertisedDevice::reset() {
   advertisedDevice = nullptr;
   // NimBLEAddress peerAddress;
-  connectedClientID = BLE_HS_CONN_HANDLE_NONE;
-  serviceUUID       = (uint16_t)0x0000;
-  charUUID          = (uint16_t)0x0000;
-  isHRM             = false;  // Heart Rate Monitor
-  isPM              = false;  // Power Meter
-  isCSC             = false;  // Cycling Speed/Cadence
-  isCT              = false;  // Controllable Trainer
-  isRemote          = false;  // BLE Remote
-  doConnect         = false;  // Initiate connection flag
-  postConnected     = false;  // Has Cost Connect Been Run?
+  connectedClientID     = BLE_HS_CONN_HANDLE_NONE;
+  serviceUUID           = (uint16_t)0x0000;
+  charUUID              = (uint16_t)0x0000;
+  isHRM                 = false;  // Heart Rate Monitor
+  isPM                  = false;  // Power Meter
+  isCSC                 = false;  // Cycling Speed/Cadence
+  isCT                  = false;  // Controllable Trainer
+  isRemote              = false;  // BLE Remote
+  doConnect             = false;  // Initiate connection flag
+  postConnected         = false;  // Has Cost Connect Been Run?
+  pClient               = nullptr;
+  pRemoteCharacteristic = nullptr;
+  battCharacteristic    = nullptr;
   if (dataBufferQueue != nullptr) {
     // Serial.println("Resetting queue");
     xQueueReset(dataBufferQueue);
   }
+  spinBLEClient.connectionsChanged();
 }
-// Poll BLE devices for battCharacteristic if available and read value.
-void SpinBLEClient::handleBattInfo(NimBLEClient *pClient, bool updateNow = false) {
-  static unsigned long last_battery_update = 0;
-  if ((millis() - last_battery_update >= BATTERY_UPDATE_INTERVAL_MILLIS) || (last_battery_update == 0) || updateNow) {
-    last_battery_update = millis();
-    if (pClient->getService(HEARTSERVICE_UUID) && pClient->getService(BATTERYSERVICE_UUID)) {  // get battery level at first connect
-      BLERemoteCharacteristic *battCharacteristic = pClient->getService(BATTERYSERVICE_UUID)->getCharacteristic(BATTERYCHARACTERISTIC_UUID);
-      if (battCharacteristic != nullptr) {
-        std::string value = battCharacteristic->readValue();
-        rtConfig.hr_batt.setValue((uint8_t)value[0]);
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "HRM battery updated %d", (int)value[0]);
-      } else {
-        rtConfig.hr_batt.setValue(0);
-      }
-    } else if ((pClient->getService(CYCLINGPOWERMEASUREMENT_UUID) || pClient->getService(CYCLINGPOWERSERVICE_UUID)) &&
-               pClient->getService(BATTERYSERVICE_UUID)) {  // get batterylevel at first connect
-      BLERemoteCharacteristic *battCharacteristic = pClient->getService(BATTERYSERVICE_UUID)->getCharacteristic(BATTERYCHARACTERISTIC_UUID);
-      if (battCharacteristic != nullptr) {
-        std::string value = battCharacteristic->readValue();
-        rtConfig.pm_batt.setValue((uint8_t)value[0]);
-        SS2K_LOG(BLE_CLIENT_LOG_TAG, "PM battery updated %d", (int)value[0]);
-      } else {
-        rtConfig.pm_batt.setValue(0);
+
+SpinBLEAdvertisedDevice *SpinBLEDevicePool::acquire(const NimBLEAddress &address) {
+  SpinBLEAdvertisedDevice *device = findByAddress(address);
+  if (device != nullptr) {
+    return device;
+  }
+  for (size_t i = 0; i < size(); i++) {
+    if (devices[i].advertisedDevice == nullptr) {  // found empty device slot
+      return &devices[i];
+    }
+  }
+  return nullptr;
+}
+
+SpinBLEAdvertisedDevice *SpinBLEDevicePool::findByAddress(const NimBLEAddress &address) {
+  for (size_t i = 0; i < size(); i++) {
+    if (devices[i].advertisedDevice != nullptr && devices[i].peerAddress == address) {
+      return &devices[i];
+    }
+  }
+  return nullptr;
+}
+
+SpinBLEAdvertisedDevice *SpinBLEDevicePool::findByConnHandle(uint16_t connHandle) {
+  if (connHandle == BLE_HS_CONN_HANDLE_NONE) {
+    return nullptr;
+  }
+  SpinBLEAdvertisedDevice *found = nullptr;
+  portENTER_CRITICAL(&handleLock);
+  for (size_t probe = 0; probe < size(); probe++) {
+    int8_t slot = handleIndex[(connHandle + probe) % size()];
+    if (slot < 0) {
+      break;
+    }
+    if (devices[slot].connectedClientID == connHandle) {
+      found = &devices[slot];
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&handleLock);
+  return found;
+}
+
+int SpinBLEDevicePool::indexOf(const SpinBLEAdvertisedDevice *device) const {
+  return (device >= devices && device < devices + BLE_DEVICE_POOL_SIZE) ? (int)(device - devices) : -1;
+}
+
+size_t SpinBLEDevicePool::connectedCount() const {
+  size_t count = 0;
+  for (size_t i = 0; i < BLE_DEVICE_POOL_SIZE; i++) {
+    if (devices[i].connectedClientID != BLE_HS_CONN_HANDLE_NONE) {
+      count++;
+    }
+  }
+  return count;
+}
+
+void SpinBLEDevicePool::rebuildHandleIndex() {
+  // Only runs on (dis)connect, so rebuilding beats supporting deletes in the probe sequence.
+  // Built under the lock too, so two rebuilds can't publish out of order.
+  portENTER_CRITICAL(&handleLock);
+  memset(handleIndex, -1, sizeof(handleIndex));
+  for (size_t i = 0; i < BLE_DEVICE_POOL_SIZE; i++) {
+    if (devices[i].connectedClientID == BLE_HS_CONN_HANDLE_NONE) {
+      continue;
+    }
+    for (size_t probe = 0; probe < BLE_DEVICE_POOL_SIZE; probe++) {
+      size_t pos = (devices[i].connectedClientID + probe) % BLE_DEVICE_POOL_SIZE;
+      if (handleIndex[pos] < 0) {
+        handleIndex[pos] = i;
+        break;
       }
     }
   }
+  portEXIT_CRITICAL(&handleLock);
+}
+void SpinBLEAdvertisedDevice::setBatteryLevel(uint8_t level) {
+  lastBatteryUpdate = millis();
+  if (isHRM) {
+    rtConfig.hr_batt.setValue(level);
+    SS2K_LOG(BLE_CLIENT_LOG_TAG, "HRM battery updated %d", level);
+  } else if (isPM) {
+    rtConfig.pm_batt.setValue(level);
+    SS2K_LOG(BLE_CLIENT_LOG_TAG, "PM battery updated %d", level);
+  }
+}
+
+void SpinBLEClient::setupBattery(NimBLEClient *pClient, SpinBLEAdvertisedDevice *device) {
+  device->battCharacteristic = nullptr;
+  if (!device->isHRM && !device->isPM) {
+    return;
+  }
+  NimBLERemoteService *pSvc = pClient->getService(BATTERYSERVICE_UUID);
+  if (pSvc == nullptr) {
+    return;
+  }
+  NimBLERemoteCharacteristic *pChr = pSvc->getCharacteristic(BATTERYCHARACTERISTIC_UUID);
+  if (pChr == nullptr) {
+    return;
+  }
+  // Initial value. We're in the client task here, not the communication loop.
+  if (pChr->canRead()) {
+    std::string value = pChr->readValue();
+    if (value.length() > 0) {
+      device->setBatteryLevel((uint8_t)value[0]);
+    }
+  }
+  if (pChr->canNotify() && pChr->subscribe(true, onBatteryNotify)) {
+    SS2K_LOG(BLE_CLIENT_LOG_TAG, "Subscribed to battery notifications");
+    return;
+  }
+  if (pChr->canRead()) {
+    device->battCharacteristic = pChr;
+  }
+}
+
+void SpinBLEClient::updateBatteries() {
+  for (size_t i = 0; i < myBLEDevices.size(); i++) {
+    SpinBLEAdvertisedDevice &device = myBLEDevices[i];
+    if (device.battCharacteristic == nullptr || device.connectedClientID == BLE_HS_CONN_HANDLE_NONE) {
+      continue;
+    }
+    if (millis() - device.lastBatteryUpdate < BATTERY_UPDATE_INTERVAL_MILLIS) {
+      continue;
+    }
+    std::string value = device.battCharacteristic->readValue();
+    if (value.length() > 0) {
+      device.setBatteryLevel((uint8_t)value[0]);
+    } else {
+      device.lastBatteryUpdate = millis();  // don't retry every loop
+    }
+  }
 }
@@ -25,7 +25,7 @@ void BLECommunications(void *pvParameters) {
       NimBLEDevice::getScan()->stop();  // stop routine scans
     }
     // **********************************Client***************************************
-    for (size_t x = 0; x < NUM_BLE_DEVICES; x++) {  // loop through discovered devices
+    for (size_t x = 0; x < spinBLEClient.myBLEDevices.size(); x++) {  // loop through discovered devices
       if (spinBLEClient.myBLEDevices[x].connectedClientID != BLE_HS_CONN_HANDLE_NONE) {
         SS2K_LOGD(BLE_COMMON_LOG_TAG, "Address: (%s) Client ID: (%d) SerUUID: (%s) CharUUID: (%s) HRM: (%s) PM: (%s) CSC: (%s) CT: (%s) doConnect: (%s)",
                   spinBLEClient.myBLEDevices[x].peerAddress.toString().c_str(), spinBLEClient.myBLEDevices[x].connectedClientID,
@@ -33,54 +33,51 @@ void BLECommunications(void *pvParameters) {
                   spinBLEClient.myBLEDevices[x].isHRM ? "true" : "false", spinBLEClient.myBLEDevices[x].isPM ? "true" : "false",
                   spinBLEClient.myBLEDevices[x].isCSC? "true" : "false", spinBLEClient.myBLEDevices[x].isCT ? "true" : "false",
                   spinBLEClient.myBLEDevices[x].doConnect ? "true" : "false");
-        if (spinBLEClient.myBLEDevices[x].advertisedDevice) {  // is device registered?
-          SpinBLEAdvertisedDevice myAdvertisedDevice = spinBLEClient.myBLEDevices[x];
-          if ((myAdvertisedDevice.connectedClientID != BLE_HS_CONN_HANDLE_NONE) && (myAdvertisedDevice.doConnect == false)) {  // client must not be in connection process
-            if (BLEDevice::getClientByPeerAddress(myAdvertisedDevice.peerAddress)) {                                           // nullptr check
-              BLEClient *pClient = NimBLEDevice::getClientByPeerAddress(myAdvertisedDevice.peerAddress);
-              // Client connected with a valid UUID registered
-              if ((myAdvertisedDevice.serviceUUID != BLEUUID((uint16_t)0x0000)) && (pClient->isConnected())) {
-                BLERemoteCharacteristic *pRemoteBLECharacteristic = pClient->getService(myAdvertisedDevice.serviceUUID)->getCharacteristic(myAdvertisedDevice.charUUID);
-
-                // Handle BLE HID Remotes
-                if (spinBLEClient.myBLEDevices[x].serviceUUID == HID_SERVICE_UUID) {
-                  spinBLEClient.keepAliveBLE_HID(pClient); //keep alive doesn't seem to help :(
-                  continue;  // There is not data that needs to be dequeued for the remote, so got to the next device.
-                }
-
-                // Dequeue sensor data we stored during notifications
-                while (pdTRUE) {
-                  NotifyData incomingNotifyData = myAdvertisedDevice.dequeueData();
-                  if (incomingNotifyData.length == 0) {
-                    break;
-                  }
-                  size_t length = incomingNotifyData.length;
-                  uint8_t pData[length];
-
-                  for (size_t i = 0; i < length; i++) {
-                    pData[i] = incomingNotifyData.data[i];
-                  }
-                  collectAndSet(pRemoteBLECharacteristic->getUUID(), myAdvertisedDevice.serviceUUID, pRemoteBLECharacteristic->getRemoteService()->getClient()->getPeerAddress(),
-                                pData, length);
-                }
-
-                spinBLEClient.handleBattInfo(pClient, false);
-                
-              } else if (!pClient->isConnected()) {  // This shouldn't ever be
-                                                     // called...
-                if (pClient->disconnect() == 0) {    // 0 is a successful disconnect
-                  BLEDevice::deleteClient(pClient);
-                  vTaskDelay(100 / portTICK_PERIOD_MS);
-                  SS2K_LOG(BLE_COMMON_LOG_TAG, "Workaround connect");
-                  myAdvertisedDevice.doConnect = true;
-                }
+        SpinBLEAdvertisedDevice &myAdvertisedDevice = spinBLEClient.myBLEDevices[x];
+        // Handles are cached once the subscription succeeds; until then the client task is still connecting.
+        BLEClient *pClient = myAdvertisedDevice.pClient;
+        if (myAdvertisedDevice.advertisedDevice && pClient != nullptr && (myAdvertisedDevice.doConnect == false)) {  // client must not be in connection process
+          if (pClient->isConnected()) {
+            // BLE HID Remotes are handled as their reports arrive.
+            if (myAdvertisedDevice.isRemote) {
+              continue;  // There is no data that needs to be dequeued for the remote, so go to the next device.
+            }
+
+            // Dequeue sensor data we stored during notifications
+            while (pdTRUE) {
+              NotifyData incomingNotifyData = myAdvertisedDevice.dequeueData();
+              if (incomingNotifyData.length == 0) {
+                break;
               }
+              collectAndSet(myAdvertisedDevice.charUUID, myAdvertisedDevice.serviceUUID, myAdvertisedDevice.peerAddress, incomingNotifyData.data, incomingNotifyData.length);
+            }
+
+          } else {  // This shouldn't ever be called...
+            if (pClient->disconnect() == 0) {  // 0 is a successful disconnect
+              myAdvertisedDevice.pClient               = nullptr;
+              myAdvertisedDevice.pRemoteCharacteristic = nullptr;
+              BLEDevice::deleteClient(pClient);
+              vTaskDelay(100 / portTICK_PERIOD_MS);
+              SS2K_LOG(BLE_COMMON_LOG_TAG, "Workaround connect");
+              myAdvertisedDevice.doConnect = true;
             }
           }
         }
       }
     }
 
+    // Peloton responses queued by SS2K::rxSerial
+    PelotonFramer::Frame pelotonFrame;
+    while (pelotonFrameQueue != nullptr && xQueueReceive(pelotonFrameQueue, &pelotonFrame, 0) == pdTRUE) {
+      collectAndSet(PELOTON_DATA_UUID, PELOTON_DATA_UUID, PELOTON_ADDRESS, pelotonFrame.data, pelotonFrame.length);
+    }
+
+    // Packets paced by the replay task, see startPacketReplay()
+    SensorNotification replayed;
+    while (packetReplayQueue != nullptr && xQueueReceive(packetReplayQueue, &replayed, 0) == pdTRUE) {
+      collectAndSet(replayed.charUUID, replayed.serviceUUID, NimBLEAddress(replayed.address), replayed.data, replayed.length);
+    }
+
     // ***********************************SERVER**************************************
     if ((spinBLEClient.connectedHRM|| rtConfig.hr.getSimulate()) && !spinBLEClient.connectedPM && !rtConfig.watts.getSimulate() && (rtConfig.hr.getValue() > 0) && userPWC.hr2Pwr) {
       calculateInstPwrFromHR();
@@ -92,6 +89,10 @@ void BLECommunications(void *pvParameters) {
     calculateInstPwrFromHR();
 #endif  // DEBUG_HR_TO_PWR
 
+    if (spinBLEClient.connectedHRM && spinBLEClient.connectedPM && !rtConfig.hr.getSimulate() && !rtConfig.watts.getSimulate()) {
+      calibrateHRToPower();
+    }
+
     if (!spinBLEClient.connectedPM && !hr2p && !rtConfig.watts.getSimulate() && !rtConfig.cad.getSimulate()) {
       rtConfig.cad.setValue(0);
       rtConfig.watts.setValue(0);
@@ -102,9 +103,7 @@ void BLECommunications(void *pvParameters) {
 
     if (connectedClientCount() > 0) {
       // update the BLE information on the server
-      updateIndoorBikeDataChar();
-      updateCyclingPowerMeasurementChar();
-      updateHeartRateMeasurementChar();
+      sensorPipeline.update(millis(), spinBLEServer);
       // controlPointIndicate();
 
       if (spinDown()) {
@@ -115,7 +114,7 @@ void BLECommunications(void *pvParameters) {
       spinBLEClient.postConnect();
 
       if (BLEDevice::getAdvertising()) {
-        if (!(BLEDevice::getAdvertising()->isAdvertising()) && (BLEDevice::getServer()->getConnectedCount() < CONFIG_BT_NIMBLE_MAX_CONNECTIONS - NUM_BLE_DEVICES)) {
+        if (!(BLEDevice::getAdvertising()->isAdvertising()) && (BLEDevice::getServer()->getConnectedCount() < CONFIG_BT_NIMBLE_MAX_CONNECTIONS - spinBLEClient.reservedConnections())) {
           SS2K_LOG(BLE_COMMON_LOG_TAG, "Starting Advertising From Communication Loop");
           BLEDevice::startAdvertising();
         }
@@ -205,113 +205,46 @@ bool spinDown() {
   return true;
 }
 
-void updateIndoorBikeDataChar() {
-  if (!spinBLEServer.clientSubscribed.IndoorBikeData) {
-    return;
+bool SpinBLEServer::isSubscribed(const NimBLEUUID &charUUID) const {
+  if (charUUID == FITNESSMACHINEINDOORBIKEDATA_UUID) {
+    return clientSubscribed.IndoorBikeData;
   }
-  float cadRaw   = rtConfig.cad.getValue();
-  int cad        = static_cast<int>(cadRaw * 2);
-  int watts      = rtConfig.watts.getValue();
-  int hr         = rtConfig.hr.getValue();
-  int res        = rtConfig.resistance.getValue();
-  int speed      = 0;
-  float speedRaw = rtConfig.getSimulatedSpeed();
-
-  if (speedRaw <= 0) {
-    speed = (((cad * watts) / 100) * 1.5);
-  } else {
-    speed = static_cast<int>(speedRaw);
+  if (charUUID == CYCLINGPOWERMEASUREMENT_UUID) {
+    return clientSubscribed.CyclingPowerMeasurement;
   }
-  ftmsIndoorBikeData[2] = (uint8_t)(speed & 0xff);
-  ftmsIndoorBikeData[3] = (uint8_t)(speed >> 8);
-
-  ftmsIndoorBikeData[4] = (uint8_t)(cad & 0xff);
-  ftmsIndoorBikeData[5] = (uint8_t)(cad >> 8);
-
-  ftmsIndoorBikeData[6] = (uint8_t)(res & 0xff);
-  ftmsIndoorBikeData[7] = (uint8_t)(res >> 8);
-
-  ftmsIndoorBikeData[8] = (uint8_t)(watts & 0xff);
-  ftmsIndoorBikeData[9] = (uint8_t)(watts >> 8);
-
-  ftmsIndoorBikeData[10] = (uint8_t)hr;
-
-  fitnessMachineIndoorBikeData->setValue(ftmsIndoorBikeData, 11);
-  fitnessMachineIndoorBikeData->notify();
-
-  // ftmsResistanceLevelRange[0] = (uint8_t)rtConfig.getMinResistance() & 0xff;
-  // ftmsResistanceLevelRange[1] = (uint8_t)rtConfig.getMinResistance() >> 8;
-  // ftmsResistanceLevelRange[2] = (uint8_t)rtConfig.getMaxResistance() & 0xff;
-  // ftmsResistanceLevelRange[3] = (uint8_t)rtConfig.getMaxResistance() >> 8;
-  // ftmsResistanceLevelRange.setValue(ftmsResistanceLevelRange, 6);
+  if (charUUID == HEARTCHARACTERISTIC_UUID) {
+    return clientSubscribed.Heartrate;
+  }
+  return false;
+}
 
+void SpinBLEServer::notify(const NimBLEUUID &charUUID, const uint8_t *data, size_t length) {
   const int kLogBufCapacity = 200;  // Data(30), Sep(data/2), Arrow(3), CharId(37), Sep(3), CharId(37), Sep(3), Name(10), Prefix(2), HR(7), SEP(1), CD(10), SEP(1), PW(8),
                                     // SEP(1), SD(7), Suffix(2), Nul(1), rounded up
   char logBuf[kLogBufCapacity];
-  const size_t ftmsIndoorBikeDataLength = sizeof(ftmsIndoorBikeData) / sizeof(ftmsIndoorBikeData[0]);
-  logCharacteristic(logBuf, kLogBufCapacity, ftmsIndoorBikeData, ftmsIndoorBikeDataLength, FITNESSMACHINESERVICE_UUID, fitnessMachineIndoorBikeData->getUUID(),
-                    "FTMS(IBD)[ HR(%d) CD(%.2f) PW(%d) SD(%.2f) ]", hr % 1000, fmodf(cadRaw, 1000.0), watts % 10000, fmodf(speed, 1000.0));
-}
-
-void updateCyclingPowerMeasurementChar() {
-  if (!spinBLEServer.clientSubscribed.CyclingPowerMeasurement) {
-    return;
-  }
-  int power = rtConfig.watts.getValue();
-  int remainder, quotient;
-  quotient                   = power / 256;
-  remainder                  = power % 256;
-  cyclingPowerMeasurement[2] = remainder;
-  cyclingPowerMeasurement[3] = quotient;
-  cyclingPowerMeasurementCharacteristic->setValue(cyclingPowerMeasurement, 9);
-
-  float cadence = rtConfig.cad.getValue();
-  if (cadence > 0) {
-    float crankRevPeriod = (60 * 1024) / cadence;
-    spinBLEClient.cscCumulativeCrankRev++;
-    spinBLEClient.cscLastCrankEvtTime += crankRevPeriod;
-    int remainder, quotient;
-    quotient                   = spinBLEClient.cscCumulativeCrankRev / 256;
-    remainder                  = spinBLEClient.cscCumulativeCrankRev % 256;
-    cyclingPowerMeasurement[5] = remainder;
-    cyclingPowerMeasurement[6] = quotient;
-    quotient                   = spinBLEClient.cscLastCrankEvtTime / 256;
-    remainder                  = spinBLEClient.cscLastCrankEvtTime % 256;
-    cyclingPowerMeasurement[7] = remainder;
-    cyclingPowerMeasurement[8] = quotient;
+  if (charUUID == FITNESSMACHINEINDOORBIKEDATA_UUID) {
+    fitnessMachineIndoorBikeData->setValue(data, length);
+    fitnessMachineIndoorBikeData->notify();
+    logCharacteristic(logBuf, kLogBufCapacity, data, length, FITNESSMACHINESERVICE_UUID, charUUID, "FTMS(IBD)[ HR(%d) CD(%.2f) PW(%d) SD(%.2f) ]", rtConfig.hr.getValue() % 1000,
+                      fmodf(rtConfig.cad.getValue(), 1000.0), rtConfig.watts.getValue() % 10000, fmodf(rtConfig.getSimulatedSpeed(), 1000.0));
+  } else if (charUUID == CYCLINGPOWERMEASUREMENT_UUID) {
+    cyclingPowerMeasurementCharacteristic->setValue(data, length);
+    cyclingPowerMeasurementCharacteristic->notify();
+    float cadence = rtConfig.cad.getValue();
+    logCharacteristic(logBuf, kLogBufCapacity, data, length, CYCLINGPOWERSERVICE_UUID, charUUID, "CPS(CPM)[ CD(%.2f) PW(%d) ]", cadence > 0 ? fmodf(cadence, 1000.0) : 0,
+                      rtConfig.watts.getValue() % 10000);
+  } else if (charUUID == HEARTCHARACTERISTIC_UUID) {
+    heartRateMeasurementCharacteristic->setValue(data, length);
+    heartRateMeasurementCharacteristic->notify();
+    logCharacteristic(logBuf, kLogBufCapacity, data, length, HEARTSERVICE_UUID, charUUID, "HRS(HRM)[ HR(%d) ]", rtConfig.hr.getValue() % 1000);
   }
-
-  cyclingPowerMeasurementCharacteristic->notify();
-
-  const int kLogBufCapacity =
-      150;  // Data(18), Sep(data/2), Arrow(3), CharId(37), Sep(3), CharId(37), Sep(3),Name(8), Prefix(2), CD(10), SEP(1), PW(8), Suffix(2), Nul(1), rounded up
-  char logBuf[kLogBufCapacity];
-  const size_t cyclingPowerMeasurementLength = sizeof(cyclingPowerMeasurement) / sizeof(cyclingPowerMeasurement[0]);
-  logCharacteristic(logBuf, kLogBufCapacity, cyclingPowerMeasurement, cyclingPowerMeasurementLength, FITNESSMACHINESERVICE_UUID, fitnessMachineIndoorBikeData->getUUID(),
-                    "CPS(CPM)[ CD(%.2f) PW(%d) ]", cadence > 0 ? fmodf(cadence, 1000.0) : 0, power % 10000);
-}
-
-void updateHeartRateMeasurementChar() {
-  if (!spinBLEServer.clientSubscribed.Heartrate) {
-    return;
-  }
-  int hr                  = rtConfig.hr.getValue();
-  heartRateMeasurement[1] = hr;
-  heartRateMeasurementCharacteristic->setValue(heartRateMeasurement, 2);
-  heartRateMeasurementCharacteristic->notify();
-
-  const int kLogBufCapacity = 125;  // Data(10), Sep(data/2), Arrow(3), CharId(37), Sep(3), CharId(37), Sep(3), Name(8), Prefix(2), HR(7), Suffix(2), Nul(1), rounded up
-  char logBuf[kLogBufCapacity];
-  const size_t heartRateMeasurementLength = sizeof(heartRateMeasurement) / sizeof(heartRateMeasurement[0]);
-  logCharacteristic(logBuf, kLogBufCapacity, heartRateMeasurement, heartRateMeasurementLength, HEARTSERVICE_UUID, heartRateMeasurementCharacteristic->getUUID(),
-                    "HRS(HRM)[ HR(%d) ]", hr % 1000);
 }
 
 // Creating Server Connection Callbacks
 void MyServerCallbacks::onConnect(BLEServer *pServer, ble_gap_conn_desc *desc) {
   SS2K_LOG(BLE_SERVER_LOG_TAG, "Bluetooth Remote Client Connected: %s Connected Clients: %d", NimBLEAddress(desc->peer_ota_addr).toString().c_str(), pServer->getConnectedCount());
 
-  if (pServer->getConnectedCount() < CONFIG_BT_NIMBLE_MAX_CONNECTIONS - NUM_BLE_DEVICES) {
+  if (pServer->getConnectedCount() < CONFIG_BT_NIMBLE_MAX_CONNECTIONS - spinBLEClient.reservedConnections()) {
     BLEDevice::startAdvertising();
   } else {
     SS2K_LOG(BLE_SERVER_LOG_TAG, "Max Remote Client Connections Reached");
@@ -581,28 +514,22 @@ int connectedClientCount() {
 }
 
 void calculateInstPwrFromHR() {
-  static int oldHR    = rtConfig.hr.getValue();
-  static int newHR    = rtConfig.hr.getValue();
-  static double delta = 0;
-  oldHR               = newHR;  // Copying HR from Last loop
-  newHR               = rtConfig.hr.getValue();
-
-  delta = (newHR - oldHR) / (BLE_CLIENT_DELAY / 1000) +1 ;
-
-  // userConfig.setSimulatedWatts((s1Pwr*s2HR)-(s2Pwr*S1HR))/(S2HR-s1HR)+(userConfig.getSimulatedHr(*((s1Pwr-s2Pwr)/(s1HR-s2HR)));
-  int avgP = ((userPWC.session1Pwr * userPWC.session2HR) - (userPWC.session2Pwr * userPWC.session1HR)) / (userPWC.session2HR - userPWC.session1HR) +
-             (newHR * ((userPWC.session1Pwr - userPWC.session2Pwr) / (userPWC.session1HR - userPWC.session2HR)));
-
-  if (avgP < DEFAULT_MIN_WATTS) {
-    avgP = DEFAULT_MIN_WATTS;
+  static HRPowerEstimator estimator;
+  HRPowerPoint sessions[HR_POWER_MAX_POINTS];
+  if (estimator.setCalibration(sessions, userPWC.getSessions(sessions, HR_POWER_MAX_POINTS))) {
+    SS2K_LOG(BLE_SERVER_LOG_TAG, "HR to Power: %.2f W/bpm, %.0f W at 0 bpm, r2 %.2f", estimator.getGradient(), estimator.getIntercept(), estimator.getR2());
   }
-
-  if (delta < 0) {
-    // magic math here for inst power
+  if (!estimator.isCalibrated()) {
+    SS2K_LOG(BLE_SERVER_LOG_TAG, "HR to Power needs two sessions where power rises with heart rate");
+#ifndef DEBUG_HR_TO_PWR
+    rtConfig.watts.setValue(0);
+#endif  // DEBUG_HR_TO_PWR
+    return;
   }
 
-  if (delta > 0) {
-    // magic math here for inst power
+  int avgP = estimator.update(rtConfig.hr.getValue(), millis());
+  if (avgP < DEFAULT_MIN_WATTS) {
+    avgP = DEFAULT_MIN_WATTS;
   }
 
 #ifndef DEBUG_HR_TO_PWR
@@ -610,7 +537,20 @@ void calculateInstPwrFromHR() {
   rtConfig.cad.setValue(NORMAL_CAD);
 #endif  // DEBUG_HR_TO_PWR
 
-  SS2K_LOG(BLE_SERVER_LOG_TAG, "Power From HR: %d", avgP);
+  SS2K_LOG(BLE_SERVER_LOG_TAG, "Power From HR: %d (steady HR %.0f, confidence %.2f)", avgP, estimator.getSteadyStateHR(), estimator.getConfidence());
+}
+
+// Refines userPWC while both a heart rate monitor and a power meter are connected.
+void calibrateHRToPower() {
+  if (!pwcCollector.update(rtConfig.hr.getValue(), rtConfig.watts.getValue(), millis())) {
+    return;
+  }
+  HRPowerPoint sessions[HR_POWER_MAX_POINTS];
+  size_t count = pwcCollector.getPoints(sessions, HR_POWER_MAX_POINTS);
+  userPWC.setSessions(sessions, count);
+  userPWC.sessionsMeasured = true;
+  userPWC.requestSave();
+  SS2K_LOG(BLE_SERVER_LOG_TAG, "HR to Power calibrated from %d efforts, r2 %.3f", (int)count, pwcCollector.getR2());
 }
 
 /*
@@ -931,7 +871,7 @@ void ss2kCustomCharacteristicCallbacks::onWrite(BLECharacteristic *pCharacterist
 
     case BLE_saveToLittleFS:  // 0x18
       logBufLength += snprintf(logBuf + logBufLength, kLogBufCapacity - logBufLength, "<-saveToLittleFS");
-      userConfig.saveToLittleFS();
+      userConfig.requestSave();
       returnValue[0] = success;
       break;
 
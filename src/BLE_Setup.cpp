@@ -28,7 +28,7 @@ void setupBLE() {  // Common BLE setup for both client and server
 
   SS2K_LOG(BLE_SETUP_LOG_TAG, "BLE Notify Task Started");
   /*vTaskDelay(100 / portTICK_PERIOD_MS);
-  if (strcmp(userConfig.getConnectedPowerMeter(), "none") != 0 || strcmp(userConfig.getConnectedHeartMonitor(), "none") != 0) {
+  if (userConfig.getPowerMeterSelection().getMode() != DeviceSelection::NONE || userConfig.getHeartMonitorSelection().getMode() != DeviceSelection::NONE) {
     spinBLEClient.serverScan(true);
     SS2K_LOG(BLE_SETUP_LOG_TAG, "Scanning");
   }*/
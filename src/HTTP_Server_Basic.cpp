@@ -11,7 +11,11 @@
 #include "HTTP_Server_Basic.h"
 #include "cert.h"
 #include "SS2KLog.h"
-#include <WebServer.h>
+#include "TelemetryDelta.h"
+#include "AssetManifest.h"
+#include "update/AssetUpdater.h"
+#include "update/UpdateCheck.h"
+#include <ESPAsyncWebServer.h>
 #include <HTTPClient.h>
 #include <HTTPUpdate.h>
 #include <LittleFS.h>
@@ -20,10 +24,14 @@
 #include <Update.h>
 #include <DNSServer.h>
 #include <ArduinoJson.h>
+#include <memory>
 
 File fsUploadFile;
+String uploadFilename;
 
-TaskHandle_t webClientTask;
+TaskHandle_t webServerTask  = NULL;
+TaskHandle_t telemetryTask  = NULL;
+bool telemetryClientJoined = false;
 
 IPAddress myIP;
 
@@ -32,7 +40,9 @@ const byte DNS_PORT = 53;
 DNSServer dnsServer;
 HTTP_Server httpServer;
 WiFiClientSecure client;
-WebServer server(80);
+AsyncWebServer server(80);
+AsyncEventSource events("/events");
+AssetManifest assetManifest;
 
 #ifdef USE_TELEGRAM
 #include <UniversalTelegramBot.h>
@@ -59,7 +69,7 @@ void startWifi() {
     vTaskDelay(1000 / portTICK_RATE_MS);
     SS2K_LOG(HTTP_SERVER_LOG_TAG, "Waiting for connection to be established...");
     i++;
-    if (i > WIFI_CONNECT_TIMEOUT || (String(userConfig.getSsid()) == DEVICE_NAME)) {
+    if (i > WIFI_CONNECT_TIMEOUT || (strcmp(userConfig.getSsid(), DEVICE_NAME) == 0)) {
       i = 0;
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "Couldn't Connect. Switching to AP mode");
       WiFi.disconnect();
@@ -75,7 +85,7 @@ void startWifi() {
   // Couldn't connect to existing network, Create SoftAP
   if (WiFi.status() != WL_CONNECTED) {
     String t_pass = DEFAULT_PASSWORD;
-    if (String(userConfig.getSsid()) == DEVICE_NAME) {
+    if (strcmp(userConfig.getSsid(), DEVICE_NAME) == 0) {
       // If default SSID is still in use, let the user
       // select a new password.
       // Else Fall Back to the default password (probably "password")
@@ -120,9 +130,24 @@ void stopWifi() {
   WiFi.disconnect();
 }
 
+// Sends a JSON document as a chunked response. The chunker serializes it once into a
+// buffer of up to JSON_RESPONSE_BUFFER_SIZE bytes that the chunks are copied from, so
+// neither a JsonDocument nor a String of the whole document is needed. write() must
+// serialize a snapshot so chunks line up.
+static void sendChunkedJSON(AsyncWebServerRequest *request, std::function<void(JsonWriter &)> write) {
+  std::shared_ptr<JsonChunker> chunker(new JsonChunker(write, JSON_RESPONSE_BUFFER_SIZE));
+  request->send(request->beginChunkedResponse("text/plain", [chunker](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+    return chunker->read(reinterpret_cast<char *>(buffer), maxLen, index);
+  }));
+}
+
 void HTTP_Server::start() {
-  server.enableCORS(true);
-  server.onNotFound([]() { SS2K_LOG(HTTP_SERVER_LOG_TAG, "Link Not Found: %s", server.uri().c_str()); });
+  loadAssetManifest();
+  DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
+  server.onNotFound([](AsyncWebServerRequest *request) {
+    SS2K_LOG(HTTP_SERVER_LOG_TAG, "Link Not Found: %s", request->url().c_str());
+    request->send(404, "text/plain", "Not Found");
+  });
 
   /***************************Begin Handlers*******************/
   server.on("/", handleIndexFile);
@@ -143,7 +168,7 @@ void HTTP_Server::start() {
   server.on("/send_settings", settingsProcessor);
   server.on("/jquery.js.gz", handleLittleFSFile);
 
-  server.on("/BLEScan", []() {
+  server.on("/BLEScan", [](AsyncWebServerRequest *request) {
     SS2K_LOG(HTTP_SERVER_LOG_TAG, "Scanning from web request");
     String response =
         "<!DOCTYPE html><html><body>Scanning for BLE Devices. Please wait "
@@ -152,10 +177,50 @@ void HTTP_Server::start() {
     // spinBLEClient.resetDevices();
     spinBLEClient.dontBlockScan = true;
     spinBLEClient.scanProcess(DEFAULT_SCAN_DURATION);
-    server.send(200, "text/html", response);
+    request->send(200, "text/html", response);
+  });
+
+  server.on("/BLEScanResults", [](AsyncWebServerRequest *request) {
+    if (request->arg("format") == "binary") {
+      uint8_t buffer[1 + SCAN_RESULT_CACHE_SIZE * (12 + ADVERTISEMENT_FILTER_MAX_NAME)];
+      size_t length                 = spinBLEClient.scanResults.toBinary(buffer, sizeof(buffer), millis(), BLE_SCAN_RESULT_MAX_AGE_MILLIS);
+      AsyncResponseStream *response = request->beginResponseStream("application/octet-stream");
+      response->write(buffer, length);
+      request->send(response);
+      return;
+    }
+    request->send(200, "application/json", spinBLEClient.getFoundDevicesJSON());
   });
 
-  server.on("/load_defaults.html", []() {
+  server.on("/capture.bin", [](AsyncWebServerRequest *request) {
+    std::vector<uint8_t> capture  = packetCapture.snapshot();
+    AsyncResponseStream *response = request->beginResponseStream("application/octet-stream", capture.size());
+    response->addHeader("Content-Disposition", "attachment; filename=capture.bin");
+    response->write(capture.data(), capture.size());
+    request->send(response);
+  });
+
+  // ?enable=0|1, ?clear=1 or ?replay=<speed>
+  server.on("/capture", [](AsyncWebServerRequest *request) {
+    if (!request->arg("enable").isEmpty()) {
+      packetCapture.setEnabled(request->arg("enable").toInt() != 0);
+    }
+    if (!request->arg("clear").isEmpty()) {
+      packetCapture.clear();
+    }
+    if (!request->arg("replay").isEmpty()) {
+      float speed = request->arg("replay").toFloat();
+      if (!startPacketReplay(speed > 0 ? speed : 1.0)) {
+        request->send(409, "text/plain", "Replay running or capture empty");
+        return;
+      }
+    }
+    String response = "{\"enabled\":" + String(packetCapture.isEnabled() ? "true" : "false") + ",\"packets\":" + String(packetCapture.size()) +
+                      ",\"replaying\":" + String(packetReplayRunning() ? "true" : "false") + "}";
+    request->send(200, "application/json", response);
+  });
+
+  server.on("/load_defaults.html", [](AsyncWebServerRequest *request) {
     SS2K_LOG(HTTP_SERVER_LOG_TAG, "Setting Defaults from Web Request");
     LittleFS.format();
     userConfig.setDefaults();
@@ -165,228 +230,186 @@ void HTTP_Server::start() {
         "loaded.</h1><p><br><br> Please reconnect to the device on WiFi "
         "network: " +
         myIP.toString() + "</p></body></html>";
-    server.send(200, "text/html", response);
-    ESP.restart();
+    request->onDisconnect(restartAfterResponse);
+    request->send(200, "text/html", response);
   });
 
-  server.on("/reboot.html", []() {
+  server.on("/reboot.html", [](AsyncWebServerRequest *request) {
     SS2K_LOG(HTTP_SERVER_LOG_TAG, "Rebooting from Web Request");
     String response = "Rebooting....<script> setTimeout(\"location.href = 'http://" + myIP.toString() + "/index.html';\",500); </script>";
-    server.send(200, "text/html", response);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    ESP.restart();
+    request->onDisconnect(restartAfterResponse);
+    request->send(200, "text/html", response);
   });
 
-  server.on("/hrslider", []() {
-    String value = server.arg("value");
+  server.on("/hrslider", [](AsyncWebServerRequest *request) {
+    String value = request->arg("value");
     if (value == "enable") {
       rtConfig.hr.setSimulate(true);
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "HR Simulator turned on");
     } else if (value == "disable") {
       rtConfig.hr.setSimulate(false);
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "HR Simulator turned off");
     } else {
       rtConfig.hr.setValue(value.toInt());
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "HR is now: %d", rtConfig.hr.getValue());
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
     }
   });
 
-  server.on("/wattsslider", []() {
-    String value = server.arg("value");
+  server.on("/wattsslider", [](AsyncWebServerRequest *request) {
+    String value = request->arg("value");
     if (value == "enable") {
       rtConfig.watts.setSimulate(true);
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "Watt Simulator turned on");
     } else if (value == "disable") {
       rtConfig.watts.setSimulate(false);
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "Watt Simulator turned off");
     } else {
       rtConfig.watts.setValue(value.toInt());
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "Watts are now: %d", rtConfig.watts.getValue());
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
     }
   });
 
-  server.on("/cadslider", []() {
-    String value = server.arg("value");
+  server.on("/cadslider", [](AsyncWebServerRequest *request) {
+    String value = request->arg("value");
     if (value == "enable") {
       rtConfig.cad.setSimulate(true);
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "CAD Simulator turned on");
     } else if (value == "disable") {
       rtConfig.cad.setSimulate(false);
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "CAD Simulator turned off");
     } else {
       rtConfig.cad.setValue(value.toInt());
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "CAD is now: %d", rtConfig.cad.getValue());
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
     }
   });
 
-  server.on("/ergmode", []() {
-    String value = server.arg("value");
+  server.on("/ergmode", [](AsyncWebServerRequest *request) {
+    String value = request->arg("value");
     if (value == "enable") {
       rtConfig.setFTMSMode(FitnessMachineControlPointProcedure::SetTargetPower);
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "ERG Mode turned on");
     } else {
       rtConfig.setFTMSMode(FitnessMachineControlPointProcedure::RequestControl);
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "ERG Mode turned off");
     }
   });
 
-  server.on("/targetwattsslider", []() {
-    String value = server.arg("value");
+  server.on("/targetwattsslider", [](AsyncWebServerRequest *request) {
+    String value = request->arg("value");
     if (value == "enable") {
       rtConfig.setSimTargetWatts(true);
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "Target Watts Simulator turned on");
     } else if (value == "disable") {
       rtConfig.setSimTargetWatts(false);
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "Target Watts Simulator turned off");
     } else {
       rtConfig.watts.setTarget(value.toInt());
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "Target Watts are now: %d", rtConfig.watts.getTarget());
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
     }
   });
 
-  server.on("/shift", []() {
-    int value = server.arg("value").toInt();
+  server.on("/shift", [](AsyncWebServerRequest *request) {
+    int value = request->arg("value").toInt();
     if ((value > -10) && (value < 10)) {
       rtConfig.setShifterPosition(rtConfig.getShifterPosition() + value);
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "Shift From HTML");
     } else {
       rtConfig.setShifterPosition(value);
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "Invalid HTML Shift");
-      server.send(200, "text/plain", "OK");
+      request->send(200, "text/plain", "OK");
     }
   });
 
-  server.on("/configJSON", []() {
-    String tString;
-    tString = userConfig.returnJSON();
-    server.send(200, "text/plain", tString);
+  server.on("/configJSON", [](AsyncWebServerRequest *request) {
+    std::shared_ptr<userParameters> config(new userParameters(userConfig.snapshot()));
+    std::shared_ptr<String> foundDevices(new String(spinBLEClient.getFoundDevicesJSON()));
+    sendChunkedJSON(request, [config, foundDevices](JsonWriter &json) { config->writeJSON(json, *foundDevices); });
+  });
+
+  server.on("/runtimeConfigJSON", [](AsyncWebServerRequest *request) {
+    std::shared_ptr<RuntimeParameters> runtime(new RuntimeParameters(rtConfig));
+    sendChunkedJSON(request, [runtime](JsonWriter &json) { runtime->writeJSON(json); });
   });
 
-  server.on("/runtimeConfigJSON", []() {
-    String tString;
-    tString = rtConfig.returnJSON();
-    server.send(200, "text/plain", tString);
+  server.on("/PWCJSON", [](AsyncWebServerRequest *request) {
+    std::shared_ptr<physicalWorkingCapacity> pwc(new physicalWorkingCapacity(userPWC));
+    sendChunkedJSON(request, [pwc](JsonWriter &json) { pwc->writeJSON(json); });
   });
 
-  server.on("/PWCJSON", []() {
-    String tString;
-    tString = userPWC.returnJSON();
-    server.send(200, "text/plain", tString);
+  server.on("/boot.json", [](AsyncWebServerRequest *request) {
+    std::shared_ptr<BootTimeline> timeline(new BootTimeline(bootTimeline));
+    sendChunkedJSON(request, [timeline](JsonWriter &json) { timeline->writeJSON(json); });
   });
 
-  server.on("/login", HTTP_GET, []() {
-    server.sendHeader("Connection", "close");
-    server.send(200, "text/html", OTALoginIndex);
+  server.on("/peloton.json", [](AsyncWebServerRequest *request) {
+    PelotonScheduler::Stats stats = pelotonLink.getStats();
+    sendChunkedJSON(request, [stats](JsonWriter &json) { stats.writeJSON(json); });
   });
 
-  server.on("/OTAIndex", HTTP_GET, []() {
+  server.on("/driver.json", [](AsyncWebServerRequest *request) {
+    DriverTelemetry::Status status = driverTelemetry.getStatus();
+    sendChunkedJSON(request, [status](JsonWriter &json) { status.writeJSON(json); });
+  });
+
+  server.on("/pwcCalibration.json", [](AsyncWebServerRequest *request) {
+    PWCCollector::Summary summary = pwcCollector.getSummary();
+    sendChunkedJSON(request, [summary](JsonWriter &json) { summary.writeJSON(json); });
+  });
+
+  server.on("/login", HTTP_GET, [](AsyncWebServerRequest *request) { request->send(200, "text/html", OTALoginIndex); });
+
+  server.on("/OTAIndex", HTTP_GET, [](AsyncWebServerRequest *request) {
     ss2k.stopTasks();
-    server.sendHeader("Connection", "close");
-    server.send(200, "text/html", OTAServerIndex);
+    request->send(200, "text/html", OTAServerIndex);
   });
 
   /*handling uploading firmware file */
-  server.on(
-      "/update", HTTP_POST,
-      []() {
-        server.sendHeader("Connection", "close");
-        server.send(200, "text/plain", (Update.hasError()) ? "FAIL" : "OK");
-      },
-      []() {
-        HTTPUpload &upload = server.upload();
-        if (upload.filename == String("firmware.bin").c_str()) {
-          if (upload.status == UPLOAD_FILE_START) {
-            SS2K_LOG(HTTP_SERVER_LOG_TAG, "Update: %s", upload.filename.c_str());
-            if (!Update.begin(UPDATE_SIZE_UNKNOWN, U_FLASH)) {  // start with max
-                                                                // available size
-              Update.printError(Serial);
-            }
-          } else if (upload.status == UPLOAD_FILE_WRITE) {
-            /* flashing firmware to ESP*/
-            if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
-              Update.printError(Serial);
-            }
-          } else if (upload.status == UPLOAD_FILE_END) {
-            if (Update.end(true)) {  // true to set the size to the
-                                     // current progress
-              server.send(200, "text/plain", "Firmware Uploaded Successfully. Rebooting...");
-              ESP.restart();
-            } else {
-              Update.printError(Serial);
-            }
-          }
-        } else if (upload.filename == String("littlefs.bin").c_str()) {
-          if (upload.status == UPLOAD_FILE_START) {
-            SS2K_LOG(HTTP_SERVER_LOG_TAG, "Update: %s", upload.filename.c_str());
-            if (!Update.begin(UPDATE_SIZE_UNKNOWN, U_SPIFFS)) {  // start with max
-                                                                 // available size
-              Update.printError(Serial);
-            }
-          } else if (upload.status == UPLOAD_FILE_WRITE) {
-            /* flashing firmware to ESP*/
-            if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
-              Update.printError(Serial);
-            }
-          } else if (upload.status == UPLOAD_FILE_END) {
-            if (Update.end(true)) {  // true to set the size to the
-                                     // current progress
-              server.send(200, "text/plain", "Littlefs Uploaded Successfully. Rebooting...");
-              userConfig.saveToLittleFS();
-              userPWC.saveToLittleFS();
-              vTaskDelay(100);
-              ESP.restart();
-            } else {
-              Update.printError(Serial);
-            }
-          }
-        } else {
-          if (upload.status == UPLOAD_FILE_START) {
-            String filename = upload.filename;
-            if (!filename.startsWith("/")) {
-              filename = "/" + filename;
-            }
-            SS2K_LOG(HTTP_SERVER_LOG_TAG, "handleFileUpload Name: %s", filename.c_str());
-            fsUploadFile = LittleFS.open(filename, "w");
-            filename     = String();
-          } else if (upload.status == UPLOAD_FILE_WRITE) {
-            if (fsUploadFile) {
-              fsUploadFile.write(upload.buf, upload.currentSize);
-            }
-          } else if (upload.status == UPLOAD_FILE_END) {
-            if (fsUploadFile) {
-              fsUploadFile.close();
-            }
-            SS2K_LOG(HTTP_SERVER_LOG_TAG, "handleFileUpload Size: %zu", upload.totalSize);
-            server.send(200, "text/plain", String(upload.filename + " Uploaded Successfully."));
-          }
-        }
-      });
+  server.on("/update", HTTP_POST, handleUploadComplete, handleUpload);
+
+  // Live runtime values as server-sent "telemetry" events, see telemetryUpdate()
+  events.onConnect([](AsyncEventSourceClient *client) { telemetryClientJoined = true; });
+  server.addHandler(&events);
 
   /********************************************End Server
    * Handlers*******************************/
 
-  xTaskCreatePinnedToCore(HTTP_Server::webClientUpdate,       /* Task function. */
-                          "webClientUpdate",                  /* name of task. */
-                          6000 + (DEBUG_LOG_BUFFER_SIZE * 2), /* Stack size of task Used to be 3000*/
-                          NULL,                               /* parameter of the task */
-                          10,                                 /* priority of the task */
-                          &webClientTask,                     /* Task handle to keep track of created task */
-                          0);                                 /* pin task to core */
+  // Requests are served from the AsyncTCP task as they arrive. This task only
+  // answers captive portal DNS in AP mode and keeps MDNS alive.
+  if (webServerTask == NULL) {
+    xTaskCreatePinnedToCore(HTTP_Server::webServerMaintenance, /* Task function. */
+                            "webServerMaintenance",            /* name of task. */
+                            3000 + (DEBUG_LOG_BUFFER_SIZE),    /* Stack size of task*/
+                            NULL,                              /* parameter of the task */
+                            1,                                 /* priority of the task */
+                            &webServerTask,                    /* Task handle to keep track of created task */
+                            0);                                /* pin task to core */
+  } else {
+    xTaskNotifyGive(webServerTask);  // WiFi mode may have changed
+  }
+  if (telemetryTask == NULL) {
+    xTaskCreatePinnedToCore(HTTP_Server::telemetryUpdate, /* Task function. */
+                            "telemetryUpdate",            /* name of task. */
+                            3000,                         /* Stack size of task*/
+                            NULL,                         /* parameter of the task */
+                            1,                            /* priority of the task */
+                            &telemetryTask,               /* Task handle to keep track of created task */
+                            0);                           /* pin task to core */
+  }
 
 #ifdef USE_TELEGRAM
   xTaskCreatePinnedToCore(telegramUpdate,   /* Task function. */
@@ -401,214 +424,444 @@ void HTTP_Server::start() {
   SS2K_LOG(HTTP_SERVER_LOG_TAG, "HTTP server started");
 }
 
-void HTTP_Server::webClientUpdate(void *pvParameters) {
+void HTTP_Server::webServerMaintenance(void *pvParameters) {
   static unsigned long mDnsTimer = millis();  // NOLINT: There is no overload in String for uint64_t
   for (;;) {
-    server.handleClient();
-    vTaskDelay(WEBSERVER_DELAY / portTICK_RATE_MS);
     if (WiFi.getMode() == WIFI_AP) {
       dnsServer.processNextRequest();
+      ulTaskNotifyTake(pdTRUE, DNS_SERVER_DELAY / portTICK_RATE_MS);
+    } else {
+      // Nothing to poll in station mode, sleep until MDNS is due or start() wakes us.
+      ulTaskNotifyTake(pdTRUE, MDNS_REFRESH_DELAY / portTICK_RATE_MS);
     }
     // Keep MDNS alive
-    if ((millis() - mDnsTimer) > 30000) {
+    if ((millis() - mDnsTimer) > MDNS_REFRESH_DELAY) {
       MDNS.addServiceTxt("http", "_tcp", "lf", String(mDnsTimer));
       mDnsTimer = millis();
 #ifdef DEBUG_STACK
-      Serial.printf("HttpServer: %d \n", uxTaskGetStackHighWaterMark(webClientTask));
+      Serial.printf("HttpServer: %d \n", uxTaskGetStackHighWaterMark(webServerTask));
 #endif  // DEBUG_STACK
     }
   }
 }
 
-void HTTP_Server::handleIndexFile() {
+// Pushes runtime values to every /events client. Each frame is serialized once and
+// only carries the values that changed, with a full frame when someone connects.
+void HTTP_Server::telemetryUpdate(void *pvParameters) {
+  static TelemetryDelta telemetry;
+  static char frame[TELEMETRY_FRAME_SIZE];
+  const int watts            = telemetry.addField("watts");
+  const int targetWatts      = telemetry.addField("targetWatts");
+  const int simWatts         = telemetry.addField("simWatts", TelemetryDelta::BOOL);
+  const int hr               = telemetry.addField("hr");
+  const int simHr            = telemetry.addField("simHr", TelemetryDelta::BOOL);
+  const int cad              = telemetry.addField("cad");
+  const int simCad           = telemetry.addField("simCad", TelemetryDelta::BOOL);
+  const int resistance       = telemetry.addField("resistance");
+  const int targetResistance = telemetry.addField("targetResistance");
+  const int targetIncline    = telemetry.addField("targetIncline", TelemetryDelta::FLOAT);
+  const int currentIncline   = telemetry.addField("currentIncline", TelemetryDelta::FLOAT);
+  const int speed            = telemetry.addField("speed", TelemetryDelta::FLOAT);
+  const int simTargetWatts   = telemetry.addField("simTargetWatts", TelemetryDelta::BOOL);
+  const int FTMSMode         = telemetry.addField("FTMSMode");
+  const int shifterPosition  = telemetry.addField("shifterPosition");
+  const int minStep          = telemetry.addField("minStep");
+  const int maxStep          = telemetry.addField("maxStep");
+  const int minResistance    = telemetry.addField("minResistance");
+  const int maxResistance    = telemetry.addField("maxResistance");
+
+  for (;;) {
+    vTaskDelay(userConfig.getTelemetryInterval() / portTICK_RATE_MS);
+    if (events.count() == 0) {
+      continue;
+    }
+    if (telemetryClientJoined) {
+      telemetryClientJoined = false;
+      telemetry.requestKeyframe();
+    }
+    telemetry.set(watts, rtConfig.watts.getValue());
+    telemetry.set(targetWatts, rtConfig.watts.getTarget());
+    telemetry.set(simWatts, rtConfig.watts.getSimulate());
+    telemetry.set(hr, rtConfig.hr.getValue());
+    telemetry.set(simHr, rtConfig.hr.getSimulate());
+    telemetry.set(cad, rtConfig.cad.getValue());
+    telemetry.set(simCad, rtConfig.cad.getSimulate());
+    telemetry.set(resistance, rtConfig.resistance.getValue());
+    telemetry.set(targetResistance, rtConfig.resistance.getTarget());
+    telemetry.set(targetIncline, rtConfig.getTargetIncline());
+    telemetry.set(currentIncline, rtConfig.getCurrentIncline());
+    telemetry.set(speed, rtConfig.getSimulatedSpeed());
+    telemetry.set(simTargetWatts, rtConfig.getSimTargetWatts());
+    telemetry.set(FTMSMode, rtConfig.getFTMSMode());
+    telemetry.set(shifterPosition, rtConfig.getShifterPosition());
+    telemetry.set(minStep, rtConfig.getMinStep());
+    telemetry.set(maxStep, rtConfig.getMaxStep());
+    telemetry.set(minResistance, rtConfig.getMinResistance());
+    telemetry.set(maxResistance, rtConfig.getMaxResistance());
+    if (telemetry.serialize(frame, sizeof(frame), millis()) > 0) {
+      events.send(frame, "telemetry", millis());
+    }
+#ifdef DEBUG_STACK
+    Serial.printf("Telemetry: %d \n", uxTaskGetStackHighWaterMark(telemetryTask));
+#endif  // DEBUG_STACK
+  }
+}
+
+// Registered with onDisconnect() so the response reaches the browser before we go down.
+void HTTP_Server::restartAfterResponse() {
+  userConfig.savePending(true);
+  userPWC.savePending(true);
+  vTaskDelay(100 / portTICK_PERIOD_MS);
+  ESP.restart();
+}
+
+// Read once, so known assets are served without probing the filesystem.
+void HTTP_Server::loadAssetManifest() {
+  assetManifest.clear();
+  File file = LittleFS.open(ASSET_MANIFEST_FILENAME, FILE_READ);
+  if (!file) {
+    SS2K_LOG(HTTP_SERVER_LOG_TAG, "No asset manifest, serving files without caching");
+    return;
+  }
+  String text = file.readString();
+  file.close();
+  SS2K_LOG(HTTP_SERVER_LOG_TAG, "Loaded %d assets from %s", assetManifest.load(text.c_str(), text.length()), ASSET_MANIFEST_FILENAME);
+}
+
+// Serve a file listed in the asset manifest with its ETag, or a 304 if the browser has it.
+bool HTTP_Server::serveAsset(AsyncWebServerRequest *request, const String &path) {
+  AssetManifest::Entry asset;
+  if (!assetManifest.find(path.c_str(), &asset)) {
+    return false;
+  }
+  const char *cacheControl = strcmp(asset.mime, "text/html") == 0 ? "no-cache" : ASSET_CACHE_CONTROL;
+  if (request->hasHeader("If-None-Match") && AssetManifest::etagMatches(request->header("If-None-Match").c_str(), asset.etag)) {
+    AsyncWebServerResponse *response = request->beginResponse(304);
+    response->addHeader("ETag", asset.etag);
+    response->addHeader("Cache-Control", cacheControl);
+    request->send(response);
+    return true;
+  }
+  File file = LittleFS.open(asset.gzip && !path.endsWith(".gz") ? path + ".gz" : path, FILE_READ);
+  if (!file) {
+    return false;
+  }
+  AsyncWebServerResponse *response = request->beginResponse(file, path, asset.mime);
+  if (asset.gzip) {
+    response->addHeader("Content-Encoding", "gzip");
+  }
+  response->addHeader("ETag", asset.etag);
+  response->addHeader("Cache-Control", cacheControl);
+  request->send(response);
+  return true;
+}
+
+void HTTP_Server::handleIndexFile(AsyncWebServerRequest *request) {
   String filename = "/index.html";
+  if (serveAsset(request, filename)) {
+    return;
+  }
   if (LittleFS.exists(filename)) {
-    File file = LittleFS.open(filename, FILE_READ);
-    server.streamFile(file, "text/html");
-    file.close();
+    request->send(LittleFS, filename, "text/html");
     SS2K_LOG(HTTP_SERVER_LOG_TAG, "Served %s", filename.c_str());
   } else {
     SS2K_LOG(HTTP_SERVER_LOG_TAG, "%s not found. Sending builtin Index.html", filename.c_str());
-    server.send(200, "text/html", noIndexHTML);
+    request->send(200, "text/html", noIndexHTML);
   }
 }
 
-void HTTP_Server::handleLittleFSFile() {
-  String filename = server.uri();
-  int dotPosition = filename.lastIndexOf(".");
-  String fileType = filename.substring((dotPosition + 1), filename.length());
+// Files are sent in chunks from the AsyncTCP task as the client acknowledges them,
+// so several downloads (and the JSON polling) are served side by side.
+void HTTP_Server::handleLittleFSFile(AsyncWebServerRequest *request) {
+  String filename = request->url();
+  if (serveAsset(request, filename)) {
+    return;
+  }
   if (LittleFS.exists(filename)) {
-    File file = LittleFS.open(filename, FILE_READ);
-    if (fileType == "gz") {
-      fileType = "html";  // no need to change content type as it's done automatically by .streamfile below VV
+    AsyncWebServerResponse *response;
+    if (filename.endsWith(".gz")) {
+      // Precompressed asset, the content type is the one of the file inside.
+      String contentType = filename.endsWith(".js.gz") ? "application/javascript" : filename.endsWith(".css.gz") ? "text/css" : "text/html";
+      response           = request->beginResponse(LittleFS, filename, contentType);
+      response->addHeader("Content-Encoding", "gzip");
+    } else {
+      response = request->beginResponse(LittleFS, filename);
     }
-    server.streamFile(file, "text/" + fileType);
-    file.close();
+    request->send(response);
     SS2K_LOG(HTTP_SERVER_LOG_TAG, "Served %s", filename.c_str());
   } else if (!LittleFS.exists("/index.html")) {
     SS2K_LOG(HTTP_SERVER_LOG_TAG, "%s not found and no filesystem. Sending builtin index.html", filename.c_str());
-    handleIndexFile();
+    handleIndexFile(request);
   } else {
     SS2K_LOG(HTTP_SERVER_LOG_TAG, "%s not found. Sending 404.", filename.c_str());
     String outputhtml = "<html><body><h1>ERROR 404 <br> FILE NOT FOUND!" + filename + "</h1></body></html>";
-    server.send(404, "text/html", outputhtml);
+    request->send(404, "text/html", outputhtml);
+  }
+}
+
+// Called for every chunk of an upload to /update, before handleUploadComplete().
+void HTTP_Server::handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) {
+  if (index == 0) {
+    uploadFilename = filename;
+  }
+  if (filename == "firmware.bin" || filename == "littlefs.bin") {
+    int command = filename == "firmware.bin" ? U_FLASH : U_SPIFFS;
+    if (index == 0) {
+      SS2K_LOG(HTTP_SERVER_LOG_TAG, "Update: %s", filename.c_str());
+      if (!Update.begin(UPDATE_SIZE_UNKNOWN, command)) {  // start with max available size
+        Update.printError(Serial);
+      }
+    }
+    /* flashing firmware to ESP*/
+    if (Update.write(data, len) != len) {
+      Update.printError(Serial);
+    }
+    if (final && !Update.end(true)) {  // true to set the size to the current progress
+      Update.printError(Serial);
+    }
+  } else {
+    if (index == 0) {
+      String path = filename.startsWith("/") ? filename : "/" + filename;
+      SS2K_LOG(HTTP_SERVER_LOG_TAG, "handleFileUpload Name: %s", path.c_str());
+      // The manifest no longer describes this file.
+      assetManifest.remove(path.c_str());
+      if (path.endsWith(".gz")) {
+        assetManifest.remove(path.substring(0, path.length() - 3).c_str());
+      }
+      fsUploadFile = LittleFS.open(path, "w");
+    }
+    if (fsUploadFile) {
+      fsUploadFile.write(data, len);
+    }
+    if (final) {
+      if (fsUploadFile) {
+        fsUploadFile.close();
+      }
+      SS2K_LOG(HTTP_SERVER_LOG_TAG, "handleFileUpload Size: %zu", index + len);
+    }
   }
 }
 
-void HTTP_Server::settingsProcessor() {
+void HTTP_Server::handleUploadComplete(AsyncWebServerRequest *request) {
+  if (uploadFilename == "firmware.bin" || uploadFilename == "littlefs.bin") {
+    if (Update.hasError() || !Update.isFinished()) {
+      request->send(200, "text/plain", "FAIL");
+      return;
+    }
+    if (uploadFilename == "littlefs.bin") {
+      userConfig.saveToLittleFS();
+      userPWC.saveToLittleFS();
+      request->send(200, "text/plain", "Littlefs Uploaded Successfully. Rebooting...");
+    } else {
+      request->send(200, "text/plain", "Firmware Uploaded Successfully. Rebooting...");
+    }
+    request->onDisconnect(restartAfterResponse);
+  } else if (!uploadFilename.isEmpty()) {
+    // Settings load from the binary records, so an uploaded JSON backup has to be imported.
+    String path = uploadFilename.startsWith("/") ? uploadFilename : "/" + uploadFilename;
+    if (path == configFILENAME) {
+      userConfig.importFromLittleFS();
+    } else if (path == userPWCFILENAME) {
+      userPWC.importFromLittleFS();
+    }
+    request->send(200, "text/plain", String(uploadFilename + " Uploaded Successfully."));
+  } else {
+    request->send(200, "text/plain", "FAIL");
+  }
+  uploadFilename = String();
+}
+
+void HTTP_Server::settingsProcessor(AsyncWebServerRequest *request) {
   String tString;
   bool wasBTUpdate       = false;
   bool wasSettingsUpdate = false;
   bool reboot            = false;
-  if (!server.arg("ssid").isEmpty()) {
-    tString = server.arg("ssid");
+  if (!request->arg("ssid").isEmpty()) {
+    tString = request->arg("ssid");
     tString.trim();
-    userConfig.setSsid(tString);
+    userConfig.setSsid(tString.c_str());
   }
-  if (!server.arg("password").isEmpty()) {
-    tString = server.arg("password");
+  if (!request->arg("password").isEmpty()) {
+    tString = request->arg("password");
     tString.trim();
-    userConfig.setPassword(tString);
+    userConfig.setPassword(tString.c_str());
   }
-  if (!server.arg("deviceName").isEmpty()) {
-    tString = server.arg("deviceName");
+  if (!request->arg("deviceName").isEmpty()) {
+    tString = request->arg("deviceName");
     tString.trim();
     userConfig.setDeviceName(tString);
   }
-  if (!server.arg("shiftStep").isEmpty()) {
-    uint64_t shiftStep = server.arg("shiftStep").toInt();
+  if (!request->arg("shiftStep").isEmpty()) {
+    uint64_t shiftStep = request->arg("shiftStep").toInt();
     if (shiftStep >= 50 && shiftStep <= 6000) {
       userConfig.setShiftStep(shiftStep);
     }
     wasSettingsUpdate = true;
   }
-  if (!server.arg("stepperPower").isEmpty()) {
-    uint64_t stepperPower = server.arg("stepperPower").toInt();
+  if (!request->arg("stepperPower").isEmpty()) {
+    uint64_t stepperPower = request->arg("stepperPower").toInt();
     if (stepperPower >= 500 && stepperPower <= 2000) {
       userConfig.setStepperPower(stepperPower);
       ss2k.updateStepperPower();
     }
   }
-  if (!server.arg("maxWatts").isEmpty()) {
-    uint64_t maxWatts = server.arg("maxWatts").toInt();
+  if (!request->arg("maxWatts").isEmpty()) {
+    uint64_t maxWatts = request->arg("maxWatts").toInt();
     if (maxWatts >= 0 && maxWatts <= 2000) {
       userConfig.setMaxWatts(maxWatts);
     }
   }
-  if (!server.arg("minWatts").isEmpty()) {
-    uint64_t minWatts = server.arg("minWatts").toInt();
+  if (!request->arg("minWatts").isEmpty()) {
+    uint64_t minWatts = request->arg("minWatts").toInt();
     if (minWatts >= 0 && minWatts <= 200) {
       userConfig.setMinWatts(minWatts);
     }
   }
-  if (!server.arg("ERGSensitivity").isEmpty()) {
-    float ERGSensitivity = server.arg("ERGSensitivity").toFloat();
+  if (!request->arg("ERGSensitivity").isEmpty()) {
+    float ERGSensitivity = request->arg("ERGSensitivity").toFloat();
     if (ERGSensitivity >= .5 && ERGSensitivity <= 20) {
       userConfig.setERGSensitivity(ERGSensitivity);
     }
   }
   // checkboxes don't report off, so need to check using another parameter
   // that's always present on that page
-  if (!server.arg("autoUpdate").isEmpty()) {
+  if (!request->arg("autoUpdate").isEmpty()) {
     userConfig.setAutoUpdate(true);
   } else if (wasSettingsUpdate) {
     userConfig.setAutoUpdate(false);
   }
-  if (!server.arg("stepperDir").isEmpty()) {
+  if (!request->arg("stepperDir").isEmpty()) {
     userConfig.setStepperDir(true);
   } else if (wasSettingsUpdate) {
     userConfig.setStepperDir(false);
   }
-  if (!server.arg("shifterDir").isEmpty()) {
+  if (!request->arg("shifterDir").isEmpty()) {
     userConfig.setShifterDir(true);
   } else if (wasSettingsUpdate) {
     userConfig.setShifterDir(false);
   }
-  if (!server.arg("udpLogEnabled").isEmpty()) {
+  if (!request->arg("udpLogEnabled").isEmpty()) {
     userConfig.setUdpLogEnabled(true);
   } else if (wasSettingsUpdate) {
     userConfig.setUdpLogEnabled(false);
   }
-  if (!server.arg("logComm").isEmpty()) {
+  if (!request->arg("logComm").isEmpty()) {
     userConfig.setLogComm(true);
   } else if (wasSettingsUpdate) {
     userConfig.setLogComm(false);
   }
-  if (!server.arg("stealthChop").isEmpty()) {
+  if (!request->arg("stealthChop").isEmpty()) {
     userConfig.setStealthChop(true);
     ss2k.updateStealthChop();
   } else if (wasSettingsUpdate) {
     userConfig.setStealthChop(false);
     ss2k.updateStealthChop();
   }
-  if (!server.arg("inclineMultiplier").isEmpty()) {
-    float inclineMultiplier = server.arg("inclineMultiplier").toFloat();
+  if (!request->arg("inclineMultiplier").isEmpty()) {
+    float inclineMultiplier = request->arg("inclineMultiplier").toFloat();
     if (inclineMultiplier >= 1 && inclineMultiplier <= 10) {
       userConfig.setInclineMultiplier(inclineMultiplier);
     }
   }
-  if (!server.arg("powerCorrectionFactor").isEmpty()) {
-    float powerCorrectionFactor = server.arg("powerCorrectionFactor").toFloat();
+  if (!request->arg("powerCorrectionFactor").isEmpty()) {
+    float powerCorrectionFactor = request->arg("powerCorrectionFactor").toFloat();
     if (powerCorrectionFactor >= MIN_PCF && powerCorrectionFactor <= MAX_PCF) {
       userConfig.setPowerCorrectionFactor(powerCorrectionFactor);
     }
   }
-  if (!server.arg("blePMDropdown").isEmpty()) {
+  if (!request->arg("blePMDropdown").isEmpty()) {
     wasBTUpdate = true;
-    if (server.arg("blePMDropdown")) {
-      tString = server.arg("blePMDropdown");
+    if (request->arg("blePMDropdown")) {
+      tString = request->arg("blePMDropdown");
       if (tString != userConfig.getConnectedPowerMeter()) {
-        userConfig.setConnectedPowerMeter(tString);
+        userConfig.setConnectedPowerMeter(tString.c_str());
         reboot = true;
       }
     } else {
       userConfig.setConnectedPowerMeter("any");
     }
   }
-  if (!server.arg("bleHRDropdown").isEmpty()) {
+  if (!request->arg("bleHRDropdown").isEmpty()) {
     wasBTUpdate = true;
-    if (server.arg("bleHRDropdown")) {
+    if (request->arg("bleHRDropdown")) {
       bool reset = false;
-      tString    = server.arg("bleHRDropdown");
+      tString    = request->arg("bleHRDropdown");
       if (tString != userConfig.getConnectedHeartMonitor()) {
         reboot = true;
       }
-      userConfig.setConnectedHeartMonitor(server.arg("bleHRDropdown"));
+      userConfig.setConnectedHeartMonitor(tString.c_str());
     } else {
       userConfig.setConnectedHeartMonitor("any");
     }
   }
-  if (!server.arg("bleRemoteDropdown").isEmpty()) {
+  if (!request->arg("bleRemoteDropdown").isEmpty()) {
     wasBTUpdate = true;
-    if (server.arg("bleRemoteDropdown")) {
+    if (request->arg("bleRemoteDropdown")) {
       bool reset = false;
-      tString    = server.arg("bleRemoteDropdown");
+      tString    = request->arg("bleRemoteDropdown");
       if (tString != userConfig.getConnectedRemote()) {
         reboot = true;
       }
-      userConfig.setConnectedRemote(server.arg("bleRemoteDropdown"));
+      userConfig.setConnectedRemote(tString.c_str());
     } else {
       userConfig.setConnectedRemote("any");
     }
   }
-  if (!server.arg("session1HR").isEmpty()) {  // Needs checking for unrealistic numbers.
-    userPWC.session1HR = server.arg("session1HR").toInt();
+  if (!request->arg("telemetryInterval").isEmpty()) {
+    int telemetryInterval = request->arg("telemetryInterval").toInt();
+    if (telemetryInterval >= MIN_TELEMETRY_INTERVAL && telemetryInterval <= MAX_TELEMETRY_INTERVAL) {
+      userConfig.setTelemetryInterval(telemetryInterval);
+    }
   }
-  if (!server.arg("session1Pwr").isEmpty()) {
-    userPWC.session1Pwr = server.arg("session1Pwr").toInt();
+  if (!request->arg("updateCheckInterval").isEmpty()) {
+    int updateCheckInterval = request->arg("updateCheckInterval").toInt();
+    if (updateCheckInterval >= MIN_UPDATE_CHECK_INTERVAL && updateCheckInterval <= MAX_UPDATE_CHECK_INTERVAL) {
+      userConfig.setUpdateCheckInterval(updateCheckInterval);
+    }
   }
-  if (!server.arg("session2HR").isEmpty()) {
-    userPWC.session2HR = server.arg("session2HR").toInt();
+  if (!request->arg("remoteKeyMap").isEmpty()) {
+    tString = request->arg("remoteKeyMap");
+    tString.trim();
+    userConfig.setRemoteKeyMap(tString);
+    spinBLEClient.updateRemoteKeyMap();
   }
-  if (!server.arg("session2Pwr").isEmpty()) {
-    userPWC.session2Pwr = server.arg("session2Pwr").toInt();
+  HRPowerPoint oldSessions[HR_POWER_MAX_POINTS];
+  userPWC.getSessions(oldSessions, HR_POWER_MAX_POINTS);
+  if (!request->arg("session1HR").isEmpty()) {  // Needs checking for unrealistic numbers.
+    userPWC.session1HR = request->arg("session1HR").toInt();
+  }
+  if (!request->arg("session1Pwr").isEmpty()) {
+    userPWC.session1Pwr = request->arg("session1Pwr").toInt();
+  }
+  if (!request->arg("session2HR").isEmpty()) {
+    userPWC.session2HR = request->arg("session2HR").toInt();
+  }
+  for (size_t i = 0; i < HR_POWER_MAX_POINTS - 2; i++) {
+    String session = "session" + String(i + 3);
+    if (!request->arg(session + "HR").isEmpty()) {
+      userPWC.extraSessions[i].hr = request->arg(session + "HR").toInt();
+    }
+    if (!request->arg(session + "Pwr").isEmpty()) {
+      userPWC.extraSessions[i].watts = request->arg(session + "Pwr").toInt();
+    }
+  }
+  if (!request->arg("session2Pwr").isEmpty()) {
+    userPWC.session2Pwr = request->arg("session2Pwr").toInt();
 
-    if (!server.arg("hr2Pwr").isEmpty()) {
+    if (!request->arg("hr2Pwr").isEmpty()) {
       userPWC.hr2Pwr = true;
     } else {
       userPWC.hr2Pwr = false;
     }
   }
+  // Sessions the rider typed in seed the automatic calibration, unchanged examples don't.
+  HRPowerPoint newSessions[HR_POWER_MAX_POINTS];
+  userPWC.getSessions(newSessions, HR_POWER_MAX_POINTS);
+  for (size_t i = 0; i < HR_POWER_MAX_POINTS; i++) {
+    if (newSessions[i].hr != oldSessions[i].hr || newSessions[i].watts != oldSessions[i].watts) {
+      userPWC.sessionsMeasured = true;
+    }
+  }
   String response = "<!DOCTYPE html><html><body><h2>";
 
   if (wasBTUpdate) {  // Special BT page update response
@@ -630,47 +883,230 @@ void HTTP_Server::settingsProcessor() {
         myIP.toString() + "/index.html';\",1000);</script></html>";
   }
   SS2K_LOG(HTTP_SERVER_LOG_TAG, "Config Updated From Web");
-  userConfig.saveToLittleFS();
-  userConfig.printFile();
-  userPWC.saveToLittleFS();
-  userPWC.printFile();
+  userConfig.requestSave();
+  userPWC.requestSave();
   if (reboot) {
     response +=
         "Please wait while your settings are saved and SmartSpin2k reboots.</h2></body><script> "
         "setTimeout(\"location.href = 'http://" +
         myIP.toString() + "/bluetoothscanner.html';\",5000);</script></html>";
-    server.send(200, "text/html", response);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    ESP.restart();
+    request->onDisconnect(restartAfterResponse);
   }
-  server.send(200, "text/html", response);
+  request->send(200, "text/html", response);
 }
 
 void HTTP_Server::stop() {
   SS2K_LOG(HTTP_SERVER_LOG_TAG, "Stopping Http Server");
-  server.stop();
-  server.close();
+  server.end();
+  // reset() deletes every handler, events is static and telemetryUpdate() keeps using it.
+  events.close();
+  server.removeHandler(&events);
+  server.reset();  // start() registers the handlers again
 }
 
 // github fingerprint
 // 70:94:DE:DD:E6:C4:69:48:3A:92:70:A1:48:56:78:2D:18:64:E0:B7
 
+// Downloads files below DATA_UPDATEURL, with a Range header to resume.
+class HttpUpdateSource : public UpdateSource {
+ public:
+  long open(const char *path, size_t offset) override {
+    http.begin(DATA_UPDATEURL + String(path), rootCACertificate);
+    if (offset > 0) {
+      http.addHeader("Range", "bytes=" + String(offset) + "-");
+    }
+    int httpCode = http.GET();
+    if (httpCode != HTTP_CODE_OK && httpCode != HTTP_CODE_PARTIAL_CONTENT) {
+      SS2K_LOG(HTTP_SERVER_LOG_TAG, "Error downloading %s %d", path, httpCode);
+      return -1;
+    }
+    stream    = http.getStreamPtr();
+    remaining = http.getSize();  // -1 if the server didn't say
+    return httpCode == HTTP_CODE_PARTIAL_CONTENT ? offset : 0;
+  }
+
+  int read(uint8_t *buffer, size_t length) override {
+    if (remaining == 0) {
+      return 0;
+    }
+    unsigned long start = millis();
+    while (stream->available() == 0) {
+      if (!http.connected()) {
+        return remaining < 0 ? 0 : -1;
+      }
+      if (millis() - start > ASSET_UPDATE_READ_TIMEOUT) {
+        return -1;
+      }
+      vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+    size_t available = stream->available();
+    int read         = stream->readBytes(buffer, length < available ? length : available);
+    if (remaining > 0) {
+      remaining -= read;
+    }
+    return read;
+  }
+
+  void close() override { http.end(); }
+
+ private:
+  HTTPClient http;
+  WiFiClient *stream = nullptr;
+  int remaining      = 0;
+};
+
+// Keeps the file being downloaded open between chunks.
+class LittleFSUpdateStore : public UpdateStore {
+ public:
+  ~LittleFSUpdateStore() { closeAppend(); }
+
+  long size(const char *path) override {
+    closeAppend(path);
+    File file = LittleFS.open(path, FILE_READ);
+    if (!file) {
+      return -1;
+    }
+    long size = file.size();
+    file.close();
+    return size;
+  }
+
+  int read(const char *path, size_t offset, uint8_t *buffer, size_t length) override {
+    closeAppend(path);
+    File file = LittleFS.open(path, FILE_READ);
+    if (!file || !file.seek(offset)) {
+      return -1;
+    }
+    int read = file.read(buffer, length);
+    file.close();
+    return read;
+  }
+
+  bool append(const char *path, const uint8_t *data, size_t length) override {
+    if (!appendFile || appendPath != path) {
+      closeAppend();
+      appendFile = LittleFS.open(path, FILE_APPEND, true);
+      appendPath = path;
+    }
+    return appendFile && appendFile.write(data, length) == length;
+  }
+
+  bool rename(const char *from, const char *to) override {
+    closeAppend(from);
+    closeAppend(to);
+    if (LittleFS.rename(from, to)) {
+      return true;
+    }
+    LittleFS.remove(to);
+    return LittleFS.rename(from, to);
+  }
+
+  void remove(const char *path) override {
+    closeAppend(path);
+    LittleFS.remove(path);
+  }
+
+ private:
+  File appendFile;
+  String appendPath;
+
+  // Close the open file, only if it is path when one is given.
+  void closeAppend(const char *path = nullptr) {
+    if (appendFile && (path == nullptr || appendPath == path)) {
+      appendFile.close();
+      appendPath = String();
+    }
+  }
+};
+
+// Brings the data files up to date with the manifest on the server.
+// Returns DONE, or the step it failed in: MANIFEST if the server has no manifest.
+static AssetUpdater::State updateAssets() {
+  HttpUpdateSource source;
+  LittleFSUpdateStore store;
+  std::unique_ptr<AssetUpdater> updater(new AssetUpdater(source, store));
+  updater->begin(ASSET_MANIFEST_FILENAME);
+  while (updater->step()) {
+    vTaskDelay(1);  // let everything else run between chunks
+  }
+  SS2K_LOG(HTTP_SERVER_LOG_TAG, "Asset update %s: %d of %d changed files, %d bytes", updater->getState() == AssetUpdater::DONE ? "done" : "failed",
+           (int)updater->getFilesUpdated(), (int)updater->getFilesChanged(), (int)updater->getBytesDownloaded());
+  return updater->getState() == AssetUpdater::DONE ? AssetUpdater::DONE : updater->getFailedStep();
+}
+
+// Loads the result of the last version check, empty if there is none.
+static void loadUpdateCheck(UpdateCheck *check) {
+  uint8_t record[UPDATE_CHECK_RECORD_SIZE];
+  File file = LittleFS.open(UPDATE_CHECK_FILENAME, FILE_READ);
+  if (!file) {
+    check->clear();
+    return;
+  }
+  size_t length = file.read(record, sizeof(record));
+  file.close();
+  if (!check->read(record, length)) {
+    SS2K_LOG(HTTP_SERVER_LOG_TAG, "%s is not valid, checking for updates", UPDATE_CHECK_FILENAME);
+  }
+}
+
+// A lost write only costs an extra check at the next boot, so no temporary file.
+static void saveUpdateCheck(const UpdateCheck &check) {
+  uint8_t record[UPDATE_CHECK_RECORD_SIZE];
+  size_t length = check.write(record, sizeof(record));
+  File file     = LittleFS.open(UPDATE_CHECK_FILENAME, FILE_WRITE);
+  if (!file || length == 0 || file.write(record, length) != length) {
+    SS2K_LOG(HTTP_SERVER_LOG_TAG, "Failed to write %s", UPDATE_CHECK_FILENAME);
+  }
+  file.close();
+}
+
 void HTTP_Server::FirmwareUpdate() {
+  static const Version currentVer(FIRMWARE_VERSION);
   HTTPClient http;
   // WiFiClientSecure client;
 
+  UpdateCheck updateCheck;
+  loadUpdateCheck(&updateCheck);
+  bool updateAnyway = false;
+  if (!LittleFS.exists("/index.html")) {
+    updateAnyway = true;
+    SS2K_LOG(HTTP_SERVER_LOG_TAG, "  -index.html not found. Forcing update");
+  }
+  String versionURL  = userConfig.getFirmwareUpdateURL() + String(FW_VERSIONFILE);
+  uint32_t now       = time(nullptr);
+  uint32_t interval  = userConfig.getUpdateCheckInterval() * 3600UL;
+  bool pendingUpdate = (updateCheck.getAvailable() > currentVer) && userConfig.getAutoUpdate();
+  if (!updateAnyway && !pendingUpdate && !updateCheck.isDue(now, interval, versionURL.c_str())) {
+    SS2K_LOG(HTTP_SERVER_LOG_TAG, "Firmware checked %lu s ago, server version %s", (unsigned long)(now - updateCheck.getLastCheck()), updateCheck.getVersionText());
+    return;
+  }
+
   client.setCACert(rootCACertificate);
   SS2K_LOG(HTTP_SERVER_LOG_TAG, "Checking for newer firmware:");
-  http.begin(userConfig.getFirmwareUpdateURL() + String(FW_VERSIONFILE),
-             rootCACertificate);  // check version URL
+  http.begin(versionURL, rootCACertificate);  // check version URL
+  // Ask for the file only if it changed since the last check.
+  if (updateCheck.hasVersion() && updateCheck.isFrom(versionURL.c_str())) {
+    if (updateCheck.getETag()[0] != '\0') {
+      http.addHeader("If-None-Match", updateCheck.getETag());
+    }
+    if (updateCheck.getLastModified()[0] != '\0') {
+      http.addHeader("If-Modified-Since", updateCheck.getLastModified());
+    }
+  }
+  const char *validators[] = {"ETag", "Last-Modified"};
+  http.collectHeaders(validators, 2);
   delay(100);
   int httpCode = http.GET();  // get data from version file
   delay(100);
-  String payload;
   if (httpCode == HTTP_CODE_OK) {  // if version received
-    payload = http.getString();    // save received version
+    String payload = http.getString();
     payload.trim();
-    SS2K_LOG(HTTP_SERVER_LOG_TAG, "  - Server version: %s", payload.c_str());
+    updateCheck.checked(now, versionURL.c_str(), payload.c_str(), http.header("ETag").c_str(), http.header("Last-Modified").c_str());
+    saveUpdateCheck(updateCheck);
+    httpServer.internetConnection = true;
+  } else if (httpCode == HTTP_CODE_NOT_MODIFIED) {
+    updateCheck.notModified(now);
+    saveUpdateCheck(updateCheck);
     httpServer.internetConnection = true;
   } else {
     SS2K_LOG(HTTP_SERVER_LOG_TAG, "error downloading %s %d", FW_VERSIONFILE, httpCode);
@@ -678,69 +1114,84 @@ void HTTP_Server::FirmwareUpdate() {
   }
 
   http.end();
-  if (httpCode == HTTP_CODE_OK) {  // if version received
-    bool updateAnyway = false;
-    if (!LittleFS.exists("/index.html")) {
-      updateAnyway = true;
-      SS2K_LOG(HTTP_SERVER_LOG_TAG, "  -index.html not found. Forcing update");
-    }
-    Version availableVer(payload.c_str());
-    Version currentVer(FIRMWARE_VERSION);
+  if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_NOT_MODIFIED) {  // if version received
+    SS2K_LOG(HTTP_SERVER_LOG_TAG, "  - Server version: %s", updateCheck.getVersionText());
+    const Version &availableVer = updateCheck.getAvailable();
 
     if (((availableVer > currentVer) && (userConfig.getAutoUpdate())) || (updateAnyway)) {
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "New firmware detected!");
-      SS2K_LOG(HTTP_SERVER_LOG_TAG, "Upgrading from %s to %s", FIRMWARE_VERSION, payload.c_str());
+      SS2K_LOG(HTTP_SERVER_LOG_TAG, "Upgrading from %s to %s", FIRMWARE_VERSION, updateCheck.getVersionText());
 
       //////////////// Update LittleFS//////////////
       SS2K_LOG(HTTP_SERVER_LOG_TAG, "Updating FileSystem");
-      http.begin(DATA_UPDATEURL + String(DATA_FILELIST),
-                 rootCACertificate);  // check version URL
-      vTaskDelay(100 / portTICK_PERIOD_MS);
-      httpCode = http.GET();  // get data from version file
-      vTaskDelay(100 / portTICK_PERIOD_MS);
-      StaticJsonDocument<500> doc;
-      if (httpCode == HTTP_CODE_OK) {  // if version received
-        String payload;
-        payload = http.getString();  // save received version
-        payload.trim();
-        // Deserialize the JSON document
-        DeserializationError error = deserializeJson(doc, payload);
-        if (error) {
-          SS2K_LOG(HTTP_SERVER_LOG_TAG, "Failed to read file list");
-          return;
-        }
-        httpServer.internetConnection = true;
-      } else {
-        SS2K_LOG(HTTP_SERVER_LOG_TAG, "error downloading %s %d", DATA_FILELIST, httpCode);
-        httpServer.internetConnection = false;
-      }
-      JsonArray files = doc.as<JsonArray>();
-      // iterate through file list and download files individually
-      for (JsonVariant v : files) {
-        String fileName = "/" + v.as<String>();
-        http.begin(DATA_UPDATEURL + fileName,
+      AssetUpdater::State assets = updateAssets();
+      if (assets == AssetUpdater::FILES) {
+        // The .part files and the local manifest stay for the next run to resume from.
+        SS2K_LOG(HTTP_SERVER_LOG_TAG, "Asset update interrupted, resuming next time");
+      } else if (assets != AssetUpdater::DONE) {
+        // No manifest on the server, download everything in list.json.
+        http.begin(DATA_UPDATEURL + String(DATA_FILELIST),
                    rootCACertificate);  // check version URL
         vTaskDelay(100 / portTICK_PERIOD_MS);
-        httpCode = http.GET();
+        httpCode = http.GET();  // get data from version file
         vTaskDelay(100 / portTICK_PERIOD_MS);
-        if (httpCode == HTTP_CODE_OK) {
-          String payload;
-          payload = http.getString();
-          payload.trim();
-          LittleFS.remove(fileName);
-          File file = LittleFS.open(fileName, FILE_WRITE, true);
-          if (!file) {
-            SS2K_LOG(HTTP_SERVER_LOG_TAG, "Failed to create file, %s", fileName);
+        StaticJsonDocument<500> doc;
+        if (httpCode == HTTP_CODE_OK) {  // if file list received
+          String fileList = http.getString();
+          fileList.trim();
+          // Deserialize the JSON document
+          DeserializationError error = deserializeJson(doc, fileList);
+          if (error) {
+            SS2K_LOG(HTTP_SERVER_LOG_TAG, "Failed to read file list");
             return;
           }
-          file.print(payload);
-          file.close();
-          SS2K_LOG(HTTP_SERVER_LOG_TAG, "Created: %s", fileName);
           httpServer.internetConnection = true;
         } else {
-          SS2K_LOG(HTTP_SERVER_LOG_TAG, "Error downloading %s %d", fileName, httpCode);
+          SS2K_LOG(HTTP_SERVER_LOG_TAG, "error downloading %s %d", DATA_FILELIST, httpCode);
           httpServer.internetConnection = false;
         }
+        http.end();
+        JsonArray files  = doc.as<JsonArray>();
+        int filesWritten = 0;
+        // iterate through file list and stream the files to LittleFS one by one
+        for (JsonVariant v : files) {
+          String fileName = "/" + v.as<String>();
+          String partName = fileName + ASSET_UPDATE_PART_SUFFIX;
+          http.begin(DATA_UPDATEURL + fileName,
+                     rootCACertificate);  // check version URL
+          vTaskDelay(100 / portTICK_PERIOD_MS);
+          httpCode = http.GET();
+          vTaskDelay(100 / portTICK_PERIOD_MS);
+          if (httpCode == HTTP_CODE_OK) {
+            File file = LittleFS.open(partName, FILE_WRITE, true);
+            if (!file) {
+              SS2K_LOG(HTTP_SERVER_LOG_TAG, "Failed to create file, %s", partName.c_str());
+              http.end();
+              return;
+            }
+            int written = http.writeToStream(&file);
+            file.close();
+            if (written > 0) {
+              LittleFS.remove(fileName);
+              LittleFS.rename(partName, fileName);
+              filesWritten++;
+              SS2K_LOG(HTTP_SERVER_LOG_TAG, "Created: %s", fileName.c_str());
+            } else {
+              LittleFS.remove(partName);
+              SS2K_LOG(HTTP_SERVER_LOG_TAG, "Error writing %s %d", fileName.c_str(), written);
+            }
+            httpServer.internetConnection = true;
+          } else {
+            SS2K_LOG(HTTP_SERVER_LOG_TAG, "Error downloading %s %d", fileName.c_str(), httpCode);
+            httpServer.internetConnection = false;
+          }
+          http.end();
+        }
+
+        // The downloaded files don't match the manifest built with littlefs.bin anymore.
+        if (filesWritten > 0) {
+          LittleFS.remove(ASSET_MANIFEST_FILENAME);
+        }
       }
 
       //////// Update Firmware /////////
@@ -811,7 +1262,7 @@ void telegramUpdate(void *pvParameters) {
     }
 #ifdef DEBUG_STACK
     Serial.printf("Telegram: %d \n", uxTaskGetStackHighWaterMark(telegramTask));
-    Serial.printf("Web: %d \n", uxTaskGetStackHighWaterMark(webClientTask));
+    Serial.printf("Web: %d \n", uxTaskGetStackHighWaterMark(webServerTask));
     Serial.printf("Free: %d \n", ESP.getFreeHeap());
 #endif  // DEBUG_STACK
     vTaskDelay(4000 / portTICK_RATE_MS);
@@ -72,7 +72,6 @@ void FSUpgrader::loadFromSPIFFS() {
   userConfig.setPassword(doc["password"]);
   userConfig.setConnectedPowerMeter(doc["connectedPowerMeter"]);
   userConfig.setConnectedHeartMonitor(doc["connectedHeartMonitor"]);
-  userConfig.setFoundDevices(doc["foundDevices"]);
   if (doc["ERGSensitivity"]) {  // If statements to upgrade old versions of config.txt that didn't include these
     userConfig.setERGSensitivity(doc["ERGSensitivity"]);
   }
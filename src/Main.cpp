@@ -20,16 +20,32 @@
 // Stepper Motor Serial
 HardwareSerial stepperSerial(2);
 TMC2208Stepper driver(&SERIAL_PORT, R_SENSE);  // Hardware Serial
+DriverTelemetry driverTelemetry;
+ThermalController thermalController(THROTTLE_TEMP);
 
 // Peloton Serial
 HardwareSerial auxSerial(1);
-AuxSerialBuffer auxSerialBuffer;
+
+// The aux UART as the SerialPort PelotonLink talks over.
+class AuxSerialPort : public SerialPort {
+ public:
+  size_t read(uint8_t *buffer, size_t length) override { return auxSerial.read(buffer, length); }
+  size_t availableForWrite() override { return auxSerial.availableForWrite(); }
+  size_t write(const uint8_t *data, size_t length) override { return auxSerial.write(data, length); }
+};
+
+static AuxSerialPort auxSerialPort;
+QueueHandle_t pelotonFrameQueue = nullptr;
+PelotonLink pelotonLink(auxSerialPort);
 
 FastAccelStepperEngine engine = FastAccelStepperEngine();
 FastAccelStepper *stepper     = NULL;
 
 TaskHandle_t moveStepperTask;
 TaskHandle_t maintenanceLoopTask;
+TaskHandle_t networkTask;
+
+BootTimeline bootTimeline;
 
 Boards boards;
 Board currentBoard;
@@ -39,6 +55,7 @@ SS2K ss2k;
 userParameters userConfig;
 RuntimeParameters rtConfig;
 physicalWorkingCapacity userPWC;
+PWCCollector pwcCollector;
 
 ///////////// Log Appender /////////////
 UdpAppender udpAppender;
@@ -80,6 +97,26 @@ void SS2K::stopTasks() {
   }
 }
 
+void SS2K::bootPhase(const char *phase) {
+  uint32_t now     = millis();
+  uint32_t elapsed = bootTimeline.mark(phase, now);
+  SS2K_LOG(MAIN_LOG_TAG, "Boot: %s done at %lu ms (+%lu ms)", phase, (unsigned long)now, (unsigned long)elapsed);
+}
+
+// WiFi, the firmware check and the web server wait on the network, so they run here
+// once the trainer is already advertising and the stepper is ready. The firmware
+// check still goes before the web server so page loads don't compete with a download.
+void SS2K::startNetwork(void *pvParameters) {
+  startWifi();
+  bootPhase("wifi");
+  httpServer.FirmwareUpdate();
+  bootPhase("firmwareCheck");
+  httpServer.start();
+  bootPhase("webServer");
+  networkTask = NULL;
+  vTaskDelete(NULL);
+}
+
 void setup() {
   // Serial port for debugging purposes
   Serial.begin(512000);
@@ -98,12 +135,16 @@ void setup() {
   stepperSerial.begin(57600, SERIAL_8N2, currentBoard.stepperSerialRxPin, currentBoard.stepperSerialTxPin);
   // initialize aux serial port (Peloton)
   if (currentBoard.auxSerialTxPin) {
+    auxSerial.setRxBufferSize(PELOTON_RX_BUFFER_SIZE);
     auxSerial.begin(19200, SERIAL_8N1, currentBoard.auxSerialRxPin, currentBoard.auxSerialTxPin, false);  //////////////////////////////////change to false after testing!!!
     if (!auxSerial) {
       SS2K_LOG(MAIN_LOG_TAG, "Invalid Serial Pin Configuration");
     }
+    pelotonFrameQueue = xQueueCreate(PELOTON_FRAME_QUEUE_SIZE, sizeof(PelotonFramer::Frame));
     auxSerial.onReceive(SS2K::rxSerial, false);  // setup callback
   }
+  bootPhase("board");
+
   // Initialize LittleFS
   SS2K_LOG(MAIN_LOG_TAG, "Mounting Filesystem");
   if (!LittleFS.begin(false)) {
@@ -116,19 +157,14 @@ void setup() {
 
   // Load Config
   userConfig.loadFromLittleFS();
-  userConfig.printFile();  // Print userConfig.contents to serial
-  userConfig.saveToLittleFS();
 
   // load PWC for HR to Pwr Calculation
   userPWC.loadFromLittleFS();
-  userPWC.printFile();
-  userPWC.saveToLittleFS();
-
-  // Check for firmware update. It's important that this stays before BLE &
-  // HTTP setup because otherwise they use too much traffic and the device
-  // fails to update which really sucks when it corrupts your settings.
-  startWifi();
-  httpServer.FirmwareUpdate();
+  if (userPWC.sessionsMeasured) {  // the setDefaults() examples aren't the rider's
+    HRPowerPoint sessions[HR_POWER_MAX_POINTS];
+    pwcCollector.seed(sessions, userPWC.getSessions(sessions, HR_POWER_MAX_POINTS));
+  }
+  bootPhase("config");
 
   pinMode(currentBoard.shiftUpPin, INPUT_PULLUP);    // Push-Button with input Pullup
   pinMode(currentBoard.shiftDownPin, INPUT_PULLUP);  // Push-Button with input Pullup
@@ -155,6 +191,7 @@ void setup() {
                           18,                    /* priority of the task */
                           &moveStepperTask,      /* Task handle to keep track of created task */
                           0);                    /* pin task to core */
+  bootPhase("stepper");
 
   digitalWrite(LED_PIN, HIGH);
 
@@ -163,8 +200,9 @@ void setup() {
   logHandler.addAppender(&udpAppender);
   logHandler.initialize();
 
+  // BLE goes first so apps can see the trainer without waiting on WiFi.
   ss2k.startTasks();
-  httpServer.start();
+  bootPhase("ble");
 
   ss2k.resetIfShiftersHeld();
   SS2K_LOG(MAIN_LOG_TAG, "Creating Shifter Interrupts");
@@ -180,6 +218,16 @@ void setup() {
                           20,                        /* priority of the task */
                           &maintenanceLoopTask,      /* Task handle to keep track of created task */
                           1);                        /* pin task to core */
+  bootPhase("tasks");
+
+  // The TLS handshake of the firmware check needs the stack loopTask used to give it.
+  xTaskCreatePinnedToCore(SS2K::startNetwork, /* Task function. */
+                          "startNetwork",     /* name of task. */
+                          8192,               /* Stack size of task */
+                          NULL,               /* parameter of the task */
+                          1,                  /* priority of the task */
+                          &networkTask,       /* Task handle to keep track of created task */
+                          1);                 /* pin task to core */
 }
 
 void loop() {  // Delete this task so we can make one that's more memory efficient.
@@ -193,7 +241,8 @@ void SS2K::maintenanceLoop(void *pvParameters) {
   static bool isScanning              = false;
 
   while (true) {
-    vTaskDelay(73 / portTICK_RATE_MS);
+    // Remote shifts notify this task so they are applied without waiting for the next pass.
+    ulTaskNotifyTake(pdTRUE, 73 / portTICK_RATE_MS);
     ss2k.FTMSModeShiftModifier();
 
     if (currentBoard.auxSerialTxPin) {
@@ -205,6 +254,9 @@ void SS2K::maintenanceLoop(void *pvParameters) {
       // ss2k.restartWifi();
       logHandler.writeLogs();
       webSocketAppender.Loop();
+      // Settings changed from the web or BLE are written once they settle.
+      userConfig.savePending();
+      userPWC.savePending();
       intervalTimer = millis();
     }
 
@@ -221,6 +273,7 @@ void SS2K::maintenanceLoop(void *pvParameters) {
       intervalTimer2 = millis();
     }
     if (loopCounter > 10) {
+      ss2k.pollDriverTelemetry();
       ss2k.checkDriverTemperature();
       // ss2k.checkBLEReconnect();
       // SS2K_LOG(MAIN_LOG_TAG, "target %f  current %f", rtConfig.getTargetIncline(), rtConfig.getCurrentIncline());
@@ -436,10 +489,11 @@ void SS2K::setupTMCStepperDriver() {
 
   ss2k.updateStepperPower();
   driver.microsteps(4);  // Set microsteps to 1/8th
-  driver.irun(currentBoard.pwrScaler);
-  driver.ihold((uint8_t)(currentBoard.pwrScaler * .5));  // hold current % 0-DRIVER_MAX_PWR_SCALER
-  driver.iholddelay(10);                                 // Controls the number of clock cycles for motor
-                                                         // power down after standstill is detected
+  thermalController.setFullCurrent(currentBoard.pwrScaler);
+  driver.irun(thermalController.getRunCurrent());
+  driver.ihold(thermalController.getHoldCurrent());  // hold current % 0-DRIVER_MAX_PWR_SCALER
+  driver.iholddelay(10);                             // Controls the number of clock cycles for motor
+                                                     // power down after standstill is detected
   driver.TPOWERDOWN(128);
 
   driver.toff(5);
@@ -453,6 +507,7 @@ void SS2K::setupTMCStepperDriver() {
 void SS2K::updateStepperPower() {
   uint16_t rmsPwr = (userConfig.getStepperPower());
   driver.rms_current(rmsPwr);
+  thermalController.setFullCurrent(driver.irun());  // derating and the hold current policy apply on top
   uint16_t current = driver.cs_actual();
   SS2K_LOG(MAIN_LOG_TAG, "Stepper power is now %d.  read:cs=%U", userConfig.getStepperPower(), current);
 }
@@ -466,20 +521,64 @@ void SS2K::updateStealthChop() {
   SS2K_LOG(MAIN_LOG_TAG, "StealthChop is now %d", t_bool);
 }
 
-// Checks the driver temperature and throttles power if above threshold.
+// Reads the driver's status registers into driverTelemetry and logs faults as they come and go.
+void SS2K::pollDriverTelemetry() {
+  static DriverTelemetry::Status last = {};
+  uint32_t drvStatus                  = driver.DRV_STATUS();
+  bool failed                         = driver.CRCerror;
+  uint32_t pwmScale                   = driver.PWM_SCALE();
+  if (failed || driver.CRCerror) {
+    driverTelemetry.readFailed();
+  } else {
+    driverTelemetry.update(drvStatus, pwmScale, stepperIsRunning);
+  }
+
+  DriverTelemetry::Status status = driverTelemetry.getStatus();
+  if (status.responding != last.responding) {
+    SS2K_LOG(MAIN_LOG_TAG, "Stepper driver %s", status.responding ? "is answering" : "isn't answering. Is the power supply connected?");
+  }
+  if (status.overTempWarning && !last.overTempWarning) {
+    SS2K_LOG(MAIN_LOG_TAG, "Stepper driver over temperature warning");
+  }
+  if (status.overTemp && !last.overTemp) {
+    SS2K_LOGW(MAIN_LOG_TAG, "Stepper driver shut down from over temperature!");
+  }
+  if (status.shortCircuit && !last.shortCircuit) {
+    SS2K_LOGW(MAIN_LOG_TAG, "Stepper driver detected a short circuit!");
+  }
+  if (status.openLoad && !last.openLoad) {
+    SS2K_LOGW(MAIN_LOG_TAG, "Stepper motor open load. Check the motor cable.");
+  }
+  if (status.stalled && !last.stalled) {
+    SS2K_LOG(MAIN_LOG_TAG, "Stepper stalled at load %d", status.load);
+  }
+  if (status.slipping && !last.slipping) {
+    SS2K_LOG(MAIN_LOG_TAG, "Knob slipping? Load %d, usually %.0f", status.load, status.loadAverage);
+  }
+  last = status;
+}
+
+// Sets the driver's run and hold current from the ESP32 and driver temperatures and whether the knob is moving.
 void SS2K::checkDriverTemperature() {
-  static bool overTemp = false;
-  if (static_cast<int>(temperatureRead()) > THROTTLE_TEMP) {  // Start throttling driver power at 72C on the ESP32
-    uint8_t throttledPower = (THROTTLE_TEMP - static_cast<int>(temperatureRead())) + currentBoard.pwrScaler;
-    driver.irun(throttledPower);
-    SS2K_LOG(MAIN_LOG_TAG, "Over temp! Driver is throttling down! ESP32 @ %f C", temperatureRead());
-    overTemp = true;
-  } else if (static_cast<int>(temperatureRead()) < THROTTLE_TEMP) {
-    if (overTemp) {
-      SS2K_LOG(MAIN_LOG_TAG, "Temperature is now under control. Driver current reset.");
-      driver.irun(currentBoard.pwrScaler);
+  static int32_t lastTarget = targetPosition;
+  bool wasDerating          = thermalController.isDerating();
+  bool moving               = stepperIsRunning || targetPosition != lastTarget;
+  lastTarget                = targetPosition;
+  thermalController.update(temperatureRead(), driverTelemetry.getStatus().overTempWarning, moving, millis());
+
+  if (thermalController.isDerating() != wasDerating) {
+    if (thermalController.isDerating()) {
+      SS2K_LOG(MAIN_LOG_TAG, "Over temp! Driver is throttling down! ESP32 @ %.1f C", thermalController.getTemperature());
+    } else {
+      SS2K_LOG(MAIN_LOG_TAG, "Temperature is now under control. Driver current returning to full.");
     }
-    overTemp = false;
+  }
+  // Only written when they change, the driver keeps the values it was given.
+  if (driver.irun() != thermalController.getRunCurrent()) {
+    driver.irun(thermalController.getRunCurrent());
+  }
+  if (driver.ihold() != thermalController.getHoldCurrent()) {
+    driver.ihold(thermalController.getHoldCurrent());
   }
 }
 
@@ -491,60 +590,39 @@ void SS2K::motorStop(bool releaseTension) {
   }
 }
 
-void SS2K::txSerial() {  // Serial.printf(" Before TX ");
-  if (PELOTON_TX && (txCheck >= 1)) {
-    static int alternate = 0;
-    byte buf[4]          = {PELOTON_REQUEST, 0x00, 0x00, PELOTON_FOOTER};
-    switch (alternate) {
-      case 0:
-        buf[PELOTON_REQ_POS] = PELOTON_POW_ID;
-        alternate++;
-        break;
-      case 1:
-        buf[PELOTON_REQ_POS] = PELOTON_CAD_ID;
-        alternate++;
-        break;
-      case 2:
-        buf[PELOTON_REQ_POS] = PELOTON_RES_ID;
-        alternate            = 0;
-        txCheck--;
-        break;
-    }
-    buf[PELOTON_CHECKSUM_POS] = (buf[0] + buf[1]) % 256;
-    if (auxSerial.availableForWrite() >= PELOTON_RQ_SIZE) {
-      auxSerial.write(buf, PELOTON_RQ_SIZE);
-    }
-  } else if (PELOTON_TX && txCheck <= 0) {
-    if (txCheck == 0) {
-      txCheck = -TX_CHECK_INTERVAL;
-    } else if (txCheck == -1) {
-      txCheck = 1;
+// Starts the request cycle and gives up on replies that don't come. Requests after
+// a reply are sent straight from rxSerial.
+void SS2K::txSerial() {
+  pelotonLink.setRequesting(PELOTON_TX);
+  pelotonLink.setErgMode(rtConfig.getFTMSMode() == FitnessMachineControlPointProcedure::SetTargetPower);
+  pelotonLink.tick(millis());
+  bool connected = pelotonLink.isConnected();
+  if (connected != pelotonIsConnected) {
+    pelotonIsConnected = connected;
+    if (connected) {
+      pelotonConnected();
+    } else {
+      pelotonDisconnected();
     }
-    rtConfig.setMinResistance(-DEFAULT_RESISTANCE_RANGE);
-    rtConfig.setMaxResistance(DEFAULT_RESISTANCE_RANGE);
-    txCheck++;
   }
 }
 
 void SS2K::pelotonConnected() {
-  txCheck = TX_CHECK_INTERVAL;
+  SS2K_LOG(MAIN_LOG_TAG, "Peloton connected");
   rtConfig.setMinResistance(MIN_PELOTON_RESISTANCE);
   rtConfig.setMaxResistance(MAX_PELOTON_RESISTANCE);
 }
 
+void SS2K::pelotonDisconnected() {
+  SS2K_LOG(MAIN_LOG_TAG, "Peloton stopped answering");
+  rtConfig.setMinResistance(-DEFAULT_RESISTANCE_RANGE);
+  rtConfig.setMaxResistance(DEFAULT_RESISTANCE_RANGE);
+}
+
+// Runs in the UART event task, so it only splits the received bytes into frames,
+// queues them and sends the next request. Whatever isn't a whole frame yet stays
+// in the framer.
 void SS2K::rxSerial(void) {
-  while (auxSerial.available()) {
-    ss2k.pelotonConnected();
-    auxSerialBuffer.len = auxSerial.readBytesUntil(PELOTON_FOOTER, auxSerialBuffer.data, AUX_BUF_SIZE);
-    for (int i = 0; i < auxSerialBuffer.len; i++) {  // Find start of data string
-      if (auxSerialBuffer.data[i] == PELOTON_HEADER) {
-        size_t newLen = auxSerialBuffer.len - i;  // find length of sub data
-        uint8_t newBuf[newLen];
-        for (int j = i; j < auxSerialBuffer.len; j++) {
-          newBuf[j - i] = auxSerialBuffer.data[j];
-        }
-        collectAndSet(PELOTON_DATA_UUID, PELOTON_DATA_UUID, PELOTON_ADDRESS, newBuf, newLen);
-      }
-    }
-  }
+  // if the queue is full, the next reply refreshes the field
+  pelotonLink.receive(millis(), [](const PelotonFramer::Frame &frame) { xQueueSend(pelotonFrameQueue, &frame, 0); });
 }
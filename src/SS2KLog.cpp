@@ -100,13 +100,6 @@ char LogHandler::_logLevelToLetter(esp_log_level_t level) {
   return ' ';
 }
 
-void ss2k_remove_newlines(std::string *str) {
-  std::string::size_type pos = 0;
-  while ((pos = (*str).find("\n", pos)) != std::string::npos) {
-    (*str).replace(pos, 1, " ");
-  }
-}
-
 int ss2k_log_hex_to_buffer(const byte *data, const size_t data_length, char *buffer, const int buffer_offset, const size_t buffer_length) {
   int written = 0;
   for (int data_offset = 0; data_offset < data_length; data_offset++) {
@@ -9,67 +9,140 @@
 #include "SS2KLog.h"
 #include "Constants.h"
 
-#include <sensors/SensorData.h>
-#include <sensors/SensorDataFactory.h>
+// rtConfig as the sensor pipeline sees it. Speed and resistance have no simulate flag.
+class RuntimeMetrics : public RideMetrics {
+ public:
+  float get(Metric metric) const override {
+    if (metric == SPEED) {
+      return rtConfig.getSimulatedSpeed();
+    }
+    Measurement *value = measurement(metric);
+    return value ? value->getValue() : 0;
+  }
+
+  void set(Metric metric, float value) override {
+    if (metric == SPEED) {
+      rtConfig.setSimulatedSpeed(value);
+    } else if (measurement(metric)) {
+      measurement(metric)->setValue(value);
+    }
+  }
+
+  bool isSimulated(Metric metric) const override {
+    if (metric == RESISTANCE) {
+      return false;
+    }
+    Measurement *value = measurement(metric);
+    return value ? value->getSimulate() : false;
+  }
+
+ private:
+  static Measurement *measurement(Metric metric) {
+    switch (metric) {
+      case HEART_RATE:
+        return &rtConfig.hr;
+      case CADENCE:
+        return &rtConfig.cad;
+      case POWER:
+        return &rtConfig.watts;
+      case RESISTANCE:
+        return &rtConfig.resistance;
+      default:
+        return nullptr;
+    }
+  }
+};
+
+static RuntimeMetrics runtimeMetrics;
+SensorPipeline sensorPipeline(runtimeMetrics);
+PacketCapture packetCapture(PACKET_CAPTURE_SIZE);
+
+QueueHandle_t packetReplayQueue = nullptr;
+
+static PacketReplay packetReplay;
+static TaskHandle_t packetReplayTask = NULL;
+
+// Hands replayed notifications to BLECommunications so collectAndSet() only ever runs on that task.
+class ReplayQueueSink : public SensorSink {
+ public:
+  void onSensorNotification(const SensorNotification &notification) override {
+    if (xQueueSend(packetReplayQueue, &notification, PACKET_REPLAY_QUEUE_WAIT / portTICK_PERIOD_MS) != pdTRUE) {
+      SS2K_LOG(BLE_COMMON_LOG_TAG, "Replay queue full, packet dropped");
+    }
+  }
+};
+
+static void packetReplayLoop(void *pvParameters) {
+  ReplayQueueSink sink;
+  while (!packetReplay.finished()) {
+    int32_t wait = packetReplay.nextDue() - millis();
+    if (wait > 0) {
+      vTaskDelay(wait / portTICK_PERIOD_MS + 1);
+    }
+    packetReplay.pump(millis(), sink);
+  }
+  SS2K_LOG(BLE_COMMON_LOG_TAG, "Packet replay finished");
+  packetReplayTask = NULL;
+  vTaskDelete(NULL);
+}
 
-SensorDataFactory sensorDataFactory;
+bool startPacketReplay(float speed) {
+  if (packetReplayTask != NULL) {
+    return false;
+  }
+  if (packetReplayQueue == nullptr) {
+    packetReplayQueue = xQueueCreate(PACKET_REPLAY_QUEUE_SIZE, sizeof(SensorNotification));
+  }
+  std::vector<uint8_t> capture = packetCapture.snapshot();
+  if (packetReplayQueue == nullptr || !packetReplay.load(capture.data(), capture.size()) || packetReplay.size() == 0) {
+    return false;
+  }
+  SS2K_LOG(BLE_COMMON_LOG_TAG, "Replaying %d packets at %.1fx", packetReplay.size(), speed);
+  packetReplay.start(millis(), speed);
+  xTaskCreatePinnedToCore(packetReplayLoop,    /* Task function. */
+                          "PacketReplayTask",  /* name of task. */
+                          6000,                /* Stack size of task */
+                          NULL,                /* parameter of the task */
+                          1,                   /* priority of the task */
+                          &packetReplayTask,   /* Task handle to keep track of created task */
+                          1);                  /* pin task to core */
+  return true;
+}
+
+bool packetReplayRunning() { return packetReplayTask != NULL; }
 
 void collectAndSet(NimBLEUUID charUUID, NimBLEUUID serviceUUID, NimBLEAddress address, uint8_t *pData, size_t length) {
+  if (packetReplayTask == NULL) {
+    packetCapture.record(millis(), (uint64_t)address, charUUID, pData, length);
+  }
   const int kLogBufMaxLength = 250;
   char logBuf[kLogBufMaxLength];
   SS2K_LOGD(BLE_COMMON_LOG_TAG, "Data length: %d", length);
   int logBufLength = ss2k_log_hex_to_buffer(pData, length, logBuf, 0, kLogBufMaxLength);
 
-  logBufLength += snprintf(logBuf + logBufLength, kLogBufMaxLength - logBufLength, "<- %.8s | %.8s", serviceUUID.toString().c_str(), charUUID.toString().c_str());
+  logBufLength += snprintf(logBuf + logBufLength, kLogBufMaxLength - logBufLength, "<- %.8s | %.8s | ", serviceUUID.toString().c_str(), charUUID.toString().c_str());
 
-  std::shared_ptr<SensorData> sensorData = sensorDataFactory.getSensorData(charUUID, (uint64_t)address, pData, length);
+  SensorPipeline::Sources sources;
+  sources.powerCorrectionFactor = userConfig.getPowerCorrectionFactor();
+  sources.powerMeterSelected    = userConfig.getPowerMeterSelection().isSpecific();
+  sources.pelotonResistance     = rtConfig.getMaxResistance() == MAX_PELOTON_RESISTANCE;
+  sensorPipeline.setSources(sources);
 
-  logBufLength += snprintf(logBuf + logBufLength, kLogBufMaxLength - logBufLength, " | %s[", sensorData->getId().c_str());
-  if (sensorData->hasHeartRate() && !rtConfig.hr.getSimulate()) {
-    int heartRate = sensorData->getHeartRate();
-    rtConfig.hr.setValue(heartRate);
-    spinBLEClient.connectedHRM|= true;
-    logBufLength += snprintf(logBuf + logBufLength, kLogBufMaxLength - logBufLength, " HR(%d)", heartRate % 1000);
+  char *decoded   = logBuf + logBufLength;
+  uint8_t applied = sensorPipeline.apply(charUUID, (uint64_t)address, pData, length, millis(), decoded, kLogBufMaxLength - logBufLength);
+  if (applied & SensorPipeline::APPLIED_HEART_RATE) {
+    spinBLEClient.connectedHRM |= true;
   }
-  if (sensorData->hasCadence() && !rtConfig.cad.getSimulate()) {
-    if ((charUUID == PELOTON_DATA_UUID) && !((String(userConfig.getConnectedPowerMeter()) == "none") || (String(userConfig.getConnectedPowerMeter()) == "any"))) {
-      // Peloton connected but using BLE Power Meter. So skip cad for Peloton UUID.
-    } else {
-      float cadence = sensorData->getCadence();
-      rtConfig.cad.setValue(cadence);
-      spinBLEClient.connectedCD |= true;
-      logBufLength += snprintf(logBuf + logBufLength, kLogBufMaxLength - logBufLength, " CD(%.2f)", fmodf(cadence, 1000.0));
-    }
+  if (applied & SensorPipeline::APPLIED_CADENCE) {
+    spinBLEClient.connectedCD |= true;
   }
-  if (sensorData->hasPower() && !rtConfig.watts.getSimulate()) {
-    if ((charUUID == PELOTON_DATA_UUID) && !((String(userConfig.getConnectedPowerMeter()) == "none") || (String(userConfig.getConnectedPowerMeter()) == "any"))) {
-      // Peloton connected but using BLE Power Meter. So skip power for Peloton UUID.
-    } else {
-      int power = sensorData->getPower() * userConfig.getPowerCorrectionFactor();
-      rtConfig.watts.setValue(power);
-      spinBLEClient.connectedPM |= true;
-      logBufLength += snprintf(logBuf + logBufLength, kLogBufMaxLength - logBufLength, " PW(%d)", power % 10000);
-    }
-  }
-  if (sensorData->hasSpeed()) {
-    float speed = sensorData->getSpeed();
-    rtConfig.setSimulatedSpeed(speed);
-    logBufLength += snprintf(logBuf + logBufLength, kLogBufMaxLength - logBufLength, " SD(%.2f)", fmodf(speed, 1000.0));
-  }
-  if (sensorData->hasResistance()) {
-    if ((rtConfig.getMaxResistance() == MAX_PELOTON_RESISTANCE) && (charUUID != PELOTON_DATA_UUID)) {
-      // Peloton connected but using BLE Power Meter. So skip resistance for UUID's that aren't Peloton.
-    } else {
-      int resistance = sensorData->getResistance();
-      rtConfig.resistance.setValue(resistance);
-      logBufLength += snprintf(logBuf + logBufLength, kLogBufMaxLength - logBufLength, " RS(%d)", resistance % 1000);
-    }
+  if (applied & SensorPipeline::APPLIED_POWER) {
+    spinBLEClient.connectedPM |= true;
   }
-  strncat(logBuf + logBufLength, " ]", kLogBufMaxLength - logBufLength);
   if (userConfig.getLogComm()) {
     SS2K_LOG(BLE_COMMON_LOG_TAG, "%s", logBuf);
   } else {
-    SS2K_LOG(BLE_COMMON_LOG_TAG, "rx %s", sensorData->getId().c_str());
+    SS2K_LOG(BLE_COMMON_LOG_TAG, "rx %s", decoded);
   }
 #ifdef USE_TELEGRAM
   SEND_TO_TELEGRAM(String(logBuf));
@@ -8,44 +8,176 @@
 #include "Main.h"
 #include "SS2KLog.h"
 #include "SmartSpin_parameters.h"
+#include "HIDKeyMapper.h"
 
 #include <ArduinoJson.h>
 #include <LittleFS.h>
+#include <functional>
+#include <mutex>
+
+// Pending saves, shared by every copy of the parameters.
+static SaveDebouncer configSaves;
+static SaveDebouncer pwcSaves;
+
+// Guards the userConfig strings. The HTTP, BLE and maintenance tasks set and save them.
+static std::recursive_mutex configLock;
+
+// Renames a freshly written temporary file over filename.
+static bool replaceFile(const String &tmpFilename, const char *filename) {
+  if (!LittleFS.rename(tmpFilename, filename)) {
+    // Shouldn't happen, LittleFS replaces the target. Don't lose the save though.
+    LittleFS.remove(filename);
+    if (!LittleFS.rename(tmpFilename, filename)) {
+      SS2K_LOG(CONFIG_LOG_TAG, "Failed to replace %s", filename);
+      return false;
+    }
+  }
+  return true;
+}
 
-String RuntimeParameters::returnJSON() {
-  // Allocate a temporary JsonDocument
-  // Don't forget to change the capacity to match your requirements.
-  // Use arduinojson.org/assistant to compute the capacity.
-  StaticJsonDocument<RUNTIMECONFIG_JSON_SIZE> doc;
-  // Set the values in the document
-
-  doc["watts"]            = this->watts.getValue();
-  doc["targetWatts"]      = this->watts.getTarget();
-  doc["simWatts"]         = this->watts.getSimulate();
-  doc["hr"]               = this->hr.getValue();
-  doc["simHr"]            = this->hr.getSimulate();
-  doc["cad"]              = this->cad.getValue();
-  doc["simCad"]           = this->cad.getSimulate();
-  doc["resistance"]       = this->resistance.getValue();
-  doc["targetResistance"] = this->resistance.getTarget();
-  doc["targetIncline"]    = targetIncline;
-  doc["currentIncline"]   = currentIncline;
-  doc["speed"]            = simulatedSpeed;
-  doc["simTargetWatts"]   = simTargetWatts;
-  doc["FTMSMode"]         = FTMSMode;
-  doc["shifterPosition"]  = shifterPosition;
-  doc["minStep"]          = minStep;
-  doc["maxStep"]          = maxStep;
-  doc["minResistance"]    = minResistance;
-  doc["maxResistance"]    = maxResistance;
-
-  String output;
-  serializeJson(doc, output);
-  return output;
+// Writes filename.tmp followed by the CRC trailer, then renames it over filename.
+// A power loss leaves either the old or the new file, never a partial one.
+static bool writeConfigFile(const char *filename, std::function<void(JsonWriter &)> write) {
+  String tmpFilename = String(filename) + ".tmp";
+  SS2K_LOG(CONFIG_LOG_TAG, "Writing File: %s", filename);
+  File file = LittleFS.open(tmpFilename, FILE_WRITE);
+  if (!file) {
+    SS2K_LOG(CONFIG_LOG_TAG, "Failed to create file");
+    return false;
+  }
+  PrintJsonOutput out(file);
+  JsonWriter json(out);
+  write(json);
+  char trailer[CONFIG_FILE_TRAILER_LENGTH + 1];
+  size_t length = ConfigFile::trailer(out.crc(), trailer);
+  bool written  = out.size() > 0 && file.write(reinterpret_cast<const uint8_t *>(trailer), length) == length;
+  file.close();
+  if (!written) {
+    SS2K_LOG(CONFIG_LOG_TAG, "Failed to write to file");
+    LittleFS.remove(tmpFilename);
+    return false;
+  }
+  return replaceFile(tmpFilename, filename);
+}
+
+// Writes a binary record the same way as writeConfigFile(). The record carries its own CRC.
+static bool writeConfigRecord(const char *filename, const uint8_t *record, size_t length) {
+  if (length == 0) {
+    SS2K_LOG(CONFIG_LOG_TAG, "%s doesn't fit CONFIG_RECORD_MAX_SIZE", filename);
+    return false;
+  }
+  String tmpFilename = String(filename) + ".tmp";
+  File file          = LittleFS.open(tmpFilename, FILE_WRITE);
+  if (!file) {
+    SS2K_LOG(CONFIG_LOG_TAG, "Failed to create file");
+    return false;
+  }
+  bool written = file.write(record, length) == length;
+  file.close();
+  if (!written) {
+    SS2K_LOG(CONFIG_LOG_TAG, "Failed to write to file");
+    LittleFS.remove(tmpFilename);
+    return false;
+  }
+  return replaceFile(tmpFilename, filename);
+}
+
+// Reads a record written by writeConfigRecord() into buffer, falling back to the
+// temporary file if a save was interrupted before the rename.
+static bool readConfigRecord(const char *filename, uint8_t *buffer, size_t capacity, ConfigRecordReader *reader) {
+  const String candidates[] = {String(filename), String(filename) + ".tmp"};
+  for (const String &candidate : candidates) {
+    File file = LittleFS.open(candidate, FILE_READ);
+    if (!file) {
+      continue;
+    }
+    size_t length = file.read(buffer, capacity);
+    file.close();
+    if (reader->open(buffer, length)) {
+      return true;
+    }
+    SS2K_LOG(CONFIG_LOG_TAG, "%s is not a valid config record", candidate.c_str());
+  }
+  return false;
+}
+
+// Reads a string field into value, leaving it alone once the record has no more fields.
+static void getString(ConfigRecordReader &record, String &value) {
+  char text[256];
+  if (record.getString(text, sizeof(text))) {
+    value = text;
+  }
+}
+
+// The remote key map is the only long string so far.
+static void getLongString(ConfigRecordReader &record, String &value) {
+  char text[REMOTE_KEY_MAP_MAX_LENGTH + 1];
+  if (record.getLongString(text, sizeof(text))) {
+    value = text;
+  }
+}
+
+static void getString(ConfigRecordReader &record, DeviceSelection &value) {
+  char text[DEVICE_SELECTION_MAX_LENGTH + 1];
+  if (record.getString(text, sizeof(text))) {
+    value.set(text);
+  }
+}
+
+// Reads a file written by writeConfigFile() without its trailer. Falls back to the
+// temporary file if a save was interrupted before the rename.
+static ConfigFile::Check readConfigFile(const char *filename, String *content) {
+  const String candidates[] = {String(filename), String(filename) + ".tmp"};
+  for (const String &candidate : candidates) {
+    File file = LittleFS.open(candidate, FILE_READ);
+    if (!file) {
+      continue;
+    }
+    *content = file.readString();
+    file.close();
+    size_t length;
+    ConfigFile::Check check = ConfigFile::verify(content->c_str(), content->length(), &length);
+    if (check == ConfigFile::CORRUPT) {
+      SS2K_LOG(CONFIG_LOG_TAG, "%s failed the CRC check", candidate.c_str());
+      continue;
+    }
+    if (candidate != filename && check != ConfigFile::VALID) {
+      continue;  // an unchecked temporary file may be incomplete
+    }
+    content->remove(length);
+    return check;
+  }
+  *content = String();
+  return ConfigFile::CORRUPT;
+}
+
+void RuntimeParameters::writeJSON(JsonWriter &json) {
+  json.beginObject();
+  json.add("watts", this->watts.getValue());
+  json.add("targetWatts", this->watts.getTarget());
+  json.add("simWatts", this->watts.getSimulate());
+  json.add("hr", this->hr.getValue());
+  json.add("simHr", this->hr.getSimulate());
+  json.add("cad", this->cad.getValue());
+  json.add("simCad", this->cad.getSimulate());
+  json.add("resistance", this->resistance.getValue());
+  json.add("targetResistance", this->resistance.getTarget());
+  json.add("targetIncline", targetIncline);
+  json.add("currentIncline", currentIncline);
+  json.add("speed", simulatedSpeed);
+  json.add("simTargetWatts", simTargetWatts);
+  json.add("FTMSMode", FTMSMode);
+  json.add("shifterPosition", shifterPosition);
+  json.add("minStep", minStep);
+  json.add("maxStep", maxStep);
+  json.add("minResistance", minResistance);
+  json.add("maxResistance", maxResistance);
+  json.endObject();
 }
 
 // Default Values
 void userParameters::setDefaults() {
+  std::lock_guard<std::recursive_mutex> lock(configLock);
   firmwareUpdateURL     = FW_UPDATEURL;
   deviceName            = DEVICE_NAME;
   shiftStep             = DEFAULT_SHIFT_STEP;
@@ -55,131 +187,247 @@ void userParameters::setDefaults() {
   powerCorrectionFactor = 1.0;
   ERGSensitivity        = ERG_SENSITIVITY;
   autoUpdate            = AUTO_FIRMWARE_UPDATE;
-  ssid                  = DEVICE_NAME;
-  password              = DEFAULT_PASSWORD;
-  connectedPowerMeter   = CONNECTED_POWER_METER;
-  connectedHeartMonitor = CONNECTED_HEART_MONITOR;
-  connectedRemote       = CONNECTED_REMOTE;
-  foundDevices          = " ";
+  setSsid(DEVICE_NAME);
+  setPassword(DEFAULT_PASSWORD);
+  setConnectedPowerMeter(CONNECTED_POWER_METER);
+  setConnectedHeartMonitor(CONNECTED_HEART_MONITOR);
+  setConnectedRemote(CONNECTED_REMOTE);
+  remoteKeyMap          = REMOTE_KEY_MAP;
   maxWatts              = DEFAULT_MAX_WATTS;
   minWatts              = DEFAULT_MIN_WATTS;
   stepperDir            = true;
   shifterDir            = true;
   udpLogEnabled         = false;
   logComm               = false;
+  telemetryInterval     = TELEMETRY_INTERVAL;
+  updateCheckInterval   = UPDATE_CHECK_INTERVAL;
+}
+
+void userParameters::setFirmwareUpdateURL(String fURL) {
+  std::lock_guard<std::recursive_mutex> lock(configLock);
+  firmwareUpdateURL = fURL;
+}
+
+void userParameters::setDeviceName(String dvn) {
+  std::lock_guard<std::recursive_mutex> lock(configLock);
+  deviceName = dvn;
+}
+
+void userParameters::setSsid(const char *sid) {
+  std::lock_guard<std::recursive_mutex> lock(configLock);
+  snprintf(ssid, sizeof(ssid), "%s", sid ? sid : "");
+}
+
+void userParameters::setPassword(const char *pwd) {
+  std::lock_guard<std::recursive_mutex> lock(configLock);
+  snprintf(password, sizeof(password), "%s", pwd ? pwd : "");
+}
+
+// The sensor selections are classified when set, see DeviceSelection.
+void userParameters::setConnectedPowerMeter(const char *cpm) {
+  std::lock_guard<std::recursive_mutex> lock(configLock);
+  connectedPowerMeter.set(cpm);
+}
+
+void userParameters::setConnectedHeartMonitor(const char *cHr) {
+  std::lock_guard<std::recursive_mutex> lock(configLock);
+  connectedHeartMonitor.set(cHr);
+}
+
+void userParameters::setConnectedRemote(const char *cRemote) {
+  std::lock_guard<std::recursive_mutex> lock(configLock);
+  connectedRemote.set(cRemote);
+}
+
+// Keeps whole bindings so the map fits the config record.
+void userParameters::setRemoteKeyMap(String map) {
+  size_t length = HIDKeyMapper::fitBindings(map.c_str(), REMOTE_KEY_MAP_MAX_LENGTH);
+  if (length < map.length()) {
+    SS2K_LOG(CONFIG_LOG_TAG, "Remote key map too long, keeping the first %d characters", length);
+    map = map.substring(0, length);
+  }
+  std::lock_guard<std::recursive_mutex> lock(configLock);
+  remoteKeyMap = map;
+}
+
+userParameters userParameters::snapshot() {
+  std::lock_guard<std::recursive_mutex> lock(configLock);
+  return *this;
 }
 
 //---------------------------------------------------------------------------------
-//-- return all config as one a single JSON string
-String userParameters::returnJSON() {
-  // Allocate a temporary JsonDocument
-  // Don't forget to change the capacity to match your requirements.
-  // Use arduinojson.org/assistant to compute the capacity.
-  StaticJsonDocument<USERCONFIG_JSON_SIZE> doc;
-  // Set the values in the document
-
-  doc["firmwareUpdateURL"]     = firmwareUpdateURL;
-  doc["firmwareVersion"]       = FIRMWARE_VERSION;
-  doc["deviceName"]            = deviceName;
-  doc["shiftStep"]             = shiftStep;
-  doc["stepperPower"]          = stepperPower;
-  doc["stealthChop"]           = stealthChop;
-  doc["inclineMultiplier"]     = inclineMultiplier;
-  doc["powerCorrectionFactor"] = powerCorrectionFactor;
-  doc["ERGSensitivity"]        = ERGSensitivity;
-  doc["autoUpdate"]            = autoUpdate;
-  doc["ssid"]                  = ssid;
-  doc["password"]              = password;
-  doc["connectedPowerMeter"]   = connectedPowerMeter;
-  doc["connectedHeartMonitor"] = connectedHeartMonitor;
-  doc["connectedRemote"]       = connectedRemote;
-  doc["foundDevices"]          = foundDevices;
-  doc["maxWatts"]              = maxWatts;
-  doc["minWatts"]              = minWatts;
-  doc["shifterDir"]            = shifterDir;
-  doc["stepperDir"]            = stepperDir;
-  doc["udpLogEnabled"]         = udpLogEnabled;
-  doc["logComm"]               = logComm;
-
-  String output;
-  serializeJson(doc, output);
-  return output;
-}
-
-//-- Saves all parameters to LittleFS
-void userParameters::saveToLittleFS() {
-  // Delete existing file, otherwise the configuration is appended to the file
-  LittleFS.remove(configFILENAME);
+//-- write all config as one JSON object, foundDevices is the current scan result
+void userParameters::writeJSON(JsonWriter &json, const String &foundDevices) {
+  json.beginObject();
+  writeSettings(json);
+  json.add("firmwareVersion", FIRMWARE_VERSION);
+  json.add("foundDevices", foundDevices.c_str());
+  json.endObject();
+}
 
-  // Open file for writing
-  SS2K_LOG(CONFIG_LOG_TAG, "Writing File: %s", configFILENAME);
-  File file = LittleFS.open(configFILENAME, FILE_WRITE);
-  if (!file) {
-    SS2K_LOG(CONFIG_LOG_TAG, "Failed to create file");
-    return;
+//-- the members of the config object that are saved to LittleFS
+void userParameters::writeSettings(JsonWriter &json) {
+  json.add("firmwareUpdateURL", firmwareUpdateURL.c_str());
+  json.add("deviceName", deviceName.c_str());
+  json.add("shiftStep", shiftStep);
+  json.add("stepperPower", stepperPower);
+  json.add("stealthChop", stealthChop);
+  json.add("inclineMultiplier", inclineMultiplier);
+  json.add("powerCorrectionFactor", powerCorrectionFactor);
+  json.add("ERGSensitivity", ERGSensitivity);
+  json.add("autoUpdate", autoUpdate);
+  json.add("ssid", ssid);
+  json.add("password", password);
+  json.add("connectedPowerMeter", connectedPowerMeter.c_str());
+  json.add("connectedHeartMonitor", connectedHeartMonitor.c_str());
+  json.add("connectedRemote", connectedRemote.c_str());
+  json.add("remoteKeyMap", remoteKeyMap.c_str());
+  json.add("maxWatts", maxWatts);
+  json.add("minWatts", minWatts);
+  json.add("shifterDir", shifterDir);
+  json.add("stepperDir", stepperDir);
+  json.add("udpLogEnabled", udpLogEnabled);
+  json.add("logComm", logComm);
+  json.add("telemetryInterval", telemetryInterval);
+  json.add("updateCheckInterval", updateCheckInterval);
+}
+
+//-- the binary record, fields are only ever appended (see ConfigRecordWriter)
+void userParameters::writeRecord(ConfigRecordWriter &record) {
+  record.putString(firmwareUpdateURL.c_str());
+  record.putString(deviceName.c_str());
+  record.putInt(shiftStep);
+  record.putInt(stepperPower);
+  record.putBool(stealthChop);
+  record.putFloat(inclineMultiplier);
+  record.putFloat(powerCorrectionFactor);
+  record.putFloat(ERGSensitivity);
+  record.putBool(autoUpdate);
+  record.putString(ssid);
+  record.putString(password);
+  record.putString(connectedPowerMeter.c_str());
+  record.putString(connectedHeartMonitor.c_str());
+  record.putString(connectedRemote.c_str());
+  record.putLongString(remoteKeyMap.c_str());
+  record.putInt(maxWatts);
+  record.putInt(minWatts);
+  record.putBool(shifterDir);
+  record.putBool(stepperDir);
+  record.putBool(udpLogEnabled);
+  record.putBool(logComm);
+  record.putInt(telemetryInterval);
+  record.putInt(updateCheckInterval);
+}
+
+void userParameters::readRecord(ConfigRecordReader &record) {
+  getString(record, firmwareUpdateURL);
+  getString(record, deviceName);
+  shiftStep             = record.getInt(shiftStep);
+  stepperPower          = record.getInt(stepperPower);
+  stealthChop           = record.getBool(stealthChop);
+  inclineMultiplier     = record.getFloat(inclineMultiplier);
+  powerCorrectionFactor = record.getFloat(powerCorrectionFactor);
+  ERGSensitivity        = record.getFloat(ERGSensitivity);
+  autoUpdate            = record.getBool(autoUpdate);
+  record.getString(ssid, sizeof(ssid));
+  record.getString(password, sizeof(password));
+  getString(record, connectedPowerMeter);
+  getString(record, connectedHeartMonitor);
+  getString(record, connectedRemote);
+  if (record.version() < 2) {
+    getString(record, remoteKeyMap);  // a length byte before version 2
+  } else {
+    getLongString(record, remoteKeyMap);
   }
+  maxWatts            = record.getInt(maxWatts);
+  minWatts            = record.getInt(minWatts);
+  shifterDir          = record.getBool(shifterDir);
+  stepperDir          = record.getBool(stepperDir);
+  udpLogEnabled       = record.getBool(udpLogEnabled);
+  logComm             = record.getBool(logComm);
+  telemetryInterval   = record.getInt(telemetryInterval);
+  updateCheckInterval = record.getInt(updateCheckInterval);
+  // Fields that change meaning in a later version are migrated here based on record.version().
+  if ((powerCorrectionFactor < MIN_PCF) || (powerCorrectionFactor > MAX_PCF)) {
+    powerCorrectionFactor = 1;
+  }
+}
 
-  // Allocate a temporary JsonDocument
-  // Don't forget to change the capacity to match your requirements.
-  // Use arduinojson.org/assistant to compute the capacity.
-  StaticJsonDocument<USERCONFIG_JSON_SIZE> doc;
+//-- Saves all parameters to LittleFS, the binary record and the JSON backup
+void userParameters::saveToLittleFS() {
+  // Serialize a copy, the maintenance task saves while other tasks may change the settings.
+  userParameters settings = snapshot();
+  uint8_t record[CONFIG_RECORD_MAX_SIZE];
+  ConfigRecordWriter writer(record, sizeof(record), USERCONFIG_RECORD_VERSION);
+  settings.writeRecord(writer);
+  bool saved    = writeConfigRecord(configRecordFILENAME, record, writer.finish());
+  bool backedUp = writeConfigFile(configFILENAME, [&settings](JsonWriter &json) {
+    json.beginObject();
+    settings.writeSettings(json);
+    json.endObject();
+  });
+  if (!saved || !backedUp) {
+    configSaves.markDirty(millis());  // try again later
+  }
+}
 
-  // Set the values in the document
-  // commented items are not needed in save file
-
-  doc["firmwareUpdateURL"]     = firmwareUpdateURL;
-  doc["deviceName"]            = deviceName;
-  doc["shiftStep"]             = shiftStep;
-  doc["stepperPower"]          = stepperPower;
-  doc["stealthChop"]           = stealthChop;
-  doc["inclineMultiplier"]     = inclineMultiplier;
-  doc["powerCorrectionFactor"] = powerCorrectionFactor;
-  doc["ERGSensitivity"]        = ERGSensitivity;
-  doc["autoUpdate"]            = autoUpdate;
-  doc["ssid"]                  = ssid;
-  doc["password"]              = password;
-  doc["connectedPowerMeter"]   = connectedPowerMeter;
-  doc["connectedHeartMonitor"] = connectedHeartMonitor;
-  doc["connectedRemote"]       = connectedRemote;
-  doc["foundDevices"]          = foundDevices;
-  doc["maxWatts"]              = maxWatts;
-  doc["minWatts"]              = minWatts;
-  doc["shifterDir"]            = shifterDir;
-  doc["stepperDir"]            = stepperDir;
-  doc["udpLogEnabled"]         = udpLogEnabled;
-  doc["logComm"]               = logComm;
-
-  // Serialize JSON to file
-  if (serializeJson(doc, file) == 0) {
-    SS2K_LOG(CONFIG_LOG_TAG, "Failed to write to file");
+void userParameters::requestSave() { configSaves.markDirty(millis()); }
+
+void userParameters::savePending(bool force) {
+  if (configSaves.claimSave(millis(), force)) {
+    saveToLittleFS();
   }
-  // Close the file
-  file.close();
 }
 
-// Loads the JSON configuration from a file into a userParameters Object
+// Loads the binary config record into a userParameters Object
 void userParameters::loadFromLittleFS() {
   setDefaults();
-  // Open file for reading
-  SS2K_LOG(CONFIG_LOG_TAG, "Reading File: %s", configFILENAME);
-  File file = LittleFS.open(configFILENAME);
-
-  // load defaults if filename doesn't exist
-  if (!file) {
-    SS2K_LOG(CONFIG_LOG_TAG, "Couldn't find configuration file.");
+  SS2K_LOG(CONFIG_LOG_TAG, "Reading File: %s", configRecordFILENAME);
+  uint8_t record[CONFIG_RECORD_MAX_SIZE];
+  ConfigRecordReader reader;
+  if (readConfigRecord(configRecordFILENAME, record, sizeof(record), &reader)) {
+    std::unique_lock<std::recursive_mutex> lock(configLock);
+    readRecord(reader);
+    lock.unlock();
+    if (reader.version() != USERCONFIG_RECORD_VERSION) {
+      requestSave();  // rewrite it in the current layout
+    }
+    SS2K_LOG(CONFIG_LOG_TAG, "Config File Loaded: %s", configRecordFILENAME);
     return;
   }
+  // First boot since the binary record was introduced, or it was lost. Fall back to the JSON backup.
+  if (!importFromLittleFS()) {
+    SS2K_LOG(CONFIG_LOG_TAG, "Couldn't load configuration. Using defaults");
+    requestSave();
+  }
+}
+
+bool userParameters::importFromLittleFS() {
+  SS2K_LOG(CONFIG_LOG_TAG, "Importing File: %s", configFILENAME);
+  String content;
+  readConfigFile(configFILENAME, &content);
+  if (content.isEmpty() || !importJSON(content)) {
+    return false;
+  }
+  requestSave();
+  SS2K_LOG(CONFIG_LOG_TAG, "Config File Imported: %s", configFILENAME);
+  return true;
+}
+
+// Replaces the settings with the ones in a JSON config, keeps them if it doesn't parse.
+bool userParameters::importJSON(const String &content) {
   // Allocate a temporary JsonDocument
   // Don't forget to change the capacity to match your requirements.
   // Use arduinojson.org/v6/assistant to compute the capacity.
   StaticJsonDocument<USERCONFIG_JSON_SIZE> doc;
 
   // Deserialize the JSON document
-  DeserializationError error = deserializeJson(doc, file);
+  DeserializationError error = deserializeJson(doc, content);
   if (error) {
-    SS2K_LOG(CONFIG_LOG_TAG, "Failed to deserialize. Using defaults");
-    return;
+    SS2K_LOG(CONFIG_LOG_TAG, "Failed to deserialize %s", configFILENAME);
+    return false;
   }
+  setDefaults();
 
   // Copy values from the JsonDocument to the Config
   setFirmwareUpdateURL(doc["firmwareUpdateURL"]);
@@ -193,7 +441,6 @@ void userParameters::loadFromLittleFS() {
   setPassword(doc["password"]);
   setConnectedPowerMeter(doc["connectedPowerMeter"]);
   setConnectedHeartMonitor(doc["connectedHeartMonitor"]);
-  setFoundDevices(doc["foundDevices"]);
   if (doc["ERGSensitivity"]) {  // If statements to upgrade old versions of config.txt that didn't include these
     setERGSensitivity(doc["ERGSensitivity"]);
   }
@@ -224,99 +471,177 @@ void userParameters::loadFromLittleFS() {
   if (doc["connectedRemote"]) {
     setConnectedRemote(doc["connectedRemote"]);
   }
-
-  SS2K_LOG(CONFIG_LOG_TAG, "Config File Loaded: %s", configFILENAME);
-  file.close();
+  if (doc["remoteKeyMap"]) {
+    setRemoteKeyMap(doc["remoteKeyMap"]);
+  }
+  if (doc["telemetryInterval"]) {
+    setTelemetryInterval(doc["telemetryInterval"]);
+  }
+  if (doc.containsKey("updateCheckInterval")) {
+    setUpdateCheckInterval(doc["updateCheckInterval"]);
+  }
+  return true;
 }
 
-// Prints the content of a file to the Serial
-void userParameters::printFile() {
-  // Open file for reading
-  SS2K_LOG(CONFIG_LOG_TAG, "Contents of file: %s", configFILENAME);
-  File file = LittleFS.open(configFILENAME);
-  if (!file) {
-    SS2K_LOG(CONFIG_LOG_TAG, "Failed to read file");
-    return;
+/*****************************************USERPWC*****************************************/
+
+// Examples from https://www.cyclinganalytics.com/
+#define DEFAULT_SESSION1_HR  129
+#define DEFAULT_SESSION1_PWR 100
+#define DEFAULT_SESSION2_HR  154
+#define DEFAULT_SESSION2_PWR 150
+
+void physicalWorkingCapacity::setDefaults() {
+  session1HR       = DEFAULT_SESSION1_HR;
+  session1Pwr      = DEFAULT_SESSION1_PWR;
+  session2HR       = DEFAULT_SESSION2_HR;
+  session2Pwr      = DEFAULT_SESSION2_PWR;
+  hr2Pwr           = false;
+  sessionsMeasured = false;
+  for (HRPowerPoint &session : extraSessions) {
+    session = {0, 0};
   }
+}
 
-  // Close the file
-  file.close();
+bool physicalWorkingCapacity::hasDefaultSessions() const {
+  for (const HRPowerPoint &session : extraSessions) {
+    if (session.hr != 0 || session.watts != 0) {
+      return false;
+    }
+  }
+  return session1HR == DEFAULT_SESSION1_HR && session1Pwr == DEFAULT_SESSION1_PWR && session2HR == DEFAULT_SESSION2_HR && session2Pwr == DEFAULT_SESSION2_PWR;
 }
 
-/*****************************************USERPWC*****************************************/
+size_t physicalWorkingCapacity::getSessions(HRPowerPoint *out, size_t capacity) const {
+  size_t count = 0;
+  if (count < capacity) out[count++] = {session1HR, session1Pwr};
+  if (count < capacity) out[count++] = {session2HR, session2Pwr};
+  for (const HRPowerPoint &session : extraSessions) {
+    if (count < capacity) out[count++] = session;
+  }
+  return count;
+}
 
-void physicalWorkingCapacity::setDefaults() {
-  session1HR  = 129;  // examples from https://www.cyclinganalytics.com/
-  session1Pwr = 100;
-  session2HR  = 154;
-  session2Pwr = 150;
-  hr2Pwr      = false;
+void physicalWorkingCapacity::setSessions(const HRPowerPoint *sessions, size_t count) {
+  HRPowerPoint all[HR_POWER_MAX_POINTS] = {};
+  for (size_t i = 0; i < count && i < HR_POWER_MAX_POINTS; i++) {
+    all[i] = sessions[i];
+  }
+  session1HR  = all[0].hr;
+  session1Pwr = all[0].watts;
+  session2HR  = all[1].hr;
+  session2Pwr = all[1].watts;
+  for (size_t i = 0; i < HR_POWER_MAX_POINTS - 2; i++) {
+    extraSessions[i] = all[i + 2];
+  }
 }
 
-//-- return all config as one a single JSON string
-String physicalWorkingCapacity::returnJSON() {
-  StaticJsonDocument<500> doc;
+//-- write all config as one JSON object
+void physicalWorkingCapacity::writeJSON(JsonWriter &json) {
+  json.beginObject();
+  json.add("session1HR", session1HR);
+  json.add("session1Pwr", session1Pwr);
+  json.add("session2HR", session2HR);
+  json.add("session2Pwr", session2Pwr);
+  for (size_t i = 0; i < HR_POWER_MAX_POINTS - 2; i++) {
+    char key[16];
+    snprintf(key, sizeof(key), "session%dHR", (int)i + 3);
+    json.add(key, extraSessions[i].hr);
+    snprintf(key, sizeof(key), "session%dPwr", (int)i + 3);
+    json.add(key, extraSessions[i].watts);
+  }
+  json.add("hr2Pwr", hr2Pwr);
+  json.add("sessionsMeasured", sessionsMeasured);
+  json.endObject();
+}
 
-  doc["session1HR"]  = session1HR;
-  doc["session1Pwr"] = session1Pwr;
-  doc["session2HR"]  = session2HR;
-  doc["session2Pwr"] = session2Pwr;
-  doc["hr2Pwr"]      = hr2Pwr;
+void physicalWorkingCapacity::writeRecord(ConfigRecordWriter &record) {
+  record.putInt(session1HR);
+  record.putInt(session1Pwr);
+  record.putInt(session2HR);
+  record.putInt(session2Pwr);
+  record.putBool(hr2Pwr);
+  for (const HRPowerPoint &session : extraSessions) {
+    record.putInt(session.hr);
+    record.putInt(session.watts);
+  }
+  record.putBool(sessionsMeasured);
+}
 
-  String output;
-  serializeJson(doc, output);
-  return output;
+void physicalWorkingCapacity::readRecord(ConfigRecordReader &record) {
+  session1HR  = record.getInt(session1HR);
+  session1Pwr = record.getInt(session1Pwr);
+  session2HR  = record.getInt(session2HR);
+  session2Pwr = record.getInt(session2Pwr);
+  hr2Pwr      = record.getBool(hr2Pwr);
+  for (HRPowerPoint &session : extraSessions) {
+    session.hr    = record.getInt(session.hr);
+    session.watts = record.getInt(session.watts);
+  }
+  sessionsMeasured = record.getBool(!hasDefaultSessions());
 }
 
-//-- Saves all parameters to LittleFS
+//-- Saves all parameters to LittleFS, the binary record and the JSON backup
 void physicalWorkingCapacity::saveToLittleFS() {
-  // Delete existing file, otherwise the configuration is appended to the file
-  LittleFS.remove(userPWCFILENAME);
-  // Open file for writing
-  SS2K_LOG(CONFIG_LOG_TAG, "Writing File: %s", userPWCFILENAME);
-  File file = LittleFS.open(userPWCFILENAME, FILE_WRITE);
-  if (!file) {
-    SS2K_LOG(CONFIG_LOG_TAG, "Failed to create file");
-    return;
+  uint8_t record[CONFIG_RECORD_MAX_SIZE];
+  ConfigRecordWriter writer(record, sizeof(record), USERPWC_RECORD_VERSION);
+  writeRecord(writer);
+  bool saved    = writeConfigRecord(userPWCRecordFILENAME, record, writer.finish());
+  bool backedUp = writeConfigFile(userPWCFILENAME, [this](JsonWriter &json) { writeJSON(json); });
+  if (!saved || !backedUp) {
+    pwcSaves.markDirty(millis());  // try again later
   }
+}
 
-  StaticJsonDocument<500> doc;
-
-  doc["session1HR"]  = session1HR;
-  doc["session1Pwr"] = session1Pwr;
-  doc["session2HR"]  = session2HR;
-  doc["session2Pwr"] = session2Pwr;
-  doc["hr2Pwr"]      = hr2Pwr;
+void physicalWorkingCapacity::requestSave() { pwcSaves.markDirty(millis()); }
 
-  // Serialize JSON to file
-  if (serializeJson(doc, file) == 0) {
-    SS2K_LOG(CONFIG_LOG_TAG, "Failed to write to file");
+void physicalWorkingCapacity::savePending(bool force) {
+  if (pwcSaves.claimSave(millis(), force)) {
+    saveToLittleFS();
   }
-  // Close the file
-  file.close();
 }
 
-// Loads the JSON configuration from a file
+// Loads the binary PWC record
 void physicalWorkingCapacity::loadFromLittleFS() {
-  // Open file for reading
-  SS2K_LOG(CONFIG_LOG_TAG, "Reading File: %s", userPWCFILENAME);
-  File file = LittleFS.open(userPWCFILENAME);
-
-  // load defaults if filename doesn't exist
-  if (!file) {
-    SS2K_LOG(CONFIG_LOG_TAG, "Couldn't find configuration file. Loading Defaults");
-    setDefaults();
+  setDefaults();
+  SS2K_LOG(CONFIG_LOG_TAG, "Reading File: %s", userPWCRecordFILENAME);
+  uint8_t record[CONFIG_RECORD_MAX_SIZE];
+  ConfigRecordReader reader;
+  if (readConfigRecord(userPWCRecordFILENAME, record, sizeof(record), &reader)) {
+    readRecord(reader);
+    if (reader.version() != USERPWC_RECORD_VERSION) {
+      requestSave();  // rewrite it in the current layout
+    }
+    SS2K_LOG(CONFIG_LOG_TAG, "Config File Loaded: %s", userPWCRecordFILENAME);
     return;
   }
+  // No record yet, fall back to the JSON backup.
+  if (!importFromLittleFS()) {
+    SS2K_LOG(CONFIG_LOG_TAG, "Couldn't load PWC. Loading Defaults");
+    requestSave();
+  }
+}
+
+bool physicalWorkingCapacity::importFromLittleFS() {
+  SS2K_LOG(CONFIG_LOG_TAG, "Importing File: %s", userPWCFILENAME);
+  String content;
+  readConfigFile(userPWCFILENAME, &content);
+  if (content.isEmpty() || !importJSON(content)) {
+    return false;
+  }
+  requestSave();
+  SS2K_LOG(CONFIG_LOG_TAG, "Config File Imported: %s", userPWCFILENAME);
+  return true;
+}
 
-  StaticJsonDocument<500> doc;
+bool physicalWorkingCapacity::importJSON(const String &content) {
+  StaticJsonDocument<1024> doc;  // up to eight sessions
 
   // Deserialize the JSON document
-  DeserializationError error = deserializeJson(doc, file);
+  DeserializationError error = deserializeJson(doc, content);
   if (error) {
-    SS2K_LOG(CONFIG_LOG_TAG, "Failed to read file, using default configuration");
-    setDefaults();
-    return;
+    SS2K_LOG(CONFIG_LOG_TAG, "Failed to deserialize %s", userPWCFILENAME);
+    return false;
   }
 
   // Copy values from the JsonDocument to the Config
@@ -325,21 +650,13 @@ void physicalWorkingCapacity::loadFromLittleFS() {
   session2HR  = doc["session2HR"];
   session2Pwr = doc["session2Pwr"];
   hr2Pwr      = doc["hr2Pwr"];
-
-  SS2K_LOG(CONFIG_LOG_TAG, "Config File Loaded: %s", userPWCFILENAME);
-  file.close();
-}
-
-// Prints the content of a file to the Serial
-void physicalWorkingCapacity::printFile() {
-  // Open file for reading
-  SS2K_LOG(CONFIG_LOG_TAG, "Contents of file: %s", userPWCFILENAME);
-  File file = LittleFS.open(userPWCFILENAME);
-  if (!file) {
-    SS2K_LOG(CONFIG_LOG_TAG, "Failed to read file");
-    return;
+  for (size_t i = 0; i < HR_POWER_MAX_POINTS - 2; i++) {
+    char key[16];
+    snprintf(key, sizeof(key), "session%dHR", (int)i + 3);
+    extraSessions[i].hr = doc[key] | 0;
+    snprintf(key, sizeof(key), "session%dPwr", (int)i + 3);
+    extraSessions[i].watts = doc[key] | 0;
   }
-
-  // Close the file
-  file.close();
+  sessionsMeasured = doc["sessionsMeasured"] | !hasDefaultSessions();
+  return true;
 }
@@ -28,6 +28,175 @@ void process() {
     RUN_TEST(test.test_parses_speed);
   }
 
+  // Advertisement Filter
+  {
+    test_advertisementFilter test;
+    RUN_TEST(test.test_classifies_services);
+    RUN_TEST(test.test_matches_configured_names);
+  }
+
+  // Scan Result Cache
+  {
+    test_scanResultCache test;
+    RUN_TEST(test.test_updates_entries);
+    RUN_TEST(test.test_serializes_json);
+    RUN_TEST(test.test_finds_selected);
+  }
+
+  // BLE HID Remotes
+  {
+    test_hidRemote test;
+    RUN_TEST(test.test_decodes_reports);
+    RUN_TEST(test.test_maps_gestures);
+    RUN_TEST(test.test_resolves_waiting_press_first);
+  }
+
+  // Host Sensor Pipeline
+  {
+    test_sensorPipeline test;
+    RUN_TEST(test.test_encodes_server_data);
+    RUN_TEST(test.test_runs_end_to_end);
+    RUN_TEST(test.test_applies_sources);
+  }
+
+  // Packet Capture
+  {
+    test_packetCapture test;
+    RUN_TEST(test.test_records_ring);
+    RUN_TEST(test.test_replays_through_pipeline);
+  }
+
+  // Live Telemetry
+  {
+    test_telemetryDelta test;
+    RUN_TEST(test.test_sends_deltas);
+    RUN_TEST(test.test_keeps_unsent_values);
+  }
+
+  // Static Assets
+  {
+    test_assetManifest test;
+    RUN_TEST(test.test_loads_entries);
+    RUN_TEST(test.test_matches_etags);
+  }
+
+  // Streaming JSON
+  {
+    test_jsonWriter test;
+    RUN_TEST(test.test_writes_values);
+    RUN_TEST(test.test_streams_chunks);
+    RUN_TEST(test.test_serializes_chunked_once);
+  }
+
+  // Config Persistence
+  {
+    test_configFile test;
+    RUN_TEST(test.test_verifies_crc);
+    RUN_TEST(test.test_coalesces_saves);
+  }
+
+  // Device Selection
+  {
+    test_deviceSelection test;
+    RUN_TEST(test.test_classifies_values);
+    RUN_TEST(test.test_parses_addresses);
+  }
+
+  // SHA-1
+  {
+    test_sha1 test;
+    RUN_TEST(test.test_known_digests);
+    RUN_TEST(test.test_streams_updates);
+  }
+
+  // Asset Updater
+  {
+    test_assetUpdater test;
+    RUN_TEST(test.test_downloads_changed_files);
+    RUN_TEST(test.test_skips_matching_files_without_manifest);
+    RUN_TEST(test.test_resumes_interrupted_downloads);
+    RUN_TEST(test.test_rejects_bad_content);
+  }
+
+  // Update Check
+  {
+    test_updateCheck test;
+    RUN_TEST(test.test_parses_versions);
+    RUN_TEST(test.test_honors_interval);
+    RUN_TEST(test.test_round_trips);
+  }
+
+  // HR to Power Estimator
+  {
+    test_hrPowerEstimator test;
+    RUN_TEST(test.test_fits_points);
+    RUN_TEST(test.test_follows_efforts);
+    RUN_TEST(test.test_rates_confidence);
+  }
+
+  // PWC Calibration Collector
+  {
+    test_pwcCollector test;
+    RUN_TEST(test.test_fits_steady_efforts);
+    RUN_TEST(test.test_ignores_unsteady_riding);
+    RUN_TEST(test.test_refines_saved_sessions);
+    RUN_TEST(test.test_fades_seeded_sessions);
+  }
+
+  // Peloton Serial Framer
+  {
+    test_pelotonFramer test;
+    RUN_TEST(test.test_frames_split_reads);
+    RUN_TEST(test.test_rejects_damaged_frames);
+  }
+
+  // Peloton Request Scheduler
+  {
+    test_pelotonScheduler test;
+    RUN_TEST(test.test_pipelines_requests);
+    RUN_TEST(test.test_prioritizes_power_in_erg);
+    RUN_TEST(test.test_detects_disconnect);
+  }
+
+  // Peloton Serial Link
+  {
+    test_pelotonLink test;
+    RUN_TEST(test.test_reads_bike_values);
+    RUN_TEST(test.test_survives_line_noise);
+    RUN_TEST(test.test_reconnects_after_unplug);
+  }
+
+  // Stepper Driver Telemetry
+  {
+    test_driverTelemetry test;
+    RUN_TEST(test.test_decodes_status);
+    RUN_TEST(test.test_senses_stall_and_slip);
+    RUN_TEST(test.test_debounces_faults);
+  }
+
+  // Stepper Thermal Controller
+  {
+    test_thermalController test;
+    RUN_TEST(test.test_derates_in_proportion);
+    RUN_TEST(test.test_does_not_oscillate);
+    RUN_TEST(test.test_lowers_idle_hold_current);
+  }
+
+  // Boot Timeline
+  {
+    test_bootTimeline test;
+    RUN_TEST(test.test_records_phases);
+    RUN_TEST(test.test_drops_extra_phases);
+  }
+
+  // Binary Config Record
+  {
+    test_configRecord test;
+    RUN_TEST(test.test_round_trips);
+    RUN_TEST(test.test_rejects_damage);
+    RUN_TEST(test.test_round_trips_long_key_map);
+  }
+
   // ERG Mode
   {
     TestPowerBuffer testPowerBuffer;
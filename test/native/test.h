@@ -22,6 +22,153 @@ class test_cyclePowerData {
   static void test_parses_speed(void);
 };
 
+class test_advertisementFilter {
+ public:
+  static void test_classifies_services(void);
+  static void test_matches_configured_names(void);
+};
+
+class test_scanResultCache {
+ public:
+  static void test_updates_entries(void);
+  static void test_serializes_json(void);
+  static void test_finds_selected(void);
+};
+
+class test_hidRemote {
+ public:
+  static void test_decodes_reports(void);
+  static void test_maps_gestures(void);
+  static void test_resolves_waiting_press_first(void);
+};
+
+class test_sensorPipeline {
+ public:
+  static void test_runs_end_to_end(void);
+  static void test_applies_sources(void);
+  static void test_encodes_server_data(void);
+};
+
+class test_packetCapture {
+ public:
+  static void test_records_ring(void);
+  static void test_replays_through_pipeline(void);
+};
+
+class test_telemetryDelta {
+ public:
+  static void test_sends_deltas(void);
+  static void test_keeps_unsent_values(void);
+};
+
+class test_assetManifest {
+ public:
+  static void test_loads_entries(void);
+  static void test_matches_etags(void);
+};
+
+class test_jsonWriter {
+ public:
+  static void test_writes_values(void);
+  static void test_streams_chunks(void);
+  static void test_serializes_chunked_once(void);
+};
+
+class test_configFile {
+ public:
+  static void test_verifies_crc(void);
+  static void test_coalesces_saves(void);
+};
+
+class test_sha1 {
+ public:
+  static void test_known_digests(void);
+  static void test_streams_updates(void);
+};
+
+class test_assetUpdater {
+ public:
+  static void test_downloads_changed_files(void);
+  static void test_skips_matching_files_without_manifest(void);
+  static void test_resumes_interrupted_downloads(void);
+  static void test_rejects_bad_content(void);
+};
+
+class test_updateCheck {
+ public:
+  static void test_parses_versions(void);
+  static void test_honors_interval(void);
+  static void test_round_trips(void);
+};
+
+class test_hrPowerEstimator {
+ public:
+  static void test_fits_points(void);
+  static void test_follows_efforts(void);
+  static void test_rates_confidence(void);
+};
+
+class test_pwcCollector {
+ public:
+  static void test_fits_steady_efforts(void);
+  static void test_ignores_unsteady_riding(void);
+  static void test_refines_saved_sessions(void);
+  static void test_fades_seeded_sessions(void);
+};
+
+class test_pelotonFramer {
+ public:
+  static void test_frames_split_reads(void);
+  static void test_rejects_damaged_frames(void);
+};
+
+class test_pelotonScheduler {
+ public:
+  static void test_pipelines_requests(void);
+  static void test_prioritizes_power_in_erg(void);
+  static void test_detects_disconnect(void);
+};
+
+class test_pelotonLink {
+ public:
+  static void test_reads_bike_values(void);
+  static void test_survives_line_noise(void);
+  static void test_reconnects_after_unplug(void);
+};
+
+class test_driverTelemetry {
+ public:
+  static void test_decodes_status(void);
+  static void test_senses_stall_and_slip(void);
+  static void test_debounces_faults(void);
+};
+
+class test_thermalController {
+ public:
+  static void test_derates_in_proportion(void);
+  static void test_does_not_oscillate(void);
+  static void test_lowers_idle_hold_current(void);
+};
+
+class test_bootTimeline {
+ public:
+  static void test_records_phases(void);
+  static void test_drops_extra_phases(void);
+};
+
+class test_deviceSelection {
+ public:
+  static void test_classifies_values(void);
+  static void test_parses_addresses(void);
+};
+
+class test_configRecord {
+ public:
+  static void test_round_trips(void);
+  static void test_rejects_damage(void);
+  static void test_round_trips_long_key_map(void);
+};
+
 class TestPowerBuffer {
  public:
   static void set__should_set_values__expect_values_added_to_correct_index(void);
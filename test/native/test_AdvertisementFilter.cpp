@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include "AdvertisementFilter.h"
+#include "Constants.h"
+#include "test.h"
+
+// Flags, complete 16 bit UUID list (0x1818), complete name "ASSIOMA17287L"
+static uint8_t assioma[] = {0x02, 0x01, 0x06, 0x03, 0x03, 0x18, 0x18, 0x0e, 0x09, 'A', 'S', 'S', 'I', 'O', 'M', 'A', '1', '7', '2', '8', '7', 'L'};
+// Flags, 16 bit UUID list (0x180A, 0x180D), shortened name "HRM"
+static uint8_t hrm[] = {0x02, 0x01, 0x06, 0x05, 0x02, 0x0a, 0x18, 0x0d, 0x18, 0x04, 0x08, 'H', 'R', 'M'};
+// Heart rate and fitness machine in one advertisement. The trainer wins.
+static uint8_t trainer[] = {0x05, 0x03, 0x0d, 0x18, 0x26, 0x18, 0x04, 0x09, 'K', 'I', 'C'};
+// 16 bit HID UUID advertised in its expanded 128 bit form.
+static uint8_t remote[] = {0x11, 0x07, 0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x12, 0x18, 0x00, 0x00};
+// Flywheel UART service with and without the Flywheel name.
+static uint8_t flywheel[] = {0x11, 0x07, 0x9e, 0xca, 0xdc, 0x24, 0x0e, 0xe5, 0xa9, 0xe0, 0x93, 0xf3, 0xa3, 0xb5, 0x01, 0x00, 0x40, 0x6e,
+                             0x0b, 0x09, 'F',  'l',  'y',  'w',  'h',  'e',  'e',  'l',  ' ',  '1'};
+static uint8_t uart[]     = {0x11, 0x07, 0x9e, 0xca, 0xdc, 0x24, 0x0e, 0xe5, 0xa9, 0xe0, 0x93, 0xf3, 0xa3, 0xb5, 0x01, 0x00, 0x40, 0x6e, 0x04, 0x09, 'N', 'U', 'S'};
+// Length byte runs past the end of the payload.
+static uint8_t truncated[] = {0x03, 0x03, 0x18, 0x18, 0x09, 0x09, 'A'};
+
+void test_advertisementFilter::test_classifies_services(void) {
+  AdvertisementFilter filter;
+
+  AdvertisementFilter::Result result = filter.evaluate(assioma, sizeof(assioma));
+  TEST_ASSERT_EQUAL(AdvertisementFilter::POWER_METER, result.category);
+  TEST_ASSERT_TRUE(*result.service == CYCLINGPOWERSERVICE_UUID);
+  TEST_ASSERT_EQUAL(13, result.nameLength);
+
+  result = filter.evaluate(hrm, sizeof(hrm));
+  TEST_ASSERT_EQUAL(AdvertisementFilter::HEART_MONITOR, result.category);
+  TEST_ASSERT_EQUAL(3, result.nameLength);
+
+  result = filter.evaluate(trainer, sizeof(trainer));
+  TEST_ASSERT_EQUAL(AdvertisementFilter::POWER_METER, result.category);
+  TEST_ASSERT_TRUE(*result.service == FITNESSMACHINESERVICE_UUID);
+
+  result = filter.evaluate(remote, sizeof(remote));
+  TEST_ASSERT_EQUAL(AdvertisementFilter::REMOTE, result.category);
+
+  result = filter.evaluate(flywheel, sizeof(flywheel));
+  TEST_ASSERT_EQUAL(AdvertisementFilter::POWER_METER, result.category);
+  TEST_ASSERT_TRUE(*result.service == FLYWHEEL_UART_SERVICE_UUID);
+
+  result = filter.evaluate(uart, sizeof(uart));
+  TEST_ASSERT_EQUAL(AdvertisementFilter::NONE, result.category);
+  TEST_ASSERT_FALSE(result.selected);
+
+  result = filter.evaluate(truncated, sizeof(truncated));
+  TEST_ASSERT_EQUAL(AdvertisementFilter::POWER_METER, result.category);
+  TEST_ASSERT_NULL(result.name);
+}
+
+void test_advertisementFilter::test_matches_configured_names(void) {
+  AdvertisementFilter filter;
+  TEST_ASSERT_TRUE(filter.evaluate(assioma, sizeof(assioma)).selected);
+  TEST_ASSERT_TRUE(filter.evaluate(hrm, sizeof(hrm)).selected);
+
+  filter.configure("ASSIOMA17287L", "none", "any");
+  TEST_ASSERT_TRUE(filter.evaluate(assioma, sizeof(assioma)).selected);
+  TEST_ASSERT_FALSE(filter.evaluate(trainer, sizeof(trainer)).selected);
+  TEST_ASSERT_FALSE(filter.evaluate(hrm, sizeof(hrm)).selected);
+  TEST_ASSERT_TRUE(filter.evaluate(remote, sizeof(remote)).selected);
+  TEST_ASSERT_TRUE(filter.isEnabled(AdvertisementFilter::POWER_METER));
+  TEST_ASSERT_FALSE(filter.isEnabled(AdvertisementFilter::HEART_MONITOR));
+
+  filter.configure("ASSIOMA17287", "HRM", "none");
+  TEST_ASSERT_FALSE(filter.evaluate(assioma, sizeof(assioma)).selected);
+  TEST_ASSERT_TRUE(filter.evaluate(hrm, sizeof(hrm)).selected);
+  TEST_ASSERT_FALSE(filter.evaluate(remote, sizeof(remote)).selected);
+
+  filter.configure("e8:fe:6e:91:9f:16", "any", "any");
+  TEST_ASSERT_TRUE(filter.evaluate(assioma, sizeof(assioma), 0xe8fe6e919f16).selected);
+  TEST_ASSERT_FALSE(filter.evaluate(assioma, sizeof(assioma), 0xe8fe6e919f17).selected);
+  TEST_ASSERT_TRUE(filter.evaluate(hrm, sizeof(hrm), 0xe8fe6e919f17).selected);
+}
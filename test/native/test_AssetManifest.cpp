@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstring>
+#include "sdkconfig.h"
+#include <unity.h>
+#include "AssetManifest.h"
+#include "test.h"
+
+static const char manifest[] =
+    "# path\tsize\tgzip\thash\tmime\n"
+    "/index.html\t5120\t0\t0123456789abcdef\ttext/html\r\n"
+    "/jquery.js.gz\t30720\t1\tfedcba9876543210\tapplication/javascript\n"
+    "/style.css\t812\t1\t00112233aabbccdd\ttext/css\n"
+    "/broken.html\t12\t0\n"
+    "relative.html\t12\t0\t0123456789abcdef\ttext/html";
+
+void test_assetManifest::test_loads_entries(void) {
+  AssetManifest assets;
+  AssetManifest::Entry entry;
+
+  TEST_ASSERT_EQUAL(3, assets.load(manifest, strlen(manifest)));
+  TEST_ASSERT_TRUE(assets.find("/style.css", &entry));
+  TEST_ASSERT_EQUAL(812, entry.size);
+  TEST_ASSERT_TRUE(entry.gzip);
+  TEST_ASSERT_EQUAL_STRING("\"00112233aabbccdd\"", entry.etag);
+  TEST_ASSERT_EQUAL_STRING("text/css", entry.mime);
+  TEST_ASSERT_TRUE(assets.find("/index.html", &entry));
+  TEST_ASSERT_EQUAL_STRING("text/html", entry.mime);
+  TEST_ASSERT_FALSE(entry.gzip);
+  TEST_ASSERT_FALSE(assets.find("/broken.html", &entry));
+  TEST_ASSERT_FALSE(assets.find("relative.html", &entry));
+
+  // A replaced file is no longer described by the manifest.
+  assets.remove("/index.html");
+  TEST_ASSERT_FALSE(assets.find("/index.html", &entry));
+  TEST_ASSERT_TRUE(assets.find("/jquery.js.gz", &entry));
+  TEST_ASSERT_TRUE(entry.gzip);
+  TEST_ASSERT_EQUAL(2, assets.size());
+}
+
+void test_assetManifest::test_matches_etags(void) {
+  const char *etag = "\"0123456789abcdef\"";
+  TEST_ASSERT_TRUE(AssetManifest::etagMatches("\"0123456789abcdef\"", etag));
+  TEST_ASSERT_TRUE(AssetManifest::etagMatches("W/\"0123456789abcdef\"", etag));
+  TEST_ASSERT_TRUE(AssetManifest::etagMatches("\"aaaa\", \"0123456789abcdef\" ", etag));
+  TEST_ASSERT_TRUE(AssetManifest::etagMatches("*", etag));
+  TEST_ASSERT_FALSE(AssetManifest::etagMatches("\"0123456789abcde\"", etag));
+  TEST_ASSERT_FALSE(AssetManifest::etagMatches("", etag));
+  TEST_ASSERT_FALSE(AssetManifest::etagMatches(nullptr, etag));
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <string>
+#include "sdkconfig.h"
+#include <unity.h>
+#include "update/AssetUpdater.h"
+#include "update/HostUpdate.h"
+#include "test.h"
+
+static std::string contentHash(const std::string &content) {
+  Sha1 sha;
+  sha.update(reinterpret_cast<const uint8_t *>(content.data()), content.size());
+  char hex[17];
+  sha.finishHex(hex, 16);
+  return hex;
+}
+
+static std::string manifestLine(const std::string &path, const std::string &content, bool gzip, const char *mime) {
+  return path + "\t" + std::to_string(content.size()) + "\t" + (gzip ? "1" : "0") + "\t" + contentHash(content) + "\t" + mime + "\n";
+}
+
+static std::string pattern(size_t length, char seed) {
+  std::string content;
+  for (size_t i = 0; i < length; i++) {
+    content += (char)(seed + i % 23);
+  }
+  return content;
+}
+
+// Two pages and a gzipped script, listed under both of its names like build_asset_manifest.py does.
+static void publish(LocalHttpServer &server, const std::string &index, const std::string &style, const std::string &script) {
+  server.put("/index.html", index);
+  server.put("/style.css", style);
+  server.put("/jquery.js.gz", script);
+  server.put("/assets.manifest", "# path\tsize\tgzip\thash\tmime\n" + manifestLine("/index.html", index, false, "text/html") +
+                                     manifestLine("/style.css", style, false, "text/css") + manifestLine("/jquery.js.gz", script, true, "application/javascript") +
+                                     manifestLine("/jquery.js", script, true, "application/javascript"));
+}
+
+static size_t run(AssetUpdater &updater) {
+  updater.begin("/assets.manifest");
+  size_t steps = 0;
+  while (updater.step() && steps < 1000) {
+    steps++;
+  }
+  return steps;
+}
+
+void test_assetUpdater::test_downloads_changed_files(void) {
+  LocalHttpServer server;
+  MemoryStore store;
+  std::string index = pattern(2500, 'a');
+  publish(server, index, pattern(300, 'A'), pattern(5000, '0'));
+  store.files["/index.html"] = "old page";
+  store.files["/config.txt"] = "{}";
+
+  AssetUpdater updater(server, store);
+  run(updater);
+  TEST_ASSERT_EQUAL(AssetUpdater::DONE, updater.getState());
+  TEST_ASSERT_EQUAL(3, updater.getFilesChanged());
+  TEST_ASSERT_EQUAL(3, updater.getFilesUpdated());
+  TEST_ASSERT_EQUAL(7800, updater.getBytesDownloaded());
+  TEST_ASSERT_TRUE(store.files["/index.html"] == index);
+  TEST_ASSERT_TRUE(store.files["/jquery.js.gz"] == pattern(5000, '0'));
+  TEST_ASSERT_FALSE(store.exists("/jquery.js"));
+  TEST_ASSERT_FALSE(store.exists("/index.html.part"));
+  TEST_ASSERT_TRUE(store.files["/config.txt"] == "{}");
+  TEST_ASSERT_TRUE(store.files["/assets.manifest"].size() > 0);
+
+  // Nothing changed: only the manifest is fetched.
+  size_t requests = server.getRequests();
+  run(updater);
+  TEST_ASSERT_EQUAL(AssetUpdater::DONE, updater.getState());
+  TEST_ASSERT_EQUAL(0, updater.getFilesChanged());
+  TEST_ASSERT_EQUAL(requests + 1, server.getRequests());
+
+  // One file changed.
+  std::string style = pattern(400, 'B');
+  publish(server, index, style, pattern(5000, '0'));
+  run(updater);
+  TEST_ASSERT_EQUAL(1, updater.getFilesUpdated());
+  TEST_ASSERT_EQUAL(400, updater.getBytesDownloaded());
+  TEST_ASSERT_TRUE(store.files["/style.css"] == style);
+}
+
+void test_assetUpdater::test_skips_matching_files_without_manifest(void) {
+  LocalHttpServer server;
+  MemoryStore store;
+  std::string index = pattern(2500, 'a');
+  publish(server, index, pattern(300, 'A'), pattern(5000, '0'));
+  // Same content as the server, but the local manifest is gone (e.g. after an upload).
+  store.files["/index.html"]   = index;
+  store.files["/jquery.js.gz"] = pattern(5000, '0');
+
+  AssetUpdater updater(server, store);
+  run(updater);
+  TEST_ASSERT_EQUAL(AssetUpdater::DONE, updater.getState());
+  TEST_ASSERT_EQUAL(1, updater.getFilesUpdated());
+  TEST_ASSERT_EQUAL(300, updater.getBytesDownloaded());
+}
+
+void test_assetUpdater::test_resumes_interrupted_downloads(void) {
+  LocalHttpServer server;
+  MemoryStore store;
+  std::string script = pattern(5000, '0');
+  publish(server, pattern(10, 'a'), pattern(10, 'A'), script);
+
+  // The connection drops in the middle of the script, the retry continues with a range request.
+  AssetUpdater updater(server, store);
+  server.dropAfter(server.getBytesServed() + 1500);
+  updater.begin("/assets.manifest");
+  while (updater.step()) {
+  }
+  TEST_ASSERT_EQUAL(AssetUpdater::DONE, updater.getState());
+  TEST_ASSERT_TRUE(store.files["/jquery.js.gz"] == script);
+
+  // A reboot in the middle of a download: the next run picks up the .part file.
+  std::string newScript = pattern(5000, '5');
+  publish(server, pattern(10, 'a'), pattern(10, 'A'), newScript);
+  AssetUpdater first(server, store);
+  first.begin("/assets.manifest");
+  for (int i = 0; i < 3; i++) {
+    first.step();  // manifest, open, one chunk
+  }
+  TEST_ASSERT_EQUAL(ASSET_UPDATE_CHUNK_SIZE, store.files["/jquery.js.gz.part"].size());
+  TEST_ASSERT_TRUE(store.files["/jquery.js.gz"] == script);
+
+  AssetUpdater second(server, store);
+  run(second);
+  TEST_ASSERT_EQUAL(AssetUpdater::DONE, second.getState());
+  TEST_ASSERT_EQUAL(ASSET_UPDATE_CHUNK_SIZE, server.getLastOffset());
+  TEST_ASSERT_EQUAL(5000 - ASSET_UPDATE_CHUNK_SIZE, second.getBytesDownloaded());
+  TEST_ASSERT_TRUE(store.files["/jquery.js.gz"] == newScript);
+  TEST_ASSERT_FALSE(store.exists("/jquery.js.gz.part"));
+
+  // Without range support the download starts over.
+  server.setRangeSupport(false);
+  store.files["/style.css.part"] = pattern(5, 'A');
+  store.files["/style.css"]      = "changed";
+  run(second);
+  TEST_ASSERT_EQUAL(AssetUpdater::DONE, second.getState());
+  TEST_ASSERT_TRUE(store.files["/style.css"] == pattern(10, 'A'));
+}
+
+void test_assetUpdater::test_rejects_bad_content(void) {
+  LocalHttpServer server;
+  MemoryStore store;
+  publish(server, pattern(2500, 'a'), pattern(300, 'A'), pattern(5000, '0'));
+  server.put("/style.css", pattern(300, 'X'));  // doesn't match the manifest
+  store.files["/style.css"] = "old";
+
+  AssetUpdater updater(server, store);
+  run(updater);
+  TEST_ASSERT_EQUAL(AssetUpdater::FAILED, updater.getState());
+  TEST_ASSERT_EQUAL(AssetUpdater::FILES, updater.getFailedStep());
+  TEST_ASSERT_TRUE(store.files["/style.css"] == "old");
+  TEST_ASSERT_FALSE(store.exists("/style.css.part"));
+  TEST_ASSERT_FALSE(store.exists("/assets.manifest"));
+
+  // No manifest on the server
+  LocalHttpServer empty;
+  AssetUpdater offline(empty, store);
+  run(offline);
+  TEST_ASSERT_EQUAL(AssetUpdater::FAILED, offline.getState());
+  TEST_ASSERT_EQUAL(AssetUpdater::MANIFEST, offline.getFailedStep());
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include "BootTimeline.h"
+#include "test.h"
+
+void test_bootTimeline::test_records_phases(void) {
+  BootTimeline timeline;
+  TEST_ASSERT_EQUAL(120, timeline.mark("config", 120));
+  TEST_ASSERT_EQUAL(35, timeline.mark("stepper", 155));
+  TEST_ASSERT_EQUAL(410, timeline.mark("ble", 565));
+  TEST_ASSERT_EQUAL(3, timeline.size());
+
+  char buffer[128];
+  JsonWindow window(buffer, sizeof(buffer) - 1, 0);
+  JsonWriter json(window);
+  timeline.writeJSON(json);
+  buffer[window.size()] = '\0';
+  TEST_ASSERT_EQUAL_STRING("{\"config\":120,\"stepper\":155,\"ble\":565}", buffer);
+
+  // A copy is unaffected by later marks.
+  BootTimeline snapshot(timeline);
+  timeline.mark("wifi", 900);
+  TEST_ASSERT_EQUAL(3, snapshot.size());
+  TEST_ASSERT_EQUAL(4, timeline.size());
+}
+
+void test_bootTimeline::test_drops_extra_phases(void) {
+  BootTimeline timeline;
+  for (int i = 0; i < BOOT_TIMELINE_MAX_PHASES + 4; i++) {
+    timeline.mark("phase", i * 10);
+  }
+  TEST_ASSERT_EQUAL(BOOT_TIMELINE_MAX_PHASES, timeline.size());
+  // Still reports the time since the previous mark.
+  TEST_ASSERT_EQUAL(25, timeline.mark("late", (BOOT_TIMELINE_MAX_PHASES + 3) * 10 + 25));
+}
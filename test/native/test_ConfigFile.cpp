@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstring>
+#include <string>
+#include "sdkconfig.h"
+#include <unity.h>
+#include "ConfigFile.h"
+#include "test.h"
+
+void test_configFile::test_verifies_crc(void) {
+  // Standard check value
+  TEST_ASSERT_EQUAL_HEX32(0xcbf43926, ConfigFile::crc32(reinterpret_cast<const uint8_t *>("123456789"), 9));
+  TEST_ASSERT_EQUAL_HEX32(0xcbf43926, ConfigFile::crc32(reinterpret_cast<const uint8_t *>("6789"), 4, ConfigFile::crc32(reinterpret_cast<const uint8_t *>("12345"), 5)));
+
+  std::string content = "{\"shiftStep\":1200}";
+  char trailer[CONFIG_FILE_TRAILER_LENGTH + 1];
+  TEST_ASSERT_EQUAL(CONFIG_FILE_TRAILER_LENGTH, ConfigFile::trailer(ConfigFile::crc32(reinterpret_cast<const uint8_t *>(content.data()), content.size()), trailer));
+  std::string file = content + trailer;
+
+  size_t length;
+  TEST_ASSERT_EQUAL(ConfigFile::VALID, ConfigFile::verify(file.data(), file.size(), &length));
+  TEST_ASSERT_EQUAL(content.size(), length);
+
+  // Truncated mid write, bit flip, or written before the trailer existed.
+  TEST_ASSERT_EQUAL(ConfigFile::UNCHECKED, ConfigFile::verify(file.data(), content.size() - 3, &length));
+  TEST_ASSERT_EQUAL(content.size() - 3, length);
+  std::string flipped = file;
+  flipped[5] ^= 0x01;
+  TEST_ASSERT_EQUAL(ConfigFile::CORRUPT, ConfigFile::verify(flipped.data(), flipped.size(), &length));
+  TEST_ASSERT_EQUAL(ConfigFile::UNCHECKED, ConfigFile::verify(content.data(), content.size(), &length));
+  // Trailer without its final newline still counts.
+  TEST_ASSERT_EQUAL(ConfigFile::VALID, ConfigFile::verify(file.data(), file.size() - 1, &length));
+}
+
+void test_configFile::test_coalesces_saves(void) {
+  SaveDebouncer saves;
+  TEST_ASSERT_FALSE(saves.claimSave(0, true));
+
+  // A burst of changes is written once, after it settles.
+  saves.markDirty(1000);
+  saves.markDirty(1500);
+  TEST_ASSERT_FALSE(saves.claimSave(1500 + CONFIG_SAVE_DEBOUNCE_MILLIS - 1));
+  TEST_ASSERT_TRUE(saves.claimSave(1500 + CONFIG_SAVE_DEBOUNCE_MILLIS));
+  TEST_ASSERT_FALSE(saves.isDirty());
+  TEST_ASSERT_FALSE(saves.claimSave(10000));
+
+  // Changes that never settle are still written.
+  uint32_t now = 20000;
+  for (; now < 20000 + CONFIG_SAVE_MAX_DELAY_MILLIS; now += 500) {
+    saves.markDirty(now);
+    TEST_ASSERT_FALSE(saves.claimSave(now));
+  }
+  saves.markDirty(now);
+  TEST_ASSERT_TRUE(saves.claimSave(now));
+
+  // Forced before a reboot.
+  saves.markDirty(now);
+  TEST_ASSERT_TRUE(saves.claimSave(now, true));
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include <cstdio>
+#include <string>
+#include "ConfigRecord.h"
+#include "HIDKeyMapper.h"
+#include "test.h"
+
+void test_configRecord::test_round_trips(void) {
+  uint8_t buffer[128];
+  ConfigRecordWriter writer(buffer, sizeof(buffer), 2);
+  writer.putString("SmartSpin2k");
+  writer.putInt(-1200);
+  writer.putFloat(0.1f);
+  writer.putBool(true);
+  writer.putString("");
+  size_t length = writer.finish();
+  TEST_ASSERT_EQUAL(CONFIG_RECORD_HEADER_SIZE + 12 + 4 + 4 + 1 + 1, length);
+
+  ConfigRecordReader reader;
+  char name[32];
+  char empty[4] = "x";
+  TEST_ASSERT_TRUE(reader.open(buffer, length));
+  TEST_ASSERT_EQUAL(2, reader.version());
+  TEST_ASSERT_TRUE(reader.getString(name, sizeof(name)));
+  TEST_ASSERT_EQUAL_STRING("SmartSpin2k", name);
+  TEST_ASSERT_EQUAL(-1200, reader.getInt(0));
+  TEST_ASSERT_EQUAL_FLOAT(0.1f, reader.getFloat(0));
+  TEST_ASSERT_TRUE(reader.getBool(false));
+  TEST_ASSERT_TRUE(reader.getString(empty, sizeof(empty)));
+  TEST_ASSERT_EQUAL_STRING("", empty);
+
+  // Fields added by a newer version keep their defaults.
+  TEST_ASSERT_EQUAL(100, reader.getInt(100));
+  TEST_ASSERT_FALSE(reader.getString(name, sizeof(name)));
+  TEST_ASSERT_EQUAL_STRING("SmartSpin2k", name);
+
+  // Strings are truncated to the buffer.
+  TEST_ASSERT_TRUE(reader.open(buffer, length));
+  TEST_ASSERT_TRUE(reader.getString(name, 6));
+  TEST_ASSERT_EQUAL_STRING("Smart", name);
+  TEST_ASSERT_EQUAL(-1200, reader.getInt(0));
+}
+
+void test_configRecord::test_rejects_damage(void) {
+  uint8_t buffer[32];
+  ConfigRecordWriter writer(buffer, sizeof(buffer), 1);
+  writer.putInt(1);
+  size_t length = writer.finish();
+
+  ConfigRecordReader reader;
+  TEST_ASSERT_FALSE(reader.open(buffer, length - 1));
+  buffer[CONFIG_RECORD_HEADER_SIZE] ^= 0x80;
+  TEST_ASSERT_FALSE(reader.open(buffer, length));
+  TEST_ASSERT_EQUAL(5, reader.getInt(5));
+  const uint8_t json[] = "{\"shiftStep\":1200}";
+  TEST_ASSERT_FALSE(reader.open(json, sizeof(json)));
+
+  // Too small a buffer
+  ConfigRecordWriter small(buffer, CONFIG_RECORD_HEADER_SIZE + 3, 1);
+  small.putInt(1);
+  TEST_ASSERT_EQUAL(0, small.finish());
+}
+
+void test_configRecord::test_round_trips_long_key_map(void) {
+  // 16 bindings, well past the 255 characters a length byte allows
+  std::string map;
+  for (int i = 0; i < HID_KEY_MAP_SIZE; i++) {
+    char binding[32];
+    snprintf(binding, sizeof(binding), "%sc0%02x.double=ergDown", i ? "," : "", 0xe0 + i);
+    map += binding;
+  }
+  TEST_ASSERT_TRUE(map.size() > 255);
+
+  uint8_t buffer[1024];
+  ConfigRecordWriter writer(buffer, sizeof(buffer), 2);
+  writer.putLongString(map.c_str());
+  writer.putInt(7);
+  size_t length = writer.finish();
+
+  ConfigRecordReader reader;
+  char text[512];
+  TEST_ASSERT_TRUE(reader.open(buffer, length));
+  TEST_ASSERT_TRUE(reader.getLongString(text, sizeof(text)));
+  TEST_ASSERT_EQUAL_STRING(map.c_str(), text);
+  TEST_ASSERT_EQUAL(7, reader.getInt(0));
+  HIDKeyMapper mapper;
+  TEST_ASSERT_TRUE(mapper.configure(text));
+  TEST_ASSERT_EQUAL(HID_KEY_MAP_SIZE, mapper.size());
+
+  // Maps too long for the setting are cut after a whole binding.
+  size_t fit = HIDKeyMapper::fitBindings(map.c_str(), 100);
+  TEST_ASSERT_EQUAL(5 * 19 + 4, fit);
+  TEST_ASSERT_EQUAL(',', map[fit]);
+  TEST_ASSERT_TRUE(mapper.configure(map.substr(0, fit).c_str()));
+  TEST_ASSERT_EQUAL(5, mapper.size());
+  TEST_ASSERT_EQUAL(map.size(), HIDKeyMapper::fitBindings(map.c_str(), map.size()));
+}
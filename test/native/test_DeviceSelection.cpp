@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <cstring>
+#include <unity.h>
+#include "DeviceSelection.h"
+#include "test.h"
+
+void test_deviceSelection::test_classifies_values(void) {
+  DeviceSelection selection;
+  TEST_ASSERT_EQUAL(DeviceSelection::ANY, selection.getMode());
+  TEST_ASSERT_EQUAL_STRING("any", selection.c_str());
+  TEST_ASSERT_TRUE(selection.matches("HRM", 3, 1));
+
+  selection.set("none");
+  TEST_ASSERT_EQUAL(DeviceSelection::NONE, selection.getMode());
+  TEST_ASSERT_FALSE(selection.isSpecific());
+  TEST_ASSERT_FALSE(selection.matches("HRM", 3, 1));
+
+  selection.set("");
+  TEST_ASSERT_EQUAL(DeviceSelection::ANY, selection.getMode());
+  selection.set(nullptr);
+  TEST_ASSERT_EQUAL_STRING("any", selection.c_str());
+
+  selection.set("HRM");
+  TEST_ASSERT_EQUAL(DeviceSelection::NAME, selection.getMode());
+  TEST_ASSERT_TRUE(selection.isSpecific());
+  TEST_ASSERT_TRUE(selection.matches("HRM", 3, 1));
+  TEST_ASSERT_FALSE(selection.matches("HRM2", 4, 1));
+  TEST_ASSERT_FALSE(selection.matches("hrm", 3, 1));
+  TEST_ASSERT_FALSE(selection.matches(nullptr, 0, 1));
+
+  selection.set("E8:FE:6E:91:9F:16");
+  TEST_ASSERT_EQUAL(DeviceSelection::ADDRESS, selection.getMode());
+  TEST_ASSERT_TRUE(selection.matches(nullptr, 0, 0xe8fe6e919f16));
+  TEST_ASSERT_FALSE(selection.matches("E8:FE:6E:91:9F:16", 17, 0));
+
+  // A long name is truncated to what an advertisement can carry.
+  selection.set("0123456789012345678901234567890123456789");
+  TEST_ASSERT_EQUAL(DEVICE_SELECTION_MAX_LENGTH, strlen(selection.c_str()));
+}
+
+void test_deviceSelection::test_parses_addresses(void) {
+  uint64_t address = 0;
+  TEST_ASSERT_TRUE(DeviceSelection::parseAddress("00:11:22:aa:bb:cc", &address));
+  TEST_ASSERT_TRUE(address == 0x001122aabbccull);
+  TEST_ASSERT_FALSE(DeviceSelection::parseAddress("00:11:22:aa:bb", &address));
+  TEST_ASSERT_FALSE(DeviceSelection::parseAddress("00:11:22:aa:bb:cc:dd", &address));
+  TEST_ASSERT_FALSE(DeviceSelection::parseAddress("00-11-22-aa-bb-cc", &address));
+  TEST_ASSERT_FALSE(DeviceSelection::parseAddress("00:11:22:aa:bb:cg", &address));
+  TEST_ASSERT_TRUE(address == 0x001122aabbccull);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include "DriverTelemetry.h"
+#include "test.h"
+
+// DRV_STATUS with StealthChop on and the given current scale.
+static uint32_t drvStatus(uint8_t current, uint32_t flags = 0) { return (1UL << 30) | ((uint32_t)current << 16) | flags; }
+
+void test_driverTelemetry::test_decodes_status(void) {
+  DriverTelemetry telemetry;
+  // otpw, t120 and t143, cs_actual 17, standstill
+  telemetry.update(drvStatus(17, (1UL << 0) | (1UL << 8) | (1UL << 9) | (1UL << 31)), 0x00150060, false);
+  DriverTelemetry::Status status = telemetry.getStatus();
+  TEST_ASSERT_TRUE(status.responding);
+  TEST_ASSERT_TRUE(status.overTempWarning);
+  TEST_ASSERT_FALSE(status.overTemp);
+  TEST_ASSERT_FALSE(status.shortCircuit);
+  TEST_ASSERT_EQUAL(143, status.temperature);
+  TEST_ASSERT_EQUAL(17, status.current);
+  TEST_ASSERT_TRUE(status.stealthChop);
+  TEST_ASSERT_TRUE(status.standstill);
+  TEST_ASSERT_EQUAL(0x60, status.load);
+  TEST_ASSERT_EQUAL(1, status.reads);
+
+  telemetry.update(drvStatus(31, (1UL << 1) | (1UL << 3)), 0, false);
+  status = telemetry.getStatus();
+  TEST_ASSERT_FALSE(status.overTempWarning);
+  TEST_ASSERT_TRUE(status.overTemp);
+  TEST_ASSERT_TRUE(status.shortCircuit);
+  TEST_ASSERT_EQUAL(0, status.temperature);
+  TEST_ASSERT_EQUAL(31, status.current);
+}
+
+void test_driverTelemetry::test_senses_stall_and_slip(void) {
+  DriverTelemetry telemetry;
+  for (int i = 0; i < DRIVER_LOAD_SETTLE_READS; i++) {
+    telemetry.update(drvStatus(20), 100 + i % 3, true);
+  }
+  DriverTelemetry::Status status = telemetry.getStatus();
+  TEST_ASSERT_FLOAT_WITHIN(2, 101, status.loadAverage);
+  TEST_ASSERT_FALSE(status.stalled);
+
+  // Knob against something it can't turn.
+  for (int i = 0; i < DRIVER_FAULT_READS; i++) {
+    telemetry.update(drvStatus(31), 255, true);
+  }
+  status = telemetry.getStatus();
+  TEST_ASSERT_TRUE(status.stalled);
+  TEST_ASSERT_FLOAT_WITHIN(2, 101, status.loadAverage);  // not dragged up by the stall
+  telemetry.update(drvStatus(20), 100, true);
+  status = telemetry.getStatus();
+  TEST_ASSERT_FALSE(status.stalled);
+
+  // Knob turning freely on its shaft.
+  for (int i = 0; i < DRIVER_FAULT_READS; i++) {
+    telemetry.update(drvStatus(20), 30, true);
+  }
+  status = telemetry.getStatus();
+  TEST_ASSERT_TRUE(status.slipping);
+
+  // Nothing to sense at rest or in SpreadCycle.
+  telemetry.update(drvStatus(20), 30, false);
+  status = telemetry.getStatus();
+  TEST_ASSERT_FALSE(status.slipping);
+  for (int i = 0; i < DRIVER_FAULT_READS; i++) {
+    telemetry.update(20UL << 16, 255, true);
+  }
+  status = telemetry.getStatus();
+  TEST_ASSERT_FALSE(status.stalled);
+}
+
+void test_driverTelemetry::test_debounces_faults(void) {
+  DriverTelemetry telemetry;
+  uint32_t openLoad = (1UL << 6);
+  // Open load at standstill is noise.
+  for (int i = 0; i < 5; i++) {
+    telemetry.update(drvStatus(10, openLoad | (1UL << 31)), 50, true);
+  }
+  DriverTelemetry::Status status = telemetry.getStatus();
+  TEST_ASSERT_FALSE(status.openLoad);
+  // A single flicker while moving too.
+  telemetry.update(drvStatus(10, openLoad), 50, true);
+  telemetry.update(drvStatus(10), 50, true);
+  status = telemetry.getStatus();
+  TEST_ASSERT_FALSE(status.openLoad);
+  for (int i = 0; i < DRIVER_FAULT_READS; i++) {
+    telemetry.update(drvStatus(10, openLoad), 50, true);
+  }
+  status = telemetry.getStatus();
+  TEST_ASSERT_TRUE(status.openLoad);
+
+  // Driver without motor power doesn't answer.
+  telemetry.readFailed();
+  status = telemetry.getStatus();
+  TEST_ASSERT_TRUE(status.responding);
+  for (int i = 1; i < DRIVER_FAULT_READS; i++) {
+    telemetry.readFailed();
+  }
+  status = telemetry.getStatus();
+  TEST_ASSERT_FALSE(status.responding);
+  TEST_ASSERT_EQUAL(DRIVER_FAULT_READS, status.failures);
+  telemetry.update(drvStatus(10), 50, false);
+  status = telemetry.getStatus();
+  TEST_ASSERT_TRUE(status.responding);
+}
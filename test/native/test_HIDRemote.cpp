@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include "HIDKeyMapper.h"
+#include "HIDReportMap.h"
+#include "test.h"
+
+// Mouse style remote: 5 buttons, 3 bits padding, X/Y axes.
+static uint8_t buttonMap[] = {0x05, 0x01, 0x09, 0x02, 0xa1, 0x01, 0x09, 0x01, 0xa1, 0x00, 0x05, 0x09, 0x19, 0x01, 0x29, 0x05, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01,
+                              0x95, 0x05, 0x81, 0x02, 0x75, 0x03, 0x95, 0x01, 0x81, 0x01, 0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x15, 0x81, 0x25, 0x7f, 0x75, 0x08,
+                              0x95, 0x02, 0x81, 0x06, 0xc0, 0xc0};
+// Media remote: report 1 is a keyboard, report 2 a 16 bit consumer control array.
+static uint8_t mediaMap[] = {0x05, 0x01, 0x09, 0x06, 0xa1, 0x01, 0x85, 0x01, 0x05, 0x07, 0x19, 0x00, 0x29, 0xff, 0x15, 0x00, 0x26, 0xff, 0x00, 0x75, 0x08, 0x95,
+                             0x01, 0x81, 0x00, 0xc0, 0x05, 0x0c, 0x09, 0x01, 0xa1, 0x01, 0x85, 0x02, 0x19, 0x00, 0x2a, 0x3c, 0x02, 0x15, 0x00, 0x26, 0x3c, 0x02,
+                             0x75, 0x10, 0x95, 0x01, 0x81, 0x00, 0xc0};
+
+void test_hidRemote::test_decodes_reports(void) {
+  HIDReportMap map;
+  uint8_t report[3] = {0x04, 0x10, 0xf0};
+  // No map: raw first non-zero byte.
+  TEST_ASSERT_EQUAL_HEX16(0x0004, map.decode(0, report, sizeof(report)));
+
+  TEST_ASSERT_TRUE(map.parse(buttonMap, sizeof(buttonMap)));
+  TEST_ASSERT_EQUAL(1, map.fieldCount());
+  TEST_ASSERT_EQUAL_HEX16(0x9003, map.decode(0, report, sizeof(report)));
+  report[0] = 0x00;  // axes only, no buttons
+  TEST_ASSERT_EQUAL_HEX16(0x0000, map.decode(0, report, sizeof(report)));
+
+  TEST_ASSERT_TRUE(map.parse(mediaMap, sizeof(mediaMap)));
+  TEST_ASSERT_EQUAL(2, map.fieldCount());
+  uint8_t volumeUp[2] = {0xe9, 0x00};
+  TEST_ASSERT_EQUAL_HEX16(0xc0e9, map.decode(2, volumeUp, sizeof(volumeUp)));
+  uint8_t keyA[1] = {0x04};
+  TEST_ASSERT_EQUAL_HEX16(0x7004, map.decode(1, keyA, sizeof(keyA)));
+  uint8_t released[2] = {0x00, 0x00};
+  TEST_ASSERT_EQUAL_HEX16(0x0000, map.decode(2, released, sizeof(released)));
+}
+
+void test_hidRemote::test_maps_gestures(void) {
+  HIDKeyMapper mapper;
+  TEST_ASSERT_FALSE(mapper.configure("9003=up,9004=down,9004.long=ergDown,c0e9.double=mode,c0e9=up,bogus=up,9005.triple=up"));
+  TEST_ASSERT_EQUAL(5, mapper.size());
+
+  // Press only: fires on key down.
+  TEST_ASSERT_EQUAL(HIDKeyMapper::SHIFT_UP, mapper.update(0x9003, 1000));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0x9003, 1010));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0, 1050));
+
+  // Short press of a key with a long binding fires on release.
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0x9004, 2000));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::SHIFT_DOWN, mapper.update(0, 2100));
+
+  // Long press fires while held, release does nothing.
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0x9004, 3000));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.poll(3000 + HID_LONG_PRESS_MILLIS - 1));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::ERG_DOWN, mapper.poll(3000 + HID_LONG_PRESS_MILLIS));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0, 4000));
+
+  // Double press.
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0xc0e9, 5000));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0, 5080));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::TOGGLE_MODE, mapper.update(0xc0e9, 5200));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0, 5280));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.poll(6000));
+
+  // Single press of a double press key fires once the window closes.
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0xc0e9, 7000));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0, 7080));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.poll(7080 + HID_MULTI_PRESS_MILLIS));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::SHIFT_UP, mapper.poll(7080 + HID_MULTI_PRESS_MILLIS + 1));
+
+  // Unbound keys do nothing.
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0x7004, 8000));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0, 8050));
+}
+
+void test_hidRemote::test_resolves_waiting_press_first(void) {
+  HIDKeyMapper mapper;
+  TEST_ASSERT_TRUE(mapper.configure("9003=up,9004=down,9004.long=ergDown,c0e9=up,c0e9.double=mode"));
+
+  // Short press of 9004 still waiting for the long press decision when 9003 goes down.
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0x9004, 1000));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::SHIFT_DOWN, mapper.update(0x9003, 1100));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::SHIFT_UP, mapper.poll(1100));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.poll(1100));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0, 1150));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.poll(3000));
+
+  // c0e9 released and waiting for a second press when 9003 goes down.
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0xc0e9, 4000));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.update(0, 4050));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::SHIFT_UP, mapper.update(0x9003, 4100));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::SHIFT_UP, mapper.poll(4100));
+  TEST_ASSERT_EQUAL(HIDKeyMapper::NO_ACTION, mapper.poll(5000));
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include <cmath>
+#include "HRPowerEstimator.h"
+#include "test.h"
+
+void test_hrPowerEstimator::test_fits_points(void) {
+  HRPowerEstimator estimator;
+  HRPowerPoint two[] = {{129, 100}, {154, 150}};
+  TEST_ASSERT_TRUE(estimator.setCalibration(two, 2));
+  TEST_ASSERT_TRUE(estimator.isCalibrated());
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 2.0, estimator.getGradient());
+  TEST_ASSERT_FLOAT_WITHIN(0.01, -158.0, estimator.getIntercept());
+  TEST_ASSERT_FALSE(estimator.setCalibration(two, 2));
+
+  // Least squares through scattered sessions, unused ones (0) are skipped.
+  HRPowerPoint four[] = {{120, 100}, {0, 0}, {140, 150}, {160, 190}, {130, 130}};
+  TEST_ASSERT_TRUE(estimator.setCalibration(four, 5));
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 2.2, estimator.getGradient());
+  TEST_ASSERT_FLOAT_WITHIN(0.1, -160, estimator.getIntercept());
+  TEST_ASSERT_TRUE(estimator.getR2() > 0.95 && estimator.getR2() < 1);
+
+  // One heart rate or power falling with heart rate can't be used.
+  HRPowerPoint flat[] = {{140, 100}, {140, 150}};
+  estimator.setCalibration(flat, 2);
+  TEST_ASSERT_FALSE(estimator.isCalibrated());
+  TEST_ASSERT_EQUAL(0, (int)estimator.update(140, 0));
+  HRPowerPoint falling[] = {{120, 150}, {140, 100}};
+  estimator.setCalibration(falling, 2);
+  TEST_ASSERT_FALSE(estimator.isCalibrated());
+}
+
+void test_hrPowerEstimator::test_follows_efforts(void) {
+  HRPowerEstimator estimator;
+  HRPowerPoint points[] = {{129, 100}, {154, 150}};
+  estimator.setCalibration(points, 2);
+
+  // The rider steps from 100 W to 150 W at 30 s. Heart rate follows with a 30 s
+  // lag and the monitor reports whole bpm once a second, the estimator runs at 10 Hz.
+  float hr = 129;
+  for (int tick = 0; tick <= 420; tick++) {
+    if (tick % 10 == 0) {
+      float target = tick < 300 ? 129 : 154;
+      hr += (target - hr) * (1 - expf(-1.0f / 30));
+    }
+    estimator.update(roundf(hr), tick * 100);
+    if (tick == 290) {
+      TEST_ASSERT_FLOAT_WITHIN(1, 100, estimator.getWatts());
+      TEST_ASSERT_FLOAT_WITHIN(0.01, 0.5, estimator.getConfidence());
+    }
+  }
+  // 12 s after the step heart rate (138) is only a third of the way there,
+  // the estimate is already close to the new power.
+  TEST_ASSERT_TRUE(roundf(hr) < 140);
+  TEST_ASSERT_FLOAT_WITHIN(10, 150, estimator.getWatts());
+  // Less sure while correcting for the lag.
+  TEST_ASSERT_TRUE(estimator.getConfidence() < 0.45);
+}
+
+void test_hrPowerEstimator::test_rates_confidence(void) {
+  HRPowerEstimator two;
+  HRPowerPoint twoPoints[] = {{129, 100}, {154, 150}};
+  two.setCalibration(twoPoints, 2);
+  two.update(140, 0);
+
+  HRPowerEstimator four;
+  HRPowerPoint fourPoints[] = {{120, 80}, {130, 100}, {140, 120}, {150, 140}};
+  four.setCalibration(fourPoints, 4);
+  four.update(140, 0);
+  TEST_ASSERT_TRUE(four.getConfidence() > two.getConfidence());
+
+  // Extrapolating far above the calibrated heart rates.
+  four.reset();
+  four.update(180, 0);
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 200, four.getWatts());
+  TEST_ASSERT_TRUE(four.getConfidence() < 0.3);
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <string>
+#include "sdkconfig.h"
+#include <unity.h>
+#include "JsonWriter.h"
+#include "test.h"
+
+class StringOutput : public JsonOutput {
+ public:
+  std::string text;
+  void write(const char *data, size_t length) override { text.append(data, length); }
+};
+
+static void writeConfig(JsonWriter &json) {
+  json.beginObject();
+  json.add("deviceName", "Smart\"Spin\"\\2k\n");
+  json.add("shiftStep", 1200).add("maxWatts", 800L);
+  json.add("inclineMultiplier", 3.0f).add("ERGSensitivity", 0.1f).add("speed", -12.5);
+  json.add("autoUpdate", true).add("logComm", false);
+  json.add("ssid", (const char *)nullptr);
+  json.endObject();
+}
+
+void test_jsonWriter::test_writes_values(void) {
+  StringOutput out;
+  JsonWriter json(out);
+  writeConfig(json);
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"deviceName\":\"Smart\\\"Spin\\\"\\\\2k\\u000a\",\"shiftStep\":1200,\"maxWatts\":800,"
+      "\"inclineMultiplier\":3,\"ERGSensitivity\":0.1,\"speed\":-12.5,\"autoUpdate\":true,\"logComm\":false,\"ssid\":null}",
+      out.text.c_str());
+}
+
+void test_jsonWriter::test_streams_chunks(void) {
+  StringOutput full;
+  JsonWriter fullJson(full);
+  writeConfig(fullJson);
+
+  // Regenerate the document for every 7 byte chunk, the way a chunked response asks for it.
+  std::string chunked;
+  char chunk[7];
+  for (size_t index = 0;;) {
+    JsonWindow window(chunk, sizeof(chunk), index);
+    JsonWriter json(window);
+    writeConfig(json);
+    TEST_ASSERT_EQUAL(full.text.size(), window.total());
+    if (window.size() == 0) {
+      break;
+    }
+    chunked.append(chunk, window.size());
+    index += window.size();
+  }
+  TEST_ASSERT_EQUAL_STRING(full.text.c_str(), chunked.c_str());
+}
+
+// Reads the whole document 7 bytes at a time.
+static std::string readChunks(JsonChunker &chunker) {
+  std::string chunked;
+  char chunk[7];
+  size_t length;
+  while ((length = chunker.read(chunk, sizeof(chunk), chunked.size())) > 0) {
+    chunked.append(chunk, length);
+  }
+  return chunked;
+}
+
+void test_jsonWriter::test_serializes_chunked_once(void) {
+  StringOutput full;
+  JsonWriter fullJson(full);
+  writeConfig(fullJson);
+
+  // Fits the buffer: sized, then serialized once.
+  JsonChunker chunker(writeConfig, 1024);
+  TEST_ASSERT_EQUAL_STRING(full.text.c_str(), readChunks(chunker).c_str());
+  TEST_ASSERT_EQUAL(2, chunker.serializations());
+
+  // Bigger than the buffer: once per buffer full, not once per chunk.
+  JsonChunker small(writeConfig, 64);
+  TEST_ASSERT_EQUAL_STRING(full.text.c_str(), readChunks(small).c_str());
+  TEST_ASSERT_EQUAL(1 + (full.text.size() + 63) / 64, small.serializations());
+
+  // A chunk asked for again, e.g. after a retry, still lines up.
+  char chunk[7];
+  size_t length = small.read(chunk, sizeof(chunk), 3);
+  TEST_ASSERT_EQUAL(7, length);
+  TEST_ASSERT_EQUAL_STRING(full.text.substr(3, 7).c_str(), std::string(chunk, length).c_str());
+}
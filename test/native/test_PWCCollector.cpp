@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include <cmath>
+#include <cstring>
+#include "PWCCollector.h"
+#include "test.h"
+
+// Rides blocks of constant power for seconds each at 1 Hz. Steady state heart
+// rate is 79 + watts / 2 and heart rate follows it with a 30 s lag. Power
+// readings wobble by up to 8 W like a real power meter.
+static int ride(PWCCollector &collector, const int *watts, size_t blocks, int seconds, uint32_t *now, float *hr) {
+  int fits = 0;
+  for (size_t block = 0; block < blocks; block++) {
+    for (int second = 0; second < seconds; second++) {
+      *hr += (79 + watts[block] / 2.0f - *hr) * (1 - expf(-1.0f / 30));
+      int reading = watts[block] + ((second * 7) % 17) - 8;
+      *now += 1000;
+      fits += collector.update((int)roundf(*hr), reading, *now) ? 1 : 0;
+    }
+  }
+  return fits;
+}
+
+void test_pwcCollector::test_fits_steady_efforts(void) {
+  PWCCollector collector;
+  uint32_t now = 0;
+  float hr     = 90;
+  int steps[]  = {100, 150, 200};
+  int fits     = ride(collector, steps, 3, 240, &now, &hr);
+  TEST_ASSERT_EQUAL(1, fits);
+
+  HRPowerPoint points[HR_POWER_MAX_POINTS];
+  TEST_ASSERT_EQUAL(3, collector.getPoints(points, HR_POWER_MAX_POINTS));
+  TEST_ASSERT_INT_WITHIN(1, 129, points[0].hr);
+  TEST_ASSERT_INT_WITHIN(2, 100, points[0].watts);
+  TEST_ASSERT_INT_WITHIN(1, 179, points[2].hr);
+  TEST_ASSERT_INT_WITHIN(2, 200, points[2].watts);
+  TEST_ASSERT_TRUE(collector.getR2() > 0.99f);
+  TEST_ASSERT_TRUE(collector.isSettled());
+
+  HRPowerEstimator estimator;
+  estimator.setCalibration(points, 3);
+  TEST_ASSERT_FLOAT_WITHIN(0.1, 2.0, estimator.getGradient());
+}
+
+void test_pwcCollector::test_ignores_unsteady_riding(void) {
+  PWCCollector collector;
+  uint32_t now    = 0;
+  float hr        = 90;
+  int intervals[] = {120, 250, 120, 250, 120, 250, 120, 250};
+  TEST_ASSERT_EQUAL(0, ride(collector, intervals, 8, 60, &now, &hr));
+  HRPowerPoint points[HR_POWER_MAX_POINTS];
+  TEST_ASSERT_EQUAL(0, collector.getPoints(points, HR_POWER_MAX_POINTS));
+
+  // A sensor dropout restarts the settling time.
+  int steady[] = {150};
+  ride(collector, steady, 1, 100, &now, &hr);
+  TEST_ASSERT_TRUE(collector.isSettled());
+  now += (PWC_MAX_GAP + 1) * 1000;
+  collector.update(150, 150, now);
+  TEST_ASSERT_FALSE(collector.isSettled());
+}
+
+void test_pwcCollector::test_refines_saved_sessions(void) {
+  PWCCollector collector;
+  // Sessions the rider measured, on the same line as the rides below.
+  HRPowerPoint saved[] = {{134, 110}, {159, 160}};
+  collector.seed(saved, 2);
+  HRPowerPoint points[HR_POWER_MAX_POINTS];
+  TEST_ASSERT_EQUAL(2, collector.getPoints(points, HR_POWER_MAX_POINTS));
+
+  // One new effort makes three buckets, enough to save.
+  uint32_t now = 0;
+  float hr     = 150;
+  int steps[]  = {250};
+  TEST_ASSERT_EQUAL(1, ride(collector, steps, 1, 200, &now, &hr));
+  TEST_ASSERT_EQUAL(3, collector.getPoints(points, HR_POWER_MAX_POINTS));
+  TEST_ASSERT_INT_WITHIN(1, 204, points[2].hr);
+
+  char buffer[160];
+  JsonWindow window(buffer, sizeof(buffer) - 1, 0);
+  JsonWriter json(window);
+  collector.getSummary().writeJSON(json);
+  buffer[window.size()] = '\0';
+  TEST_ASSERT_NOT_NULL(strstr(buffer, "\"points\":3,"));
+  TEST_ASSERT_NOT_NULL(strstr(buffer, "\"fits\":1}"));
+}
+
+void test_pwcCollector::test_fades_seeded_sessions(void) {
+  PWCCollector collector;
+  // Saved sessions well off the rider's line (79 + watts / 2).
+  HRPowerPoint saved[] = {{160, 100}, {170, 150}};
+  collector.seed(saved, 2);
+
+  // Riding never goes near them: they stay in the first fits, then fade out.
+  uint32_t now = 0;
+  float hr     = 150;
+  int steps[]  = {200, 250, 300};
+  ride(collector, steps, 3, 240, &now, &hr);
+  HRPowerPoint points[HR_POWER_MAX_POINTS];
+  TEST_ASSERT_EQUAL(5, collector.getPoints(points, HR_POWER_MAX_POINTS));
+  TEST_ASSERT_EQUAL(100, points[0].watts);
+  TEST_ASSERT_EQUAL(160, points[0].hr);
+
+  ride(collector, steps, 3, PWC_SEED_FADE_TIME / 3 + PWC_SETTLE_TIME, &now, &hr);
+  size_t count = collector.getPoints(points, HR_POWER_MAX_POINTS);
+  TEST_ASSERT_TRUE(count >= 3);
+  TEST_ASSERT_TRUE(points[0].watts > 175);  // both saved sessions are gone
+  for (size_t i = 0; i < count; i++) {
+    TEST_ASSERT_INT_WITHIN(2, 79 + points[i].watts / 2, points[i].hr);
+  }
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <unity.h>
+#include "Constants.h"
+#include "PacketCapture.h"
+#include "SensorPipeline.h"
+#include "transport/HostTransport.h"
+#include "test.h"
+
+static uint8_t cps0[] = {0x20, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x0b};
+static uint8_t cps1[] = {0x20, 0x00, 0x2d, 0x00, 0x02, 0x00, 0xb8, 0x12};
+static uint8_t hr0[]  = {0x00, 131};
+
+class RecordingSink : public SensorSink {
+ public:
+  std::vector<SensorNotification> received;
+  void onSensorNotification(const SensorNotification &notification) override { received.push_back(notification); }
+};
+
+void test_packetCapture::test_records_ring(void) {
+  // Room for three 8 byte CPS records (13 + 2 + 8 bytes each)
+  PacketCapture capture(3 * 23);
+  capture.record(1000, 0x112233445566ULL, CYCLINGPOWERMEASUREMENT_UUID, cps0, sizeof(cps0));
+  capture.record(1250, 0x112233445566ULL, CYCLINGPOWERMEASUREMENT_UUID, cps1, sizeof(cps1));
+  capture.record(1500, 0x112233445566ULL, CYCLINGPOWERMEASUREMENT_UUID, cps0, sizeof(cps0));
+  TEST_ASSERT_EQUAL(3, capture.size());
+  // Wraps, dropping the oldest
+  capture.record(1750, 0x112233445566ULL, CYCLINGPOWERMEASUREMENT_UUID, cps1, sizeof(cps1));
+  TEST_ASSERT_EQUAL(3, capture.size());
+
+  std::vector<uint8_t> snapshot = capture.snapshot();
+  TEST_ASSERT_EQUAL(8 + 3 * 23, snapshot.size());
+  TEST_ASSERT_EQUAL('S', snapshot[0]);
+  TEST_ASSERT_EQUAL(3, snapshot[6]);
+
+  PacketReplay replay;
+  TEST_ASSERT_TRUE(replay.load(snapshot.data(), snapshot.size()));
+  TEST_ASSERT_EQUAL(3, replay.size());
+  RecordingSink sink;
+  replay.start(0, 1.0);
+  TEST_ASSERT_EQUAL(3, replay.pump(1000, sink));
+  TEST_ASSERT_EQUAL(1250, sink.received[0].timestamp);
+  TEST_ASSERT_EQUAL(1750, sink.received[2].timestamp);
+  TEST_ASSERT_TRUE(sink.received[2].charUUID == CYCLINGPOWERMEASUREMENT_UUID);
+  TEST_ASSERT_EQUAL(0x112233445566ULL, sink.received[2].address);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(cps1, sink.received[2].data, sizeof(cps1));
+
+  capture.setEnabled(false);
+  capture.record(2000, 0, HEARTCHARACTERISTIC_UUID, hr0, sizeof(hr0));
+  TEST_ASSERT_EQUAL(3, capture.size());
+
+  // Corrupt record length
+  snapshot[8] = 200;
+  TEST_ASSERT_FALSE(replay.load(snapshot.data(), snapshot.size()));
+}
+
+void test_packetCapture::test_replays_through_pipeline(void) {
+  PacketCapture capture(1024);
+  NimBLEUUID custom("6e400003-b5a3-f393-e0a9-e50e24dcca9e");
+  capture.record(100, 0x010203040506ULL, CYCLINGPOWERMEASUREMENT_UUID, cps0, sizeof(cps0));
+  capture.record(600, 0x0a0b0c0d0e0fULL, HEARTCHARACTERISTIC_UUID, hr0, sizeof(hr0));
+  capture.record(1100, 0x010203040506ULL, CYCLINGPOWERMEASUREMENT_UUID, cps1, sizeof(cps1));
+  capture.record(1200, 0x010203040506ULL, custom, cps1, 3);
+  std::vector<uint8_t> snapshot = capture.snapshot();
+
+  PacketReplay replay;
+  TEST_ASSERT_TRUE(replay.load(snapshot.data(), snapshot.size()));
+  HostRideMetrics metrics;
+  SensorPipeline pipeline(metrics);
+  // 4x speed: records due at 5000, 5125, 5250 and 5275
+  replay.start(5000, 4.0);
+  TEST_ASSERT_EQUAL(5000, replay.nextDue());
+  TEST_ASSERT_EQUAL(1, replay.pump(5000, pipeline));
+  TEST_ASSERT_EQUAL(5125, replay.nextDue());
+  TEST_ASSERT_EQUAL(1, replay.pump(5200, pipeline));
+  TEST_ASSERT_EQUAL(131, metrics.get(RideMetrics::HEART_RATE));
+  TEST_ASSERT_EQUAL(2, replay.pump(5300, pipeline));
+  TEST_ASSERT_TRUE(replay.finished());
+  TEST_ASSERT_EQUAL(45, metrics.get(RideMetrics::POWER));
+  TEST_ASSERT_EQUAL(4, pipeline.getStats().sensorNotifications);
+}
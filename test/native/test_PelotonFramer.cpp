@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include <cstring>
+#include "Constants.h"
+#include "PelotonFramer.h"
+#include "sensors/PelotonData.h"
+#include "test.h"
+
+// Responses for 150.0 W, 88 rpm and 42% resistance, digits least significant first.
+static uint8_t power[]      = {PELOTON_HEADER, PELOTON_POW_ID, 0x04, '0', '0', '5', '1', 0x00, PELOTON_FOOTER};
+static uint8_t cadence[]    = {PELOTON_HEADER, PELOTON_CAD_ID, 0x03, '8', '8', '0', 0x00, PELOTON_FOOTER};
+static uint8_t resistance[] = {PELOTON_HEADER, PELOTON_RES_ID, 0x03, '2', '4', '0', 0x00, PELOTON_FOOTER};
+// Our own power request, as heard on a shared line.
+static uint8_t request[] = {PELOTON_REQUEST, PELOTON_POW_ID, (PELOTON_REQUEST + PELOTON_POW_ID) % 256, PELOTON_FOOTER};
+
+static void setChecksum(uint8_t *frame, size_t length) {
+  uint8_t sum = 0;
+  for (size_t i = 0; i < length - 2; i++) {
+    sum += frame[i];
+  }
+  frame[length - 2] = sum;
+}
+
+// Pushes the bytes and decodes every frame, returns the number of frames.
+static int feed(PelotonFramer &framer, PelotonData &sensor, const uint8_t *data, size_t length) {
+  int found = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (framer.push(data[i])) {
+      sensor.decode(const_cast<uint8_t *>(framer.getFrame().data), framer.getFrame().length);
+      found++;
+    }
+  }
+  return found;
+}
+
+void test_pelotonFramer::test_frames_split_reads(void) {
+  setChecksum(power, sizeof(power));
+  setChecksum(cadence, sizeof(cadence));
+  setChecksum(resistance, sizeof(resistance));
+  PelotonFramer framer;
+  PelotonData sensor;
+
+  TEST_ASSERT_EQUAL(0, feed(framer, sensor, request, sizeof(request)));
+  TEST_ASSERT_EQUAL(0, feed(framer, sensor, power, 4));
+  TEST_ASSERT_EQUAL(1, feed(framer, sensor, power + 4, sizeof(power) - 4));
+  TEST_ASSERT_EQUAL(150, sensor.getPower());
+  TEST_ASSERT_EQUAL(sizeof(power), framer.getFrame().length);
+
+  uint8_t stream[sizeof(cadence) + sizeof(resistance)];
+  memcpy(stream, cadence, sizeof(cadence));
+  memcpy(stream + sizeof(cadence), resistance, sizeof(resistance));
+  TEST_ASSERT_EQUAL(2, feed(framer, sensor, stream, sizeof(stream)));
+  TEST_ASSERT_EQUAL_FLOAT(88, sensor.getCadence());
+  TEST_ASSERT_EQUAL(42, sensor.getResistance());
+  TEST_ASSERT_EQUAL(3, framer.getFrames());
+  TEST_ASSERT_EQUAL(0, framer.getErrors());
+  TEST_ASSERT_EQUAL(sizeof(request), framer.getSkippedBytes());
+}
+
+void test_pelotonFramer::test_rejects_damaged_frames(void) {
+  setChecksum(power, sizeof(power));
+  setChecksum(cadence, sizeof(cadence));
+  PelotonFramer framer;
+  PelotonData sensor;
+
+  uint8_t damaged[sizeof(power)];
+  memcpy(damaged, power, sizeof(power));
+  damaged[4] = '9';
+  TEST_ASSERT_EQUAL(0, feed(framer, sensor, damaged, sizeof(damaged)));
+  TEST_ASSERT_EQUAL(1, framer.getErrors());
+
+  // A frame cut short by the next one, and a stray header right before a frame.
+  uint8_t stream[4 + 1 + sizeof(cadence)];
+  memcpy(stream, power, 4);
+  stream[4] = PELOTON_HEADER;
+  memcpy(stream + 5, cadence, sizeof(cadence));
+  TEST_ASSERT_EQUAL(1, feed(framer, sensor, stream, sizeof(stream)));
+  TEST_ASSERT_EQUAL_FLOAT(88, sensor.getCadence());
+
+  // Lengths that can't be a Peloton response.
+  uint8_t tooLong[] = {PELOTON_HEADER, PELOTON_POW_ID, PELOTON_MAX_PAYLOAD + 1};
+  uint32_t errors   = framer.getErrors();
+  TEST_ASSERT_EQUAL(0, feed(framer, sensor, tooLong, sizeof(tooLong)));
+  TEST_ASSERT_EQUAL(errors + 1, framer.getErrors());
+  TEST_ASSERT_EQUAL(1, feed(framer, sensor, power, sizeof(power)));
+  TEST_ASSERT_EQUAL(150, sensor.getPower());
+}
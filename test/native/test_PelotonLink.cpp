@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include "Constants.h"
+#include "PelotonLink.h"
+#include "sensors/PelotonData.h"
+#include "transport/HostSerial.h"
+#include "transport/HostTransport.h"
+#include "test.h"
+
+// Decodes every frame the link hands on, like BLECommunications does.
+struct BikeReadings {
+  PelotonData data;
+  int frames = 0;
+  int power  = 0;
+
+  PelotonLink::FrameHandler handler() {
+    return [this](const PelotonFramer::Frame &frame) {
+      PelotonFramer::Frame copy = frame;
+      data.decode(copy.data, copy.length);
+      frames++;
+      power += frame.data[PELOTON_REQ_POS] == PELOTON_POW_ID;
+    };
+  }
+};
+
+// Runs the link for the given time: the UART delivers bytes every ms and the
+// maintenance loop ticks every 73 ms.
+static void ride(VirtualClock &clock, PelotonLink &link, BikeReadings &readings, uint32_t millis) {
+  uint32_t end = clock.now() + millis;
+  while (clock.now() < end) {
+    link.receive(clock.now(), readings.handler());
+    if (clock.now() % 73 == 0) {
+      link.tick(clock.now());
+    }
+    clock.advance(1);
+  }
+}
+
+void test_pelotonLink::test_reads_bike_values(void) {
+  VirtualClock clock;
+  PelotonEmulator bike(clock);
+  bike.setPower(187.3);
+  bike.setCadence(92);
+  bike.setResistance(41);
+  bike.setLatency(20);
+  bike.setChunkSize(3);
+  PelotonLink link(bike);
+  BikeReadings readings;
+
+  ride(clock, link, readings, 1000);
+  TEST_ASSERT_TRUE(link.isConnected());
+  TEST_ASSERT_EQUAL(187, readings.data.getPower());
+  TEST_ASSERT_EQUAL_FLOAT(92, readings.data.getCadence());
+  TEST_ASSERT_EQUAL(41, readings.data.getResistance());
+  // A request per reply, where the fixed 73 ms tick managed 13 a second.
+  TEST_ASSERT_INT_WITHIN(1, bike.getReplies(), readings.frames);  // the last one may still be on its way
+  TEST_ASSERT_TRUE(readings.frames >= 45);
+  TEST_ASSERT_EQUAL(0, bike.getBadRequests());
+
+  // ERG mode asks for power every other request.
+  link.setErgMode(true);
+  readings.power  = 0;
+  readings.frames = 0;
+  ride(clock, link, readings, 1000);
+  TEST_ASSERT_TRUE(readings.power * 2 >= readings.frames - 1);
+}
+
+void test_pelotonLink::test_survives_line_noise(void) {
+  VirtualClock clock;
+  PelotonEmulator bike(clock, 42);
+  bike.setPower(250);
+  bike.setCadence(85);
+  bike.setResistance(50);
+  bike.setNoise(2);
+  bike.setCorruption(20);
+  bike.setDropRate(5);
+  bike.setLatency(15);
+  bike.setChunkSize(5);
+  PelotonLink link(bike);
+  BikeReadings readings;
+
+  ride(clock, link, readings, 10000);
+  TEST_ASSERT_TRUE(bike.getCorrupted() > 0);
+  TEST_ASSERT_TRUE(bike.getDropped() > 0);
+  // Every damaged reply is rejected, the rest come through.
+  TEST_ASSERT_INT_WITHIN(1, bike.getReplies() - bike.getCorrupted(), readings.frames);
+  TEST_ASSERT_TRUE(link.getFramer().getErrors() > 0);
+  TEST_ASSERT_TRUE(link.isConnected());
+  TEST_ASSERT_INT_WITHIN(2, 250, readings.data.getPower());
+  TEST_ASSERT_FLOAT_WITHIN(2, 85, readings.data.getCadence());
+  TEST_ASSERT_INT_WITHIN(2, 50, readings.data.getResistance());
+
+  PelotonScheduler::Stats stats = link.getStats();
+  TEST_ASSERT_TRUE(stats.timeouts > 0);
+  TEST_ASSERT_FLOAT_WITHIN(2, 15, stats.latency[PelotonScheduler::POWER]);
+}
+
+void test_pelotonLink::test_reconnects_after_unplug(void) {
+  VirtualClock clock;
+  PelotonEmulator bike(clock);
+  bike.setPower(120);
+  PelotonLink link(bike);
+  BikeReadings readings;
+
+  ride(clock, link, readings, 500);
+  TEST_ASSERT_TRUE(link.isConnected());
+
+  bike.setConnected(false);
+  ride(clock, link, readings, 3000);
+  TEST_ASSERT_FALSE(link.isConnected());
+  // Only probed once a second while it's gone.
+  uint32_t requests = bike.getRequests();
+  ride(clock, link, readings, 3000);
+  TEST_ASSERT_INT_WITHIN(1, 3, bike.getRequests() - requests);
+
+  bike.setConnected(true);
+  ride(clock, link, readings, 1500);
+  TEST_ASSERT_TRUE(link.isConnected());
+
+  // Nothing is sent while another device polls the bike.
+  link.setRequesting(false);
+  ride(clock, link, readings, 500);
+  requests = bike.getRequests();
+  ride(clock, link, readings, 1000);
+  TEST_ASSERT_EQUAL(requests, bike.getRequests());
+}
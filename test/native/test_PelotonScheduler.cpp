@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include "Constants.h"
+#include "PelotonScheduler.h"
+#include "test.h"
+
+void test_pelotonScheduler::test_pipelines_requests(void) {
+  PelotonScheduler scheduler;
+  uint8_t id = scheduler.poll(0);
+  TEST_ASSERT_EQUAL(PELOTON_POW_ID, id);
+  id = scheduler.poll(73);
+  TEST_ASSERT_EQUAL(0, id);  // still waiting
+  id = scheduler.onResponse(PELOTON_POW_ID, 90);
+  TEST_ASSERT_EQUAL(PELOTON_CAD_ID, id);
+  TEST_ASSERT_TRUE(scheduler.isConnected());
+  id = scheduler.onResponse(PELOTON_CAD_ID, 110);
+  TEST_ASSERT_EQUAL(PELOTON_RES_ID, id);
+  id = scheduler.onResponse(PELOTON_RES_ID, 140);
+  TEST_ASSERT_EQUAL(PELOTON_POW_ID, id);
+
+  PelotonScheduler::Stats stats = scheduler.getStats();
+  TEST_ASSERT_EQUAL(4, stats.requests);
+  TEST_ASSERT_EQUAL(3, stats.responses);
+  TEST_ASSERT_EQUAL_FLOAT(90, stats.latency[PelotonScheduler::POWER]);
+  TEST_ASSERT_EQUAL_FLOAT(20, stats.latency[PelotonScheduler::CADENCE]);
+  TEST_ASSERT_EQUAL_FLOAT(30, stats.latency[PelotonScheduler::RESISTANCE]);
+
+  uint8_t request[PELOTON_RQ_SIZE];
+  PelotonScheduler::buildRequest(PELOTON_CAD_ID, request);
+  uint8_t expected[] = {PELOTON_REQUEST, PELOTON_CAD_ID, (PELOTON_REQUEST + PELOTON_CAD_ID) % 256, PELOTON_FOOTER};
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, request, PELOTON_RQ_SIZE);
+}
+
+void test_pelotonScheduler::test_prioritizes_power_in_erg(void) {
+  PelotonScheduler scheduler;
+  scheduler.setErgMode(true);
+  // The bike answers in 20 ms, the maintenance loop polls every 73 ms.
+  int power    = 0;
+  uint32_t now = 0;
+  uint8_t id   = scheduler.poll(now);
+  while (now < 1000) {
+    power += id == PELOTON_POW_ID;
+    now += 20;
+    id = scheduler.onResponse(id, now);
+  }
+  // Half the requests, where polling every 73 ms got a third of 13.
+  TEST_ASSERT_EQUAL(25, power);
+  TEST_ASSERT_TRUE(power > 2 * (1000 / 73 / 3));
+}
+
+void test_pelotonScheduler::test_detects_disconnect(void) {
+  PelotonScheduler scheduler;
+  uint8_t id = scheduler.poll(0);
+  scheduler.onResponse(id, 20);  // heard from the bike, the next request is waiting
+  TEST_ASSERT_TRUE(scheduler.isConnected());
+
+  // The bike goes quiet.
+  uint32_t now = 20;
+  while (scheduler.getStats().timeouts < PELOTON_MAX_MISSES - 1) {
+    now += 10;
+    scheduler.poll(now);
+  }
+  TEST_ASSERT_TRUE(scheduler.isConnected());
+  while (scheduler.isConnected()) {
+    now += 10;
+    id = scheduler.poll(now);
+  }
+  TEST_ASSERT_EQUAL(PELOTON_MAX_MISSES, scheduler.getStats().timeouts);
+  TEST_ASSERT_EQUAL(20 + PELOTON_MAX_MISSES * PELOTON_RESPONSE_TIMEOUT, now);
+  TEST_ASSERT_NOT_EQUAL(0, id);  // the first probe
+
+  // Probed once a second until it answers again.
+  id = scheduler.poll(now + PELOTON_RESPONSE_TIMEOUT);
+  TEST_ASSERT_EQUAL(0, id);
+  id = scheduler.poll(now + PELOTON_PROBE_INTERVAL - 1);
+  TEST_ASSERT_EQUAL(0, id);
+  id = scheduler.poll(now + PELOTON_PROBE_INTERVAL);
+  TEST_ASSERT_NOT_EQUAL(0, id);
+  id = scheduler.onResponse(id, now + PELOTON_PROBE_INTERVAL + 20);
+  TEST_ASSERT_NOT_EQUAL(0, id);
+  TEST_ASSERT_TRUE(scheduler.isConnected());
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include "ScanResultCache.h"
+#include "test.h"
+
+// Flags, complete 16 bit UUID list (0x1818), complete name "Pedal \"L\""
+static uint8_t pedal[] = {0x02, 0x01, 0x06, 0x03, 0x03, 0x18, 0x18, 0x0a, 0x09, 'P', 'e', 'd', 'a', 'l', ' ', '"', 'L', '"'};
+// Heart rate service, no name (e.g. a scan response arriving first).
+static uint8_t hrm[] = {0x03, 0x03, 0x0d, 0x18};
+
+void test_scanResultCache::test_updates_entries(void) {
+  AdvertisementFilter filter;
+  ScanResultCache cache;
+  ScanResultCache::Entry entry;
+
+  cache.update(0xe8fe6e919f16, 0, filter.evaluate(pedal, sizeof(pedal)), -60, 1000);
+  cache.update(0xe8fe6e919f16, 0, filter.evaluate(hrm, sizeof(hrm)), -80, 2000);
+  TEST_ASSERT_EQUAL(1, cache.size());
+  TEST_ASSERT_TRUE(cache.find(0xe8fe6e919f16, &entry));
+  TEST_ASSERT_EQUAL_STRING("Pedal \"L\"", entry.name);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, -65.0, entry.rssi);
+  TEST_ASSERT_EQUAL(2000, entry.lastSeen);
+  TEST_ASSERT_EQUAL(2, entry.timesSeen);
+  TEST_ASSERT_EQUAL(AdvertisementFilter::HEART_MONITOR, entry.category);
+  TEST_ASSERT_FALSE(cache.find(0x1, &entry));
+
+  // Evicts the least recently seen device once full.
+  for (uint64_t i = 0; i < SCAN_RESULT_CACHE_SIZE; i++) {
+    cache.update(0x100 + i, 0, filter.evaluate(hrm, sizeof(hrm)), -70, 3000 + i);
+  }
+  TEST_ASSERT_EQUAL(SCAN_RESULT_CACHE_SIZE, cache.size());
+  TEST_ASSERT_FALSE(cache.find(0xe8fe6e919f16, &entry));
+  TEST_ASSERT_TRUE(cache.find(0x100, &entry));
+}
+
+void test_scanResultCache::test_serializes_json(void) {
+  AdvertisementFilter filter;
+  ScanResultCache cache;
+  char json[256];
+
+  TEST_ASSERT_EQUAL(2, cache.toJSON(json, sizeof(json), 0, 1000));
+  TEST_ASSERT_EQUAL_STRING("{}", json);
+
+  cache.update(0xe8fe6e919f16, 0, filter.evaluate(pedal, sizeof(pedal)), -60, 1000);
+  cache.update(0x0000000000aa, 0, filter.evaluate(hrm, sizeof(hrm)), -70, 5000);
+  size_t length = cache.toJSON(json, sizeof(json), 6000, 60000);
+  TEST_ASSERT_EQUAL(strlen(json), length);
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"device 0\":{\"address\":\"e8:fe:6e:91:9f:16\",\"name\":\"Pedal \\\"L\\\"\",\"UUID\":\"0x1818\",\"rssi\":-60,\"age\":5},"
+      "\"device 1\":{\"address\":\"00:00:00:00:00:aa\",\"UUID\":\"0x180d\",\"rssi\":-70,\"age\":1}}",
+      json);
+
+  // Stale entries are left out and truncation still reports the full length.
+  cache.toJSON(json, sizeof(json), 6000, 2000);
+  TEST_ASSERT_EQUAL_STRING("{\"device 0\":{\"address\":\"00:00:00:00:00:aa\",\"UUID\":\"0x180d\",\"rssi\":-70,\"age\":1}}", json);
+  TEST_ASSERT_EQUAL(length, cache.toJSON(json, 10, 6000, 60000));
+  TEST_ASSERT_EQUAL(9, strlen(json));
+
+  uint8_t binary[64];
+  TEST_ASSERT_EQUAL(1 + 12 + 9 + 12, cache.toBinary(binary, sizeof(binary), 6000, 60000));
+  TEST_ASSERT_EQUAL(2, binary[0]);
+  TEST_ASSERT_EQUAL(0x16, binary[1]);
+  TEST_ASSERT_EQUAL(0xe8, binary[6]);
+  TEST_ASSERT_EQUAL((uint8_t)-60, binary[9]);
+  TEST_ASSERT_EQUAL(5, binary[10]);
+  TEST_ASSERT_EQUAL(9, binary[12]);
+  TEST_ASSERT_EQUAL(1, cache.toBinary(binary, 20, 6000, 60000));
+}
+
+void test_scanResultCache::test_finds_selected(void) {
+  AdvertisementFilter filter;
+  filter.configure(DeviceSelection("Pedal \"L\""), DeviceSelection("any"), DeviceSelection("none"));
+  ScanResultCache cache;
+  ScanResultCache::Entry entry;
+
+  cache.update(0x0000000000aa, 0, filter.evaluate(hrm, sizeof(hrm)), -70, 1000);
+  cache.update(0x0000000000bb, 0, filter.evaluate(hrm, sizeof(hrm)), -70, 2000);
+  pedal[9] = 'M';  // another power meter, not the selected one
+  cache.update(0x0000000000cc, 0, filter.evaluate(pedal, sizeof(pedal)), -60, 2500);
+  pedal[9] = 'P';
+  TEST_ASSERT_TRUE(cache.findSelected(AdvertisementFilter::HEART_MONITOR, 3000, 5000, &entry));
+  TEST_ASSERT_EQUAL(0xbb, entry.address);
+  TEST_ASSERT_FALSE(cache.findSelected(AdvertisementFilter::POWER_METER, 3000, 5000, &entry));
+
+  cache.update(0xe8fe6e919f16, 0, filter.evaluate(pedal, sizeof(pedal)), -60, 2800);
+  TEST_ASSERT_TRUE(cache.findSelected(AdvertisementFilter::POWER_METER, 3000, 5000, &entry));
+  TEST_ASSERT_EQUAL(0xe8fe6e919f16, entry.address);
+  // Too old
+  TEST_ASSERT_FALSE(cache.findSelected(AdvertisementFilter::HEART_MONITOR, 9000, 5000, &entry));
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstring>
+#include <unity.h>
+#include "Constants.h"
+#include "SensorPipeline.h"
+#include "sensors/FitnessMachineIndoorBikeData.h"
+#include "transport/HostTransport.h"
+#include "test.h"
+
+// Same Assioma Uno session as test_CyclePowerData
+static uint8_t cps0[] = {0x20, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x0b};
+static uint8_t cps1[] = {0x20, 0x00, 0x2d, 0x00, 0x02, 0x00, 0xb8, 0x12};
+static uint8_t cps2[] = {0x20, 0x00, 0x2e, 0x00, 0x03, 0x00, 0xae, 0x17};
+static uint8_t cps3[] = {0x20, 0x00, 0x39, 0x00, 0x05, 0x00, 0x31, 0x20};
+static uint8_t hr0[]  = {0x00, 120};
+static uint8_t hr1[]  = {0x00, 125};
+
+// Communications loop period of the firmware (BLE_NOTIFY_DELAY)
+static const uint32_t NOTIFY_PERIOD = 503;
+
+void test_sensorPipeline::test_runs_end_to_end(void) {
+  VirtualClock clock;
+  FakePeripheral powerMeter(0x112233445566ULL, CYCLINGPOWERSERVICE_UUID, CYCLINGPOWERMEASUREMENT_UUID);
+  powerMeter.record(0, cps0, sizeof(cps0));
+  powerMeter.record(500, cps1, sizeof(cps1));
+  powerMeter.record(1000, cps2, sizeof(cps2));
+  powerMeter.record(1500, cps3, sizeof(cps3));
+  FakePeripheral heartMonitor(0xaabbccddeeffULL, HEARTSERVICE_UUID, HEARTCHARACTERISTIC_UUID);
+  heartMonitor.record(0, hr0, sizeof(hr0));
+  heartMonitor.record(1000, hr1, sizeof(hr1));
+  heartMonitor.setRepeat(2000);
+
+  FakeCentral app(clock);
+  app.subscribe(FITNESSMACHINEINDOORBIKEDATA_UUID);
+  app.subscribe(HEARTCHARACTERISTIC_UUID);
+
+  HostRideMetrics metrics;
+  SensorPipeline pipeline(metrics);
+  // ERG stand-in: one resistance step per pass towards the target.
+  const float targetWatts = 100;
+  pipeline.setControlStep([targetWatts](RideMetrics &metrics, uint32_t now) {
+    float watts      = metrics.get(RideMetrics::POWER);
+    float resistance = metrics.get(RideMetrics::RESISTANCE);
+    if (watts < targetWatts) {
+      metrics.set(RideMetrics::RESISTANCE, resistance + 1);
+    } else if (watts > targetWatts) {
+      metrics.set(RideMetrics::RESISTANCE, resistance - 1);
+    }
+  });
+
+  powerMeter.start(clock.now());
+  heartMonitor.start(clock.now());
+  uint32_t nextUpdate = NOTIFY_PERIOD;
+  while (clock.now() < 10000) {
+    clock.advance(1);
+    powerMeter.pump(clock.now(), pipeline);
+    heartMonitor.pump(clock.now(), pipeline);
+    if (clock.now() >= nextUpdate) {
+      pipeline.update(clock.now(), app);
+      nextUpdate += NOTIFY_PERIOD;
+    }
+  }
+
+  TEST_ASSERT_TRUE(powerMeter.finished());
+  TEST_ASSERT_FALSE(heartMonitor.finished());
+  TEST_ASSERT_EQUAL(4 + 11, pipeline.getStats().sensorNotifications);
+  TEST_ASSERT_EQUAL(19, app.count(FITNESSMACHINEINDOORBIKEDATA_UUID));
+  TEST_ASSERT_EQUAL(19, app.count(HEARTCHARACTERISTIC_UUID));
+  TEST_ASSERT_EQUAL(0, app.count(CYCLINGPOWERMEASUREMENT_UUID));
+  TEST_ASSERT_TRUE(pipeline.getStats().maxLatency <= NOTIFY_PERIOD);
+
+  // What the app sees decodes back to what the sensors sent.
+  const FakeCentral::Received *last = app.last(FITNESSMACHINEINDOORBIKEDATA_UUID);
+  TEST_ASSERT_NOT_NULL(last);
+  std::vector<uint8_t> data = last->data;
+  FitnessMachineIndoorBikeData ibd;
+  ibd.decode(data.data(), data.size());
+  TEST_ASSERT_EQUAL(57, ibd.getPower());
+  TEST_ASSERT_EQUAL(125, ibd.getHeartRate());
+  TEST_ASSERT_EQUAL(19, ibd.getResistance());
+  TEST_ASSERT_EQUAL(19 * NOTIFY_PERIOD, last->timestamp);
+}
+
+void test_sensorPipeline::test_applies_sources(void) {
+  HostRideMetrics metrics;
+  SensorPipeline pipeline(metrics);
+  SensorPipeline::Sources sources;
+  sources.powerCorrectionFactor = 1.5;
+  sources.powerMeterSelected    = true;
+  sources.pelotonResistance     = true;
+  pipeline.setSources(sources);
+  const uint64_t powerMeter = 0x010203040506ULL;
+  const uint64_t bike       = 0x0a0b0c0d0e0fULL;
+  const uint64_t peloton    = 0;
+
+  // The user's simulated heart rate wins over the monitor.
+  metrics.setSimulated(RideMetrics::HEART_RATE, true);
+  metrics.set(RideMetrics::HEART_RATE, 90);
+  uint8_t hr[] = {0x00, 120};
+  TEST_ASSERT_EQUAL(0, pipeline.apply(HEARTCHARACTERISTIC_UUID, 0xaabbccddeeffULL, hr, sizeof(hr), 0));
+  TEST_ASSERT_EQUAL_FLOAT(90, metrics.get(RideMetrics::HEART_RATE));
+
+  uint8_t first[sizeof(cps2)];
+  uint8_t second[sizeof(cps3)];
+  memcpy(first, cps2, sizeof(cps2));
+  memcpy(second, cps3, sizeof(cps3));
+  pipeline.apply(CYCLINGPOWERMEASUREMENT_UUID, powerMeter, first, sizeof(first), 0);
+  char log[64];
+  uint8_t applied = pipeline.apply(CYCLINGPOWERMEASUREMENT_UUID, powerMeter, second, sizeof(second), 0, log, sizeof(log));
+  TEST_ASSERT_TRUE(applied & SensorPipeline::APPLIED_POWER);
+  TEST_ASSERT_EQUAL_FLOAT(85, metrics.get(RideMetrics::POWER));
+  TEST_ASSERT_EQUAL(0, strncmp(log, "CPS[", 4));
+  TEST_ASSERT_NOT_NULL(strstr(log, " PW(85) ]"));
+
+  // A power meter is selected, so the Peloton only sets resistance.
+  uint8_t pelotonPower[]      = {PELOTON_HEADER, PELOTON_POW_ID, 4, '0', '0', '0', '2', 0x00, PELOTON_FOOTER};
+  uint8_t pelotonResistance[] = {PELOTON_HEADER, PELOTON_RES_ID, 2, '5', '4', 0x00, PELOTON_FOOTER};
+  applied = pipeline.apply(PELOTON_DATA_UUID, peloton, pelotonPower, sizeof(pelotonPower), 0);
+  TEST_ASSERT_FALSE(applied & (SensorPipeline::APPLIED_POWER | SensorPipeline::APPLIED_CADENCE));
+  TEST_ASSERT_EQUAL_FLOAT(85, metrics.get(RideMetrics::POWER));
+  pipeline.apply(PELOTON_DATA_UUID, peloton, pelotonResistance, sizeof(pelotonResistance), 0);
+  TEST_ASSERT_EQUAL_FLOAT(45, metrics.get(RideMetrics::RESISTANCE));
+
+  // With the Peloton resistance range other sensors don't set resistance.
+  uint8_t ibd[SERVER_DATA_MAX_LENGTH];
+  size_t ibdLength = ServerData::indoorBikeData(90.0, 200, 0, 30, 0, ibd);
+  applied          = pipeline.apply(FITNESSMACHINEINDOORBIKEDATA_UUID, bike, ibd, ibdLength, 0);
+  TEST_ASSERT_FALSE(applied & SensorPipeline::APPLIED_RESISTANCE);
+  TEST_ASSERT_EQUAL_FLOAT(45, metrics.get(RideMetrics::RESISTANCE));
+  TEST_ASSERT_EQUAL_FLOAT(300, metrics.get(RideMetrics::POWER));
+  TEST_ASSERT_EQUAL_FLOAT(90, metrics.get(RideMetrics::CADENCE));
+
+  sources.powerMeterSelected = false;
+  pipeline.setSources(sources);
+  applied = pipeline.apply(PELOTON_DATA_UUID, peloton, pelotonPower, sizeof(pelotonPower), 0);
+  TEST_ASSERT_TRUE(applied & SensorPipeline::APPLIED_POWER);
+  TEST_ASSERT_EQUAL_FLOAT(300, metrics.get(RideMetrics::POWER));
+}
+
+void test_sensorPipeline::test_encodes_server_data(void) {
+  uint8_t out[SERVER_DATA_MAX_LENGTH];
+  TEST_ASSERT_EQUAL(11, ServerData::indoorBikeData(90.0, 200, 140, 30, 0, out));
+  FitnessMachineIndoorBikeData ibd;
+  ibd.decode(out, 11);
+  TEST_ASSERT_EQUAL(200, ibd.getPower());
+  TEST_ASSERT_EQUAL_FLOAT(90.0, ibd.getCadence());
+  TEST_ASSERT_EQUAL(140, ibd.getHeartRate());
+  TEST_ASSERT_EQUAL(30, ibd.getResistance());
+
+  ServerData::CrankRevolutions crank;
+  TEST_ASSERT_EQUAL(9, ServerData::cyclingPowerMeasurement(300, 60.0, crank, out));
+  TEST_ASSERT_EQUAL_HEX8(0x2c, out[2]);
+  TEST_ASSERT_EQUAL_HEX8(0x01, out[3]);
+  TEST_ASSERT_EQUAL(1, out[5]);
+  TEST_ASSERT_EQUAL(1024, out[7] | (out[8] << 8));
+  ServerData::cyclingPowerMeasurement(300, 0, crank, out);
+  TEST_ASSERT_EQUAL(1, crank.cumulative);
+
+  TEST_ASSERT_EQUAL(2, ServerData::heartRateMeasurement(151, out));
+  TEST_ASSERT_EQUAL(151, out[1]);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include <cstring>
+#include "sdkconfig.h"
+#include <unity.h>
+#include "Sha1.h"
+#include "test.h"
+
+static void hashHex(const char *text, char *out) {
+  Sha1 sha;
+  sha.update(reinterpret_cast<const uint8_t *>(text), strlen(text));
+  sha.finishHex(out, 40);
+}
+
+void test_sha1::test_known_digests(void) {
+  char hex[41];
+  hashHex("", hex);
+  TEST_ASSERT_EQUAL_STRING("da39a3ee5e6b4b0d3255bfef95601890afd80709", hex);
+  hashHex("abc", hex);
+  TEST_ASSERT_EQUAL_STRING("a9993e364706816aba3e25717850c26c9cd0d89d", hex);
+  hashHex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", hex);
+  TEST_ASSERT_EQUAL_STRING("84983e441c3bd26ebaae4aa1f95129e5e54670f1", hex);
+}
+
+void test_sha1::test_streams_updates(void) {
+  // One million 'a', fed in odd sized pieces.
+  Sha1 sha;
+  uint8_t block[777];
+  memset(block, 'a', sizeof(block));
+  size_t left = 1000000;
+  while (left > 0) {
+    size_t length = left < sizeof(block) ? left : sizeof(block);
+    sha.update(block, length);
+    left -= length;
+  }
+  char hex[17];
+  sha.finishHex(hex, 16);
+  TEST_ASSERT_EQUAL_STRING("34aa973cd4c4daa4", hex);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include "TelemetryDelta.h"
+#include "test.h"
+
+void test_telemetryDelta::test_sends_deltas(void) {
+  TelemetryDelta telemetry;
+  char frame[128];
+  int watts = telemetry.addField("watts");
+  int speed = telemetry.addField("speed", TelemetryDelta::FLOAT);
+  int simHr = telemetry.addField("simHr", TelemetryDelta::BOOL);
+
+  // First frame is a keyframe.
+  telemetry.set(watts, 212);
+  telemetry.set(speed, 31.456);
+  TEST_ASSERT_EQUAL(41, telemetry.serialize(frame, sizeof(frame), 1000));
+  TEST_ASSERT_EQUAL_STRING("{\"watts\":212,\"speed\":31.46,\"simHr\":false}", frame);
+
+  // Nothing changed, nothing to send.
+  TEST_ASSERT_EQUAL(0, telemetry.serialize(frame, sizeof(frame), 1100));
+
+  telemetry.set(watts, 215);
+  telemetry.set(simHr, true);
+  telemetry.serialize(frame, sizeof(frame), 1200);
+  TEST_ASSERT_EQUAL_STRING("{\"watts\":215,\"simHr\":true}", frame);
+
+  // Keyframes on request and periodically.
+  telemetry.requestKeyframe();
+  telemetry.serialize(frame, sizeof(frame), 1300);
+  TEST_ASSERT_EQUAL_STRING("{\"watts\":215,\"speed\":31.46,\"simHr\":true}", frame);
+  TEST_ASSERT_EQUAL(0, telemetry.serialize(frame, sizeof(frame), 1300 + TELEMETRY_KEYFRAME_MILLIS - 1));
+  TEST_ASSERT_NOT_EQUAL(0, telemetry.serialize(frame, sizeof(frame), 1300 + TELEMETRY_KEYFRAME_MILLIS));
+}
+
+void test_telemetryDelta::test_keeps_unsent_values(void) {
+  TelemetryDelta telemetry;
+  char frame[128];
+  int watts = telemetry.addField("watts");
+  int cad   = telemetry.addField("cad");
+  telemetry.serialize(frame, sizeof(frame), 0);
+
+  // Too small a buffer doesn't lose the change.
+  telemetry.set(watts, 100);
+  telemetry.set(cad, 90);
+  TEST_ASSERT_EQUAL(0, telemetry.serialize(frame, 12, 10));
+  TEST_ASSERT_EQUAL(22, telemetry.serialize(frame, sizeof(frame), 20));
+  TEST_ASSERT_EQUAL_STRING("{\"watts\":100,\"cad\":90}", frame);
+
+  for (int i = telemetry.fieldCount(); i < TELEMETRY_MAX_FIELDS; i++) {
+    TEST_ASSERT_EQUAL(i, telemetry.addField("x"));
+  }
+  TEST_ASSERT_EQUAL(-1, telemetry.addField("full"));
+}
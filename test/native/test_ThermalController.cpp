@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include "ThermalController.h"
+#include "test.h"
+
+// Checks every 800 ms, like the maintenance loop.
+#define CHECK_INTERVAL 800
+
+void test_thermalController::test_derates_in_proportion(void) {
+  ThermalController thermal(85);
+  thermal.setFullCurrent(31);
+  uint32_t now = 0;
+  thermal.update(70, false, true, now);
+  TEST_ASSERT_EQUAL(31, thermal.getRunCurrent());
+  TEST_ASSERT_FALSE(thermal.isDerating());
+
+  // A single hot reading is filtered.
+  thermal.update(100, false, true, now += CHECK_INTERVAL);
+  TEST_ASSERT_FALSE(thermal.isDerating());
+
+  for (int i = 0; i < 50; i++) {
+    thermal.update(91, false, true, now += CHECK_INTERVAL);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.1, 91, thermal.getTemperature());
+  TEST_ASSERT_TRUE(thermal.isDerating());
+  TEST_ASSERT_EQUAL(25, thermal.getRunCurrent());
+
+  // Never below the floor.
+  for (int i = 0; i < 50; i++) {
+    thermal.update(150, false, true, now += CHECK_INTERVAL);
+  }
+  TEST_ASSERT_EQUAL(31 * THERMAL_MIN_RUN_PERCENT / 100, thermal.getRunCurrent());
+
+  // The driver's own warning derates even with a cool ESP32.
+  ThermalController warned(85);
+  warned.setFullCurrent(31);
+  warned.update(60, true, true, 0);
+  TEST_ASSERT_TRUE(warned.isDerating());
+  TEST_ASSERT_EQUAL(31 - THERMAL_WARNING_EXCESS, warned.getRunCurrent());
+}
+
+void test_thermalController::test_does_not_oscillate(void) {
+  ThermalController thermal(85);
+  thermal.setFullCurrent(31);
+  uint32_t now = 0;
+  for (int i = 0; i < 50; i++) {
+    thermal.update(88, false, true, now += CHECK_INTERVAL);
+  }
+  TEST_ASSERT_EQUAL(28, thermal.getRunCurrent());
+
+  // Noisy readings while hot, where the old check stepped on every reading.
+  int changes  = 0;
+  uint8_t last = thermal.getRunCurrent();
+  for (int i = 0; i < 200; i++) {
+    thermal.update(i % 2 ? 89 : 85, false, true, now += CHECK_INTERVAL);
+    changes += thermal.getRunCurrent() != last;
+    last = thermal.getRunCurrent();
+  }
+  TEST_ASSERT_TRUE(changes <= 2);
+  TEST_ASSERT_TRUE(last < 31);
+
+  // Hovering around the throttle temperature, where it switched between full and throttled power.
+  int drops = 0;
+  for (int i = 0; i < 200; i++) {
+    thermal.update(i % 2 ? 87 : 82, false, true, now += CHECK_INTERVAL);
+    drops += thermal.getRunCurrent() < last;
+    last = thermal.getRunCurrent();
+  }
+  TEST_ASSERT_TRUE(thermal.isDerating());
+  TEST_ASSERT_EQUAL(0, drops);
+
+  // Cooled off: back to full power a step at a time.
+  for (int i = 0; i < 50; i++) {
+    thermal.update(60, false, true, now += CHECK_INTERVAL);
+    TEST_ASSERT_TRUE(thermal.getRunCurrent() <= last + 1);
+    last = thermal.getRunCurrent();
+  }
+  TEST_ASSERT_FALSE(thermal.isDerating());
+  TEST_ASSERT_EQUAL(31, thermal.getRunCurrent());
+}
+
+void test_thermalController::test_lowers_idle_hold_current(void) {
+  ThermalController thermal(85);
+  thermal.setFullCurrent(30);
+  uint32_t now = 100000;
+  thermal.update(60, false, true, now);
+  TEST_ASSERT_FALSE(thermal.isIdle());
+  TEST_ASSERT_EQUAL(15, thermal.getHoldCurrent());
+
+  now += THERMAL_IDLE_DELAY - 1;
+  thermal.update(60, false, false, now);
+  TEST_ASSERT_EQUAL(15, thermal.getHoldCurrent());
+  thermal.update(60, false, false, now += 1);
+  TEST_ASSERT_TRUE(thermal.isIdle());
+  TEST_ASSERT_EQUAL(30 * THERMAL_IDLE_HOLD_PERCENT / 100, thermal.getHoldCurrent());
+
+  // Full hold current as soon as ERG moves the knob again.
+  thermal.update(60, false, true, now += CHECK_INTERVAL);
+  TEST_ASSERT_EQUAL(15, thermal.getHoldCurrent());
+
+  // A new stepper power setting applies right away unless it's derating.
+  thermal.setFullCurrent(20);
+  TEST_ASSERT_EQUAL(20, thermal.getRunCurrent());
+  TEST_ASSERT_EQUAL(10, thermal.getHoldCurrent());
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020  Anthony Doud & Joel Baranick
+ * All rights reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "sdkconfig.h"
+#include <unity.h>
+#include "update/UpdateCheck.h"
+#include "test.h"
+
+#define URL   "https://example.com/ota/"
+#define NOW   1700000000UL
+#define HOURS 3600UL
+
+void test_updateCheck::test_parses_versions(void) {
+  Version master("v2.11.7.1");
+  TEST_ASSERT_TRUE(Version("2.11.7.1") == master);
+  TEST_ASSERT_TRUE(Version("v2.11.7.1-3-g1a2b3c4") > master);
+  TEST_ASSERT_TRUE(Version("v2.12.0.0") > Version("v2.11.7.1-3-g1a2b3c4"));
+  TEST_ASSERT_FALSE(master > Version("v2.11.7.1"));
+  TEST_ASSERT_FALSE(Version("v2.11.7") > Version("v2.11.7.0"));
+
+  Version branch("v2.11.7.1-feature-x-4-gdeadbee");
+  TEST_ASSERT_EQUAL_STRING("feature-x", branch.getBranch());
+  TEST_ASSERT_EQUAL_STRING("deadbee", branch.getCommit());
+  TEST_ASSERT_TRUE(Version("v2.11.7.1-feature-x-5-g0123456") > branch);
+  // Never newer across branches.
+  TEST_ASSERT_FALSE(Version("v3.0.0.0") > branch);
+  TEST_ASSERT_EQUAL_STRING("gpio", Version("v1.0.0.0-gpio").getBranch());
+}
+
+void test_updateCheck::test_honors_interval(void) {
+  UpdateCheck check;
+  TEST_ASSERT_TRUE(check.isDue(NOW, 24 * HOURS, URL));
+
+  check.checked(NOW, URL, "v2.11.7.1", "\"abc\"", "Tue, 10 Oct 2023 10:00:00 GMT");
+  TEST_ASSERT_TRUE(check.getAvailable() == Version("v2.11.7.1"));
+  TEST_ASSERT_FALSE(check.isDue(NOW + 23 * HOURS, 24 * HOURS, URL));
+  TEST_ASSERT_TRUE(check.isDue(NOW + 24 * HOURS, 24 * HOURS, URL));
+  TEST_ASSERT_TRUE(check.isDue(NOW, 0, URL));
+  // A new URL, an unsynced clock or one that went back all check again.
+  TEST_ASSERT_TRUE(check.isDue(NOW + HOURS, 24 * HOURS, "https://example.com/other/"));
+  TEST_ASSERT_FALSE(check.isFrom("https://example.com/other/"));
+  TEST_ASSERT_TRUE(check.isDue(12, 24 * HOURS, URL));
+  TEST_ASSERT_TRUE(check.isDue(NOW - HOURS, 24 * HOURS, URL));
+
+  check.notModified(NOW + 30 * HOURS);
+  TEST_ASSERT_FALSE(check.isDue(NOW + 31 * HOURS, 24 * HOURS, URL));
+  TEST_ASSERT_EQUAL_STRING("\"abc\"", check.getETag());
+}
+
+void test_updateCheck::test_round_trips(void) {
+  UpdateCheck check;
+  check.checked(NOW, URL, "v2.11.7.1-2-gabcdef0", "W/\"etag\"", "Tue, 10 Oct 2023 10:00:00 GMT");
+  uint8_t buffer[UPDATE_CHECK_RECORD_SIZE];
+  size_t length = check.write(buffer, sizeof(buffer));
+  TEST_ASSERT_TRUE(length > 0);
+
+  UpdateCheck loaded;
+  TEST_ASSERT_TRUE(loaded.read(buffer, length));
+  TEST_ASSERT_EQUAL(NOW, loaded.getLastCheck());
+  TEST_ASSERT_EQUAL_STRING("W/\"etag\"", loaded.getETag());
+  TEST_ASSERT_EQUAL_STRING("Tue, 10 Oct 2023 10:00:00 GMT", loaded.getLastModified());
+  TEST_ASSERT_TRUE(loaded.getAvailable() == check.getAvailable());
+  TEST_ASSERT_FALSE(loaded.isDue(NOW + HOURS, 24 * HOURS, URL));
+
+  buffer[length - 1] ^= 0xff;
+  TEST_ASSERT_FALSE(loaded.read(buffer, length));
+  TEST_ASSERT_TRUE(loaded.isDue(NOW + HOURS, 24 * HOURS, URL));
+}